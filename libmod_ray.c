@@ -43,6 +43,10 @@ float *g_zbuffer = NULL;
 static GRAPH *render_graph = NULL;
 static GRAPH *lowres_buffer = NULL; // Low-resolution rendering buffer
 
+/* Frame en dos etapas (ver ray_scene_prepare) */
+static int s_scene_explicit = 0;    /* RAY_PREPARE_SCENE abrió el frame */
+static float s_scene_render_ms = 0; /* Suma de las vistas del frame */
+
 /* External functions */
 extern int ray_load_map_v8(const char *filename);
 extern int ray_save_map_v8(const char *filename);
@@ -52,6 +56,7 @@ extern void ray_render_frame_portal_simple(GRAPH *dest);
 extern void
 ray_render_frame_build(GRAPH *dest);          /* Build Engine style renderer */
 extern void ray_render_frame_gpu(void *dest); /* GPU renderer */
+extern void ray_render_build_shutdown(void);   /* Stops band threads */
 static int g_use_gpu = 1;                     // 1=GPU (vitagl/SDL_gpu), 0=Software (Build Engine)
 
 extern void ray_detect_portals(RAY_Engine *engine);
@@ -87,11 +92,12 @@ int64_t libmod_ray_init(INSTANCE *my, int64_t *params) {
   g_engine.displayWidth = screen_w;
   g_engine.displayHeight = screen_h;
 
-  // PERFORMANCE: Internal resolution scaling (DISABLED)
-  // Set to 1.0 for full resolution rendering
-  g_engine.resolutionScale = 1.0f;
-  g_engine.internalWidth = screen_w;
-  g_engine.internalHeight = screen_h;
+  // PERFORMANCE: Internal resolution scaling
+  // 1.0 = full resolution; RAY_SET_RESOLUTION_SCALE / RAY_SET_DYNAMIC_RESOLUTION
+  g_engine.target_frame_ms = 0.0f;
+  g_engine.resolution_min_scale = 0.5f;
+  g_engine.render_frame_ms = 0.0f;
+  ray_set_resolution_scale(1.0f);
 
   printf("RAY: Internal Resolution: %dx%d (%.0f%%)\n", g_engine.internalWidth,
          g_engine.internalHeight, g_engine.resolutionScale * 100.0f);
@@ -129,10 +135,13 @@ int64_t libmod_ray_init(INSTANCE *my, int64_t *params) {
   g_engine.camera.current_sector_id = -1;
 
   /* Inicializar arrays dinámicos */
-  g_engine.sprites_capacity = RAY_MAX_SPRITES;
-  g_engine.sprites =
-      (RAY_Sprite *)calloc(g_engine.sprites_capacity, sizeof(RAY_Sprite));
+  g_engine.sprites = NULL;
+  g_engine.active_sprites = NULL;
+  g_engine.sprites_capacity = 0;
   g_engine.num_sprites = 0;
+  g_engine.num_active_sprites = 0;
+  g_engine.sprite_free_head = -1;
+  ray_sprite_pool_reserve(RAY_MAX_SPRITES);
 
   g_engine.spawn_flags_capacity = RAY_MAX_SPAWN_FLAGS;
   g_engine.spawn_flags = (RAY_SpawnFlag *)calloc(g_engine.spawn_flags_capacity,
@@ -143,12 +152,19 @@ int64_t libmod_ray_init(INSTANCE *my, int64_t *params) {
   g_engine.sectors =
       (RAY_Sector *)calloc(g_engine.sectors_capacity, sizeof(RAY_Sector));
   g_engine.num_sectors = 0;
+  g_engine.sector_id_lookup = NULL;
+  g_engine.sector_id_lookup_size = 0;
 
   g_engine.portals_capacity = RAY_MAX_PORTALS;
   g_engine.portals =
       (RAY_Portal *)calloc(g_engine.portals_capacity, sizeof(RAY_Portal));
   g_engine.num_portals = 0;
 
+  /* Bins de sprites por sector (se reservan al cargar el mapa) */
+  g_engine.sector_sprite_head = NULL;
+  g_engine.sector_sprite_head_capacity = 0;
+  g_engine.outside_sprite_head = -1;
+
   /* Opciones de renderizado por defecto */
   g_engine.drawMiniMap = 1;
   g_engine.drawTexturedFloor = 1;
@@ -175,6 +191,21 @@ int64_t libmod_ray_init(INSTANCE *my, int64_t *params) {
   g_engine.max_portal_depth = 16; /* Aumentado para mejor visibilidad */
   g_engine.portal_rendering_enabled = 1;
 
+  /* Software renderer: single-threaded unless requested */
+  g_engine.render_threads = 1;
+  g_engine.floor_spans = 1;
+  g_engine.mipmaps = 1;
+  g_engine.mip_budget = 32 * 1024 * 1024;
+
+  /* Carga de mapas sin detalle por sector/pared */
+  g_engine.verbose = 0;
+
+  /* Sprites de procesos: sincronizados por RAY_RENDER */
+  g_engine.auto_sync = 1;
+
+  /* Shader de normales: solo las luces que alcanzan cada sector */
+  g_engine.light_culling = RAY_LIGHT_CULL_SECTOR;
+
   /* Billboard */
   g_engine.billboard_enabled = 1;
   g_engine.billboard_directions = 12;
@@ -204,9 +235,12 @@ int64_t libmod_ray_shutdown(INSTANCE *my, int64_t *params) {
   }
 
   /* Liberar sprites */
-  if (g_engine.sprites) {
-    free(g_engine.sprites);
-    g_engine.sprites = NULL;
+  ray_sprite_pool_free();
+
+  /* Liberar bins de sprites */
+  if (g_engine.sector_sprite_head) {
+    free(g_engine.sector_sprite_head);
+    g_engine.sector_sprite_head = NULL;
   }
 
   /* Liberar spawn flags */
@@ -236,6 +270,34 @@ int64_t libmod_ray_shutdown(INSTANCE *my, int64_t *params) {
     g_engine.portals = NULL;
   }
 
+  /* Liberar PVS */
+  ray_free_pvs();
+  ray_lights_free();
+  ray_lightmap_free();
+  ray_mip_clear();
+  ray_gpu_invalidate_textures();
+
+  /* Liberar índices de sectores */
+  ray_sector_grid_free();
+  ray_wall_bvh_free();
+  ray_free_sector_id_lookup(&g_engine);
+  ray_gpu_free_sector_cache();
+  ray_gpu_free_internal_target();
+
+  /* Detener hilos del renderer software */
+  ray_render_build_shutdown();
+  ray_raster_shutdown();
+  ray_model_lod_clear();
+  ray_async_shutdown();
+  ray_trace_shutdown();
+
+  /* Liberar buffers de física */
+  ray_physics_shutdown();
+
+  /* El próximo RAY_RENDER vuelve a preparar su propia escena */
+  s_scene_explicit = 0;
+  s_scene_render_ms = 0;
+
   /* Liberar render graph */
   if (render_graph) {
     bitmap_destroy(render_graph);
@@ -299,132 +361,598 @@ void ray_calculate_all_sector_bounds() {
 
 /* ============================================================================
    STATIC PVS (Potentially Visible Set) BAKING
+   Portal-to-portal flow in 2D (Quake vis style): from every source sector,
+   follow chains of portals and clip each next portal to the anti-penumbra
+   of the source portal seen through the last one. Heights only ever hide
+   more, so the 2D result is conservative. Rows are bitsets over sector
+   indices, stored RLE-compressed (a zero byte is followed by the length of
+   the zero run).
    ============================================================================
  */
 
-static void ray_bake_pvs_recursive(int source_id, int current_id, int depth,
-                                   uint8_t *visited) {
-  if (depth <= 0)
-    return;
+#define RAY_PVS_ON_EPSILON 0.1f   /* Points this close to a line are on it */
+#define RAY_PVS_MIN_LENGTH2 1e-4f /* Clipped portals shorter than this */
+#define RAY_PVS_SIDE_PROBE 1.0f   /* Offset used to find a portal's sides */
+#define RAY_PVS_MAX_CHAIN 256     /* Portals in one line of sight */
+#define RAY_PVS_FLOW_BUDGET 200000 /* Flow steps per source sector */
+#define RAY_PVS_MAX_THREADS 16
+
+typedef struct {
+  float x1, y1, x2, y2;
+} RAY_PvsSeg;
+
+typedef struct {
+  RAY_PvsSeg seg;
+  int sector[2]; /* Sector indices (portal sector_a / sector_b) */
+  int side[2];   /* Side of the portal line each one is on (0 = unknown) */
+} RAY_PvsPortal;
+
+typedef struct {
+  RAY_PvsPortal *portals;
+  int *sector_first; /* Portals of sector i: refs[first[i] .. first[i + 1]) */
+  int *refs;
+  int num_sectors;
+  int row_bytes;
+  uint8_t *matrix; /* num_sectors rows of row_bytes */
+  SDL_atomic_t next_source;
+  SDL_atomic_t fallbacks;
+} RAY_PvsBake;
+
+typedef struct {
+  RAY_PvsBake *bake;
+  uint8_t *on_chain; /* Per portal: already crossed by this line of sight */
+  int *queue;        /* Connectivity fallback */
+  uint8_t *row;
+  int steps;
+  int overflow;
+  SDL_Thread *thread;
+} RAY_PvsWorker;
+
+#define PVS_SET(row, i) ((row)[(i) >> 3] |= (uint8_t)(1u << ((i) & 7)))
+
+/* Signed distance from (x, y) to the line a->b (left side positive) */
+static float pvs_dist(float ax, float ay, float bx, float by, float x,
+                      float y) {
+  float dx = bx - ax, dy = by - ay;
+  float len = sqrtf(dx * dx + dy * dy);
+  if (len < 1e-6f)
+    return 0.0f;
+  return (dx * (y - ay) - dy * (x - ax)) / len;
+}
+
+/* Keep the part of seg with sign * distance >= -epsilon. 0 = nothing left */
+static int pvs_clip_line(RAY_PvsSeg *seg, float ax, float ay, float bx,
+                         float by, float sign) {
+  float e1 =
+      sign * pvs_dist(ax, ay, bx, by, seg->x1, seg->y1) + RAY_PVS_ON_EPSILON;
+  float e2 =
+      sign * pvs_dist(ax, ay, bx, by, seg->x2, seg->y2) + RAY_PVS_ON_EPSILON;
+
+  if (e1 < 0.0f && e2 < 0.0f)
+    return 0;
+  if (e1 < 0.0f || e2 < 0.0f) {
+    float t = e1 / (e1 - e2);
+    float ix = seg->x1 + (seg->x2 - seg->x1) * t;
+    float iy = seg->y1 + (seg->y2 - seg->y1) * t;
+    if (e1 < 0.0f) {
+      seg->x1 = ix;
+      seg->y1 = iy;
+    } else {
+      seg->x2 = ix;
+      seg->y2 = iy;
+    }
+  }
+
+  float dx = seg->x2 - seg->x1, dy = seg->y2 - seg->y1;
+  return dx * dx + dy * dy >= RAY_PVS_MIN_LENGTH2;
+}
+
+static int pvs_clip_front(RAY_PvsSeg *seg, const RAY_PvsSeg *line, int side) {
+  if (!side)
+    return 1; /* Unknown orientation: keep everything */
+  return pvs_clip_line(seg, line->x1, line->y1, line->x2, line->y2,
+                       (float)side);
+}
+
+/* Clip tgt to what can be seen from src through pass: every line through an
+   endpoint of src and an endpoint of pass that leaves the rest of src and
+   of pass on opposite sides bounds the anti-penumbra; keep the pass side. */
+static int pvs_clip_separators(const RAY_PvsSeg *src, const RAY_PvsSeg *pass,
+                               RAY_PvsSeg *tgt) {
+  float sx[2] = {src->x1, src->x2}, sy[2] = {src->y1, src->y2};
+  float px[2] = {pass->x1, pass->x2}, py[2] = {pass->y1, pass->y2};
+
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      float dx = px[j] - sx[i], dy = py[j] - sy[i];
+      if (dx * dx + dy * dy < RAY_PVS_MIN_LENGTH2)
+        continue;
+      float ds = pvs_dist(sx[i], sy[i], px[j], py[j], sx[1 - i], sy[1 - i]);
+      float dp = pvs_dist(sx[i], sy[i], px[j], py[j], px[1 - j], py[1 - j]);
+      float sign;
+      if (ds > RAY_PVS_ON_EPSILON && dp < -RAY_PVS_ON_EPSILON)
+        sign = -1.0f;
+      else if (ds < -RAY_PVS_ON_EPSILON && dp > RAY_PVS_ON_EPSILON)
+        sign = 1.0f;
+      else
+        continue; /* Not a separator */
+      if (!pvs_clip_line(tgt, sx[i], sy[i], px[j], py[j], sign))
+        return 0;
+    }
+  }
+  return 1;
+}
 
-  // Mark as visible
-  // Matrix is flat: [source * num_sectors + current]
-  int idx = source_id * g_engine.num_sectors + current_id;
-  g_engine.pvs_matrix[idx] = 1;
+/* Side of the portal line the sector lies on, probing just off its middle */
+static int pvs_sector_side(const RAY_PvsSeg *seg, int sector_index) {
+  if (sector_index < 0)
+    return 0;
+  float dx = seg->x2 - seg->x1, dy = seg->y2 - seg->y1;
+  float len = sqrtf(dx * dx + dy * dy);
+  if (len < 1e-6f)
+    return 0;
+  float nx = -dy / len * RAY_PVS_SIDE_PROBE;
+  float ny = dx / len * RAY_PVS_SIDE_PROBE;
+  float mx = (seg->x1 + seg->x2) * 0.5f, my = (seg->y1 + seg->y2) * 0.5f;
 
-  RAY_Sector *sector = &g_engine.sectors[current_id];
+  RAY_Sector *sector = &g_engine.sectors[sector_index];
+  int front = ray_point_in_sector_local(sector, mx + nx, my + ny);
+  int back = ray_point_in_sector_local(sector, mx - nx, my - ny);
+  if (front == back)
+    return 0;
+  return front ? 1 : -1;
+}
+
+static void pvs_flow(RAY_PvsWorker *w, int cur, const RAY_PvsSeg *src,
+                     int src_side, const RAY_PvsSeg *pass, int pass_side,
+                     int depth) {
+  RAY_PvsBake *bake = w->bake;
+  PVS_SET(w->row, cur);
+
+  if (w->overflow)
+    return;
+  if (++w->steps > RAY_PVS_FLOW_BUDGET || depth >= RAY_PVS_MAX_CHAIN) {
+    w->overflow = 1;
+    return;
+  }
 
-  // Traverse portals
-  for (int p = 0; p < sector->num_portals; p++) {
-    int portal_id = sector->portal_ids[p];
-    if (portal_id < 0 || portal_id >= g_engine.num_portals)
+  for (int r = bake->sector_first[cur]; r < bake->sector_first[cur + 1];
+       r++) {
+    int pi = bake->refs[r];
+    if (w->on_chain[pi])
+      continue;
+    const RAY_PvsPortal *portal = &bake->portals[pi];
+    int k = (portal->sector[0] == cur) ? 1 : 0;
+    int next = portal->sector[k];
+    if (next < 0 || next == cur)
       continue;
 
-    RAY_Portal *portal = &g_engine.portals[portal_id];
+    /* The line of sight is in front of every portal it has crossed */
+    RAY_PvsSeg tgt = portal->seg;
+    if (!pvs_clip_front(&tgt, src, src_side))
+      continue;
+    RAY_PvsSeg new_src = *src;
+    if (pass != src) {
+      if (!pvs_clip_front(&tgt, pass, pass_side))
+        continue;
+      if (!pvs_clip_separators(src, pass, &tgt))
+        continue;
+      /* And only the part of the source that sees tgt matters further on */
+      if (!pvs_clip_separators(&tgt, pass, &new_src))
+        continue;
+    }
 
-    int next_id = -1;
-    if (portal->sector_a == current_id)
-      next_id = portal->sector_b;
-    else if (portal->sector_b == current_id)
-      next_id = portal->sector_a;
+    w->on_chain[pi] = 1;
+    pvs_flow(w, next, &new_src, src_side, &tgt, portal->side[k], depth + 1);
+    w->on_chain[pi] = 0;
+    if (w->overflow)
+      return;
+  }
+}
 
-    if (next_id != -1 && !visited[next_id]) {
-      visited[next_id] = 1;
-      // Recurse with decremented depth
-      ray_bake_pvs_recursive(source_id, next_id, depth - 1, visited);
-      visited[next_id] = 0;
+/* Too many portal chains: fall back to plain connectivity for this row */
+static void pvs_flood(RAY_PvsWorker *w, int source) {
+  RAY_PvsBake *bake = w->bake;
+  int head = 0, tail = 0;
+  w->queue[tail++] = source;
+  PVS_SET(w->row, source);
+  while (head < tail) {
+    int cur = w->queue[head++];
+    for (int r = bake->sector_first[cur]; r < bake->sector_first[cur + 1];
+         r++) {
+      const RAY_PvsPortal *portal = &bake->portals[bake->refs[r]];
+      int next = (portal->sector[0] == cur) ? portal->sector[1]
+                                            : portal->sector[0];
+      if (next < 0 || RAY_PVS_TEST(w->row, next))
+        continue;
+      PVS_SET(w->row, next);
+      w->queue[tail++] = next;
     }
   }
 }
 
-// Helper function to recursively mark all descendants as visible
-static void mark_descendants_visible(int ancestor_idx, int descendant_idx) {
-  // Mark ancestor->descendant as visible
-  g_engine.pvs_matrix[ancestor_idx * g_engine.num_sectors + descendant_idx] = 1;
-  // Mark descendant->ancestor as visible (bidirectional)
-  g_engine.pvs_matrix[descendant_idx * g_engine.num_sectors + ancestor_idx] = 1;
+static void pvs_bake_source(RAY_PvsWorker *w, int source) {
+  RAY_PvsBake *bake = w->bake;
+  w->row = bake->matrix + (size_t)source * bake->row_bytes;
+  w->steps = 0;
+  w->overflow = 0;
+  PVS_SET(w->row, source);
+
+  for (int r = bake->sector_first[source];
+       r < bake->sector_first[source + 1] && !w->overflow; r++) {
+    int pi = bake->refs[r];
+    const RAY_PvsPortal *portal = &bake->portals[pi];
+    int k = (portal->sector[0] == source) ? 1 : 0;
+    int next = portal->sector[k];
+    if (next < 0 || next == source)
+      continue;
+    /* Everything leaving the source crosses this portal, so it is both the
+       source and the first pass portal */
+    w->on_chain[pi] = 1;
+    pvs_flow(w, next, &portal->seg, portal->side[k], &portal->seg,
+             portal->side[k], 1);
+    w->on_chain[pi] = 0;
+  }
 
-  // Recursively mark all children of this descendant
-  RAY_Sector *desc_sector = &g_engine.sectors[descendant_idx];
-  for (int c = 0; c < desc_sector->num_children; c++) {
-    int child_id = desc_sector->child_sector_ids[c];
+  if (w->overflow) {
+    pvs_flood(w, source);
+    SDL_AtomicAdd(&bake->fallbacks, 1);
+  }
+}
 
-    // Find child index
-    for (int j = 0; j < g_engine.num_sectors; j++) {
-      if (g_engine.sectors[j].sector_id == child_id) {
-        mark_descendants_visible(ancestor_idx, j);
-        break;
-      }
-    }
+static int pvs_bake_worker(void *data) {
+  RAY_PvsWorker *w = (RAY_PvsWorker *)data;
+  for (;;) {
+    int source = SDL_AtomicAdd(&w->bake->next_source, 1);
+    if (source >= w->bake->num_sectors)
+      break;
+    pvs_bake_source(w, source);
   }
+  return 0;
 }
 
-void ray_bake_pvs() {
-  if (g_engine.num_sectors == 0)
+/* Nested sectors have no portal to their parent: everything inside a
+   visible sector may be visible, and from inside a child the camera sees
+   whatever its parent sees */
+static void pvs_apply_hierarchy(RAY_PvsBake *bake) {
+  int n = bake->num_sectors;
+  int *parent = (int *)malloc(n * sizeof(int));
+  int *order = (int *)malloc(n * sizeof(int));
+  int *depth = (int *)calloc(n, sizeof(int));
+  if (!parent || !order || !depth) {
+    free(parent);
+    free(order);
+    free(depth);
     return;
+  }
 
-  printf("RAY: Baking Static PVS for %d sectors...\n", g_engine.num_sectors);
-
-  // Allocate Matrix (num * num bytes)
-  if (g_engine.pvs_matrix)
-    free(g_engine.pvs_matrix);
-  g_engine.pvs_matrix =
-      (uint8_t *)calloc(g_engine.num_sectors * g_engine.num_sectors, 1);
+  int max_depth = 0;
+  for (int i = 0; i < n; i++) {
+    int pid = g_engine.sectors[i].parent_sector_id;
+    parent[i] = pid >= 0 ? ray_sector_index_by_id(&g_engine, pid) : -1;
+    if (parent[i] == i)
+      parent[i] = -1;
+  }
+  for (int i = 0; i < n; i++) {
+    int d = 0;
+    for (int p = parent[i]; p >= 0 && d < n; p = parent[p])
+      d++;
+    depth[i] = d;
+    if (d > max_depth)
+      max_depth = d;
+  }
 
-  if (!g_engine.pvs_matrix) {
-    fprintf(stderr, "RAY: Error allocating PVS matrix\n");
-    return;
+  /* Parents before children */
+  int num_order = 0;
+  for (int d = 1; d <= max_depth; d++)
+    for (int i = 0; i < n; i++)
+      if (depth[i] == d)
+        order[num_order++] = i;
+
+  for (int s = 0; s < n; s++) {
+    uint8_t *row = bake->matrix + (size_t)s * bake->row_bytes;
+    for (int o = 0; o < num_order; o++) {
+      int c = order[o];
+      if (RAY_PVS_TEST(row, parent[c]))
+        PVS_SET(row, c);
+    }
+  }
+  for (int o = 0; o < num_order; o++) {
+    int c = order[o];
+    uint8_t *row = bake->matrix + (size_t)c * bake->row_bytes;
+    const uint8_t *prow = bake->matrix + (size_t)parent[c] * bake->row_bytes;
+    for (int b = 0; b < bake->row_bytes; b++)
+      row[b] |= prow[b];
   }
 
-  // Temporary visited array for recursion
-  uint8_t *visited = (uint8_t *)malloc(g_engine.num_sectors);
+  free(parent);
+  free(order);
+  free(depth);
+}
 
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    // Clear visited for this source sector
-    memset(visited, 0, g_engine.num_sectors);
+/* RLE-compress every row into g_engine.pvs_data / pvs_offsets */
+static int pvs_compress(const RAY_PvsBake *bake) {
+  int n = bake->num_sectors;
+  size_t capacity = (size_t)n * 4 + 64;
+  uint8_t *data = (uint8_t *)malloc(capacity);
+  uint32_t *offsets = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+  if (!data || !offsets) {
+    free(data);
+    free(offsets);
+    return 0;
+  }
+
+  size_t size = 0;
+  for (int s = 0; s < n; s++) {
+    const uint8_t *row = bake->matrix + (size_t)s * bake->row_bytes;
+    offsets[s] = (uint32_t)size;
+    /* Worst case doubles the row */
+    if (size + (size_t)bake->row_bytes * 2 > capacity) {
+      while (size + (size_t)bake->row_bytes * 2 > capacity)
+        capacity *= 2;
+      uint8_t *grown = (uint8_t *)realloc(data, capacity);
+      if (!grown) {
+        free(data);
+        free(offsets);
+        return 0;
+      }
+      data = grown;
+    }
+    for (int b = 0; b < bake->row_bytes;) {
+      if (row[b]) {
+        data[size++] = row[b++];
+        continue;
+      }
+      int run = 0;
+      while (b < bake->row_bytes && !row[b] && run < 255) {
+        b++;
+        run++;
+      }
+      data[size++] = 0;
+      data[size++] = (uint8_t)run;
+    }
+  }
+  offsets[n] = (uint32_t)size;
+
+  ray_free_pvs();
+  g_engine.pvs_data = data;
+  g_engine.pvs_offsets = offsets;
+  g_engine.pvs_size = (uint32_t)size;
+  g_engine.pvs_num_sectors = n;
+  g_engine.pvs_row_sector = -1;
+  g_engine.pvs_ready = 1;
+  return 1;
+}
 
-    // Setup recursion
-    visited[i] = 1;
+void ray_free_pvs(void) {
+  free(g_engine.pvs_data);
+  free(g_engine.pvs_offsets);
+  free(g_engine.pvs_row);
+  g_engine.pvs_data = NULL;
+  g_engine.pvs_offsets = NULL;
+  g_engine.pvs_row = NULL;
+  g_engine.pvs_size = 0;
+  g_engine.pvs_num_sectors = 0;
+  g_engine.pvs_row_sector = -1;
+  g_engine.pvs_ready = 0;
+}
 
-    // Mark self as visible
-    g_engine.pvs_matrix[i * g_engine.num_sectors + i] = 1;
+const uint8_t *ray_pvs_row(int sector_index) {
+  int n = g_engine.num_sectors;
+  if (!g_engine.pvs_ready || !g_engine.pvs_data || !g_engine.pvs_offsets ||
+      g_engine.pvs_num_sectors != n || sector_index < 0 || sector_index >= n)
+    return NULL;
 
-    // Start traversal (Depth 32 is sufficient for most maps)
-    ray_bake_pvs_recursive(i, i, 32, visited);
+  int row_bytes = (n + 7) >> 3;
+  if (!g_engine.pvs_row) {
+    g_engine.pvs_row = (uint8_t *)malloc(row_bytes);
+    if (!g_engine.pvs_row)
+      return NULL;
+    g_engine.pvs_row_sector = -1;
   }
+  if (g_engine.pvs_row_sector == sector_index)
+    return g_engine.pvs_row;
+
+  const uint8_t *in = g_engine.pvs_data + g_engine.pvs_offsets[sector_index];
+  const uint8_t *end =
+      g_engine.pvs_data + g_engine.pvs_offsets[sector_index + 1];
+  int b = 0;
+  while (in < end && b < row_bytes) {
+    if (*in) {
+      g_engine.pvs_row[b++] = *in++;
+      continue;
+    }
+    int run = (in + 1 < end) ? in[1] : 0;
+    in += 2;
+    if (run > row_bytes - b)
+      run = row_bytes - b;
+    memset(g_engine.pvs_row + b, 0, run);
+    b += run;
+  }
+  if (b < row_bytes)
+    memset(g_engine.pvs_row + b, 0, row_bytes - b);
 
-  // HIERARCHY FIX: Mark all parent-child sector pairs as mutually visible
-  // This ensures nested sectors are always visible from their parent
-  // We need to do this TRANSITIVELY - grandparents can see grandchildren, etc.
+  g_engine.pvs_row_sector = sector_index;
+  return g_engine.pvs_row;
+}
 
+int ray_pvs_test(int from_index, int to_index) {
+  int n = g_engine.num_sectors;
+  if (!g_engine.pvs_ready || !g_engine.pvs_data || !g_engine.pvs_offsets ||
+      g_engine.pvs_num_sectors != n || from_index < 0 || from_index >= n ||
+      to_index < 0 || to_index >= n)
+    return 1;
 
+  /* Avanzar por las rachas RLE hasta el byte del destino */
+  const uint8_t *in = g_engine.pvs_data + g_engine.pvs_offsets[from_index];
+  const uint8_t *end = g_engine.pvs_data + g_engine.pvs_offsets[from_index + 1];
+  int target = to_index >> 3;
+  int b = 0;
+  while (in < end) {
+    if (*in) {
+      if (b == target)
+        return (*in >> (to_index & 7)) & 1;
+      b++;
+      in++;
+      continue;
+    }
+    int run = (in + 1 < end) ? in[1] : 0;
+    in += 2;
+    if (target < b + run)
+      return 0;
+    b += run;
+  }
+  return 0;
+}
 
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    RAY_Sector *sector = &g_engine.sectors[i];
+void ray_bake_pvs(void) {
+  if (g_engine.num_sectors == 0)
+    return;
 
-    // For each child of this sector
-    for (int c = 0; c < sector->num_children; c++) {
-      int child_id = sector->child_sector_ids[c];
+  printf("RAY: Baking Static PVS for %d sectors...\n", g_engine.num_sectors);
+  uint32_t bake_start = SDL_GetTicks();
+
+  RAY_PvsBake bake;
+  memset(&bake, 0, sizeof(bake));
+  bake.num_sectors = g_engine.num_sectors;
+  bake.row_bytes = (bake.num_sectors + 7) >> 3;
+
+  int num_portals = g_engine.num_portals;
+  bake.portals = (RAY_PvsPortal *)malloc(
+      (num_portals > 0 ? num_portals : 1) * sizeof(RAY_PvsPortal));
+  bake.sector_first = (int *)calloc(bake.num_sectors + 1, sizeof(int));
+  bake.refs = (int *)malloc((num_portals > 0 ? num_portals : 1) * 2 *
+                            sizeof(int));
+  bake.matrix = (uint8_t *)calloc((size_t)bake.num_sectors, bake.row_bytes);
+  if (!bake.portals || !bake.sector_first || !bake.refs || !bake.matrix) {
+    fprintf(stderr, "RAY: Error allocating PVS bake buffers\n");
+    free(bake.portals);
+    free(bake.sector_first);
+    free(bake.refs);
+    free(bake.matrix);
+    ray_free_pvs();
+    return;
+  }
 
-      // Find the child sector's index
-      int child_index = -1;
-      for (int j = 0; j < g_engine.num_sectors; j++) {
-        if (g_engine.sectors[j].sector_id == child_id) {
-          child_index = j;
-          break;
-        }
+  /* Portal segments with sector indices and orientation, then a per-sector
+     portal list (walls may carry stale ids, so read the portal array) */
+  for (int p = 0; p < num_portals; p++) {
+    RAY_Portal *src = &g_engine.portals[p];
+    RAY_PvsPortal *dst = &bake.portals[p];
+    dst->seg.x1 = src->x1;
+    dst->seg.y1 = src->y1;
+    dst->seg.x2 = src->x2;
+    dst->seg.y2 = src->y2;
+    dst->sector[0] = ray_sector_index_by_id(&g_engine, src->sector_a);
+    dst->sector[1] = ray_sector_index_by_id(&g_engine, src->sector_b);
+    dst->side[0] = pvs_sector_side(&dst->seg, dst->sector[0]);
+    dst->side[1] = pvs_sector_side(&dst->seg, dst->sector[1]);
+    /* Both probes should agree that the sectors face each other */
+    if (dst->side[0] && dst->side[0] == dst->side[1])
+      dst->side[0] = dst->side[1] = 0;
+    else if (!dst->side[0])
+      dst->side[0] = -dst->side[1];
+    else if (!dst->side[1])
+      dst->side[1] = -dst->side[0];
+
+    for (int k = 0; k < 2; k++)
+      if (dst->sector[k] >= 0 && dst->sector[0] != dst->sector[1])
+        bake.sector_first[dst->sector[k] + 1]++;
+  }
+  for (int i = 0; i < bake.num_sectors; i++)
+    bake.sector_first[i + 1] += bake.sector_first[i];
+  {
+    int *fill = (int *)malloc(bake.num_sectors * sizeof(int));
+    if (fill) {
+      memcpy(fill, bake.sector_first, bake.num_sectors * sizeof(int));
+      for (int p = 0; p < num_portals; p++) {
+        RAY_PvsPortal *portal = &bake.portals[p];
+        if (portal->sector[0] == portal->sector[1])
+          continue;
+        for (int k = 0; k < 2; k++)
+          if (portal->sector[k] >= 0)
+            bake.refs[fill[portal->sector[k]]++] = p;
       }
+      free(fill);
+    } else {
+      memset(bake.sector_first, 0, (bake.num_sectors + 1) * sizeof(int));
+    }
+  }
 
-      if (child_index >= 0) {
-        // Recursively mark this child and all its descendants as visible
-        mark_descendants_visible(i, child_index);
-      }
+  /* One worker per core, sources handed out one at a time */
+  int num_workers = SDL_GetCPUCount();
+  if (num_workers > RAY_PVS_MAX_THREADS)
+    num_workers = RAY_PVS_MAX_THREADS;
+  if (num_workers > bake.num_sectors)
+    num_workers = bake.num_sectors;
+  if (num_workers < 1)
+    num_workers = 1;
+
+  RAY_PvsWorker workers[RAY_PVS_MAX_THREADS];
+  memset(workers, 0, sizeof(workers));
+  int ready = 0;
+  for (int t = 0; t < num_workers; t++) {
+    workers[t].bake = &bake;
+    workers[t].on_chain = (uint8_t *)calloc(num_portals > 0 ? num_portals : 1,
+                                            1);
+    workers[t].queue = (int *)malloc(bake.num_sectors * sizeof(int));
+    if (!workers[t].on_chain || !workers[t].queue) {
+      free(workers[t].on_chain);
+      free(workers[t].queue);
+      break;
     }
+    ready++;
+  }
+  if (ready == 0) {
+    fprintf(stderr, "RAY: Error allocating PVS bake buffers\n");
+    free(bake.portals);
+    free(bake.sector_first);
+    free(bake.refs);
+    free(bake.matrix);
+    ray_free_pvs();
+    return;
   }
 
-  free(visited);
-  g_engine.pvs_ready = 1;
-  printf("RAY: PVS Bake Complete.\n");
+  SDL_AtomicSet(&bake.next_source, 0);
+  SDL_AtomicSet(&bake.fallbacks, 0);
+  for (int t = 1; t < ready; t++)
+    workers[t].thread =
+        SDL_CreateThread(pvs_bake_worker, "ray_pvs", &workers[t]);
+  pvs_bake_worker(&workers[0]);
+  for (int t = 1; t < ready; t++)
+    if (workers[t].thread)
+      SDL_WaitThread(workers[t].thread, NULL);
+  for (int t = 0; t < ready; t++) {
+    free(workers[t].on_chain);
+    free(workers[t].queue);
+  }
+
+  pvs_apply_hierarchy(&bake);
+
+  long visible = 0;
+  for (int s = 0; s < bake.num_sectors; s++) {
+    const uint8_t *row = bake.matrix + (size_t)s * bake.row_bytes;
+    for (int i = 0; i < bake.num_sectors; i++)
+      visible += RAY_PVS_TEST(row, i) ? 1 : 0;
+  }
+
+  int ok = pvs_compress(&bake);
+  free(bake.portals);
+  free(bake.sector_first);
+  free(bake.refs);
+  free(bake.matrix);
+
+  if (!ok) {
+    fprintf(stderr, "RAY: Error allocating PVS rows\n");
+    ray_free_pvs();
+    return;
+  }
+
+  printf("RAY: PVS Bake Complete (%u ms, %d threads): %.1f visible sectors "
+         "per sector, %u bytes, %d rows by connectivity\n",
+         SDL_GetTicks() - bake_start, ready,
+         (double)visible / bake.num_sectors, g_engine.pvs_size,
+         SDL_AtomicGet(&bake.fallbacks));
 }
 
 int64_t libmod_ray_load_map(INSTANCE *my, int64_t *params) {
@@ -437,17 +965,44 @@ int64_t libmod_ray_load_map(INSTANCE *my, int64_t *params) {
   int fpg_id = (int)params[1];
 
   g_engine.fpg_id = fpg_id;
+  ray_mip_clear(); /* Las texturas pueden venir de otro FPG */
+  ray_gpu_invalidate_textures();
 
   printf("RAY: Cargando mapa: %s (FPG: %d)\n", filename, fpg_id);
 
-  int result = ray_load_map(filename);
+  /* La caché compilada ya trae topología, jerarquía, AABBs y PVS */
+  int from_cache = ray_load_map_compiled(filename);
+  int result = from_cache ? 1 : ray_load_map(filename);
 
   if (result) {
     // Optimización 1: Calcular AABB de todos los sectores
-    ray_calculate_all_sector_bounds();
+    if (!from_cache)
+      ray_calculate_all_sector_bounds();
 
-    // Optimización 2: Static PVS Bake
-    ray_bake_pvs();
+    // Optimización 1b: Grid uniforme para búsquedas punto->sector
+    ray_sector_grid_build(&g_engine);
+
+    // Optimización 1c: Datos estáticos de sectores para el renderer GPU
+    ray_gpu_build_sector_cache(&g_engine);
+
+    // Optimización 1d: BVH de paredes por sector para colisión por barrido
+    ray_wall_bvh_build(&g_engine);
+
+    // Optimización 2: Static PVS Bake (y regenerar la caché compilada)
+    if (!from_cache) {
+      ray_bake_pvs();
+      ray_save_map_compiled(filename);
+    }
+
+    // Optimización 3: Sprites agrupados por sector
+    ray_sprite_bins_rebuild();
+
+    // Optimización 4: Luces por sector (se asignan en el primer frame)
+    ray_lights_invalidate();
+
+    // Optimización 5: Luces estáticas horneadas (RAY_SET_LIGHTMAPS), desde
+    // <mapa>.raylm si sigue valiendo
+    ray_lightmap_bake(filename);
 
     printf("RAY: Mapa cargado exitosamente\n");
     printf("RAY: %d sectores, %d portales, %d sprites\n", g_engine.num_sectors,
@@ -465,11 +1020,21 @@ int64_t libmod_ray_free_map(INSTANCE *my, int64_t *params) {
     return 0;
 
   /* Liberar PVS */
-  if (g_engine.pvs_matrix) {
-    free(g_engine.pvs_matrix);
-    g_engine.pvs_matrix = NULL;
-  }
-  g_engine.pvs_ready = 0;
+  ray_free_pvs();
+  ray_lights_free();
+  ray_lightmap_free();
+  ray_mip_clear();
+  ray_gpu_invalidate_textures();
+
+  /* Liberar índices de sectores */
+  ray_sector_grid_free();
+  ray_wall_bvh_free();
+  ray_free_sector_id_lookup(&g_engine);
+  ray_gpu_free_sector_cache();
+
+  /* Un frame abierto con RAY_PREPARE_SCENE no sobrevive al mapa */
+  s_scene_explicit = 0;
+  s_scene_render_ms = 0;
 
   /* Liberar sectores */
   if (g_engine.sectors) {
@@ -496,9 +1061,13 @@ int64_t libmod_ray_free_map(INSTANCE *my, int64_t *params) {
   }
   g_engine.num_portals = 0;
 
-  /* Liberar sprites */
+  /* Liberar sprites (el pool conserva su memoria para el siguiente mapa) */
+  for (int i = 0; i < g_engine.num_sprites; i++)
+    ray_sprite_release(i);
   g_engine.num_sprites = 0;
+  ray_sprite_pool_rebuild();
   g_engine.num_spawn_flags = 0;
+  ray_sprite_bins_rebuild();
 
   printf("RAY: Mapa liberado\n");
   return 1;
@@ -547,8 +1116,8 @@ int64_t libmod_ray_get_camera_pitch(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_get_sprite_x(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int id = (int)params[0];
-  if (id < 0 || id >= g_engine.num_sprites)
+  int id = ray_sprite_resolve(params[0]);
+  if (id < 0)
     return 0;
   float val = g_engine.sprites[id].x;
   return (int64_t) * (int32_t *)&val;
@@ -557,8 +1126,8 @@ int64_t libmod_ray_get_sprite_x(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_get_sprite_y(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int id = (int)params[0];
-  if (id < 0 || id >= g_engine.num_sprites)
+  int id = ray_sprite_resolve(params[0]);
+  if (id < 0)
     return 0;
   float val = g_engine.sprites[id].y;
   return (int64_t) * (int32_t *)&val;
@@ -567,8 +1136,8 @@ int64_t libmod_ray_get_sprite_y(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_get_sprite_z(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int id = (int)params[0];
-  if (id < 0 || id >= g_engine.num_sprites)
+  int id = ray_sprite_resolve(params[0]);
+  if (id < 0)
     return 0;
   float val = g_engine.sprites[id].z;
   return (int64_t) * (int32_t *)&val;
@@ -577,8 +1146,8 @@ int64_t libmod_ray_get_sprite_z(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_get_sprite_id(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int id = (int)params[0];
-  if (id < 0 || id >= g_engine.num_sprites)
+  int id = ray_sprite_resolve(params[0]);
+  if (id < 0)
     return 0;
   if (g_engine.sprites[id].process_ptr == NULL)
     return 0;
@@ -862,35 +1431,49 @@ int64_t libmod_ray_jump(INSTANCE *my, int64_t *params) {
    ============================================================================
  */
 
-int64_t libmod_ray_render(INSTANCE *my, int64_t *params) {
-  if (!g_engine.initialized) {
-    fprintf(stderr, "RAY: Motor no inicializado\n");
-    return 0;
-  }
-
-  int graph_id = (int)params[0];
+static GRAPH *render_target_graph(int graph_id) {
   GRAPH *dest = NULL;
 
   // Si graph_id es 0, crear un nuevo graph automáticamente
   if (graph_id == 0) {
     dest = bitmap_new_syslib(g_engine.displayWidth, g_engine.displayHeight);
-    if (!dest) {
+    if (!dest)
       fprintf(stderr, "RAY: No se pudo crear graph\n");
-      return 0;
-    }
-    graph_id = dest->code;
   } else {
     dest = bitmap_get(0, graph_id);
-    if (!dest) {
+    if (!dest)
       fprintf(stderr, "RAY: Graph no válido: %d\n", graph_id);
-      return 0;
-    }
   }
-
+  return dest;
+}
+
+/* Closes the frame: dynamic resolution and stats see the time of all the
+   views together. Whatever opened the frame, the next view prepares its
+   own scene again unless RAY_PREPARE_SCENE is called. */
+static void ray_scene_finish(void) {
+  /* Resolución dinámica: ajustar la escala para el siguiente frame */
+  ray_resolution_update(s_scene_render_ms);
+
+  RAY_STAT_ADD(RAY_STAT_FRAME_MS, s_scene_render_ms);
+  ray_stats_end_frame();
+  s_scene_render_ms = 0;
+  s_scene_explicit = 0;
+}
+
+/* A tick is split in two stages. ray_scene_prepare() does the work shared
+   by every view: time and animation advance, process sync (which re-bins
+   the sprites that moved), background loads and the GPU island cache.
+   ray_scene_render_view() then only traverses and rasterizes for the
+   current camera. RAY_RENDER on its own does both, as before; a script
+   drawing several views calls RAY_PREPARE_SCENE, then RAY_RENDER or
+   RAY_RENDER_VIEW once per view, then RAY_END_SCENE. */
+static void ray_scene_prepare(void) {
   /* Automatic animation update logic */
   uint32_t current_ticks = SDL_GetTicks();
   float dt = 0.0f;
-  if (g_engine.last_ticks > 0) {
+  if (ray_bench_timestep() > 0.0f) {
+    dt = ray_bench_timestep(); /* Benchmark: animaciones reproducibles */
+  } else if (g_engine.last_ticks > 0) {
     uint32_t diff = current_ticks - g_engine.last_ticks;
     if (diff == 0)
       dt = 0.001f; /* Force minimum progression for high-FPS */
@@ -899,48 +1482,568 @@ int64_t libmod_ray_render(INSTANCE *my, int64_t *params) {
   } else {
     dt = 0.016f;
   }
-  g_engine.last_ticks = current_ticks;
+  g_engine.last_ticks = current_ticks;
+
+  if (dt > 0.1f)
+    dt = 0.1f; /* Cap large drops */
+
+  g_engine.time += dt;
+
+  /* Sprites de procesos (RAY_SET_AUTO_SYNC(0) lo deja al script) */
+  if (g_engine.auto_sync)
+    ray_sync_sprites();
+
+  /* Cargas en segundo plano: subidas a la GPU y sprites que esperaban */
+  ray_async_update();
+
+  for (int k = 0; k < g_engine.num_active_sprites; ++k) {
+    RAY_Sprite *s = &g_engine.sprites[g_engine.active_sprites[k]];
+    if (s->glb_anim_speed != 0) {
+      s->glb_anim_time += dt * s->glb_anim_speed;
+    }
+  }
+
+  /* Oclusores de islas: iguales para todas las vistas del frame */
+  if (g_use_gpu)
+    ray_gpu_prepare_scene();
+}
+
+static void ray_scene_render_view(GRAPH *dest) {
+  /* Cuerpos físicos en paso fijo: dibujar transformaciones interpoladas */
+  ray_physics_begin_render();
+
+  Uint64 render_start = SDL_GetPerformanceCounter();
+
+  /* SOFTWARE RENDERING (Stable - Active) */
+  if (!g_use_gpu) {
+    ray_render_frame_build(dest);
+  } else {
+    /* GPU RENDERING (SDL_gpu - Testing) */
+    ray_render_frame_gpu(dest);
+  }
+
+  s_scene_render_ms +=
+      (float)((double)(SDL_GetPerformanceCounter() - render_start) * 1000.0 /
+              (double)SDL_GetPerformanceFrequency());
+
+  ray_physics_end_render();
+}
+
+int64_t libmod_ray_prepare_scene(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+
+  /* Sin RAY_END_SCENE el frame anterior termina aquí */
+  if (s_scene_explicit)
+    ray_scene_finish();
+  ray_scene_prepare();
+  s_scene_explicit = 1;
+  return 1;
+}
+
+int64_t libmod_ray_end_scene(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized || !s_scene_explicit)
+    return 0;
+  ray_scene_finish();
+  return 1;
+}
+
+/* One view, with the tick stages around it unless RAY_PREPARE_SCENE
+   already opened the frame */
+static void ray_scene_render(GRAPH *dest) {
+  if (s_scene_explicit) {
+    ray_scene_render_view(dest);
+    return;
+  }
+  ray_scene_prepare();
+  ray_scene_render_view(dest);
+  ray_scene_finish();
+}
+
+int64_t libmod_ray_render(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized) {
+    fprintf(stderr, "RAY: Motor no inicializado\n");
+    return 0;
+  }
+
+  GRAPH *dest = render_target_graph((int)params[0]);
+  if (!dest)
+    return 0;
+
+  ray_scene_render(dest);
+  return dest->code;
+}
+
+/* RAY_RENDER_VIEW(graph, x, y, z, rot, pitch): one view from its own camera,
+   same arguments as RAY_SET_CAMERA. The engine camera is restored
+   afterwards, so the views do not disturb each other or the movement
+   functions. */
+int64_t libmod_ray_render_view(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized) {
+    fprintf(stderr, "RAY: Motor no inicializado\n");
+    return 0;
+  }
+
+  GRAPH *dest = render_target_graph((int)params[0]);
+  if (!dest)
+    return 0;
+
+  /* Fuera de todo sector la vista no hereda el sector de la cámara */
+  RAY_Camera saved = g_engine.camera;
+  g_engine.camera.current_sector_id = -1;
+  libmod_ray_set_camera(my, params + 1);
+  ray_scene_render(dest);
+  g_engine.camera = saved;
+  return dest->code;
+}
+
+/* ============================================================================
+   SINCRONIZACIÓN CON PROCESOS
+   ============================================================================
+ */
+
+/* Copy x/y/z/angle of the linked processes into their sprites. The raw
+   locals are compared with the values read last time, so a process that
+   did not move costs five reads: no conversion, no sector lookup and no
+   re-binning. Returns how many sprites moved. */
+int ray_sync_sprites(void) {
+  int moved = 0;
+
+  for (int k = 0; k < g_engine.num_active_sprites; ++k) {
+    int i = g_engine.active_sprites[k];
+    RAY_Sprite *s = &g_engine.sprites[i];
+    if (!s->process_ptr || s->no_sync)
+      continue;
+
+    double locals[5];
+    locals[0] = (id_x != -1) ? LOCDOUBLE(libbggfx, s->process_ptr, id_x) : 0.0;
+    locals[1] = (id_y != -1) ? LOCDOUBLE(libbggfx, s->process_ptr, id_y) : 0.0;
+    locals[2] = (id_z != -1) ? LOCDOUBLE(libbggfx, s->process_ptr, id_z) : 0.0;
+    locals[3] = (id_angle != -1)
+                    ? LOCDOUBLE(libbggfx, s->process_ptr, id_angle)
+                    : 0.0;
+    locals[4] =
+        (id_res != -1) ? LOCDOUBLE(libbggfx, s->process_ptr, id_res) : 1.0;
+
+    if (s->synced && memcmp(locals, s->sync_locals, sizeof(locals)) == 0)
+      continue;
+    memcpy(s->sync_locals, locals, sizeof(locals));
+    s->synced = 1;
+
+    double res = locals[4] > 0.0 ? locals[4] : 1.0;
+    if (id_x != -1)
+      s->x = (float)(locals[0] / res);
+    if (id_y != -1)
+      s->y = (float)(locals[1] / res);
+    if (id_z != -1)
+      s->z = (float)(locals[2] / res);
+    /* BennuGD 'angle' is millidegrees (0-360000) */
+    if (id_angle != -1)
+      s->rot = (float)(locals[3] * M_PI / 180000.0);
+
+    ray_sprite_bin_update(i);
+    moved++;
+  }
+
+  RAY_STAT_ADD(RAY_STAT_SPRITES_MOVED, moved);
+  return moved;
+}
+
+/* RAY_SYNC_SPRITES(): run the process sync now, e.g. once per frame before
+   several RAY_RENDER calls with RAY_SET_AUTO_SYNC(0) */
+int64_t libmod_ray_sync_sprites(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  return ray_sync_sprites();
+}
+
+/* RAY_SET_AUTO_SYNC(enable): whether RAY_RENDER syncs by itself. Returns the
+   previous setting */
+int64_t libmod_ray_set_auto_sync(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int prev = g_engine.auto_sync;
+  g_engine.auto_sync = (int)params[0] ? 1 : 0;
+  return prev;
+}
+
+/* RAY_SET_SPRITE_SYNC(sprite, enable): 0 keeps the sprite where the module
+   API puts it even though a process owns it */
+int64_t libmod_ray_set_sprite_sync(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+
+  int sprite_id = ray_sprite_resolve(params[0]);
+  if (sprite_id < 0)
+    return 0;
+
+  RAY_Sprite *s = &g_engine.sprites[sprite_id];
+  s->no_sync = (int)params[1] ? 0 : 1;
+  s->synced = 0; /* Re-read the locals the next time it syncs */
+  return 1;
+}
+
+/* ============================================================================
+   ESTADÍSTICAS DE FRAME
+   ============================================================================
+ */
+
+double g_ray_stats_acc[RAY_STAT_COUNT];
+static float s_stats_last[RAY_STAT_COUNT];
+
+uint64_t ray_stats_clock(void) {
+  uint64_t t = SDL_GetPerformanceCounter();
+  return t ? t : 1; /* 0 significa "sin medir" en RAY_STAT_TIMER */
+}
+
+double ray_stats_elapsed_ms(uint64_t since) {
+  return (double)(SDL_GetPerformanceCounter() - since) * 1000.0 /
+         (double)SDL_GetPerformanceFrequency();
+}
+
+/* Grabación de benchmark: una fila de RAY_STAT_COUNT valores por frame */
+static struct {
+  float *frames;
+  int capacity;
+  int count;
+  float timestep;
+  int prev_stats_enabled;
+} s_bench;
+
+float ray_bench_timestep(void) {
+  return s_bench.frames ? s_bench.timestep : 0.0f;
+}
+
+void ray_stats_end_frame(void) {
+  static int frame_count = 0;
+  if (!g_engine.stats_enabled)
+    return;
+  for (int i = 0; i < RAY_STAT_COUNT; i++) {
+    s_stats_last[i] = (float)g_ray_stats_acc[i];
+    g_ray_stats_acc[i] = 0.0;
+  }
+
+  if (s_bench.frames && s_bench.count < s_bench.capacity) {
+    memcpy(&s_bench.frames[(size_t)s_bench.count * RAY_STAT_COUNT],
+           s_stats_last, sizeof(s_stats_last));
+    s_bench.count++;
+  }
+
+  if (g_engine.verbose >= 2 && ++frame_count % 60 == 0) {
+    const float *st = s_stats_last;
+    printf("RAY: Frame %.2f ms (trav %.2f, paredes %.2f, planos %.2f, "
+           "sprites %.2f, modelos %.2f, física %.2f, commit %.2f)\n",
+           st[RAY_STAT_FRAME_MS], st[RAY_STAT_TRAVERSAL_MS],
+           st[RAY_STAT_WALLS_MS], st[RAY_STAT_PLANES_MS],
+           st[RAY_STAT_SPRITES_MS], st[RAY_STAT_MODELS_MS],
+           st[RAY_STAT_PHYSICS_MS], st[RAY_STAT_COMMIT_MS]);
+    printf("RAY:   %dx%d (%.0f%%), sectores %d/%d, portales %d, PVS "
+           "descartados %d, draw calls %d, triángulos %d, sprites %d "
+           "(%d descartados)\n",
+           g_engine.internalWidth, g_engine.internalHeight,
+           g_engine.resolutionScale * 100.0f, (int)st[RAY_STAT_SECTORS],
+           g_engine.num_sectors, (int)st[RAY_STAT_PORTALS],
+           (int)st[RAY_STAT_PVS_CULLED], (int)st[RAY_STAT_DRAW_CALLS],
+           (int)st[RAY_STAT_TRIANGLES], (int)st[RAY_STAT_SPRITES_DRAWN],
+           (int)st[RAY_STAT_SPRITES_CULLED]);
+  }
+}
+
+/* RAY_SET_STATS(on): collect per-frame counters and stage timings */
+int64_t libmod_ray_set_stats(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  g_engine.stats_enabled = (int)params[0] ? 1 : 0;
+  memset(g_ray_stats_acc, 0, sizeof(g_ray_stats_acc));
+  memset(s_stats_last, 0, sizeof(s_stats_last));
+  return 1;
+}
+
+/* RAY_GET_STAT(id): value of RAY_STAT_* for the last rendered frame */
+int64_t libmod_ray_get_stat(INSTANCE *my, int64_t *params) {
+  int id = (int)params[0];
+  float v = 0.0f;
+  if (g_engine.initialized && id >= 0 && id < RAY_STAT_COUNT)
+    v = s_stats_last[id];
+  int64_t result = 0;
+  *(float *)&result = v;
+  return result;
+}
+
+/* ============================================================================
+   BENCHMARK
+   RAY_BENCH_BEGIN graba las estadísticas de cada frame renderizado y fija
+   el paso de tiempo de las animaciones; RAY_BENCH_END escribe el resultado.
+   El recorrido de cámara, los sprites y la física los pone el script, igual
+   que en un juego (ver ray_bench.prg).
+   ============================================================================
+ */
+
+static const char *s_stat_names[RAY_STAT_COUNT] = {
+    "frame_ms",   "traversal_ms",  "walls_ms",      "planes_ms",
+    "sprites_ms", "models_ms",     "physics_ms",    "commit_ms",
+    "sectors",    "portals",       "pvs_culled",    "draw_calls",
+    "triangles",  "sprites_drawn", "sprites_culled", "sprites_moved",
+    "texture_switches", "impostors"};
+
+static int bench_float_cmp(const void *a, const void *b) {
+  float fa = *(const float *)a, fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
+
+/* Percentil por rango más cercano sobre valores ya ordenados */
+static float bench_percentile(const float *sorted, int n, int pct) {
+  int rank = (pct * n + 99) / 100;
+  if (rank < 1)
+    rank = 1;
+  return sorted[rank - 1];
+}
+
+static void bench_discard(void) {
+  free(s_bench.frames);
+  s_bench.frames = NULL;
+  s_bench.capacity = 0;
+  s_bench.count = 0;
+  s_bench.timestep = 0.0f;
+}
+
+/* RAY_BENCH_BEGIN(max_frames, timestep): start recording; timestep > 0
+   replaces the wall-clock dt of RAY_RENDER for animations */
+int64_t libmod_ray_bench_begin(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int max_frames = (int)params[0];
+  float timestep = *(float *)&params[1];
+  if (max_frames < 1)
+    return 0;
+
+  if (s_bench.frames)
+    bench_discard();
+  else
+    s_bench.prev_stats_enabled = g_engine.stats_enabled;
+  s_bench.frames =
+      (float *)malloc((size_t)max_frames * RAY_STAT_COUNT * sizeof(float));
+  if (!s_bench.frames)
+    return 0;
+  s_bench.capacity = max_frames;
+  s_bench.timestep = timestep > 0.0f ? timestep : 0.0f;
+
+  g_engine.stats_enabled = 1;
+  memset(g_ray_stats_acc, 0, sizeof(g_ray_stats_acc));
+  return 1;
+}
+
+static void bench_write_csv(FILE *f) {
+  fprintf(f, "frame");
+  for (int s = 0; s < RAY_STAT_COUNT; s++)
+    fprintf(f, ",%s", s_stat_names[s]);
+  fprintf(f, "\n");
+  for (int i = 0; i < s_bench.count; i++) {
+    const float *row = &s_bench.frames[(size_t)i * RAY_STAT_COUNT];
+    fprintf(f, "%d", i);
+    for (int s = 0; s < RAY_STAT_COUNT; s++)
+      fprintf(f, ",%.4f", row[s]);
+    fprintf(f, "\n");
+  }
+}
+
+static void bench_write_json(FILE *f, float *sorted) {
+  int n = s_bench.count;
+  fprintf(f, "{\n  \"renderer\": \"%s\",\n",
+          g_use_gpu ? "gpu" : "software");
+  fprintf(f, "  \"resolution\": [%d, %d],\n", g_engine.internalWidth,
+          g_engine.internalHeight);
+  fprintf(f, "  \"render_threads\": %d,\n", g_engine.render_threads);
+  fprintf(f, "  \"sectors\": %d,\n  \"sprites\": %d,\n",
+          g_engine.num_sectors, g_engine.num_sprites);
+  fprintf(f, "  \"frames\": %d,\n", n);
+  fprintf(f,
+          "  \"frame_ms\": {\"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, "
+          "\"p99\": %.4f, \"max\": %.4f},\n",
+          sorted[0], bench_percentile(sorted, n, 50),
+          bench_percentile(sorted, n, 95), bench_percentile(sorted, n, 99),
+          sorted[n - 1]);
+  fprintf(f, "  \"mean\": {");
+  for (int s = 0; s < RAY_STAT_COUNT; s++) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+      sum += s_bench.frames[(size_t)i * RAY_STAT_COUNT + s];
+    fprintf(f, "%s\n    \"%s\": %.4f", s ? "," : "", s_stat_names[s],
+            sum / n);
+  }
+  fprintf(f, "\n  }\n}\n");
+}
+
+static int bench_write(const char *filename, int json, float *sorted) {
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    fprintf(stderr, "RAY: No se pudo escribir %s\n", filename);
+    return 0;
+  }
+  if (json)
+    bench_write_json(f, sorted);
+  else
+    bench_write_csv(f);
+  fclose(f);
+  return 1;
+}
+
+/* RAY_BENCH_END(prefix): stop recording and write <prefix>.json (p50/p95/p99
+   frame times and the mean of every counter) and <prefix>.csv (one row per
+   frame). Returns the frames recorded, 0 if nothing could be written */
+int64_t libmod_ray_bench_end(INSTANCE *my, int64_t *params) {
+  const char *prefix = (const char *)string_get((int)params[0]);
+  int written = 0;
+
+  if (s_bench.frames && s_bench.count > 0 && prefix) {
+    int n = s_bench.count;
+    size_t len = strlen(prefix) + 6;
+    float *sorted = (float *)malloc((size_t)n * sizeof(float));
+    char *filename = (char *)malloc(len);
+    if (sorted && filename) {
+      for (int i = 0; i < n; i++)
+        sorted[i] = s_bench.frames[(size_t)i * RAY_STAT_COUNT +
+                                   RAY_STAT_FRAME_MS];
+      qsort(sorted, n, sizeof(float), bench_float_cmp);
+
+      snprintf(filename, len, "%s.json", prefix);
+      int ok = bench_write(filename, 1, sorted);
+      snprintf(filename, len, "%s.csv", prefix);
+      ok &= bench_write(filename, 0, sorted);
+      if (ok) {
+        printf("RAY: Benchmark %d frames: p50 %.2f ms, p95 %.2f ms, "
+               "p99 %.2f ms -> %s.json\n",
+               n, bench_percentile(sorted, n, 50),
+               bench_percentile(sorted, n, 95),
+               bench_percentile(sorted, n, 99), prefix);
+        written = n;
+      }
+    }
+    free(filename);
+    free(sorted);
+  }
+
+  if (s_bench.frames) {
+    bench_discard();
+    g_engine.stats_enabled = s_bench.prev_stats_enabled;
+  }
+  string_discard((int)params[0]);
+  return written;
+}
 
-  if (dt > 0.1f)
-    dt = 0.1f; /* Cap large drops */
+/* RAY_SET_RENDERER(gpu): 1 = SDL_gpu renderer, 0 = software renderer.
+   Returns the previous mode */
+int64_t libmod_ray_set_renderer(INSTANCE *my, int64_t *params) {
+  int prev = g_use_gpu;
+  g_use_gpu = (int)params[0] ? 1 : 0;
+  return prev;
+}
 
-  g_engine.time += dt;
+/* RAY_GENERATE_STRESS_MAP(file, cols, rows, boxes, seed): write a synthetic
+   .raymap for benchmarks; load it with RAY_LOAD_MAP */
+int64_t libmod_ray_generate_stress_map(INSTANCE *my, int64_t *params) {
+  const char *filename = (const char *)string_get((int)params[0]);
+  int result = ray_generate_stress_map(filename, (int)params[1],
+                                       (int)params[2], (int)params[3],
+                                       (uint32_t)params[4]);
+  string_discard((int)params[0]);
+  return result;
+}
 
-  for (int i = 0; i < g_engine.num_sprites; ++i) {
-    RAY_Sprite *s = &g_engine.sprites[i];
-    if (!s->in_use) continue;
-
-    /* Automatic Sync from BennuGD Process if attached */
-    if (s->process_ptr) {
-        /* Use standard macros for robust cross-platform variable access */
-        double res = (id_res != -1) ? LOCDOUBLE(libbggfx, s->process_ptr, id_res) : 1.0;
-        if (res <= 0.0) res = 1.0;
-
-        if (id_x != -1) s->x = (float)(LOCDOUBLE(libbggfx, s->process_ptr, id_x) / res);
-        if (id_y != -1) s->y = (float)(LOCDOUBLE(libbggfx, s->process_ptr, id_y) / res);
-        if (id_z != -1) s->z = (float)(LOCDOUBLE(libbggfx, s->process_ptr, id_z) / res);
-        
-        if (id_angle != -1) {
-            double b_angle = LOCDOUBLE(libbggfx, s->process_ptr, id_angle);
-            /* Sync Angle: BennuGD 'angle' is millidegrees (0-360000) */
-            s->rot = (float)((double)b_angle * M_PI / 180000.0);
-        }
-    }
+/* ============================================================================
+   RESOLUCIÓN DINÁMICA
+   ============================================================================
+ */
 
-    if (s->glb_anim_speed != 0) {
-      s->glb_anim_time += dt * s->glb_anim_speed;
-    }
-  }
+void ray_set_resolution_scale(float scale) {
+  if (scale < 0.25f)
+    scale = 0.25f;
+  if (scale > 1.0f)
+    scale = 1.0f;
+  g_engine.resolutionScale = scale;
+
+  /* Tamaño par para que el centro de proyección caiga en un pixel */
+  int w = (int)(g_engine.displayWidth * scale + 0.5f) & ~1;
+  int h = (int)(g_engine.displayHeight * scale + 0.5f) & ~1;
+  if (w < 2 || scale >= 1.0f)
+    w = g_engine.displayWidth;
+  if (h < 2 || scale >= 1.0f)
+    h = g_engine.displayHeight;
+  g_engine.internalWidth = w;
+  g_engine.internalHeight = h;
+}
+
+/* Controlador: media móvil del tiempo de render y, cada pocos frames, la
+   escala que llevaría al objetivo (el coste escala con el área, de ahí la
+   raíz), con pasos limitados e histéresis para no oscilar. */
+void ray_resolution_update(float render_ms) {
+  static int frames_since_change = 0;
+
+  if (g_engine.render_frame_ms <= 0.0f)
+    g_engine.render_frame_ms = render_ms;
+  else
+    g_engine.render_frame_ms += (render_ms - g_engine.render_frame_ms) * 0.1f;
+
+  if (g_engine.target_frame_ms <= 0.0f)
+    return;
+  if (++frames_since_change < 15)
+    return;
 
-  /* SOFTWARE RENDERING (Stable - Active) */
-  if (!g_use_gpu) {
-    ray_render_frame_build(dest);
+  float target = g_engine.target_frame_ms;
+  float avg = g_engine.render_frame_ms;
+  float scale = g_engine.resolutionScale;
+  if (avg > target * 1.05f) {
+    float f = sqrtf(target / avg);
+    scale *= (f < 0.85f) ? 0.85f : f;
+  } else if (avg < target * 0.8f && scale < 1.0f) {
+    float f = sqrtf(target * 0.9f / (avg > 0.01f ? avg : 0.01f));
+    scale *= (f > 1.05f) ? 1.05f : f;
   } else {
-    /* GPU RENDERING (SDL_gpu - Testing) */
-    ray_render_frame_gpu(dest);
+    return;
   }
+  if (scale < g_engine.resolution_min_scale)
+    scale = g_engine.resolution_min_scale;
+
+  int old_w = g_engine.internalWidth;
+  ray_set_resolution_scale(scale);
+  if (g_engine.internalWidth != old_w) {
+    frames_since_change = 0;
+    if (g_engine.verbose)
+      printf("RAY: Resolución dinámica %dx%d (%.0f%%, %.2f ms)\n",
+             g_engine.internalWidth, g_engine.internalHeight,
+             g_engine.resolutionScale * 100.0f, avg);
+  }
+}
 
-  return graph_id;
+/* RAY_SET_RESOLUTION_SCALE(scale): fixed internal resolution (0.25 - 1.0).
+   Turns the dynamic controller off. */
+int64_t libmod_ray_set_resolution_scale(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  g_engine.target_frame_ms = 0.0f;
+  ray_set_resolution_scale(*(float *)&params[0]);
+  return 1;
+}
+
+/* RAY_SET_DYNAMIC_RESOLUTION(target_ms, min_scale): adjust the scale every
+   few frames so the render takes about target_ms. target_ms <= 0 = off. */
+int64_t libmod_ray_set_dynamic_resolution(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  float target_ms = *(float *)&params[0];
+  float min_scale = *(float *)&params[1];
+  g_engine.target_frame_ms = target_ms > 0.0f ? target_ms : 0.0f;
+  g_engine.resolution_min_scale = (min_scale > 0.0f) ? min_scale : 0.5f;
+  if (g_engine.resolutionScale < g_engine.resolution_min_scale)
+    ray_set_resolution_scale(g_engine.resolution_min_scale);
+  return 1;
+}
+
+int64_t libmod_ray_get_resolution_scale(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  float val = g_engine.resolutionScale;
+  return (int64_t) * (int32_t *)&val;
 }
 
 /* ============================================================================
@@ -965,6 +2068,7 @@ int64_t libmod_ray_set_fog(INSTANCE *my, int64_t *params) {
   g_engine.fog_b = b;
   g_engine.fog_start_distance = start_dist;
   g_engine.fog_end_distance = end_dist;
+  ray_shade_invalidate();
 
   return 1;
 }
@@ -1004,6 +2108,16 @@ int64_t libmod_ray_check_collision(INSTANCE *my, int64_t *params) {
                              g_engine.default_step_height);
 }
 
+/* RAY_TRACE_BATCH(&traces, count): traces is an array of the RAY_Trace
+   layout (six FLOATs, then INT32 mask, ignore, hit, sector_id, wall_id,
+   sprite and FLOAT hit_x, hit_y, hit_z, fraction). Fills the outputs of
+   every element and returns how many hit something. */
+int64_t libmod_ray_trace_batch(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  return ray_trace_batch((RAY_Trace *)(intptr_t)params[0], (int)params[1]);
+}
+
 int64_t libmod_ray_check_collision_z(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
@@ -1030,11 +2144,264 @@ int64_t libmod_ray_set_minimap(INSTANCE *my, int64_t *params) {
   return 1;
 }
 
+/* ============================================================================
+   SPRITE SECTOR BINS
+   Each sector keeps an intrusive list of the sprites inside it, so renderers
+   can walk only the sprites of visited sectors. Bins are updated when a
+   sprite moves, using its previous sector as the search hint.
+   ============================================================================
+ */
+
+static int *sprite_bin_head(int sector_index) {
+  if (sector_index >= 0 && sector_index < g_engine.sector_sprite_head_capacity)
+    return &g_engine.sector_sprite_head[sector_index];
+  return &g_engine.outside_sprite_head;
+}
+
+static void sprite_bin_link(int sprite_index, int sector_index) {
+  RAY_Sprite *s = &g_engine.sprites[sprite_index];
+  int *head = sprite_bin_head(sector_index);
+  s->sector_index = (head == &g_engine.outside_sprite_head) ? -1 : sector_index;
+  s->bin_prev = -1;
+  s->bin_next = *head;
+  if (*head >= 0)
+    g_engine.sprites[*head].bin_prev = sprite_index;
+  *head = sprite_index;
+  s->binned = 1;
+}
+
+void ray_sprite_bin_remove(int sprite_index) {
+  if (!g_engine.sprites || sprite_index < 0 ||
+      sprite_index >= g_engine.num_sprites)
+    return;
+  RAY_Sprite *s = &g_engine.sprites[sprite_index];
+  if (!s->binned)
+    return;
+
+  if (s->bin_prev >= 0)
+    g_engine.sprites[s->bin_prev].bin_next = s->bin_next;
+  else
+    *sprite_bin_head(s->sector_index) = s->bin_next;
+  if (s->bin_next >= 0)
+    g_engine.sprites[s->bin_next].bin_prev = s->bin_prev;
+
+  s->bin_prev = s->bin_next = -1;
+  s->binned = 0;
+}
+
+void ray_sprite_bin_update(int sprite_index) {
+  if (!g_engine.sprites || sprite_index < 0 ||
+      sprite_index >= g_engine.num_sprites)
+    return;
+  RAY_Sprite *s = &g_engine.sprites[sprite_index];
+  if (!s->in_use || s->cleanup) {
+    ray_sprite_bin_remove(sprite_index);
+    return;
+  }
+
+  int hint = s->binned ? s->sector_index : -1;
+  int sector_index = ray_locate_sector_index(&g_engine, hint, s->x, s->y);
+
+  if (s->binned && sector_index == s->sector_index)
+    return; /* Same sector: nothing to relink */
+
+  ray_sprite_bin_remove(sprite_index);
+  sprite_bin_link(sprite_index, sector_index);
+}
+
+/* (Re)allocate bins for the current map and relink every active sprite */
+void ray_sprite_bins_rebuild(void) {
+  int needed = g_engine.num_sectors;
+  if (needed > g_engine.sector_sprite_head_capacity) {
+    int *heads = (int *)realloc(g_engine.sector_sprite_head,
+                                needed * sizeof(int));
+    if (!heads) {
+      fprintf(stderr, "RAY: No se pudo reservar bins de sprites\n");
+      needed = g_engine.sector_sprite_head_capacity;
+    } else {
+      g_engine.sector_sprite_head = heads;
+      g_engine.sector_sprite_head_capacity = needed;
+    }
+  }
+  for (int i = 0; i < g_engine.sector_sprite_head_capacity; i++)
+    g_engine.sector_sprite_head[i] = -1;
+  g_engine.outside_sprite_head = -1;
+
+  if (!g_engine.sprites)
+    return;
+  for (int i = 0; i < g_engine.num_sprites; i++) {
+    RAY_Sprite *s = &g_engine.sprites[i];
+    s->binned = 0;
+    s->bin_prev = s->bin_next = -1;
+    s->sector_index = -1;
+    if (s->in_use && !s->cleanup)
+      sprite_bin_link(i, ray_locate_sector_index(&g_engine, -1, s->x, s->y));
+  }
+}
+
 /* ============================================================================
    SPRITES DINÁMICOS
+   Pool creciente: los slots libres forman una lista enlazada (pool_next) y
+   los ocupados una lista densa (active_sprites), así añadir, quitar y
+   recorrer los sprites vivos no depende de los huecos que deja el churn.
    ============================================================================
  */
 
+int ray_sprite_pool_reserve(int capacity) {
+  int old_capacity = g_engine.sprites ? g_engine.sprites_capacity : 0;
+  if (capacity <= old_capacity && g_engine.active_sprites)
+    return 1;
+  if (capacity > RAY_SPRITE_SLOT_MASK + 1) {
+    fprintf(stderr, "RAY: Máximo de sprites alcanzado\n");
+    return 0;
+  }
+
+  int cap = (capacity + RAY_SPRITE_CHUNK - 1) / RAY_SPRITE_CHUNK *
+            RAY_SPRITE_CHUNK;
+  if (cap < old_capacity)
+    cap = old_capacity;
+  int *active = (int *)realloc(g_engine.active_sprites, cap * sizeof(int));
+  if (!active)
+    return 0;
+  g_engine.active_sprites = active;
+
+  RAY_Sprite *sprites =
+      (RAY_Sprite *)realloc(g_engine.sprites, cap * sizeof(RAY_Sprite));
+  if (!sprites)
+    return 0;
+  memset(sprites + old_capacity, 0,
+         (cap - old_capacity) * sizeof(RAY_Sprite));
+  g_engine.sprites = sprites;
+  g_engine.sprites_capacity = cap;
+  return 1;
+}
+
+/* Rebuild the free and active lists from in_use, after a map load filled
+   sprites[0..num_sprites) directly */
+void ray_sprite_pool_rebuild(void) {
+  g_engine.num_active_sprites = 0;
+  g_engine.sprite_free_head = -1;
+  if (!g_engine.sprites || !g_engine.active_sprites)
+    return;
+  for (int i = g_engine.num_sprites - 1; i >= 0; i--) {
+    RAY_Sprite *s = &g_engine.sprites[i];
+    if (s->in_use) {
+      s->pool_next = -1;
+      continue;
+    }
+    s->active_index = -1;
+    s->pool_next = g_engine.sprite_free_head;
+    g_engine.sprite_free_head = i;
+  }
+  for (int i = 0; i < g_engine.num_sprites; i++) {
+    RAY_Sprite *s = &g_engine.sprites[i];
+    if (s->in_use) {
+      s->active_index = g_engine.num_active_sprites;
+      g_engine.active_sprites[g_engine.num_active_sprites++] = i;
+    }
+  }
+}
+
+void ray_sprite_pool_free(void) {
+  if (g_engine.sprites) {
+    for (int i = 0; i < g_engine.num_sprites; i++) {
+      ray_physics_destroy_body(g_engine.sprites[i].physics);
+      free(g_engine.sprites[i].model_data);
+    }
+    free(g_engine.sprites);
+    g_engine.sprites = NULL;
+  }
+  free(g_engine.active_sprites);
+  g_engine.active_sprites = NULL;
+  g_engine.sprites_capacity = 0;
+  g_engine.num_sprites = 0;
+  g_engine.num_active_sprites = 0;
+  g_engine.sprite_free_head = -1;
+}
+
+/* Take a free slot (or a new one at the end, growing the pool) and mark it
+   in use. Returns the slot index, -1 if the pool cannot grow */
+int ray_sprite_alloc(void) {
+  int slot = g_engine.sprite_free_head;
+  if (slot >= 0) {
+    g_engine.sprite_free_head = g_engine.sprites[slot].pool_next;
+  } else {
+    if (g_engine.num_sprites >= g_engine.sprites_capacity &&
+        !ray_sprite_pool_reserve(g_engine.num_sprites + RAY_SPRITE_CHUNK))
+      return -1;
+    slot = g_engine.num_sprites++;
+  }
+
+  RAY_Sprite *s = &g_engine.sprites[slot];
+  int generation = s->generation;
+  memset(s, 0, sizeof(RAY_Sprite));
+  s->generation = generation;
+  s->pool_next = -1;
+  s->in_use = 1;
+  s->sector_index = -1;
+  s->bin_prev = s->bin_next = -1;
+  s->active_index = g_engine.num_active_sprites;
+  g_engine.active_sprites[g_engine.num_active_sprites++] = slot;
+  return slot;
+}
+
+void ray_sprite_release(int sprite_index) {
+  if (!g_engine.sprites || sprite_index < 0 ||
+      sprite_index >= g_engine.num_sprites)
+    return;
+  RAY_Sprite *s = &g_engine.sprites[sprite_index];
+  if (!s->in_use)
+    return;
+
+  ray_sprite_bin_remove(sprite_index);
+  ray_physics_destroy_body(s->physics);
+  s->physics = NULL;
+  free(s->model_data);
+  s->model_data = NULL;
+  s->process_ptr = NULL;
+  s->in_use = 0;
+  s->cleanup = 1;
+  s->generation = (s->generation + 1) & RAY_SPRITE_GEN_MASK;
+
+  /* El último activo ocupa el hueco en la lista densa */
+  int last = g_engine.active_sprites[--g_engine.num_active_sprites];
+  g_engine.active_sprites[s->active_index] = last;
+  g_engine.sprites[last].active_index = s->active_index;
+  s->active_index = -1;
+
+  s->pool_next = g_engine.sprite_free_head;
+  g_engine.sprite_free_head = sprite_index;
+}
+
+/* Slot of a live sprite handle, -1 if it is out of range, free or stale */
+int ray_sprite_resolve(int64_t handle) {
+  if (handle < 0 || !g_engine.sprites)
+    return -1;
+  int slot = (int)(handle & RAY_SPRITE_SLOT_MASK);
+  if (slot >= g_engine.num_sprites)
+    return -1;
+  RAY_Sprite *s = &g_engine.sprites[slot];
+  if (!s->in_use || (handle >> RAY_SPRITE_SLOT_BITS) != s->generation)
+    return -1;
+  return slot;
+}
+
+int64_t ray_sprite_handle(int sprite_index) {
+  if (!g_engine.sprites || sprite_index < 0 ||
+      sprite_index >= g_engine.num_sprites)
+    return -1;
+  return ((int64_t)g_engine.sprites[sprite_index].generation
+          << RAY_SPRITE_SLOT_BITS) |
+         sprite_index;
+}
+
+RAY_SpriteModelData *ray_sprite_model_data(RAY_Sprite *sprite) {
+  if (!sprite->model_data)
+    sprite->model_data =
+        (RAY_SpriteModelData *)calloc(1, sizeof(RAY_SpriteModelData));
+  return sprite->model_data;
+}
+
 int64_t libmod_ray_add_sprite(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
@@ -1057,28 +2424,11 @@ int64_t libmod_ray_add_sprite(INSTANCE *my, int64_t *params) {
   int h = (int)params[6];
   int flags = (int)params[7];
 
-  /* Look for an empty slot first to reuse */
-  int slot = -1;
-  for (int i = 0; i < g_engine.num_sprites; i++) {
-    if (!g_engine.sprites[i].in_use) {
-      slot = i;
-      break;
-    }
-  }
-
-  /* If no empty slot found, check if we can expand num_sprites */
-  if (slot == -1) {
-    if (g_engine.num_sprites >= g_engine.sprites_capacity) {
-      fprintf(stderr, "RAY: Máximo de sprites alcanzado\n");
-      return -1;
-    }
-    slot = g_engine.num_sprites;
-    g_engine.num_sprites++;
-  }
+  int slot = ray_sprite_alloc();
+  if (slot < 0)
+    return -1;
 
   RAY_Sprite *sprite = &g_engine.sprites[slot];
-  memset(sprite, 0, sizeof(RAY_Sprite));
-
   sprite->x = x;
   sprite->y = y;
   sprite->z = z;
@@ -1095,24 +2445,24 @@ int64_t libmod_ray_add_sprite(INSTANCE *my, int64_t *params) {
   sprite->glb_anim_index = -1; // Default: no animation
   sprite->glb_anim_time = 0.0f;
   sprite->glb_anim_speed = 0.0f;
-  sprite->in_use = 1;
+  sprite->glb_pose_slot = -1;
+  sprite->glb_pose_serial = 0;
+  ray_sprite_bin_update(slot);
 
-  return slot;
+  return ray_sprite_handle(slot);
 }
 
 int64_t libmod_ray_remove_sprite(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites) {
+  if (sprite_id < 0) {
     return 0;
   }
 
-  g_engine.sprites[sprite_id].cleanup = 1;
-  g_engine.sprites[sprite_id].in_use = 0; // Mark as reusable immediately
-
+  ray_sprite_release(sprite_id); /* Reusable immediately, handle goes stale */
   return 1;
 }
 
@@ -1123,8 +2473,8 @@ int64_t libmod_ray_get_sprite_frame(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return -1;
 
-  int sprite_id = (int)params[0];
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  int sprite_id = ray_sprite_resolve(params[0]);
+  if (sprite_id < 0)
     return -1;
 
   // currentFrame is the 'from' frame used by the MD3/MD2 renderer
@@ -1135,20 +2485,21 @@ int64_t libmod_ray_update_sprite_position(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   float x = 0.0f, y = 0.0f, z = 0.0f;
   
   memcpy(&x, &params[1], 4);
   memcpy(&y, &params[2], 4);
   memcpy(&z, &params[3], 4);
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites) {
+  if (sprite_id < 0) {
     return 0;
   }
 
   g_engine.sprites[sprite_id].x = x;
   g_engine.sprites[sprite_id].y = y;
   g_engine.sprites[sprite_id].z = z;
+  ray_sprite_bin_update(sprite_id);
 
   return 1;
 }
@@ -1307,38 +2658,119 @@ int64_t libmod_ray_load_gltf(INSTANCE *my, int64_t *params) {
   return (int64_t)(intptr_t)model;
 }
 
-int64_t libmod_ray_get_gltf_anim_count(INSTANCE *my, int64_t *params) {
-  RAY_GLTF_Model *model = (RAY_GLTF_Model *)(intptr_t)params[0];
-  if (!model || !model->data)
+/* RAY_LOAD_*_ASYNC(file): handle immediately, the file is read and decoded
+   on a background thread. The handle can be given straight to
+   RAY_SET_SPRITE_* (flat sprite until ready); RAY_LOAD_STATUS polls it and
+   RAY_LOADED_MODEL returns the model once it is RAY_LOAD_READY. */
+static int64_t load_async(int64_t *params, uint32_t format) {
+  if (!g_engine.initialized)
     return 0;
-  return (int64_t)model->data->animations_count;
+  const char *filename = (const char *)string_get((int)params[0]);
+  void *handle = ray_async_load(filename, format);
+  string_discard((int)params[0]);
+  return (int64_t)(intptr_t)handle;
 }
 
-int64_t libmod_ray_set_sprite_md2(INSTANCE *my, int64_t *params) {
+int64_t libmod_ray_load_md2_async(INSTANCE *my, int64_t *params) {
+  return load_async(params, MD2_MAGIC);
+}
+
+int64_t libmod_ray_load_md3_async(INSTANCE *my, int64_t *params) {
+  return load_async(params, MD3_MAGIC);
+}
+
+int64_t libmod_ray_load_gltf_async(INSTANCE *my, int64_t *params) {
+  return load_async(params, GLTF_MAGIC);
+}
+
+int64_t libmod_ray_load_status(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return RAY_LOAD_FAILED;
+  return ray_async_status((void *)(intptr_t)params[0]);
+}
+
+int64_t libmod_ray_loaded_model(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
-  int64_t model_ptr = params[1];
-  int skin_id = (int)params[2]; // Texture ID for skin
+  return (int64_t)(intptr_t)ray_async_model((void *)(intptr_t)params[0]);
+}
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+/* RAY_SET_LOAD_BUDGET(n): glTF textures uploaded to the GPU per frame */
+int64_t libmod_ray_set_load_budget(INSTANCE *my, int64_t *params) {
+  ray_async_set_budget((int)params[0]);
+  return 1;
+}
+
+/* RAY_MODEL_ADD_LOD(model, lod_model, screen_px): lod_model (same format,
+   loaded with RAY_LOAD_*) replaces model once it covers less than screen_px
+   pixels of height */
+int64_t libmod_ray_model_add_lod(INSTANCE *my, int64_t *params) {
+  return ray_model_lod_add(ray_async_model((void *)(intptr_t)params[0]),
+                           ray_async_model((void *)(intptr_t)params[1]),
+                           (float)params[2]);
+}
+
+/* RAY_MODEL_SET_IMPOSTOR(model, screen_px, size): bakes one view of at most
+   size pixels per billboard direction (MD2/MD3, frame 0) and draws it
+   below screen_px */
+int64_t libmod_ray_model_set_impostor(INSTANCE *my, int64_t *params) {
+  void *model = ray_async_model((void *)(intptr_t)params[0]);
+  return ray_model_impostor_bake(model, (float)params[1], (int)params[2]);
+}
+
+/* RAY_MODEL_SET_IMPOSTOR_GRAPHS(model, screen_px, file, first_graph): views
+   drawn by the game, graph first_graph + k seen from k * 360 / directions
+   degrees around the model; any format */
+int64_t libmod_ray_model_set_impostor_graphs(INSTANCE *my, int64_t *params) {
+  void *model = ray_async_model((void *)(intptr_t)params[0]);
+  return ray_model_impostor_graphs(model, (float)params[1], params[2],
+                                   (int)params[3]);
+}
+
+int64_t libmod_ray_get_gltf_anim_count(INSTANCE *my, int64_t *params) {
+  RAY_GLTF_Model *model =
+      (RAY_GLTF_Model *)ray_async_model((void *)(intptr_t)params[0]);
+  if (!model || model->magic != GLTF_MAGIC || !model->data)
     return 0;
+  return (int64_t)model->data->animations_count;
+}
 
-  RAY_Sprite *s = &g_engine.sprites[sprite_id];
-  s->model = (struct RAY_Model *)(intptr_t)model_ptr;
-  s->textureID = skin_id; // Set as sprite-specific skin
+void ray_sprite_set_model(RAY_Sprite *s, void *model, int skin) {
+  s->model = (struct RAY_Model *)model;
+  if (s->model_data)
+    s->model_data->pending_load = NULL; /* Gana la ultima asignacion */
+  if (skin < 0)
+    return;
+  s->textureID = skin; // Set as sprite-specific skin
 
   if (s->model) {
     int magic = *(int *)s->model;
     if (magic == MD2_MAGIC) {
       // Still set model default as fallback, but sprite skin takes priority
-      ((RAY_MD2_Model *)s->model)->textureID = skin_id;
+      ((RAY_MD2_Model *)s->model)->textureID = skin;
     } else if (magic == MD3_MAGIC) {
-      ((RAY_MD3_Model *)s->model)->textureID = skin_id;
+      ((RAY_MD3_Model *)s->model)->textureID = skin;
     } else if (magic == GLTF_MAGIC) {
-      ((RAY_GLTF_Model *)s->model)->textureID = skin_id;
+      ((RAY_GLTF_Model *)s->model)->textureID = skin;
     }
   }
+}
+
+int64_t libmod_ray_set_sprite_md2(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int sprite_id = ray_sprite_resolve(params[0]);
+  void *model = (void *)(intptr_t)params[1];
+  int skin_id = (int)params[2]; // Texture ID for skin
+
+  if (sprite_id < 0)
+    return 0;
+
+  RAY_Sprite *s = &g_engine.sprites[sprite_id];
+  if (ray_async_is_handle(model))
+    ray_async_attach(s, model, skin_id);
+  else
+    ray_sprite_set_model(s, model, skin_id);
   return 1;
 }
 
@@ -1349,26 +2781,29 @@ int64_t libmod_ray_set_sprite_md3(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_set_sprite_gltf(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   int64_t model_ptr = params[1];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   RAY_Sprite *s = &g_engine.sprites[sprite_id];
-  s->model = (struct RAY_Model *)(intptr_t)model_ptr;
+  if (ray_async_is_handle((void *)(intptr_t)model_ptr))
+    ray_async_attach(s, (void *)(intptr_t)model_ptr, -1);
+  else
+    ray_sprite_set_model(s, (void *)(intptr_t)model_ptr, -1);
   return 1;
 }
 
 int64_t libmod_ray_set_sprite_anim(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   int frame = (int)params[1];
   int next_frame = (int)params[2];
   float interp = *(float *)&params[3];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   RAY_Sprite *s = &g_engine.sprites[sprite_id];
@@ -1381,11 +2816,11 @@ int64_t libmod_ray_set_sprite_anim(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_set_sprite_glb_anim(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   int anim_index = (int)params[1];
   float anim_time = *(float *)&params[2];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   RAY_Sprite *s = &g_engine.sprites[sprite_id];
@@ -1397,10 +2832,10 @@ int64_t libmod_ray_set_sprite_glb_anim(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_set_sprite_glb_speed(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   float speed = *(float *)&params[1];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   RAY_Sprite *s = &g_engine.sprites[sprite_id];
@@ -1412,10 +2847,10 @@ int64_t libmod_ray_set_sprite_angle(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   float angle = *(float *)&params[1];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   // Angle in degrees to radians
@@ -1428,32 +2863,52 @@ int64_t libmod_ray_set_sprite_md3_surface_texture(INSTANCE *my,
                                                   int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   int surface_idx = (int)params[1];
   int texture_id = (int)params[2];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   RAY_Sprite *s = &g_engine.sprites[sprite_id];
   if (surface_idx < 0 || surface_idx >= 32)
     return 0;
 
-  s->md3_surface_textures[surface_idx] = texture_id;
+  RAY_SpriteModelData *md = ray_sprite_model_data(s);
+  if (!md)
+    return 0;
+  md->md3_surface_textures[surface_idx] = texture_id;
+  return 1;
+}
+
+/* RAY_SET_MODEL_CULLING(sprite, RAY_CULL_*): backface culling of an MD2/MD3
+   sprite in the software renderer */
+int64_t libmod_ray_set_model_culling(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int sprite_id = ray_sprite_resolve(params[0]);
+  int mode = (int)params[1];
+  if (sprite_id < 0 || mode < RAY_CULL_NONE || mode > RAY_CULL_FRONT)
+    return 0;
+
+  RAY_SpriteModelData *md = ray_sprite_model_data(&g_engine.sprites[sprite_id]);
+  if (!md)
+    return 0;
+  md->cull_mode = mode;
   return 1;
 }
 
 int64_t libmod_ray_get_md3_tag(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   const char *tag_name = (const char *)string_get(params[1]);
   float *out_x = (float *)(intptr_t)params[2];
   float *out_y = (float *)(intptr_t)params[3];
   float *out_z = (float *)(intptr_t)params[4];
   float *out_angle = (float *)(intptr_t)params[5];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites) {
+  if (sprite_id < 0) {
     string_discard(params[1]);
     return 0;
   }
@@ -1523,10 +2978,10 @@ int64_t libmod_ray_set_sprite_scale(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   float scale = *(float *)&params[1];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   g_engine.sprites[sprite_id].model_scale = scale;
@@ -1603,7 +3058,7 @@ int64_t libmod_ray_get_tag_point(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   const char *tag_name = (const char *)string_get((int)params[1]);
   int *ptr_x = (int *)params[2]; // Pointers to FLOAT variables
   int *ptr_y = (int *)params[3];
@@ -1612,7 +3067,7 @@ int64_t libmod_ray_get_tag_point(INSTANCE *my, int64_t *params) {
   // Default return
   int result = 0;
 
-  if (sprite_id >= 0 && sprite_id < g_engine.num_sprites) {
+  if (sprite_id >= 0) {
     RAY_Sprite *s = &g_engine.sprites[sprite_id];
 
     if (s->model && (*(int *)s->model) == MD3_MAGIC) {
@@ -1710,6 +3165,7 @@ int64_t libmod_ray_add_light(INSTANCE *my, int64_t *params) {
          "Intensity=%.1f\n",
          l->x, l->y, l->z, l->r, l->g, l->b, l->intensity);
 
+  ray_lights_invalidate(); /* Las listas por sector se rehacen al dibujar */
   return g_engine.num_lights++;
 }
 
@@ -1720,6 +3176,226 @@ int64_t libmod_ray_clear_lights(INSTANCE *my, int64_t *params) {
   return 1;
 }
 
+/* RAY_SET_LIGHT_CULLING(mode): RAY_LIGHT_CULL_NONE / _SECTOR / _SCREEN.
+   Returns the previous mode */
+int64_t libmod_ray_set_light_culling(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return -1;
+  int prev = g_engine.light_culling;
+  int mode = (int)params[0];
+  if (mode < RAY_LIGHT_CULL_NONE || mode > RAY_LIGHT_CULL_SCREEN)
+    return -1;
+  g_engine.light_culling = mode;
+  return prev;
+}
+
+/* ============================================================================
+   LISTAS DE LUCES POR SECTOR
+   Each light floods out of the sector that contains it through every portal
+   whose segment lies within its range, into the nested sectors its circle
+   overlaps and up to the parent of every sector it reaches. Heights are
+   ignored, which only keeps a few extra lights. The GPU renderer uploads
+   the list of the sector it is drawing instead of every light in the map.
+   ============================================================================
+ */
+
+typedef struct {
+  int sector, light;
+} RAY_LightRef;
+
+static float light_seg_dist2(float px, float py, float x1, float y1, float x2,
+                             float y2) {
+  float dx = x2 - x1, dy = y2 - y1;
+  float len2 = dx * dx + dy * dy;
+  float t = len2 > 1e-6f ? ((px - x1) * dx + (py - y1) * dy) / len2 : 0.0f;
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  float ex = x1 + dx * t - px, ey = y1 + dy * t - py;
+  return ex * ex + ey * ey;
+}
+
+static int light_touches_box(const RAY_Sector *sector, float x, float y,
+                             float range) {
+  float cx = x < sector->min_x ? sector->min_x
+                               : (x > sector->max_x ? sector->max_x : x);
+  float cy = y < sector->min_y ? sector->min_y
+                               : (y > sector->max_y ? sector->max_y : y);
+  return (cx - x) * (cx - x) + (cy - y) * (cy - y) <= range * range;
+}
+
+/* Strongest first, so a sector with more than RAY_MAX_DRAW_LIGHTS keeps the
+   ones that matter */
+static int light_strength_cmp(const void *a, const void *b) {
+  int la = *(const int *)a, lb = *(const int *)b;
+  float ia = g_engine.lights[la].intensity, ib = g_engine.lights[lb].intensity;
+  if (ia != ib)
+    return ia < ib ? 1 : -1;
+  return la - lb;
+}
+
+static void lights_rebuild(void) {
+  int n = g_engine.num_sectors;
+  int np = g_engine.num_portals;
+  ray_lights_free();
+  g_engine.sector_lights_dirty = 0;
+  if (n <= 0 || g_engine.num_lights <= 0 || !g_engine.sectors)
+    return;
+
+  int *portal_first = (int *)calloc(n + 1, sizeof(int));
+  int *portal_refs = (int *)malloc((np > 0 ? np : 1) * 2 * sizeof(int));
+  int *portal_sector = (int *)malloc((np > 0 ? np : 1) * 2 * sizeof(int));
+  int *parent = (int *)malloc(n * sizeof(int));
+  int *stamp = (int *)malloc(n * sizeof(int));
+  int *queue = (int *)malloc(n * sizeof(int));
+  int *first = (int *)calloc(n + 1, sizeof(int));
+  int refs_cap = g_engine.num_lights * 4;
+  RAY_LightRef *refs = (RAY_LightRef *)malloc(refs_cap * sizeof(RAY_LightRef));
+  int num_refs = 0;
+  int *lists = NULL;
+
+  if (!portal_first || !portal_refs || !portal_sector || !parent || !stamp ||
+      !queue || !first || !refs)
+    goto done;
+
+  /* Portal adjacency by sector index */
+  for (int p = 0; p < np; p++) {
+    RAY_Portal *portal = &g_engine.portals[p];
+    portal_sector[p * 2] = ray_sector_index_by_id(&g_engine, portal->sector_a);
+    portal_sector[p * 2 + 1] =
+        ray_sector_index_by_id(&g_engine, portal->sector_b);
+    for (int k = 0; k < 2; k++)
+      if (portal_sector[p * 2 + k] >= 0)
+        portal_first[portal_sector[p * 2 + k] + 1]++;
+  }
+  for (int i = 0; i < n; i++)
+    portal_first[i + 1] += portal_first[i];
+  memcpy(queue, portal_first, n * sizeof(int)); /* Fill cursors */
+  for (int p = 0; p < np; p++)
+    for (int k = 0; k < 2; k++)
+      if (portal_sector[p * 2 + k] >= 0)
+        portal_refs[queue[portal_sector[p * 2 + k]]++] = p;
+
+  for (int i = 0; i < n; i++) {
+    int pid = g_engine.sectors[i].parent_sector_id;
+    parent[i] = pid >= 0 ? ray_sector_index_by_id(&g_engine, pid) : -1;
+    stamp[i] = -1;
+  }
+
+  for (int l = 0; l < g_engine.num_lights; l++) {
+    const RAY_Light *light = &g_engine.lights[l];
+    float range = RAY_LIGHT_RANGE * light->intensity;
+    if (range <= 0.0f)
+      continue;
+    int start = ray_locate_sector_index(&g_engine, -1, light->x, light->y);
+    if (start < 0)
+      continue;
+
+    int head = 0, tail = 0;
+    queue[tail++] = start;
+    stamp[start] = l;
+    while (head < tail) {
+      int cur = queue[head++];
+      if (num_refs >= refs_cap) {
+        RAY_LightRef *grown = (RAY_LightRef *)realloc(
+            refs, refs_cap * 2 * sizeof(RAY_LightRef));
+        if (!grown)
+          goto done;
+        refs = grown;
+        refs_cap *= 2;
+      }
+      refs[num_refs].sector = cur;
+      refs[num_refs].light = l;
+      num_refs++;
+      first[cur + 1]++;
+
+      for (int r = portal_first[cur]; r < portal_first[cur + 1]; r++) {
+        int p = portal_refs[r];
+        int next = portal_sector[p * 2] == cur ? portal_sector[p * 2 + 1]
+                                               : portal_sector[p * 2];
+        if (next < 0 || stamp[next] == l)
+          continue;
+        RAY_Portal *portal = &g_engine.portals[p];
+        if (light_seg_dist2(light->x, light->y, portal->x1, portal->y1,
+                            portal->x2, portal->y2) > range * range)
+          continue;
+        stamp[next] = l;
+        queue[tail++] = next;
+      }
+
+      RAY_Sector *sector = &g_engine.sectors[cur];
+      for (int c = 0; c < sector->num_children; c++) {
+        int child =
+            ray_sector_index_by_id(&g_engine, sector->child_sector_ids[c]);
+        if (child < 0 || stamp[child] == l ||
+            !light_touches_box(&g_engine.sectors[child], light->x, light->y,
+                               range))
+          continue;
+        stamp[child] = l;
+        queue[tail++] = child;
+      }
+      if (parent[cur] >= 0 && stamp[parent[cur]] != l) {
+        stamp[parent[cur]] = l;
+        queue[tail++] = parent[cur];
+      }
+    }
+  }
+
+  lists = (int *)malloc((num_refs > 0 ? num_refs : 1) * sizeof(int));
+  if (!lists)
+    goto done;
+  for (int i = 0; i < n; i++)
+    first[i + 1] += first[i];
+  memcpy(queue, first, n * sizeof(int));
+  for (int r = 0; r < num_refs; r++)
+    lists[queue[refs[r].sector]++] = refs[r].light;
+  for (int i = 0; i < n; i++)
+    if (first[i + 1] - first[i] > 1)
+      qsort(&lists[first[i]], first[i + 1] - first[i], sizeof(int),
+            light_strength_cmp);
+
+  g_engine.sector_light_first = first;
+  g_engine.sector_lights = lists;
+  g_engine.sector_lights_sectors = n;
+  first = NULL;
+  lists = NULL;
+  if (g_engine.verbose)
+    printf("RAY: Luces por sector: %d luces, %d asignaciones en %d sectores\n",
+           g_engine.num_lights, num_refs, n);
+
+done:
+  free(portal_first);
+  free(portal_refs);
+  free(portal_sector);
+  free(parent);
+  free(stamp);
+  free(queue);
+  free(first);
+  free(refs);
+  free(lists);
+}
+
+void ray_lights_invalidate(void) { g_engine.sector_lights_dirty = 1; }
+
+void ray_lights_free(void) {
+  free(g_engine.sector_light_first);
+  free(g_engine.sector_lights);
+  g_engine.sector_light_first = NULL;
+  g_engine.sector_lights = NULL;
+  g_engine.sector_lights_sectors = 0;
+}
+
+const int *ray_sector_lights(int sector_index, int *count) {
+  *count = 0;
+  if (g_engine.sector_lights_dirty)
+    lights_rebuild();
+  if (!g_engine.sector_light_first ||
+      g_engine.sector_lights_sectors != g_engine.num_sectors ||
+      sector_index < 0 || sector_index >= g_engine.sector_lights_sectors)
+    return NULL;
+  int begin = g_engine.sector_light_first[sector_index];
+  *count = g_engine.sector_light_first[sector_index + 1] - begin;
+  return &g_engine.sector_lights[begin];
+}
+
 int64_t libmod_ray_set_texture_quality(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
@@ -1727,15 +3403,91 @@ int64_t libmod_ray_set_texture_quality(INSTANCE *my, int64_t *params) {
   return 1;
 }
 
+/* RAY_SET_FLOOR_SPANS(on): software floors/ceilings as row spans (1,
+   default) or one column at a time (0). */
+int64_t libmod_ray_set_floor_spans(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  g_engine.floor_spans = (int)params[0] ? 1 : 0;
+  return 1;
+}
+
+/* RAY_SET_MIPMAPS(on): mipmaps for software walls, floors and models (1,
+   default). Changing it drops the cached chains. */
+int64_t libmod_ray_set_mipmaps(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int on = (int)params[0] ? 1 : 0;
+  if (on != g_engine.mipmaps) {
+    g_engine.mipmaps = on;
+    ray_mip_clear();
+  }
+  return 1;
+}
+
+/* RAY_GET_MIP_MEMORY(): bytes used by the reduced mip levels */
+int64_t libmod_ray_get_mip_memory(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  return (int64_t)ray_mip_memory_used();
+}
+
+/* RAY_SET_TEXTURE_ATLAS(on): GPU renderer packs the map's RAY_TEXTURE_SIZE
+   world textures into one atlas so walls batch across textures (0,
+   default). Returns the previous value */
+int64_t libmod_ray_set_texture_atlas(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int prev = g_engine.texture_atlas;
+  g_engine.texture_atlas = (int)params[0] ? 1 : 0;
+  return prev;
+}
+
+/* RAY_FLUSH_TEXTURES(): forget cached textures (mip chains, GPU handles,
+   atlas). Both caches notice unloaded or reloaded FPGs on their own; this
+   only frees the memory of chains and cells that are no longer used */
+int64_t libmod_ray_flush_textures(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  ray_mip_clear();
+  ray_gpu_invalidate_textures();
+  return 1;
+}
+
+/* RAY_SET_RENDER_THREADS(n): column bands for the software renderer.
+   1 = single-threaded (default), 0 = one band per CPU core. */
+int64_t libmod_ray_set_render_threads(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int n = (int)params[0];
+  if (n < 0)
+    n = 0;
+  g_engine.render_threads = n;
+  return 1;
+}
+
+/* RAY_SET_VERBOSE(level): 1 = log every sector, wall and portal while
+   loading maps, 2 = also a renderer summary every 60 frames (turns stats
+   on), 0 = summaries only (default). */
+int64_t libmod_ray_set_verbose(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  int level = (int)params[0];
+  g_engine.verbose = level < 0 ? 0 : (level > 2 ? 2 : level);
+  if (g_engine.verbose >= 2)
+    g_engine.stats_enabled = 1; /* El resumen periódico sale de RAY_GET_STAT */
+  return 1;
+}
+
 int64_t libmod_ray_set_collision_box(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   float w = *(float *)&params[1];
   float d = *(float *)&params[2]; // Parameter 2 is usually Depth in the editor
   float h = *(float *)&params[3]; // Parameter 3 is Height
 
-  if (sprite_id >= 0 && sprite_id < g_engine.num_sprites) {
+  if (sprite_id >= 0) {
     g_engine.sprites[sprite_id].col_w = w;
     g_engine.sprites[sprite_id].col_h = h;
     g_engine.sprites[sprite_id].col_d = d;
@@ -1747,26 +3499,27 @@ int64_t libmod_ray_set_collision_box(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_get_collision(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return -1;
-  int sprite_id = (int)params[0];
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  int sprite_id = ray_sprite_resolve(params[0]);
+  if (sprite_id < 0)
     return -1;
 
   RAY_Sprite *s1 = &g_engine.sprites[sprite_id];
   if (!s1->in_use || s1->cleanup)
     return -1;
 
-  for (int i = 0; i < g_engine.num_sprites; i++) {
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
     if (i == sprite_id)
       continue;
     RAY_Sprite *s2 = &g_engine.sprites[i];
-    if (!s2->in_use || s2->cleanup || s2->hidden)
+    if (s2->cleanup || s2->hidden)
       continue;
 
     // Check intersection (Simple AABB)
     if (fabsf(s1->x - s2->x) < (s1->col_w + s2->col_w) * 0.5f &&
         fabsf(s1->y - s2->y) < (s1->col_d + s2->col_d) * 0.5f &&
         fabsf(s1->z - s2->z) < (s1->col_h + s2->col_h) * 0.5f) {
-      return i;
+      return ray_sprite_handle(i);
     }
   }
   return -1;
@@ -1775,9 +3528,9 @@ int64_t libmod_ray_get_collision(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_set_sprite_flags(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   int flags = (int)params[1];
-  if (sprite_id >= 0 && sprite_id < g_engine.num_sprites) {
+  if (sprite_id >= 0) {
     g_engine.sprites[sprite_id].flags = flags;
     // Handle specific flags (e.g., bit 0 = invisible)
     if (flags & 1)
@@ -1792,9 +3545,9 @@ int64_t libmod_ray_set_sprite_flags(INSTANCE *my, int64_t *params) {
 int64_t libmod_ray_set_sprite_graph(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   int graph = (int)params[1];
-  if (sprite_id >= 0 && sprite_id < g_engine.num_sprites) {
+  if (sprite_id >= 0) {
     g_engine.sprites[sprite_id].textureID = graph;
     return 1;
   }
@@ -1914,11 +3667,11 @@ int64_t libmod_ray_move_sprite(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int sprite_id = (int)params[0];
+  int sprite_id = ray_sprite_resolve(params[0]);
   float dist = *(float *)&params[1];
   float step_h = *(float *)&params[2];
 
-  if (sprite_id < 0 || sprite_id >= g_engine.num_sprites)
+  if (sprite_id < 0)
     return 0;
 
   RAY_Sprite *s = &g_engine.sprites[sprite_id];
@@ -1949,6 +3702,7 @@ int64_t libmod_ray_move_sprite(INSTANCE *my, int64_t *params) {
   if (!blocked) {
     s->x = newX;
     s->y = newY;
+    ray_sprite_bin_update(sprite_id);
 
     // Actualizar Z automáticamente (climbing)
     RAY_Sector *sector =
@@ -1989,7 +3743,7 @@ int64_t libmod_ray_check_sprite_collision(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return -1;
 
-  int self_id = (int)params[0];
+  int self_id = ray_sprite_resolve(params[0]);
   float new_x = *(float *)&params[1];
   float new_y = *(float *)&params[2];
   float radius = *(float *)&params[3];
@@ -1997,7 +3751,8 @@ int64_t libmod_ray_check_sprite_collision(INSTANCE *my, int64_t *params) {
   if (radius <= 0.0f)
     radius = 32.0f;
 
-  for (int i = 0; i < g_engine.num_sprites; i++) {
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
     if (i == self_id)
       continue;
     RAY_Sprite *other = &g_engine.sprites[i];
@@ -2014,10 +3769,10 @@ int64_t libmod_ray_check_sprite_collision(INSTANCE *my, int64_t *params) {
 
     if (dist_sq < min_dist * min_dist) {
       float self_z = 0;
-      if (self_id >= 0 && self_id < g_engine.num_sprites) {
+      if (self_id >= 0) {
         self_z = g_engine.sprites[self_id].z;
       }
-      float self_h = (self_id >= 0 && self_id < g_engine.num_sprites)
+      float self_h = (self_id >= 0)
                          ? (g_engine.sprites[self_id].col_h > 0
                                 ? g_engine.sprites[self_id].col_h
                                 : g_engine.sprites[self_id].h)
@@ -2025,7 +3780,7 @@ int64_t libmod_ray_check_sprite_collision(INSTANCE *my, int64_t *params) {
       float other_h = (other->col_h > 0) ? other->col_h : other->h;
 
       if (self_z < other->z + other_h && self_z + self_h > other->z) {
-        return i;
+        return ray_sprite_handle(i);
       }
     }
   }
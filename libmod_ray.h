@@ -22,11 +22,11 @@
 
 #define RAY_WORLD_UNIT 128      /* Unidad base del mundo */
 #define RAY_TEXTURE_SIZE 128    /* Tamaño de texturas */
-#define RAY_MAX_SPRITES 2000    /* Máximo de sprites */
+#define RAY_MAX_SPRITES 2000    /* Capacidad inicial del pool de sprites */
 #define RAY_MAX_SPAWN_FLAGS 500 /* Máximo de spawn flags */
 #define RAY_MAX_SECTORS 5000    /* Máximo de sectores */
 #define RAY_MAX_PORTALS 10000   /* Máximo de portales */
-#define RAY_MAX_LIGHTS 64       /* Máximo de luces puntuales */
+#define RAY_MAX_LIGHTS 1024     /* Máximo de luces puntuales */
 #define RAY_MAX_VERTICES_PER_SECTOR                                            \
   256 /* Máximo vértices por sector (aumentado para mapas complejos) */
 #define RAY_MAX_WALLS_PER_SECTOR                                               \
@@ -191,6 +191,31 @@ typedef struct {
 typedef struct RAY_Model RAY_Model;
 extern float *g_zbuffer;
 
+/* Cold per-model data, allocated the first time a sprite needs it */
+typedef struct {
+  int md3_surface_textures[32]; /* Texturas por superficie si es MD3 */
+  int cull_mode;                /* RAY_CULL_*, rasterizador software */
+  void *pending_load; /* Carga asincrona aun sin terminar (NULL = ninguna) */
+  int pending_skin;   /* Skin a aplicar al terminar (-1 = no tocar) */
+} RAY_SpriteModelData;
+
+/* Backface culling por modelo. BACK descarta los triangulos que quedan en
+   sentido antihorario en pantalla; FRONT es para modelos con el winding
+   invertido. Por defecto no se descarta nada. */
+#define RAY_CULL_NONE 0
+#define RAY_CULL_BACK 1
+#define RAY_CULL_FRONT 2
+
+/* Sprite handles: slot in the low bits, slot generation above them. The
+   generation changes every time the slot is freed, so a handle kept by a
+   process after RAY_REMOVE_SPRITE stops resolving instead of aliasing the
+   next sprite. Generation 0 handles equal the plain slot index, which keeps
+   the sprite numbers of map files valid. */
+#define RAY_SPRITE_SLOT_BITS 20
+#define RAY_SPRITE_SLOT_MASK ((1 << RAY_SPRITE_SLOT_BITS) - 1)
+#define RAY_SPRITE_GEN_MASK 0x7FF
+#define RAY_SPRITE_CHUNK 256 /* Crecimiento del pool en sprites */
+
 typedef struct {
   float x, y, z;
   int w, h;
@@ -226,15 +251,33 @@ typedef struct {
   float interpolation; /* Factor de interpolación entre frames (0.0 - 1.0) */
   float model_scale;   /* Factor de escala del modelo (1.0 = normal, 10.0 = 10x
                           más grande) */
-  int md3_surface_textures[32]; /* Texturas por superficie si es MD3 */
+  RAY_SpriteModelData *model_data; /* NULL hasta el primer uso */
 
   /* Soporte animación glTF */
   int glb_anim_index;
   float glb_anim_time;
   float glb_anim_speed;
+  int glb_pose_slot;            /* Cached pose slot in the model (-1 = none) */
+  unsigned int glb_pose_serial; /* Serial of that pose when it was taken */
 
   /* Physics body (NULL = no physics, static sprite) */
   struct RAY_PhysicsBody *physics;
+
+  /* Sector bin (per-sector sprite list, maintained on movement) */
+  int binned;       /* 1 if linked into a sector bin */
+  int sector_index; /* Sector index (-1 = outside every sector) */
+  int bin_prev;     /* Previous sprite in the same bin (-1 = head) */
+  int bin_next;     /* Next sprite in the same bin (-1 = tail) */
+
+  /* Sprite pool */
+  int generation;   /* Handle generation of this slot */
+  int pool_next;    /* Next free slot (-1 = end) while the slot is free */
+  int active_index; /* Position in g_engine.active_sprites (-1 = free) */
+
+  /* Process sync (ray_sync_sprites) */
+  int no_sync;           /* 1 = process locals are not copied in */
+  int synced;            /* 1 once sync_locals holds a valid snapshot */
+  double sync_locals[5]; /* x, y, z, angle, resolution as last read */
 } RAY_Sprite;
 
 /* ============================================================================
@@ -276,6 +319,25 @@ typedef struct RAY_PhysicsBody {
 
   /* Sector awareness */
   int current_sector_id; /* Which sector this body is in */
+
+  /* Sleeping (resting bodies skip integration) */
+  int is_sleeping;          /* 1 = at rest, not simulated */
+  int sleep_counter;        /* Consecutive resting steps */
+  int sleep_sector;         /* Sector index under the body when it slept */
+  float sleep_floor_z;      /* Floor/ceiling of sleep_sector at that time */
+  float sleep_ceiling_z;
+  float sleep_x, sleep_y, sleep_z; /* Position at sleep time */
+
+  /* Kinematic movers: transform seen at the previous step */
+  float kin_x, kin_y, kin_z, kin_rot;
+  int kin_valid; /* kin_* hold a previous step */
+  int kin_moved; /* Moved by code since that step (wakes sleepers) */
+
+  /* Fixed-step interpolation (previous / current simulated transform) */
+  float prev_x, prev_y, prev_z, prev_rot;
+  float curr_x, curr_y, curr_z, curr_rot;
+  int interp_valid;   /* prev/curr hold a simulated step */
+  int interp_applied; /* Sprite currently shows the interpolated transform */
 } RAY_PhysicsBody;
 
 /* ============================================================================
@@ -302,6 +364,86 @@ typedef struct {
   float falloff;   // 1=linear, 2=quadratic
 } RAY_Light;
 
+/* A light reaches RAY_LIGHT_RANGE * intensity units; the shader fades its
+   falloff to zero there, so dropping it beyond that distance is exact */
+#define RAY_LIGHT_RANGE 4.0f
+#define RAY_MAX_DRAW_LIGHTS 16 /* Luces por draw en el shader de normales */
+
+#define RAY_LIGHT_CULL_NONE 0   /* Las primeras luces del mapa en todo */
+#define RAY_LIGHT_CULL_SECTOR 1 /* Las que alcanzan el sector dibujado */
+#define RAY_LIGHT_CULL_SCREEN 2 /* Y además solapan su ventana de portal */
+
+/* ============================================================================
+   LIGHTMAPS
+   Luces estáticas horneadas en un atlas: por sector un rect de suelo, uno
+   de techo y uno por pared (de floor_z a ceiling_z). Cada luxel guarda la
+   luz de las luces horneadas a media escala (0..2x), sin ambiente: cada
+   renderer suma el suyo.
+   ============================================================================
+ */
+
+#define RAY_LIGHTMAP_LUXEL 16.0f     /* World units per luxel */
+#define RAY_LIGHTMAP_MAX_SIDE 128    /* Interior luxels per surface axis */
+#define RAY_LIGHTMAP_ATLAS_W 1024
+#define RAY_LIGHTMAP_ATLAS_MAX_H 4096 /* Larger maps double the luxel */
+
+#define RAY_LIGHTMAP_FLOOR 0   /* Rect slots inside a sector; */
+#define RAY_LIGHTMAP_CEILING 1 /* wall w uses slot 2 + w */
+
+/* Interior of a rect in the atlas (a one-luxel border copying the edge
+   surrounds it). Luxel coords = (world - origin) * scale on the surface
+   axes: walls use (distance from x1,y1 ; z), planes (x ; y) */
+typedef struct {
+  int x, y, w, h;
+  float origin_u, origin_v;
+  float scale_u, scale_v;
+} RAY_LightmapRect;
+
+typedef struct {
+  uint8_t *rgba; /* width * height luxels, R G B A bytes */
+  int width, height;
+  float luxel;            /* World units per luxel actually used */
+  RAY_LightmapRect *rects;
+  int *sector_first;      /* Sector i: rects[sector_first[i] + slot] */
+  int num_rects;
+  int num_sectors;        /* Sector count the atlas was baked for */
+  int baked_lights;       /* lights[0 .. baked_lights) are in the atlas */
+  uint32_t serial;        /* Bumped on every bake/load (GPU re-upload) */
+} RAY_Lightmap;
+
+/* One surface of the atlas, ready to sample */
+typedef struct {
+  const uint8_t *rgba; /* Luxel (0, 0) of the interior */
+  int stride;          /* Bytes per atlas row */
+  int x, y, w, h;      /* Interior, in atlas luxels */
+  float origin_u, origin_v, scale_u, scale_v;
+} RAY_LightmapSurface;
+
+/* Nearest luxel for world coords on the surface axes, clamped to it */
+static inline const uint8_t *ray_lightmap_luxel(const RAY_LightmapSurface *s,
+                                                float u, float v) {
+  int lx = (int)((u - s->origin_u) * s->scale_u);
+  int ly = (int)((v - s->origin_v) * s->scale_v);
+  lx = lx < 0 ? 0 : (lx >= s->w ? s->w - 1 : lx);
+  ly = ly < 0 ? 0 : (ly >= s->h ? s->h - 1 : ly);
+  return s->rgba + ly * s->stride + lx * 4;
+}
+
+/* pixel * (ambient + baked): ambient 256 = 1.0, luxels are half scale */
+static inline uint32_t ray_lightmap_apply(uint32_t pixel, const uint8_t *lux,
+                                          int ambient) {
+  uint32_t r = (((pixel >> 16) & 0xFF) * (uint32_t)(ambient + 2 * lux[0]));
+  uint32_t g = (((pixel >> 8) & 0xFF) * (uint32_t)(ambient + 2 * lux[1]));
+  uint32_t b = ((pixel & 0xFF) * (uint32_t)(ambient + 2 * lux[2]));
+  r >>= 8;
+  g >>= 8;
+  b >>= 8;
+  r = r > 255 ? 255 : r;
+  g = g > 255 ? 255 : g;
+  b = b > 255 ? 255 : b;
+  return (pixel & 0xFF000000) | (r << 16) | (g << 8) | b;
+}
+
 /* ============================================================================
    RAY HIT - Información de colisión de un rayo
    ============================================================================
@@ -365,6 +507,10 @@ typedef struct {
   int displayWidth, displayHeight;   // Target/Output resolution
   int internalWidth, internalHeight; // Rendering resolution (can be lower)
   float resolutionScale;             // Scale factor (e.g., 0.5 for half-res)
+  /* Dynamic resolution: resolutionScale follows a render-time budget */
+  float target_frame_ms;      // 0 = fixed scale
+  float resolution_min_scale; // Lower bound for the controller
+  float render_frame_ms;      // Smoothed render time (ms)
   int stripWidth;
   int rayCount;
   int fovDegrees;
@@ -381,15 +527,27 @@ typedef struct {
   RAY_Sector *sectors;
   int num_sectors;
   int sectors_capacity;
+  int *sector_id_lookup;     /* sector_id -> index (-1 = none) */
+  int sector_id_lookup_size; /* max sector_id + 1 */
 
   RAY_Portal *portals;
   int num_portals;
   int portals_capacity;
 
-  /* Sprites */
+  /* Sprites: pool growing in RAY_SPRITE_CHUNK steps. num_sprites is the
+     high-water mark of used slots; active_sprites lists the slots in use
+     (unordered) for loops that must not walk the holes */
   RAY_Sprite *sprites;
   int num_sprites;
   int sprites_capacity;
+  int *active_sprites;
+  int num_active_sprites;
+  int sprite_free_head; /* First free slot below num_sprites (-1 = none) */
+
+  /* Sprite bins: first sprite per sector index (-1 = empty) */
+  int *sector_sprite_head;
+  int sector_sprite_head_capacity;
+  int outside_sprite_head; /* Sprites not inside any sector */
 
   /* Spawn Flags */
   RAY_SpawnFlag *spawn_flags;
@@ -416,6 +574,16 @@ typedef struct {
   /* Texture Filtering */
   int texture_quality; /* 0 = Nearest, 1 = Bilinear */
 
+  /* Software floors/ceilings: 1 = row spans (visplanes), 0 = per column */
+  int floor_spans;
+
+  /* Software mipmaps: 1 = sample a mip level chosen from depth */
+  int mipmaps;
+  size_t mip_budget; /* Bytes maximos para niveles reducidos */
+
+  /* GPU: 1 = pack the map's RAY_TEXTURE_SIZE textures into one atlas */
+  int texture_atlas;
+
   /* Fog configuration */
   uint8_t fog_r, fog_g, fog_b;
   float fog_start_distance;
@@ -430,18 +598,50 @@ typedef struct {
   int max_portal_depth;         /* Profundidad máxima de recursión */
   int portal_rendering_enabled; /* 1 = activo, 0 = desactivado */
 
+  /* Software renderer threading (column bands) */
+  int render_threads; /* 1 = single thread, 0 = auto (CPU count), N bands */
+
   /* Billboard */
   int billboard_enabled;
   int billboard_directions;
 
   /* PVS (Static Potentially Visible Set) */
-  uint8_t *pvs_matrix; /* Matrix: pvs[source_id * num_sectors + target_id] */
-  int pvs_ready;       /* 1 if PVS is baked and valid */
+  uint8_t *pvs_data;      /* Rows RLE-compressed, one bit per sector index */
+  uint32_t *pvs_offsets;  /* Row i: pvs_data[offsets[i] .. offsets[i + 1]) */
+  uint32_t pvs_size;      /* Bytes in pvs_data */
+  int pvs_num_sectors;    /* Sector count the PVS was baked for */
+  uint8_t *pvs_row;       /* Decompressed row of pvs_row_sector */
+  int pvs_row_sector;     /* -1 = nothing decompressed yet */
+  int pvs_ready;          /* 1 if PVS is baked and valid */
 
   /* Luces puntuales */
   RAY_Light lights[RAY_MAX_LIGHTS];
   int num_lights;
 
+  /* Per-sector light lists, strongest first: sector index i is lit by
+     sector_lights[sector_light_first[i] .. sector_light_first[i + 1]) */
+  int *sector_light_first;
+  int *sector_lights;
+  int sector_lights_sectors; /* num_sectors the lists were built for */
+  int sector_lights_dirty;   /* Rebuild before the next lookup */
+  int light_culling;         /* RAY_LIGHT_CULL_* */
+
+  /* Baked static lights; with lightmaps enabled the runtime only evaluates
+     lights[lightmap.baked_lights ..] (RAY_LIGHT_ADD after the bake) */
+  RAY_Lightmap lightmap;
+  int lightmaps_enabled;
+
+  /* Logging: 1 = per-sector/per-wall detail while loading maps,
+     2 = also periodic renderer diagnostics */
+  int verbose;
+
+  /* Frame statistics (RAY_GET_STAT); 0 = counters and timers skipped */
+  int stats_enabled;
+
+  /* 1 = RAY_RENDER syncs process-linked sprites itself; 0 = the script
+     calls RAY_SYNC_SPRITES once per frame */
+  int auto_sync;
+
   /* Inicializado */
   int initialized;
   float time;          /* Tiempo global para shaders */
@@ -481,6 +681,9 @@ extern int64_t libmod_ray_jump(INSTANCE *my, int64_t *params);
 
 /* Renderizado */
 extern int64_t libmod_ray_render(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_render_view(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_prepare_scene(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_end_scene(INSTANCE *my, int64_t *params);
 extern void ray_render_md2(GRAPH *dest, RAY_Sprite *sprite);
 
 /* Configuración */
@@ -512,6 +715,21 @@ extern int64_t libmod_ray_set_sprite_flags(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_set_sprite_graph(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_set_sprite_md3_surface_texture(INSTANCE *my,
                                                          int64_t *params);
+extern int64_t libmod_ray_set_model_culling(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_trace_batch(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_load_md2_async(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_load_md3_async(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_load_gltf_async(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_load_status(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_loaded_model(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_load_budget(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_model_add_lod(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_model_set_impostor(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_model_set_impostor_graphs(INSTANCE *my,
+                                                    int64_t *params);
+extern int64_t libmod_ray_sync_sprites(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_auto_sync(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_sprite_sync(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_camera_load(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_camera_play(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_camera_path_update(INSTANCE *my, int64_t *params);
@@ -523,6 +741,23 @@ extern int64_t libmod_ray_camera_set_time(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_camera_free(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_set_fov(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_set_texture_quality(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_floor_spans(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_mipmaps(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_get_mip_memory(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_texture_atlas(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_flush_textures(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_resolution_scale(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_dynamic_resolution(INSTANCE *my,
+                                                 int64_t *params);
+extern int64_t libmod_ray_get_resolution_scale(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_stats(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_get_stat(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_bench_begin(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_bench_end(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_renderer(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_generate_stress_map(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_render_threads(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_verbose(INSTANCE *my, int64_t *params);
 
 /* Distances (v29+) */
 extern int64_t libmod_ray_get_dist(INSTANCE *my, int64_t *params);
@@ -534,6 +769,9 @@ extern int64_t libmod_ray_get_camera_angle(INSTANCE *my, int64_t *params);
 /* Iluminación */
 extern int64_t libmod_ray_add_light(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_clear_lights(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_light_culling(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_set_lightmaps(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_bake_lightmap(INSTANCE *my, int64_t *params);
 
 /* ============================================================================
    PHYSICS ENGINE
@@ -543,6 +781,10 @@ extern int64_t libmod_ray_clear_lights(INSTANCE *my, int64_t *params);
 /* Core physics functions (C API) */
 extern void ray_physics_init(void);
 extern void ray_physics_step(float dt);
+extern void ray_physics_shutdown(void);
+extern void ray_physics_update(float frame_dt);
+extern void ray_physics_begin_render(void);
+extern void ray_physics_end_render(void);
 extern RAY_PhysicsBody *ray_physics_create_body(float mass, float radius,
                                                 float height);
 extern void ray_physics_destroy_body(RAY_PhysicsBody *body);
@@ -575,6 +817,9 @@ extern int64_t libmod_ray_physics_apply_impulse_bgd(INSTANCE *my,
                                                     int64_t *params);
 extern int64_t libmod_ray_physics_get_velocity(INSTANCE *my, int64_t *params);
 extern int64_t libmod_ray_physics_step_bgd(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_physics_stats(INSTANCE *my, int64_t *params);
+extern int64_t libmod_ray_physics_set_fixed_step(INSTANCE *my,
+                                                 int64_t *params);
 
 /* ============================================================================
    FUNCIONES INTERNAS - Geometría
@@ -600,6 +845,127 @@ void ray_sector_add_portal(RAY_Sector *sector, int portal_id);
 RAY_Sector *ray_find_sector_at_point(RAY_Engine *engine, float x, float y);
 RAY_Sector *ray_find_sector_at_position(RAY_Engine *engine, float x, float y,
                                         float z);
+int ray_locate_sector_index(RAY_Engine *engine, int hint_index, float x,
+                            float y);
+
+/* Sector id -> index lookup */
+void ray_build_sector_id_lookup(RAY_Engine *engine);
+void ray_free_sector_id_lookup(RAY_Engine *engine);
+int ray_sector_index_by_id(RAY_Engine *engine, int sector_id);
+RAY_Sector *ray_sector_by_id(RAY_Engine *engine, int sector_id);
+
+/* Sector spatial index (uniform grid over sector AABBs) */
+void ray_sector_grid_build(RAY_Engine *engine);
+void ray_sector_grid_free(void);
+int ray_sector_grid_query(RAY_Engine *engine, float x, float y,
+                          const int **indices);
+
+/* Static PVS (bitset rows over sector indices). ray_pvs_row decompresses
+   into a shared buffer: call it once per frame, before rendering threads */
+void ray_bake_pvs(void);
+void ray_free_pvs(void);
+const uint8_t *ray_pvs_row(int sector_index);
+/* Un bit de la fila sin tocar el buffer compartido (apto para hilos):
+   1 visible o sin PVS, 0 si el PVS lo descarta */
+int ray_pvs_test(int from_index, int to_index);
+
+/* Sector light lists. ray_sector_lights rebuilds them if lights or sectors
+   changed and returns NULL when there is nothing to cull against */
+void ray_lights_invalidate(void);
+void ray_lights_free(void);
+const int *ray_sector_lights(int sector_index, int *count);
+
+/* Lightmaps (libmod_ray_lightmap.c). ray_lightmap_bake remembers the map
+   and, if lightmaps are enabled, loads <map>.raylm when it matches the map
+   and its lights or bakes and rewrites it; NULL reuses the last map */
+int ray_lightmap_bake(const char *map_filename);
+void ray_lightmap_free(void);
+int ray_lightmap_active(void);
+int ray_lightmap_surface(int sector_index, int slot, RAY_LightmapSurface *out);
+#define RAY_PVS_TEST(row, index) (((row)[(index) >> 3] >> ((index) & 7)) & 1)
+
+/* GPU renderer static sector data (wall TBN, portal links, convexity) */
+void ray_gpu_build_sector_cache(RAY_Engine *engine);
+void ray_gpu_free_sector_cache(void);
+void ray_gpu_free_internal_target(void);
+/* Island occluders, once per tick before the views of the frame */
+void ray_gpu_prepare_scene(void);
+/* Drops resolved texture handles and the texture atlas (FPG unloaded or
+   reloaded, map changed) */
+void ray_gpu_invalidate_textures(void);
+
+/* ============================================================================
+   FRAME STATISTICS
+   Acumuladores del frame en curso; ray_stats_end_frame() los publica para
+   RAY_GET_STAT y los pone a cero. Tiempos en ms, el resto son recuentos.
+   Solo se tocan desde el hilo principal (las bandas del renderer software
+   acumulan aparte y se suman al terminar).
+   ============================================================================
+ */
+
+#define RAY_STAT_FRAME_MS 0       /* Renderer completo */
+#define RAY_STAT_TRAVERSAL_MS 1   /* Recorrido de sectores/portales */
+#define RAY_STAT_WALLS_MS 2       /* Dibujo de paredes */
+#define RAY_STAT_PLANES_MS 3      /* Suelos, techos y tapas */
+#define RAY_STAT_SPRITES_MS 4     /* Billboards */
+#define RAY_STAT_MODELS_MS 5      /* MD2/MD3/glTF */
+#define RAY_STAT_PHYSICS_MS 6     /* Pasos de fisica desde el frame anterior */
+#define RAY_STAT_COMMIT_MS 7      /* Reescalado y subida del frame */
+#define RAY_STAT_SECTORS 8        /* Sectores visitados */
+#define RAY_STAT_PORTALS 9        /* Portales atravesados */
+#define RAY_STAT_PVS_CULLED 10    /* Sectores descartados por el PVS */
+#define RAY_STAT_DRAW_CALLS 11    /* Lotes GPU / segmentos de pared software */
+#define RAY_STAT_TRIANGLES 12     /* Triangulos enviados o rasterizados */
+#define RAY_STAT_SPRITES_DRAWN 13 /* Sprites y modelos enviados a dibujar */
+#define RAY_STAT_SPRITES_CULLED 14 /* Sprites descartados por visibilidad */
+#define RAY_STAT_SPRITES_MOVED 15  /* Sprites cuyo proceso cambió x/y/z/angle */
+#define RAY_STAT_TEXTURE_SWITCHES 16 /* Lotes GPU con otra textura */
+#define RAY_STAT_IMPOSTORS 17        /* Modelos dibujados como impostor */
+#define RAY_STAT_COUNT 18
+
+extern double g_ray_stats_acc[RAY_STAT_COUNT];
+
+uint64_t ray_stats_clock(void);
+double ray_stats_elapsed_ms(uint64_t since);
+void ray_stats_end_frame(void);
+float ray_bench_timestep(void); /* dt fijo de RAY_BENCH_BEGIN, o 0 */
+
+/* Sin coste con las estadisticas apagadas: una comparacion por sitio */
+#define RAY_STAT_ADD(id, v)                                                    \
+  do {                                                                         \
+    if (g_engine.stats_enabled)                                                \
+      g_ray_stats_acc[(id)] += (double)(v);                                    \
+  } while (0)
+#define RAY_STAT_TIMER(t)                                                      \
+  uint64_t t = g_engine.stats_enabled ? ray_stats_clock() : 0
+#define RAY_STAT_ELAPSED(id, t)                                                \
+  do {                                                                         \
+    if (t)                                                                     \
+      g_ray_stats_acc[(id)] += ray_stats_elapsed_ms(t);                        \
+  } while (0)
+
+/* Resolution scaling (internalWidth/internalHeight from resolutionScale) */
+void ray_set_resolution_scale(float scale);
+void ray_resolution_update(float render_ms);
+
+/* Sprite pool (handles: see RAY_SPRITE_SLOT_BITS) */
+int ray_sprite_pool_reserve(int capacity);
+void ray_sprite_pool_rebuild(void);
+void ray_sprite_pool_free(void);
+int ray_sprite_alloc(void);
+void ray_sprite_release(int sprite_index);
+int ray_sprite_resolve(int64_t handle);
+int64_t ray_sprite_handle(int sprite_index);
+RAY_SpriteModelData *ray_sprite_model_data(RAY_Sprite *sprite);
+/* Asigna el modelo (NULL = sprite plano); skin >= 0 pasa a ser la textura
+   del sprite y la del modelo */
+void ray_sprite_set_model(RAY_Sprite *sprite, void *model, int skin);
+int ray_sync_sprites(void);
+
+/* Sprite sector bins */
+void ray_sprite_bins_rebuild(void);
+void ray_sprite_bin_update(int sprite_index);
+void ray_sprite_bin_remove(int sprite_index);
 
 /* Paredes */
 RAY_Wall *ray_wall_create(int wall_id, float x1, float y1, float x2, float y2);
@@ -623,6 +989,14 @@ int ray_portal_is_visible(RAY_Portal *portal, RAY_Camera *camera);
 int ray_load_map(const char *filename);
 int ray_save_map_v9(const char *filename);
 
+/* Synthetic benchmark map: cols x rows rooms, optional floating boxes */
+int ray_generate_stress_map(const char *filename, int cols, int rows,
+                            int boxes, uint32_t seed);
+
+/* Compiled map cache (<map>.raymapc, regenerated when the source changes) */
+int ray_load_map_compiled(const char *filename);
+int ray_save_map_compiled(const char *filename);
+
 /* Deprecated (kept for temporary compatibility if needed) */
 int ray_load_map_v8(const char *filename);
 int ray_save_map_v8(const char *filename);
@@ -682,4 +1056,298 @@ void ray_cast_ray(RAY_Engine *engine, int sector_id, float x, float y,
                   float angle, int strip_idx, RAY_RayHit *hits, int *num_hits);
 uint32_t ray_fog_pixel(uint32_t pixel, float distance);
 
+/* ============================================================================
+   MIPMAP CACHE (software renderer)
+   Cadena de mips por textura FPG, clave (fpg_id, graph code). El nivel 0
+   apunta a la superficie original; los niveles 1.. son copias reducidas
+   2x2 guardadas en un solo bloque y limitadas por g_engine.mip_budget.
+   ============================================================================
+ */
+
+#define RAY_MIP_MAX_LEVELS 8
+
+typedef struct {
+  const uint32_t *pixels;
+  int pitch; /* En pixeles */
+  int width, height;
+  int w_mask, h_mask; /* Validos si pot */
+  int pot;
+} RAY_MipLevel;
+
+typedef struct RAY_MipChain {
+  int64_t file_id, graph_id;
+  GRAPH *source;
+  const void *source_pixels; /* Detecta graficos recargados */
+  int num_levels;
+  RAY_MipLevel levels[RAY_MIP_MAX_LEVELS];
+  uint32_t *storage; /* Niveles 1.. */
+  size_t bytes;
+  struct RAY_MipChain *next;
+} RAY_MipChain;
+
+const RAY_MipChain *ray_mip_get(int64_t file_id, GRAPH *graph);
+void ray_mip_clear(void);
+size_t ray_mip_memory_used(void);
+
+/* Nivel para una huella de texels_per_pixel texels por pixel de pantalla */
+static inline const RAY_MipLevel *ray_mip_select(const RAY_MipChain *mip,
+                                                 float texels_per_pixel) {
+  int level = 0;
+  while (texels_per_pixel >= 2.0f && level + 1 < mip->num_levels) {
+    texels_per_pixel *= 0.5f;
+    level++;
+  }
+  return &mip->levels[level];
+}
+
+/* Texel (tex_x, tex_y) en coordenadas del nivel 0; 0 fuera de rango */
+static inline uint32_t ray_mip_texel(const RAY_MipChain *mip,
+                                     float texels_per_pixel, int tex_x,
+                                     int tex_y) {
+  const RAY_MipLevel *lv = ray_mip_select(mip, texels_per_pixel);
+  int lod = (int)(lv - mip->levels);
+  tex_x >>= lod;
+  tex_y >>= lod;
+  if (tex_x < 0 || tex_y < 0 || tex_x >= lv->width || tex_y >= lv->height)
+    return 0;
+  return lv->pixels[tex_y * lv->pitch + tex_x];
+}
+
+/* ============================================================================
+   SHADE TABLES (software renderer)
+   Tabla precalculada banda_distancia x nivel_luz. Cada entrada aplica
+   (pixel * mul + fog * peso) >> 8 en aritmetica entera, procesando los
+   canales R y B juntos en un uint32 (SWAR) y G aparte.
+   ============================================================================
+ */
+
+#define RAY_SHADE_BANDS 64
+#define RAY_SHADE_LIGHTS 32
+
+typedef struct {
+  uint32_t mul;    /* 0..256, factor sobre el pixel */
+  uint32_t add_rb; /* (fog_r << 16 | fog_b) * peso_niebla */
+  uint32_t add_g;  /* (fog_g << 8) * peso_niebla */
+} RAY_ShadeEntry;
+
+typedef struct {
+  RAY_ShadeEntry entries[RAY_SHADE_LIGHTS][RAY_SHADE_BANDS];
+  float band_scale; /* bandas por unidad de distancia (0 = sin niebla) */
+  int identity;     /* 1 si no hay niebla: solo importa la luz */
+} RAY_ShadeTable;
+
+extern RAY_ShadeTable g_ray_shade;
+
+void ray_shade_prepare(void);
+void ray_shade_invalidate(void);
+
+/* Entrada para (luz, distancia); NULL si no modifica el pixel */
+static inline const RAY_ShadeEntry *ray_shade_lookup(int light_level,
+                                                     float distance) {
+  if (light_level >= 255 && g_ray_shade.identity)
+    return NULL;
+  int li = light_level < 0 ? 0 : (light_level > 255 ? 255 : light_level);
+  int band = (int)(distance * g_ray_shade.band_scale);
+  if (band < 0)
+    band = 0;
+  else if (band >= RAY_SHADE_BANDS)
+    band = RAY_SHADE_BANDS - 1;
+  return &g_ray_shade.entries[li >> 3][band];
+}
+
+static inline uint32_t ray_shade_pixel(uint32_t pixel,
+                                       const RAY_ShadeEntry *e) {
+  uint32_t rb = (((pixel & 0x00FF00FF) * e->mul + e->add_rb) >> 8) &
+                0x00FF00FF;
+  uint32_t g = (((pixel & 0x0000FF00) * e->mul + e->add_g) >> 8) & 0x0000FF00;
+  return (pixel & 0xFF000000) | rb | g;
+}
+
+static inline uint32_t ray_shade(uint32_t pixel, int light_level,
+                                 float distance) {
+  const RAY_ShadeEntry *e = ray_shade_lookup(light_level, distance);
+  return e ? ray_shade_pixel(pixel, e) : pixel;
+}
+
+/* ============================================================================
+   MODEL RASTERIZER (software renderer)
+   Los renderers MD2/MD3 proyectan sus vertices y encolan triangulos entre
+   ray_raster_begin y ray_raster_flush; el flush los reparte en tiles de
+   pantalla que rasterizan los hilos de render. Solo hilo principal.
+   ============================================================================
+ */
+
+#define RAY_RASTER_NEAR 1.0f /* Vertices mas cerca descartan su triangulo */
+
+typedef struct {
+  float x, y; /* Pantalla */
+  float z;    /* Profundidad de camara */
+} RAY_RasterVert;
+
+/* 1 si abre un lote nuevo (el llamador debe hacer el flush), 0 si ya habia
+   uno abierto o no hay z-buffer */
+int ray_raster_begin(GRAPH *dest);
+/* Lo mismo sobre otro destino: w x h pixels, z-buffer con zpitch floats
+   por fila y profundidad de pared por columna (RAY_INFINITY = ninguna) */
+int ray_raster_begin_target(GRAPH *dest, int width, int height,
+                            float *zbuffer, int zpitch,
+                            const float *col_depth);
+void ray_raster_flush(void);
+void ray_raster_shutdown(void);
+
+/* Buffer reutilizable para los vertices proyectados de un modelo */
+RAY_RasterVert *ray_raster_vertices(int count);
+
+/* Esfera relativa a la camara dentro del frustum y no tapada por completo
+   por las paredes solidas ya dibujadas */
+int ray_raster_sphere_visible(float dx, float dy, float dz, float radius);
+
+/* Textura (graph code, 0 = color plano) y RAY_CULL_* para los triangulos
+   siguientes */
+void ray_raster_surface(int texture_id, int cull_mode);
+void ray_raster_triangle(const RAY_RasterVert *a, const RAY_RasterVert *b,
+                         const RAY_RasterVert *c, float ua, float va,
+                         float ub, float vb, float uc, float vc);
+
+/* ============================================================================
+   MODEL LOD / IMPOSTORS
+   Cadena por modelo cargado: mallas mas ligeras por debajo de una altura
+   en pantalla y, por debajo de la ultima, un billboard con una vista por
+   direccion (g_engine.billboard_directions). Solo hilo principal.
+   ============================================================================
+ */
+
+#define RAY_LOD_MAX_LEVELS 4
+#define RAY_IMPOSTOR_MAX_VIEWS 32
+
+typedef struct {
+  GRAPH *views[RAY_IMPOSTOR_MAX_VIEWS]; /* Vista k desde k * 360 / n grados */
+  int num_views;
+  int owned;          /* 1 si los graphs salen del bake */
+  float axis_radius;  /* Alcance horizontal desde el origen, escala 1 */
+  float z_min, z_max; /* Altura de la caja del modelo, escala 1 */
+} RAY_ModelImpostor;
+
+typedef struct {
+  void *model;  /* Modelo base */
+  float radius; /* Media diagonal de la caja, escala 1 */
+  int num_levels;
+  void *levels[RAY_LOD_MAX_LEVELS];   /* Mismo formato que el base */
+  float level_px[RAY_LOD_MAX_LEVELS]; /* Altura en pantalla para usarlo */
+  float impostor_px;                  /* 0 = sin impostor */
+  RAY_ModelImpostor impostor;
+} RAY_ModelLOD;
+
+typedef struct {
+  GRAPH *graph; /* Vista que toca */
+  float w, h;   /* Billboard en unidades de mundo */
+  float z;      /* Centro vertical en el mundo */
+} RAY_ImpostorDraw;
+
+int ray_model_lod_add(void *model, void *lod_model, float screen_px);
+int ray_model_impostor_bake(void *model, float screen_px, int size);
+int ray_model_impostor_graphs(void *model, float screen_px, int64_t file,
+                              int first_graph);
+void ray_model_lod_clear(void);
+
+/* Modelo a dibujar para el sprite a esa distancia: el base o uno de sus
+   LOD. NULL = dibujar el impostor descrito en *imp. */
+void *ray_model_lod_pick(const RAY_Sprite *sprite, float distance,
+                         RAY_ImpostorDraw *imp);
+
+/* ============================================================================
+   LINE TRACES
+   Segmentos 3D en lote para IA y disparos: cada uno camina por los portales
+   desde su sector y se para en la primera pared, suelo/techo o sprite.
+   Con RAY_TRACE_VISIBILITY el PVS descarta antes los que no pueden verse.
+   El lote se reparte entre los hilos de render. Solo hilo principal.
+   ============================================================================
+ */
+
+/* RAY_Trace.mask */
+#define RAY_TRACE_SPRITES 1    /* Los sprites tambien paran el segmento */
+#define RAY_TRACE_VISIBILITY 2 /* Solo importa si llega: permite el PVS */
+
+/* RAY_Trace.hit */
+#define RAY_TRACE_HIT_NONE 0
+#define RAY_TRACE_HIT_WALL 1   /* Pared o escalon; wall_id -1 = PVS/fuera */
+#define RAY_TRACE_HIT_PLANE 2  /* Suelo, techo o tapa de bloque */
+#define RAY_TRACE_HIT_SPRITE 3
+
+/* Misma disposicion que el TYPE del script: todo de 32 bits, sin huecos
+   (FLOAT e INT32 en BennuGD) */
+typedef struct {
+  float x0, y0, z0;   /* Origen */
+  float x1, y1, z1;   /* Destino */
+  int32_t mask;       /* RAY_TRACE_* */
+  int32_t ignore;     /* Handle de sprite que no cuenta (-1 = ninguno) */
+  int32_t hit;        /* Salida: RAY_TRACE_HIT_* */
+  int32_t sector_id;  /* Sector del impacto (o del destino si no hay) */
+  int32_t wall_id;    /* -1 si no es una pared */
+  int32_t sprite;     /* Handle del sprite tocado (-1 = ninguno) */
+  float hit_x, hit_y, hit_z;
+  float fraction;     /* 0..1 a lo largo del segmento, 1 = sin impacto */
+} RAY_Trace;
+
+/* Rellena la salida de cada segmento; devuelve cuantos tocaron algo */
+int ray_trace_batch(RAY_Trace *traces, int count);
+void ray_trace_shutdown(void);
+
+/* ============================================================================
+   SWEPT COLLISION
+   Circulo de col_radius y col_height de alto (pies en z) desplazado por
+   (dx, dy) contra un BVH de paredes por sector construido al cargar el mapa.
+   ============================================================================
+ */
+
+typedef struct {
+  float t;      /* Tiempo de impacto 0..1 (1 = sin impacto) */
+  float nx, ny; /* Normal de contacto, apunta hacia el cuerpo */
+  float x, y;   /* Punto de contacto en la pared */
+  int sector_id;
+  int wall_id;
+} RAY_SweepHit;
+
+void ray_wall_bvh_build(RAY_Engine *engine);
+void ray_wall_bvh_free(void);
+/* Devuelve 1 si choca antes de completar el movimiento */
+int ray_sweep_circle(RAY_Engine *engine, float x, float y, float z,
+                     float radius, float height, float step_h, float dx,
+                     float dy, RAY_SweepHit *hit);
+
+/* ============================================================================
+   ASYNC MODEL LOADING
+   RAY_LOAD_*_ASYNC devuelven un handle al momento; un hilo de fondo hace la
+   lectura, el parseo y la decodificacion de imagenes y el hilo principal
+   sube las texturas glTF a la GPU con un presupuesto por frame.
+   ============================================================================
+ */
+
+#define RAY_ASYNC_MAGIC 0x444C5952 /* "RYLD" */
+
+/* Estado de un handle (RAY_LOAD_STATUS) */
+#define RAY_LOAD_FAILED -1
+#define RAY_LOAD_PENDING 0
+#define RAY_LOAD_READY 1
+
+#define RAY_LOAD_DEFAULT_BUDGET 2 /* Texturas subidas a la GPU por frame */
+
+void *ray_async_load(const char *filename, uint32_t format);
+int ray_async_status(const void *handle);
+
+/* Modelo detras de `ptr`: el propio ptr si ya es un modelo, el modelo del
+   handle si esta listo, NULL si el handle sigue pendiente o fallo */
+void *ray_async_model(void *ptr);
+int ray_async_is_handle(const void *ptr);
+void ray_async_set_budget(int textures_per_frame);
+
+/* Da el modelo del handle al sprite cuando este listo; hasta entonces se
+   dibuja plano con su textura */
+void ray_async_attach(RAY_Sprite *sprite, void *handle, int skin);
+
+/* Hilo principal, una vez por frame: subidas pendientes y sprites que
+   esperaban su modelo */
+void ray_async_update(void);
+void ray_async_shutdown(void);
+
 #endif /* __LIBMOD_RAY_H */
@@ -0,0 +1,297 @@
+/* ============================================================================
+   libmod_ray_async.c - Background model loading
+   ============================================================================
+   RAY_LOAD_MD2_ASYNC / MD3 / GLTF return a handle at once and queue the
+   file for a worker thread, which runs the normal CPU loaders (fopen/fread,
+   cgltf parse and buffers, image decoding). The GL context only exists on
+   the main thread, so the decoded glTF images wait there and
+   ray_async_update() uploads a few of them per frame. A sprite given a
+   pending handle keeps drawing as a flat sprite and gets its model as soon
+   as the handle is ready. Models loaded this way are never freed, like the
+   ones from the synchronous loaders.
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_compat.h"
+#include "libmod_ray_gltf.h"
+#include "libmod_ray_md2.h"
+#include "libmod_ray_md3.h"
+#ifdef __ANDROID__
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern RAY_Engine g_engine;
+
+/* Estados internos; RAY_LOAD_STATUS solo distingue pendiente/listo/fallo */
+#define ASYNC_QUEUED 0  /* En cola o cargando en el hilo */
+#define ASYNC_DECODED 1 /* CPU terminada, faltan subidas a la GPU */
+#define ASYNC_READY 2
+#define ASYNC_FAILED 3
+
+typedef struct RAY_AsyncLoad {
+  uint32_t magic;  /* RAY_ASYNC_MAGIC: distingue el handle de un modelo */
+  uint32_t format; /* MD2_MAGIC, MD3_MAGIC o GLTF_MAGIC */
+  char filename[256];
+  SDL_atomic_t state; /* ASYNC_*, escrito por el hilo hasta DECODED */
+  void *model;        /* Valido desde ASYNC_DECODED */
+  int settled;        /* Hilo principal: ya contado como terminado */
+  struct RAY_AsyncLoad *next_job;
+} RAY_AsyncLoad;
+
+static RAY_AsyncLoad **s_loads = NULL;
+static int s_num_loads = 0, s_loads_capacity = 0;
+static int s_unsettled = 0;       /* Handles sin READY/FAILED asentado */
+static int s_pending_sprites = 0; /* Sprites esperando un handle */
+static int s_budget = RAY_LOAD_DEFAULT_BUDGET;
+
+/* Cola FIFO del hilo de carga */
+static RAY_AsyncLoad *s_job_head = NULL, *s_job_tail = NULL;
+static SDL_mutex *s_job_lock = NULL;
+static SDL_sem *s_job_sem = NULL;
+static SDL_Thread *s_worker = NULL;
+static SDL_atomic_t s_quit;
+
+static int async_worker(void *data) {
+  (void)data;
+  for (;;) {
+    SDL_SemWait(s_job_sem);
+    if (SDL_AtomicGet(&s_quit))
+      break;
+
+    SDL_LockMutex(s_job_lock);
+    RAY_AsyncLoad *job = s_job_head;
+    if (job) {
+      s_job_head = job->next_job;
+      if (!s_job_head)
+        s_job_tail = NULL;
+    }
+    SDL_UnlockMutex(s_job_lock);
+    if (!job)
+      continue;
+
+    void *model = NULL;
+    if (job->format == MD2_MAGIC)
+      model = ray_md2_load(job->filename);
+    else if (job->format == MD3_MAGIC)
+      model = ray_md3_load(job->filename);
+    else if (job->format == GLTF_MAGIC)
+      model = ray_gltf_load_cpu(job->filename);
+
+    job->model = model;
+    SDL_AtomicSet(&job->state, model ? ASYNC_DECODED : ASYNC_FAILED);
+  }
+  return 0;
+}
+
+static int async_start_worker(void) {
+  if (s_worker)
+    return 1;
+  s_job_lock = SDL_CreateMutex();
+  s_job_sem = SDL_CreateSemaphore(0);
+  SDL_AtomicSet(&s_quit, 0);
+  if (s_job_lock && s_job_sem)
+    s_worker = SDL_CreateThread(async_worker, "ray_loader", NULL);
+  if (!s_worker) {
+    fprintf(stderr, "RAY: No se pudo crear el hilo de carga: %s\n",
+            SDL_GetError());
+    if (s_job_lock)
+      SDL_DestroyMutex(s_job_lock);
+    if (s_job_sem)
+      SDL_DestroySemaphore(s_job_sem);
+    s_job_lock = NULL;
+    s_job_sem = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+/* ============================================================================
+   HANDLES
+   ============================================================================
+ */
+
+void *ray_async_load(const char *filename, uint32_t format) {
+  if (!filename || !*filename)
+    return NULL;
+
+  if (s_num_loads == s_loads_capacity) {
+    int cap = s_loads_capacity ? s_loads_capacity * 2 : 16;
+    RAY_AsyncLoad **grown =
+        (RAY_AsyncLoad **)realloc(s_loads, cap * sizeof(RAY_AsyncLoad *));
+    if (!grown)
+      return NULL;
+    s_loads = grown;
+    s_loads_capacity = cap;
+  }
+
+  RAY_AsyncLoad *h = (RAY_AsyncLoad *)calloc(1, sizeof(RAY_AsyncLoad));
+  if (!h)
+    return NULL;
+  h->magic = RAY_ASYNC_MAGIC;
+  h->format = format;
+  strncpy(h->filename, filename, sizeof(h->filename) - 1);
+  SDL_AtomicSet(&h->state, ASYNC_QUEUED);
+  s_loads[s_num_loads++] = h;
+  s_unsettled++;
+
+  if (!async_start_worker()) {
+    /* Sin hilo: cargar aqui, el handle sigue siendo valido */
+    if (format == MD2_MAGIC)
+      h->model = ray_md2_load(h->filename);
+    else if (format == MD3_MAGIC)
+      h->model = ray_md3_load(h->filename);
+    else if (format == GLTF_MAGIC)
+      h->model = ray_gltf_load_cpu(h->filename);
+    SDL_AtomicSet(&h->state, h->model ? ASYNC_DECODED : ASYNC_FAILED);
+    return h;
+  }
+
+  SDL_LockMutex(s_job_lock);
+  if (s_job_tail)
+    s_job_tail->next_job = h;
+  else
+    s_job_head = h;
+  s_job_tail = h;
+  SDL_UnlockMutex(s_job_lock);
+  SDL_SemPost(s_job_sem);
+
+  if (g_engine.verbose)
+    printf("RAY: Carga en segundo plano de %s\n", h->filename);
+  return h;
+}
+
+int ray_async_is_handle(const void *ptr) {
+  return ptr && *(const uint32_t *)ptr == RAY_ASYNC_MAGIC;
+}
+
+int ray_async_status(const void *handle) {
+  if (!handle)
+    return RAY_LOAD_FAILED;
+  if (!ray_async_is_handle(handle))
+    return RAY_LOAD_READY; /* Modelo de un loader sincrono */
+  int state = SDL_AtomicGet(&((RAY_AsyncLoad *)handle)->state);
+  if (state == ASYNC_READY)
+    return RAY_LOAD_READY;
+  if (state == ASYNC_FAILED)
+    return RAY_LOAD_FAILED;
+  return RAY_LOAD_PENDING;
+}
+
+void *ray_async_model(void *ptr) {
+  if (!ray_async_is_handle(ptr))
+    return ptr;
+  RAY_AsyncLoad *h = (RAY_AsyncLoad *)ptr;
+  return SDL_AtomicGet(&h->state) == ASYNC_READY ? h->model : NULL;
+}
+
+void ray_async_set_budget(int textures_per_frame) {
+  s_budget = textures_per_frame > 0 ? textures_per_frame : 1;
+}
+
+void ray_async_attach(RAY_Sprite *sprite, void *handle, int skin) {
+  int status = ray_async_status(handle);
+  if (status == RAY_LOAD_READY) {
+    ray_sprite_set_model(sprite, ray_async_model(handle), skin);
+    return;
+  }
+
+  /* Mientras tanto se dibuja como sprite plano con su textura */
+  ray_sprite_set_model(sprite, NULL, -1);
+  if (status == RAY_LOAD_FAILED)
+    return;
+  RAY_SpriteModelData *md = ray_sprite_model_data(sprite);
+  if (!md)
+    return;
+  md->pending_load = handle;
+  md->pending_skin = skin;
+  s_pending_sprites++;
+}
+
+/* ============================================================================
+   PER-FRAME UPDATE
+   ============================================================================
+ */
+
+void ray_async_update(void) {
+  if (s_unsettled > 0) {
+    int budget = s_budget;
+    for (int i = 0; i < s_num_loads; i++) {
+      RAY_AsyncLoad *h = s_loads[i];
+      if (h->settled)
+        continue;
+      int state = SDL_AtomicGet(&h->state);
+      if (state == ASYNC_QUEUED)
+        continue;
+
+      if (state == ASYNC_DECODED && h->format == GLTF_MAGIC) {
+        RAY_GLTF_Model *gltf = (RAY_GLTF_Model *)h->model;
+        if (budget > 0)
+          budget -= ray_gltf_upload_textures(gltf, budget);
+        if (gltf->pending_textures > 0)
+          continue; /* Sigue el proximo frame */
+      }
+
+      if (state == ASYNC_DECODED)
+        SDL_AtomicSet(&h->state, ASYNC_READY);
+      else
+        fprintf(stderr, "RAY: Fallo la carga en segundo plano de %s\n",
+                h->filename);
+      h->settled = 1;
+      s_unsettled--;
+      if (g_engine.verbose && state == ASYNC_DECODED)
+        printf("RAY: %s listo\n", h->filename);
+    }
+  }
+
+  if (s_pending_sprites == 0)
+    return;
+
+  int waiting = 0;
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    RAY_Sprite *s = &g_engine.sprites[g_engine.active_sprites[k]];
+    RAY_SpriteModelData *md = s->model_data;
+    if (!md || !md->pending_load)
+      continue;
+    int status = ray_async_status(md->pending_load);
+    if (status == RAY_LOAD_PENDING) {
+      waiting++;
+      continue;
+    }
+    void *model =
+        status == RAY_LOAD_READY ? ray_async_model(md->pending_load) : NULL;
+    md->pending_load = NULL;
+    if (model)
+      ray_sprite_set_model(s, model, md->pending_skin);
+  }
+  s_pending_sprites = waiting;
+}
+
+void ray_async_shutdown(void) {
+  if (s_worker) {
+    /* Termina la carga en curso; lo que quede en cola se descarta */
+    SDL_AtomicSet(&s_quit, 1);
+    SDL_SemPost(s_job_sem);
+    SDL_WaitThread(s_worker, NULL);
+    s_worker = NULL;
+    SDL_DestroyMutex(s_job_lock);
+    SDL_DestroySemaphore(s_job_sem);
+    s_job_lock = NULL;
+    s_job_sem = NULL;
+  }
+  s_job_head = s_job_tail = NULL;
+
+  for (int i = 0; i < s_num_loads; i++)
+    free(s_loads[i]);
+  free(s_loads);
+  s_loads = NULL;
+  s_num_loads = s_loads_capacity = 0;
+  s_unsettled = 0;
+  s_pending_sprites = 0;
+}
@@ -14,7 +14,46 @@
 
 /* Constantes exportadas */
 DLCONSTANT __bgdexport(libmod_ray, constants_def)[] = {
-    {"SPRITE_INVISIBLE", TYPE_INT, 1}, {NULL, 0, 0}};
+    {"SPRITE_INVISIBLE", TYPE_INT, 1},
+    /* RAY_GET_STAT */
+    {"RAY_STAT_FRAME_MS", TYPE_INT, RAY_STAT_FRAME_MS},
+    {"RAY_STAT_TRAVERSAL_MS", TYPE_INT, RAY_STAT_TRAVERSAL_MS},
+    {"RAY_STAT_WALLS_MS", TYPE_INT, RAY_STAT_WALLS_MS},
+    {"RAY_STAT_PLANES_MS", TYPE_INT, RAY_STAT_PLANES_MS},
+    {"RAY_STAT_SPRITES_MS", TYPE_INT, RAY_STAT_SPRITES_MS},
+    {"RAY_STAT_MODELS_MS", TYPE_INT, RAY_STAT_MODELS_MS},
+    {"RAY_STAT_PHYSICS_MS", TYPE_INT, RAY_STAT_PHYSICS_MS},
+    {"RAY_STAT_COMMIT_MS", TYPE_INT, RAY_STAT_COMMIT_MS},
+    {"RAY_STAT_SECTORS", TYPE_INT, RAY_STAT_SECTORS},
+    {"RAY_STAT_PORTALS", TYPE_INT, RAY_STAT_PORTALS},
+    {"RAY_STAT_PVS_CULLED", TYPE_INT, RAY_STAT_PVS_CULLED},
+    {"RAY_STAT_DRAW_CALLS", TYPE_INT, RAY_STAT_DRAW_CALLS},
+    {"RAY_STAT_TRIANGLES", TYPE_INT, RAY_STAT_TRIANGLES},
+    {"RAY_STAT_SPRITES_DRAWN", TYPE_INT, RAY_STAT_SPRITES_DRAWN},
+    {"RAY_STAT_SPRITES_CULLED", TYPE_INT, RAY_STAT_SPRITES_CULLED},
+    {"RAY_STAT_SPRITES_MOVED", TYPE_INT, RAY_STAT_SPRITES_MOVED},
+    {"RAY_STAT_TEXTURE_SWITCHES", TYPE_INT, RAY_STAT_TEXTURE_SWITCHES},
+    {"RAY_STAT_IMPOSTORS", TYPE_INT, RAY_STAT_IMPOSTORS},
+    /* RAY_SET_LIGHT_CULLING */
+    {"RAY_LIGHT_CULL_NONE", TYPE_INT, RAY_LIGHT_CULL_NONE},
+    {"RAY_LIGHT_CULL_SECTOR", TYPE_INT, RAY_LIGHT_CULL_SECTOR},
+    {"RAY_LIGHT_CULL_SCREEN", TYPE_INT, RAY_LIGHT_CULL_SCREEN},
+    /* RAY_SET_MODEL_CULLING */
+    {"RAY_CULL_NONE", TYPE_INT, RAY_CULL_NONE},
+    {"RAY_CULL_BACK", TYPE_INT, RAY_CULL_BACK},
+    {"RAY_CULL_FRONT", TYPE_INT, RAY_CULL_FRONT},
+    /* RAY_LOAD_STATUS */
+    {"RAY_LOAD_FAILED", TYPE_INT, RAY_LOAD_FAILED},
+    {"RAY_LOAD_PENDING", TYPE_INT, RAY_LOAD_PENDING},
+    {"RAY_LOAD_READY", TYPE_INT, RAY_LOAD_READY},
+    /* RAY_TRACE_BATCH */
+    {"RAY_TRACE_SPRITES", TYPE_INT, RAY_TRACE_SPRITES},
+    {"RAY_TRACE_VISIBILITY", TYPE_INT, RAY_TRACE_VISIBILITY},
+    {"RAY_TRACE_HIT_NONE", TYPE_INT, RAY_TRACE_HIT_NONE},
+    {"RAY_TRACE_HIT_WALL", TYPE_INT, RAY_TRACE_HIT_WALL},
+    {"RAY_TRACE_HIT_PLANE", TYPE_INT, RAY_TRACE_HIT_PLANE},
+    {"RAY_TRACE_HIT_SPRITE", TYPE_INT, RAY_TRACE_HIT_SPRITE},
+    {NULL, 0, 0}};
 
 #endif
 
@@ -24,6 +63,9 @@ DLSYSFUNCS __bgdexport(libmod_ray, functions_exports)[] = {
     FUNC("RAY_LOAD_MAP", "SI", TYPE_INT, libmod_ray_load_map),
     FUNC("RAY_FREE_MAP", "", TYPE_INT, libmod_ray_free_map),
     FUNC("RAY_RENDER", "I", TYPE_INT, libmod_ray_render),
+    FUNC("RAY_RENDER_VIEW", "IFFFFF", TYPE_INT, libmod_ray_render_view),
+    FUNC("RAY_PREPARE_SCENE", "", TYPE_INT, libmod_ray_prepare_scene),
+    FUNC("RAY_END_SCENE", "", TYPE_INT, libmod_ray_end_scene),
     FUNC("RAY_MOVE_FORWARD", "F", TYPE_INT, libmod_ray_move_forward),
     FUNC("RAY_MOVE_BACKWARD", "F", TYPE_INT, libmod_ray_move_backward),
     FUNC("RAY_STRAFE_LEFT", "F", TYPE_INT, libmod_ray_strafe_left),
@@ -51,6 +93,7 @@ DLSYSFUNCS __bgdexport(libmod_ray, functions_exports)[] = {
          libmod_ray_check_collision_z),
     FUNC("RAY_CHECK_COLLISION_EXT", "FFFFFF", TYPE_INT,
          libmod_ray_check_collision_h),
+    FUNC("RAY_TRACE_BATCH", "PI", TYPE_INT, libmod_ray_trace_batch),
     FUNC("RAY_TOGGLE_DOOR", "", TYPE_INT, libmod_ray_toggle_door),
     FUNC("RAY_ADD_SPRITE", "FFFIIIII", TYPE_INT, libmod_ray_add_sprite),
     FUNC("RAY_SET_FLAG", "I", TYPE_INT, libmod_ray_set_flag),
@@ -64,6 +107,12 @@ DLSYSFUNCS __bgdexport(libmod_ray, functions_exports)[] = {
     FUNC("RAY_LOAD_MD2", "S", TYPE_INT, libmod_ray_load_md2),
     FUNC("RAY_LOAD_MD3", "S", TYPE_INT, libmod_ray_load_md3),
     FUNC("RAY_LOAD_GLTF", "S", TYPE_INT, libmod_ray_load_gltf),
+    FUNC("RAY_LOAD_MD2_ASYNC", "S", TYPE_INT, libmod_ray_load_md2_async),
+    FUNC("RAY_LOAD_MD3_ASYNC", "S", TYPE_INT, libmod_ray_load_md3_async),
+    FUNC("RAY_LOAD_GLTF_ASYNC", "S", TYPE_INT, libmod_ray_load_gltf_async),
+    FUNC("RAY_LOAD_STATUS", "I", TYPE_INT, libmod_ray_load_status),
+    FUNC("RAY_LOADED_MODEL", "I", TYPE_INT, libmod_ray_loaded_model),
+    FUNC("RAY_SET_LOAD_BUDGET", "I", TYPE_INT, libmod_ray_set_load_budget),
     FUNC("RAY_GET_GLTF_ANIM_COUNT", "I", TYPE_INT,
          libmod_ray_get_gltf_anim_count),
     FUNC("RAY_SET_SPRITE_MD2", "III", TYPE_INT, libmod_ray_set_sprite_md2),
@@ -89,6 +138,27 @@ DLSYSFUNCS __bgdexport(libmod_ray, functions_exports)[] = {
     FUNC("RAY_GET_TAG_POINT", "ISPPP", TYPE_INT, libmod_ray_get_tag_point),
     FUNC("RAY_SET_TEXTURE_QUALITY", "I", TYPE_INT,
          libmod_ray_set_texture_quality),
+    FUNC("RAY_SET_FLOOR_SPANS", "I", TYPE_INT, libmod_ray_set_floor_spans),
+    FUNC("RAY_SET_MIPMAPS", "I", TYPE_INT, libmod_ray_set_mipmaps),
+    FUNC("RAY_GET_MIP_MEMORY", "", TYPE_INT, libmod_ray_get_mip_memory),
+    FUNC("RAY_SET_TEXTURE_ATLAS", "I", TYPE_INT, libmod_ray_set_texture_atlas),
+    FUNC("RAY_FLUSH_TEXTURES", "", TYPE_INT, libmod_ray_flush_textures),
+    FUNC("RAY_SET_RESOLUTION_SCALE", "F", TYPE_INT,
+         libmod_ray_set_resolution_scale),
+    FUNC("RAY_SET_DYNAMIC_RESOLUTION", "FF", TYPE_INT,
+         libmod_ray_set_dynamic_resolution),
+    FUNC("RAY_GET_RESOLUTION_SCALE", "", TYPE_FLOAT,
+         libmod_ray_get_resolution_scale),
+    FUNC("RAY_SET_STATS", "I", TYPE_INT, libmod_ray_set_stats),
+    FUNC("RAY_GET_STAT", "I", TYPE_FLOAT, libmod_ray_get_stat),
+    FUNC("RAY_BENCH_BEGIN", "IF", TYPE_INT, libmod_ray_bench_begin),
+    FUNC("RAY_BENCH_END", "S", TYPE_INT, libmod_ray_bench_end),
+    FUNC("RAY_SET_RENDERER", "I", TYPE_INT, libmod_ray_set_renderer),
+    FUNC("RAY_GENERATE_STRESS_MAP", "SIIII", TYPE_INT,
+         libmod_ray_generate_stress_map),
+    FUNC("RAY_SET_RENDER_THREADS", "I", TYPE_INT,
+         libmod_ray_set_render_threads),
+    FUNC("RAY_SET_VERBOSE", "I", TYPE_INT, libmod_ray_set_verbose),
     FUNC("RAY_CAMERA_LOAD", "S", TYPE_INT, libmod_ray_camera_load),
     FUNC("RAY_CAMERA_PLAY", "I", TYPE_INT, libmod_ray_camera_play),
     FUNC("RAY_CAMERA_IS_PLAYING", "", TYPE_INT, libmod_ray_camera_is_playing),
@@ -103,8 +173,22 @@ DLSYSFUNCS __bgdexport(libmod_ray, functions_exports)[] = {
     FUNC("RAY_SET_FOV", "F", TYPE_INT, libmod_ray_set_fov),
     FUNC("RAY_SET_SPRITE_MD3_SURFACE", "III", TYPE_INT,
          libmod_ray_set_sprite_md3_surface_texture),
+    FUNC("RAY_SET_MODEL_CULLING", "II", TYPE_INT,
+         libmod_ray_set_model_culling),
+    FUNC("RAY_MODEL_ADD_LOD", "III", TYPE_INT, libmod_ray_model_add_lod),
+    FUNC("RAY_MODEL_SET_IMPOSTOR", "III", TYPE_INT,
+         libmod_ray_model_set_impostor),
+    FUNC("RAY_MODEL_SET_IMPOSTOR_GRAPHS", "IIII", TYPE_INT,
+         libmod_ray_model_set_impostor_graphs),
+    FUNC("RAY_SYNC_SPRITES", "", TYPE_INT, libmod_ray_sync_sprites),
+    FUNC("RAY_SET_AUTO_SYNC", "I", TYPE_INT, libmod_ray_set_auto_sync),
+    FUNC("RAY_SET_SPRITE_SYNC", "II", TYPE_INT, libmod_ray_set_sprite_sync),
     FUNC("RAY_LIGHT_ADD", "FFFIIIFF", TYPE_INT, libmod_ray_add_light),
     FUNC("RAY_LIGHT_CLEAR", "", TYPE_INT, libmod_ray_clear_lights),
+    FUNC("RAY_SET_LIGHT_CULLING", "I", TYPE_INT,
+         libmod_ray_set_light_culling),
+    FUNC("RAY_SET_LIGHTMAPS", "I", TYPE_INT, libmod_ray_set_lightmaps),
+    FUNC("RAY_BAKE_LIGHTMAP", "", TYPE_INT, libmod_ray_bake_lightmap),
     FUNC("RAY_MOVE_SPRITE", "IFF", TYPE_INT, libmod_ray_move_sprite),
     FUNC("RAY_SET_STEP_HEIGHT", "F", TYPE_INT, libmod_ray_set_step_height),
     FUNC("RAY_GET_FLOOR_HEIGHT_Z", "FFF", TYPE_FLOAT,
@@ -137,6 +221,9 @@ DLSYSFUNCS __bgdexport(libmod_ray, functions_exports)[] = {
     FUNC("RAY_PHYSICS_GET_VELOCITY", "II", TYPE_FLOAT,
          libmod_ray_physics_get_velocity),
     FUNC("RAY_PHYSICS_STEP", "F", TYPE_INT, libmod_ray_physics_step_bgd),
+    FUNC("RAY_PHYSICS_STATS", "I", TYPE_FLOAT, libmod_ray_physics_stats),
+    FUNC("RAY_PHYSICS_SET_FIXED_STEP", "FI", TYPE_INT,
+         libmod_ray_physics_set_fixed_step),
     /* Sprite-to-Sprite Collision */
     FUNC("RAY_CHECK_SPRITE_COLLISION", "IFFF", TYPE_INT,
          libmod_ray_check_sprite_collision),
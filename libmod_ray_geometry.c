@@ -7,6 +7,7 @@
 #include "libmod_ray_compat.h"
 #include <float.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -181,40 +182,235 @@ void ray_sector_add_portal(RAY_Sector *sector, int portal_id) {
   sector->num_portals++;
 }
 
-/* Find which sector contains a point - hierarchical version for nested sectors
+/* ============================================================================
+   SECTOR SPATIAL INDEX (Uniform grid over sector AABBs)
+   Each cell lists, in ascending index order, every sector whose AABB touches
+   it. Any sector containing a point is listed in that point's cell, so point
+   lookups test a handful of polygons and keep the same priority rules as a
+   full scan. Rebuilt on map load.
+   ============================================================================
  */
-RAY_Sector *ray_find_sector_at_point(RAY_Engine *engine, float x, float y) {
-  if (!engine)
-    return NULL;
 
-  /* Find all sectors that contain this point */
-  int candidate_count = 0;
-  int candidates[RAY_MAX_SECTORS];
+#define RAY_GRID_MAX_DIM 256
+
+typedef struct {
+  RAY_Engine *engine; /* Engine/map the grid was built for */
+  int num_sectors;
+  float min_x, min_y;
+  float max_x, max_y;
+  float inv_cell;
+  int cols, rows;
+  int *cell_start; /* cols*rows + 1 offsets into cell_items */
+  int *cell_items; /* Sector indices, ascending within each cell */
+} RAY_SectorGrid;
+
+static RAY_SectorGrid s_grid = {0};
+
+/* Bounds used for indexing: polygon vertices (what the point tests use)
+   merged with the stored AABB from ray_calculate_all_sector_bounds */
+static int sector_grid_bounds(RAY_Sector *s, float *x0, float *y0, float *x1,
+                              float *y1) {
+  if (!s->vertices || s->num_vertices < 1)
+    return 0;
+  *x0 = *x1 = s->vertices[0].x;
+  *y0 = *y1 = s->vertices[0].y;
+  for (int v = 1; v < s->num_vertices; v++) {
+    if (s->vertices[v].x < *x0)
+      *x0 = s->vertices[v].x;
+    if (s->vertices[v].x > *x1)
+      *x1 = s->vertices[v].x;
+    if (s->vertices[v].y < *y0)
+      *y0 = s->vertices[v].y;
+    if (s->vertices[v].y > *y1)
+      *y1 = s->vertices[v].y;
+  }
+  if (!(s->min_x == 0 && s->max_x == 0 && s->min_y == 0 && s->max_y == 0)) {
+    if (s->min_x < *x0)
+      *x0 = s->min_x;
+    if (s->max_x > *x1)
+      *x1 = s->max_x;
+    if (s->min_y < *y0)
+      *y0 = s->min_y;
+    if (s->max_y > *y1)
+      *y1 = s->max_y;
+  }
+  return 1;
+}
+
+static inline int sector_grid_col(float x) {
+  int c = (int)((x - s_grid.min_x) * s_grid.inv_cell);
+  return (c < 0) ? 0 : (c >= s_grid.cols ? s_grid.cols - 1 : c);
+}
+
+static inline int sector_grid_row(float y) {
+  int r = (int)((y - s_grid.min_y) * s_grid.inv_cell);
+  return (r < 0) ? 0 : (r >= s_grid.rows ? s_grid.rows - 1 : r);
+}
+
+void ray_sector_grid_free(void) {
+  free(s_grid.cell_start);
+  free(s_grid.cell_items);
+  memset(&s_grid, 0, sizeof(s_grid));
+}
 
+void ray_sector_grid_build(RAY_Engine *engine) {
+  ray_sector_grid_free();
+  if (!engine || engine->num_sectors <= 0)
+    return;
+
+  /* 1. World bounds */
+  int any = 0;
+  float wx0 = 0, wy0 = 0, wx1 = 0, wy1 = 0;
   for (int i = 0; i < engine->num_sectors; i++) {
-    RAY_Sector *sector = &engine->sectors[i];
-    if (ray_point_in_polygon(x, y, sector->vertices, sector->num_vertices)) {
-      if (candidate_count < RAY_MAX_SECTORS) {
-        candidates[candidate_count++] = i;
-      }
+    float x0, y0, x1, y1;
+    if (!sector_grid_bounds(&engine->sectors[i], &x0, &y0, &x1, &y1))
+      continue;
+    if (!any) {
+      wx0 = x0, wy0 = y0, wx1 = x1, wy1 = y1;
+      any = 1;
+      continue;
     }
+    if (x0 < wx0)
+      wx0 = x0;
+    if (y0 < wy0)
+      wy0 = y0;
+    if (x1 > wx1)
+      wx1 = x1;
+    if (y1 > wy1)
+      wy1 = y1;
   }
+  if (!any)
+    return;
 
-  /* No sectors found */
-  if (candidate_count == 0) {
-    return NULL;
+  /* 2. Cell size: roughly one sector per cell, capped grid dimensions */
+  float w = wx1 - wx0, h = wy1 - wy0;
+  if (w < 1.0f)
+    w = 1.0f;
+  if (h < 1.0f)
+    h = 1.0f;
+  float cell = sqrtf((w * h) / (float)engine->num_sectors);
+  if (cell < 1.0f)
+    cell = 1.0f;
+  if (w / cell > RAY_GRID_MAX_DIM)
+    cell = w / RAY_GRID_MAX_DIM;
+  if (h / cell > RAY_GRID_MAX_DIM)
+    cell = h / RAY_GRID_MAX_DIM;
+
+  s_grid.min_x = wx0;
+  s_grid.min_y = wy0;
+  s_grid.max_x = wx1;
+  s_grid.max_y = wy1;
+  s_grid.inv_cell = 1.0f / cell;
+  s_grid.cols = (int)(w / cell) + 1;
+  s_grid.rows = (int)(h / cell) + 1;
+  if (s_grid.cols > RAY_GRID_MAX_DIM)
+    s_grid.cols = RAY_GRID_MAX_DIM;
+  if (s_grid.rows > RAY_GRID_MAX_DIM)
+    s_grid.rows = RAY_GRID_MAX_DIM;
+
+  int num_cells = s_grid.cols * s_grid.rows;
+  s_grid.cell_start = (int *)calloc(num_cells + 1, sizeof(int));
+  if (!s_grid.cell_start) {
+    ray_sector_grid_free();
+    return;
   }
 
-  /* Only one sector - return it */
-  if (candidate_count == 1) {
-    return &engine->sectors[candidates[0]];
+  /* 3. Count items per cell, then fill in ascending sector order */
+  for (int i = 0; i < engine->num_sectors; i++) {
+    float x0, y0, x1, y1;
+    if (!sector_grid_bounds(&engine->sectors[i], &x0, &y0, &x1, &y1))
+      continue;
+    int c0 = sector_grid_col(x0), c1 = sector_grid_col(x1);
+    int r0 = sector_grid_row(y0), r1 = sector_grid_row(y1);
+    for (int r = r0; r <= r1; r++)
+      for (int c = c0; c <= c1; c++)
+        s_grid.cell_start[r * s_grid.cols + c + 1]++;
+  }
+  for (int c = 0; c < num_cells; c++)
+    s_grid.cell_start[c + 1] += s_grid.cell_start[c];
+
+  int total = s_grid.cell_start[num_cells];
+  s_grid.cell_items = (int *)malloc((total > 0 ? total : 1) * sizeof(int));
+  int *fill = (int *)malloc(num_cells * sizeof(int));
+  if (!s_grid.cell_items || !fill) {
+    free(fill);
+    ray_sector_grid_free();
+    return;
+  }
+  memcpy(fill, s_grid.cell_start, num_cells * sizeof(int));
+
+  for (int i = 0; i < engine->num_sectors; i++) {
+    float x0, y0, x1, y1;
+    if (!sector_grid_bounds(&engine->sectors[i], &x0, &y0, &x1, &y1))
+      continue;
+    int c0 = sector_grid_col(x0), c1 = sector_grid_col(x1);
+    int r0 = sector_grid_row(y0), r1 = sector_grid_row(y1);
+    for (int r = r0; r <= r1; r++)
+      for (int c = c0; c <= c1; c++)
+        s_grid.cell_items[fill[r * s_grid.cols + c]++] = i;
   }
+  free(fill);
+
+  s_grid.engine = engine;
+  s_grid.num_sectors = engine->num_sectors;
+
+  if (engine->verbose)
+    printf("RAY: Sector grid %dx%d (cell %.1f, %d entries)\n", s_grid.cols,
+           s_grid.rows, cell, total);
+}
+
+/* Candidate sector indices for (x,y), ascending. Returns the count, or -1
+   if no grid is available for this engine/map (caller scans everything). */
+int ray_sector_grid_query(RAY_Engine *engine, float x, float y,
+                          const int **indices) {
+  if (!s_grid.cell_start || s_grid.engine != engine ||
+      s_grid.num_sectors != engine->num_sectors)
+    return -1;
+
+  if (x < s_grid.min_x || x > s_grid.max_x || y < s_grid.min_y ||
+      y > s_grid.max_y) {
+    *indices = NULL;
+    return 0;
+  }
+
+  int cell = sector_grid_row(y) * s_grid.cols + sector_grid_col(x);
+  *indices = &s_grid.cell_items[s_grid.cell_start[cell]];
+  return s_grid.cell_start[cell + 1] - s_grid.cell_start[cell];
+}
+
+/* Candidates for a point lookup: the grid cell, or every sector as fallback.
+   *list == NULL means "index k is sector k". */
+static int sector_candidates(RAY_Engine *engine, float x, float y,
+                             const int **list) {
+  int n = ray_sector_grid_query(engine, x, y, list);
+  if (n >= 0)
+    return n;
+  *list = NULL;
+  return engine->num_sectors;
+}
+
+/* Find which sector contains a point - hierarchical version for nested sectors
+ */
+RAY_Sector *ray_find_sector_at_point(RAY_Engine *engine, float x, float y) {
+  if (!engine)
+    return NULL;
+
+  const int *list;
+  int n = sector_candidates(engine, x, y, &list);
 
   /* Prioritize the LAST candidate (usually the innermost/newest sector)
    * This ensures that nested sectors (islands) are returned instead of the
    * parent
    */
-  return &engine->sectors[candidates[candidate_count - 1]];
+  for (int k = n - 1; k >= 0; k--) {
+    int idx = list ? list[k] : k;
+    RAY_Sector *sector = &engine->sectors[idx];
+    if (ray_point_in_polygon(x, y, sector->vertices, sector->num_vertices))
+      return sector;
+  }
+
+  /* No sectors found */
+  return NULL;
 }
 
 /* Find sector at (x,y,z) - handles solid nested sectors correctly */
@@ -223,28 +419,8 @@ RAY_Sector *ray_find_sector_at_position(RAY_Engine *engine, float x, float y,
   if (!engine)
     return NULL;
 
-  /* Find all sectors that contain this point (x,y) */
-  int candidate_count = 0;
-  int candidates[RAY_MAX_SECTORS];
-
-  for (int i = 0; i < engine->num_sectors; i++) {
-    RAY_Sector *sector = &engine->sectors[i];
-    if (ray_point_in_polygon(x, y, sector->vertices, sector->num_vertices)) {
-      if (candidate_count < RAY_MAX_SECTORS) {
-        candidates[candidate_count++] = i;
-      }
-    }
-  }
-
-  /* No sectors found */
-  if (candidate_count == 0) {
-    return NULL;
-  }
-
-  /* Only one sector - return it */
-  if (candidate_count == 1) {
-    return &engine->sectors[candidates[0]];
-  }
+  const int *list;
+  int n = sector_candidates(engine, x, y, &list);
 
   /* Multiple sectors - filter by Z for Solid Sectors */
   /* Sort/Selection logic:
@@ -253,15 +429,26 @@ RAY_Sector *ray_find_sector_at_position(RAY_Engine *engine, float x, float y,
      If we are outside its Z range, we ignore it (unless it's the only option?).
   */
 
+  int candidate_count = 0;
+  RAY_Sector *innermost = NULL;
+  RAY_Sector *z_match = NULL;
   RAY_Sector *best_match = NULL;
 
   /* Search from most nested (last) to least nested (first)
      This ensures we pick the 'Platform' instead of the 'Room' if we are inside
      it.
   */
-  for (int i = candidate_count - 1; i >= 0; i--) {
-    int idx = candidates[i];
+  for (int k = n - 1; k >= 0; k--) {
+    int idx = list ? list[k] : k;
     RAY_Sector *s = &engine->sectors[idx];
+    if (!ray_point_in_polygon(x, y, s->vertices, s->num_vertices))
+      continue;
+
+    candidate_count++;
+    if (!innermost)
+      innermost = s;
+    if (z_match)
+      continue; /* Only counting now (single-candidate rule) */
 
     /* A sector is a valid container if Z is within its bounds.
        For solid sectors (islands/platforms), we allow a small margin above
@@ -269,7 +456,8 @@ RAY_Sector *ray_find_sector_at_position(RAY_Engine *engine, float x, float y,
     */
     float tolerance = ray_sector_is_solid(s) ? 2.0f : 0.0f;
     if (z >= s->floor_z && z < s->ceiling_z + tolerance) {
-      return s;
+      z_match = s;
+      continue;
     }
 
     /* Fallback: if we are exactly ON the floor/ceiling (floating point
@@ -281,6 +469,17 @@ RAY_Sector *ray_find_sector_at_position(RAY_Engine *engine, float x, float y,
     }
   }
 
+  /* No sectors found */
+  if (candidate_count == 0)
+    return NULL;
+
+  /* Only one sector - return it */
+  if (candidate_count == 1)
+    return innermost;
+
+  if (z_match)
+    return z_match;
+
   /* Fallback 2: If we are not strictly inside ANY Z-range (e.g. we are 'Void'
      or on top), default to the innermost sector at this point (2D search
      result).
@@ -288,7 +487,165 @@ RAY_Sector *ray_find_sector_at_position(RAY_Engine *engine, float x, float y,
   if (best_match)
     return best_match;
 
-  return ray_find_sector_at_point(engine, x, y);
+  return innermost;
+}
+
+/* ============================================================================
+   SECTOR ID LOOKUP
+   Dense id -> index table, rebuilt whenever the sector array is loaded.
+   Entries are verified on use, so a stale table degrades to a linear scan.
+   ============================================================================
+ */
+
+#define RAY_SECTOR_ID_SLACK 1024 /* Max ids beyond num_sectors kept dense */
+
+void ray_build_sector_id_lookup(RAY_Engine *engine) {
+  if (!engine)
+    return;
+
+  free(engine->sector_id_lookup);
+  engine->sector_id_lookup = NULL;
+  engine->sector_id_lookup_size = 0;
+
+  int max_id = -1;
+  for (int i = 0; i < engine->num_sectors; i++) {
+    if (engine->sectors[i].sector_id > max_id)
+      max_id = engine->sectors[i].sector_id;
+  }
+  if (max_id < 0)
+    return;
+  if (max_id >= engine->num_sectors * 4 + RAY_SECTOR_ID_SLACK) {
+    fprintf(stderr,
+            "RAY: Sector ids too sparse for lookup table (max id %d)\n",
+            max_id);
+    return;
+  }
+
+  int size = max_id + 1;
+  engine->sector_id_lookup = (int *)malloc(size * sizeof(int));
+  if (!engine->sector_id_lookup)
+    return;
+  for (int i = 0; i < size; i++)
+    engine->sector_id_lookup[i] = -1;
+
+  /* First sector wins on duplicate ids, same as a linear scan */
+  for (int i = 0; i < engine->num_sectors; i++) {
+    int id = engine->sectors[i].sector_id;
+    if (id >= 0 && engine->sector_id_lookup[id] < 0)
+      engine->sector_id_lookup[id] = i;
+  }
+  engine->sector_id_lookup_size = size;
+}
+
+void ray_free_sector_id_lookup(RAY_Engine *engine) {
+  if (!engine)
+    return;
+  free(engine->sector_id_lookup);
+  engine->sector_id_lookup = NULL;
+  engine->sector_id_lookup_size = 0;
+}
+
+int ray_sector_index_by_id(RAY_Engine *engine, int sector_id) {
+  if (!engine || sector_id < 0)
+    return -1;
+
+  if (engine->sector_id_lookup && sector_id < engine->sector_id_lookup_size) {
+    int idx = engine->sector_id_lookup[sector_id];
+    if (idx >= 0 && idx < engine->num_sectors &&
+        engine->sectors[idx].sector_id == sector_id)
+      return idx;
+  }
+
+  /* No table, or the table predates this id (stale or unmapped entry) */
+  for (int i = 0; i < engine->num_sectors; i++) {
+    if (engine->sectors[i].sector_id == sector_id)
+      return i;
+  }
+  return -1;
+}
+
+RAY_Sector *ray_sector_by_id(RAY_Engine *engine, int sector_id) {
+  int idx = ray_sector_index_by_id(engine, sector_id);
+  return (idx >= 0) ? &engine->sectors[idx] : NULL;
+}
+
+/* ============================================================================
+   INCREMENTAL SECTOR TRACKING
+   Finds the innermost sector at (x,y) starting from a known sector (hint).
+   Moving inside the same sector or across one of its portals costs a few
+   polygon tests instead of a scan over every sector.
+   ============================================================================
+ */
+
+static int sector_index_contains(RAY_Engine *engine, int index, float x,
+                                 float y) {
+  if (index < 0 || index >= engine->num_sectors)
+    return 0;
+  RAY_Sector *s = &engine->sectors[index];
+  return ray_point_in_polygon(x, y, s->vertices, s->num_vertices);
+}
+
+/* Walk down the nesting hierarchy while a child contains the point */
+static int descend_to_innermost(RAY_Engine *engine, int index, float x,
+                                float y) {
+  for (int guard = 0; guard < 32; guard++) {
+    RAY_Sector *s = &engine->sectors[index];
+    int next = -1;
+    for (int c = 0; c < s->num_children; c++) {
+      int ci = ray_sector_index_by_id(engine, s->child_sector_ids[c]);
+      if (ci != index && sector_index_contains(engine, ci, x, y)) {
+        next = ci;
+        break;
+      }
+    }
+    if (next < 0)
+      break;
+    index = next;
+  }
+  return index;
+}
+
+/* Returns the sector index at (x,y), or -1 if the point is outside the map.
+   hint_index is the sector the point was last known to be in (-1 = none). */
+int ray_locate_sector_index(RAY_Engine *engine, int hint_index, float x,
+                            float y) {
+  if (!engine || engine->num_sectors <= 0)
+    return -1;
+
+  if (hint_index >= 0 && hint_index < engine->num_sectors) {
+    /* 1. Still inside the hint sector (or one of its children) */
+    if (sector_index_contains(engine, hint_index, x, y))
+      return descend_to_innermost(engine, hint_index, x, y);
+
+    RAY_Sector *hint = &engine->sectors[hint_index];
+
+    /* 2. Crossed one of the hint's portals */
+    for (int p = 0; p < hint->num_portals; p++) {
+      int portal_id = hint->portal_ids[p];
+      if (portal_id < 0 || portal_id >= engine->num_portals)
+        continue;
+      RAY_Portal *portal = &engine->portals[portal_id];
+      int other_id = (portal->sector_a == hint->sector_id) ? portal->sector_b
+                                                           : portal->sector_a;
+      int other = ray_sector_index_by_id(engine, other_id);
+      if (other >= 0 && other != hint_index &&
+          sector_index_contains(engine, other, x, y))
+        return descend_to_innermost(engine, other, x, y);
+    }
+
+    /* 3. Left a nested sector: climb to the first ancestor containing it */
+    int parent = ray_sector_index_by_id(engine, hint->parent_sector_id);
+    for (int guard = 0; parent >= 0 && guard < 32; guard++) {
+      if (sector_index_contains(engine, parent, x, y))
+        return descend_to_innermost(engine, parent, x, y);
+      parent = ray_sector_index_by_id(engine,
+                               engine->sectors[parent].parent_sector_id);
+    }
+  }
+
+  /* 4. Teleport or no hint: full lookup */
+  RAY_Sector *found = ray_find_sector_at_point(engine, x, y);
+  return found ? (int)(found - engine->sectors) : -1;
 }
 
 /* ============================================================================
@@ -480,11 +837,10 @@ int64_t libmod_ray_get_dist(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int id1 = (int)params[0];
-  int id2 = (int)params[1];
+  int id1 = ray_sprite_resolve(params[0]);
+  int id2 = ray_sprite_resolve(params[1]);
 
-  if (id1 < 0 || id1 >= g_engine.num_sprites || id2 < 0 ||
-      id2 >= g_engine.num_sprites)
+  if (id1 < 0 || id2 < 0)
     return 0;
 
   float dx = g_engine.sprites[id1].x - g_engine.sprites[id2].x;
@@ -501,9 +857,9 @@ int64_t libmod_ray_get_camera_dist(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int id = (int)params[0];
+  int id = ray_sprite_resolve(params[0]);
 
-  if (id < 0 || id >= g_engine.num_sprites)
+  if (id < 0)
     return 0;
 
   float dx = g_engine.sprites[id].x - g_engine.camera.x;
@@ -541,11 +897,10 @@ int64_t libmod_ray_get_angle(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int id1 = (int)params[0];
-  int id2 = (int)params[1];
+  int id1 = ray_sprite_resolve(params[0]);
+  int id2 = ray_sprite_resolve(params[1]);
 
-  if (id1 < 0 || id1 >= g_engine.num_sprites || id2 < 0 ||
-      id2 >= g_engine.num_sprites)
+  if (id1 < 0 || id2 < 0)
     return 0;
 
   float dx = g_engine.sprites[id2].x - g_engine.sprites[id1].x;
@@ -561,9 +916,9 @@ int64_t libmod_ray_get_camera_angle(INSTANCE *my, int64_t *params) {
   if (!g_engine.initialized)
     return 0;
 
-  int id = (int)params[0];
+  int id = ray_sprite_resolve(params[0]);
 
-  if (id < 0 || id >= g_engine.num_sprites)
+  if (id < 0)
     return 0;
 
   float dx = g_engine.sprites[id].x - g_engine.camera.x;
@@ -7,6 +7,8 @@
 /* SDL2 for image loading from memory */
 #include "SDL.h"
 
+static void capture_rest_pose(RAY_GLTF_Model *model);
+
 static void compute_node_world_matrix(cgltf_node *node, mat4 parent_world) {
   mat4 local;
   if (node->has_matrix) {
@@ -69,7 +71,99 @@ void ray_gltf_update_matrices(RAY_GLTF_Model *model) {
   }
 }
 
-RAY_GLTF_Model *ray_gltf_load(const char *filename) {
+/* Expand one primitive into packed arrays so rendering never touches the
+   accessors again */
+static void decode_primitive(cgltf_data *data, cgltf_primitive *prim,
+                             RAY_GLTF_Primitive *out) {
+  memset(out, 0, sizeof(*out));
+  out->image_index = -1;
+
+  cgltf_accessor *pos_acc = NULL;
+  cgltf_accessor *uv_acc = NULL;
+  cgltf_accessor *joints_acc = NULL;
+  cgltf_accessor *weights_acc = NULL;
+
+  for (cgltf_size k = 0; k < prim->attributes_count; ++k) {
+    if (prim->attributes[k].type == cgltf_attribute_type_position)
+      pos_acc = prim->attributes[k].data;
+    if (prim->attributes[k].type == cgltf_attribute_type_texcoord)
+      uv_acc = prim->attributes[k].data;
+    if (prim->attributes[k].type == cgltf_attribute_type_joints)
+      joints_acc = prim->attributes[k].data;
+    if (prim->attributes[k].type == cgltf_attribute_type_weights)
+      weights_acc = prim->attributes[k].data;
+  }
+
+  if (prim->material) {
+    cgltf_texture *tex_ptr =
+        prim->material->pbr_metallic_roughness.base_color_texture.texture;
+    if (tex_ptr && tex_ptr->image)
+      out->image_index = (int)(tex_ptr->image - data->images);
+    out->alpha_blend =
+        (prim->material->alpha_mode == cgltf_alpha_mode_blend) ? 1 : 0;
+  }
+
+  if (!pos_acc || !prim->indices)
+    return;
+
+  int count = ((int)prim->indices->count / 3) * 3;
+  if (count <= 0)
+    return;
+
+  out->vertices = (float *)malloc(count * GLTF_VERTEX_FLOATS * sizeof(float));
+  if (!out->vertices)
+    return;
+  if (joints_acc && weights_acc) {
+    out->skin = (float *)malloc(count * GLTF_SKIN_FLOATS * sizeof(float));
+    if (!out->skin) {
+      free(out->vertices);
+      out->vertices = NULL;
+      return;
+    }
+  }
+
+  for (int k = 0; k < count; k++) {
+    cgltf_size idx = cgltf_accessor_read_index(prim->indices, k);
+    float *v = &out->vertices[k * GLTF_VERTEX_FLOATS];
+    cgltf_accessor_read_float(pos_acc, idx, v, 3);
+    if (uv_acc) {
+      cgltf_accessor_read_float(uv_acc, idx, &v[3], 2);
+    } else {
+      v[3] = v[4] = 0.0f;
+    }
+    if (out->skin) {
+      float *sk = &out->skin[k * GLTF_SKIN_FLOATS];
+      cgltf_accessor_read_float(joints_acc, idx, sk, 4);
+      cgltf_accessor_read_float(weights_acc, idx, sk + 4, 4);
+    }
+  }
+  out->vertex_count = count;
+}
+
+static void decode_meshes(RAY_GLTF_Model *model) {
+  cgltf_data *data = model->data;
+  int total = 0;
+  for (cgltf_size m = 0; m < data->meshes_count; ++m)
+    total += (int)data->meshes[m].primitives_count;
+
+  model->mesh_first_prim = (int *)calloc(data->meshes_count + 1, sizeof(int));
+  model->prims =
+      (RAY_GLTF_Primitive *)calloc(total > 0 ? total : 1,
+                                   sizeof(RAY_GLTF_Primitive));
+  if (!model->mesh_first_prim || !model->prims)
+    return;
+
+  int n = 0;
+  for (cgltf_size m = 0; m < data->meshes_count; ++m) {
+    model->mesh_first_prim[m] = n;
+    for (cgltf_size j = 0; j < data->meshes[m].primitives_count; ++j)
+      decode_primitive(data, &data->meshes[m].primitives[j], &model->prims[n++]);
+  }
+  model->mesh_first_prim[data->meshes_count] = n;
+  model->prims_count = n;
+}
+
+RAY_GLTF_Model *ray_gltf_load_cpu(const char *filename) {
   cgltf_options options = {0};
   cgltf_data *data = NULL;
   cgltf_result result = cgltf_parse_file(&options, filename, &data);
@@ -94,25 +188,25 @@ RAY_GLTF_Model *ray_gltf_load(const char *filename) {
   model->textureID = 0;
   strncpy(model->name, filename, 63);
 
-  /* Load internal textures */
+  /* Decode internal textures. Only the CPU side happens here: the surfaces
+     are turned into GPU images by ray_gltf_upload_textures, which needs the
+     GL context (main thread) */
   model->textures_count = (int)data->images_count;
   model->textures =
       (GPU_Image **)calloc(model->textures_count, sizeof(GPU_Image *));
+  model->pending_surfaces =
+      (SDL_Surface **)calloc(model->textures_count, sizeof(SDL_Surface *));
 
   for (cgltf_size i = 0; i < data->images_count; ++i) {
     cgltf_image *image = &data->images[i];
+    SDL_Surface *surface = NULL;
     if (image->buffer_view) {
       void *ptr = (uint8_t *)image->buffer_view->buffer->data +
                   image->buffer_view->offset;
       size_t size = image->buffer_view->size;
       SDL_RWops *rw = SDL_RWFromMem(ptr, (int)size);
-      if (rw) {
-        model->textures[i] = GPU_LoadImage_RW(rw, 1);
-        if (model->textures[i]) {
-          GPU_SetImageFilter(model->textures[i], GPU_FILTER_LINEAR);
-          GPU_GenerateMipmaps(model->textures[i]);
-        }
-      }
+      if (rw)
+        surface = GPU_LoadSurface_RW(rw, 1);
     } else if (image->uri && strncmp(image->uri, "data:", 5) != 0) {
       char path[256];
       strncpy(path, filename, 255);
@@ -122,11 +216,11 @@ RAY_GLTF_Model *ray_gltf_load(const char *filename) {
       else
         path[0] = '\0';
       strncat(path, image->uri, 255);
-      model->textures[i] = GPU_LoadImage(path);
-      if (model->textures[i]) {
-        GPU_SetImageFilter(model->textures[i], GPU_FILTER_LINEAR);
-        GPU_GenerateMipmaps(model->textures[i]);
-      }
+      surface = GPU_LoadSurface(path);
+    }
+    if (surface) {
+      model->pending_surfaces[i] = surface;
+      model->pending_textures++;
     }
   }
 
@@ -141,12 +235,133 @@ RAY_GLTF_Model *ray_gltf_load(const char *filename) {
     }
   }
 
+  /* Decode vertex data once (positions, UVs, joints, weights) */
+  decode_meshes(model);
+
+  /* Rest pose + inverse bind matrices for the pose cache */
+  capture_rest_pose(model);
+
   printf("RAY_GLTF: Loaded %s (Meshes: %d, Skins: %d, Textures: %d)\n",
          filename, (int)data->meshes_count, model->skins_count,
          model->textures_count);
   return model;
 }
 
+int ray_gltf_upload_textures(RAY_GLTF_Model *model, int budget) {
+  int uploaded = 0;
+  if (!model || !model->pending_surfaces)
+    return 0;
+  for (int i = 0; i < model->textures_count && model->pending_textures > 0;
+       ++i) {
+    if (!model->pending_surfaces[i])
+      continue;
+    if (uploaded >= budget)
+      break;
+    model->textures[i] = GPU_CopyImageFromSurface(model->pending_surfaces[i]);
+    if (model->textures[i]) {
+      GPU_SetImageFilter(model->textures[i], GPU_FILTER_LINEAR);
+      GPU_GenerateMipmaps(model->textures[i]);
+    }
+    SDL_FreeSurface(model->pending_surfaces[i]);
+    model->pending_surfaces[i] = NULL;
+    model->pending_textures--;
+    uploaded++;
+  }
+  return uploaded;
+}
+
+RAY_GLTF_Model *ray_gltf_load(const char *filename) {
+  RAY_GLTF_Model *model = ray_gltf_load_cpu(filename);
+  if (model)
+    ray_gltf_upload_textures(model, model->pending_textures);
+  return model;
+}
+
+/* Sample one animation channel at `time` into the matching TRS slot.
+   Returns 1 if something was written. */
+static int sample_channel(cgltf_animation_channel *channel, float time,
+                          float translation[3], float rotation[4],
+                          float scale[3]) {
+  cgltf_animation_sampler *sampler = channel->sampler;
+  if (!channel->target_node || !sampler)
+    return 0;
+
+  cgltf_accessor *input = sampler->input;
+  cgltf_accessor *output = sampler->output;
+  if (input->count < 1)
+    return 0;
+
+  float duration = 0;
+  cgltf_accessor_read_float(input, input->count - 1, &duration, 1);
+  if (duration <= 0)
+    duration = 0.001f;
+
+  float t = fmodf(time, duration);
+  if (t < 0)
+    t += duration;
+
+  cgltf_size low = 0, high = input->count - 1;
+  while (low + 1 < high) {
+    cgltf_size mid = low + (high - low) / 2;
+    float mid_t;
+    cgltf_accessor_read_float(input, mid, &mid_t, 1);
+    if (mid_t <= t)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  float t0, t1;
+  cgltf_accessor_read_float(input, low, &t0, 1);
+  t1 = t0;
+  if (low + 1 < input->count)
+    cgltf_accessor_read_float(input, low + 1, &t1, 1);
+
+  float alpha = 0;
+  if (t1 > t0)
+    alpha = (t - t0) / (t1 - t0);
+
+  if (channel->target_path == cgltf_animation_path_type_translation) {
+    float v0[3], v1[3];
+    cgltf_accessor_read_float(output, low, v0, 3);
+    if (low + 1 < output->count)
+      cgltf_accessor_read_float(output, low + 1, v1, 3);
+    else
+      memcpy(v1, v0, sizeof(v0));
+    for (int j = 0; j < 3; ++j)
+      translation[j] = v0[j] + alpha * (v1[j] - v0[j]);
+    return 1;
+  } else if (channel->target_path == cgltf_animation_path_type_rotation) {
+    float v0[4], v1[4];
+    cgltf_accessor_read_float(output, low, v0, 4);
+    if (low + 1 < output->count)
+      cgltf_accessor_read_float(output, low + 1, v1, 4);
+    else
+      memcpy(v1, v0, sizeof(v0));
+    float dot = v0[0] * v1[0] + v0[1] * v1[1] + v0[2] * v1[2] + v0[3] * v1[3];
+    float sign = (dot < 0.0f) ? -1.0f : 1.0f;
+    for (int j = 0; j < 4; ++j)
+      rotation[j] = v0[j] + alpha * (v1[j] * sign - v0[j]);
+    float len = sqrtf(rotation[0] * rotation[0] + rotation[1] * rotation[1] +
+                      rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+    if (len > 0)
+      for (int j = 0; j < 4; j++)
+        rotation[j] /= len;
+    return 1;
+  } else if (channel->target_path == cgltf_animation_path_type_scale) {
+    float v0[3], v1[3];
+    cgltf_accessor_read_float(output, low, v0, 3);
+    if (low + 1 < output->count)
+      cgltf_accessor_read_float(output, low + 1, v1, 3);
+    else
+      memcpy(v1, v0, sizeof(v0));
+    for (int j = 0; j < 3; ++j)
+      scale[j] = v0[j] + alpha * (v1[j] - v0[j]);
+    return 1;
+  }
+  return 0;
+}
+
 void ray_gltf_apply_animation(RAY_GLTF_Model *model, int anim_index,
                               float time) {
   if (!model || !model->data || anim_index < 0 ||
@@ -157,88 +372,213 @@ void ray_gltf_apply_animation(RAY_GLTF_Model *model, int anim_index,
   for (cgltf_size i = 0; i < anim->channels_count; ++i) {
     cgltf_animation_channel *channel = &anim->channels[i];
     cgltf_node *node = channel->target_node;
-    cgltf_animation_sampler *sampler = channel->sampler;
-
-    if (!node || !sampler)
+    if (!sample_channel(channel, time, node ? node->translation : NULL,
+                        node ? node->rotation : NULL,
+                        node ? node->scale : NULL))
       continue;
+    if (channel->target_path == cgltf_animation_path_type_translation)
+      node->has_translation = 1;
+    else if (channel->target_path == cgltf_animation_path_type_rotation)
+      node->has_rotation = 1;
+    else if (channel->target_path == cgltf_animation_path_type_scale)
+      node->has_scale = 1;
+    node->has_matrix = 0; // Clear cached world matrix
+  }
+}
 
-    cgltf_accessor *input = sampler->input;
-    cgltf_accessor *output = sampler->output;
-    if (input->count < 1)
-      continue;
+/* ============================================================================
+   POSE CACHE
+   Poses are evaluated from the rest pose captured at load into per-slot
+   matrices, without touching cgltf_data, so sprites sharing a model can't
+   stomp on each other. Identical (animation, time) pairs share a slot.
+   ============================================================================
+ */
+
+static void capture_rest_pose(RAY_GLTF_Model *model) {
+  cgltf_data *data = model->data;
+  cgltf_size n = data->nodes_count;
 
-    float duration = 0;
-    cgltf_accessor_read_float(input, input->count - 1, &duration, 1);
-    if (duration <= 0)
-      duration = 0.001f;
-
-    float t = fmodf(time, duration);
-    if (t < 0)
-      t += duration;
-
-    cgltf_size low = 0, high = input->count - 1;
-    while (low + 1 < high) {
-      cgltf_size mid = low + (high - low) / 2;
-      float mid_t;
-      cgltf_accessor_read_float(input, mid, &mid_t, 1);
-      if (mid_t <= t)
-        low = mid;
+  model->rest_trs = (float *)malloc((n ? n : 1) * 10 * sizeof(float));
+  model->rest_matrix = (float *)malloc((n ? n : 1) * 16 * sizeof(float));
+  model->rest_has_matrix = (unsigned char *)calloc(n ? n : 1, 1);
+  model->scratch_trs = (float *)malloc((n ? n : 1) * 10 * sizeof(float));
+  model->scratch_has_matrix = (unsigned char *)calloc(n ? n : 1, 1);
+  if (!model->rest_trs || !model->rest_matrix || !model->rest_has_matrix ||
+      !model->scratch_trs || !model->scratch_has_matrix)
+    return;
+
+  for (cgltf_size i = 0; i < n; ++i) {
+    cgltf_node *node = &data->nodes[i];
+    float *trs = &model->rest_trs[i * 10];
+    trs[0] = trs[1] = trs[2] = 0.0f;
+    trs[3] = trs[4] = trs[5] = 0.0f;
+    trs[6] = 1.0f;
+    trs[7] = trs[8] = trs[9] = 1.0f;
+    if (node->has_translation)
+      memcpy(&trs[0], node->translation, 3 * sizeof(float));
+    if (node->has_rotation)
+      memcpy(&trs[3], node->rotation, 4 * sizeof(float));
+    if (node->has_scale)
+      memcpy(&trs[7], node->scale, 3 * sizeof(float));
+    model->rest_has_matrix[i] = node->has_matrix ? 1 : 0;
+    if (node->has_matrix)
+      memcpy(&model->rest_matrix[i * 16], node->matrix, sizeof(mat4));
+  }
+
+  /* Inverse bind matrices, read once */
+  model->skin_joint_offset =
+      (int *)calloc(data->skins_count + 1, sizeof(int));
+  if (!model->skin_joint_offset)
+    return;
+  int total = 0;
+  for (cgltf_size s = 0; s < data->skins_count; ++s) {
+    model->skin_joint_offset[s] = total;
+    total += (int)data->skins[s].joints_count;
+  }
+  model->skin_joint_offset[data->skins_count] = total;
+  model->joints_total = total;
+
+  model->inv_bind = (float *)malloc((total ? total : 1) * 16 * sizeof(float));
+  if (!model->inv_bind)
+    return;
+  for (cgltf_size s = 0; s < data->skins_count; ++s) {
+    cgltf_skin *skin = &data->skins[s];
+    for (cgltf_size j = 0; j < skin->joints_count; ++j) {
+      float *m = &model->inv_bind[(model->skin_joint_offset[s] + j) * 16];
+      if (skin->inverse_bind_matrices)
+        cgltf_accessor_read_float(skin->inverse_bind_matrices, j, m, 16);
       else
-        high = mid;
+        mat4_identity(m);
     }
+  }
+}
 
-    float t0, t1;
-    cgltf_accessor_read_float(input, low, &t0, 1);
-    t1 = t0;
-    if (low + 1 < input->count)
-      cgltf_accessor_read_float(input, low + 1, &t1, 1);
-
-    float alpha = 0;
-    if (t1 > t0)
-      alpha = (t - t0) / (t1 - t0);
-
-    if (channel->target_path == cgltf_animation_path_type_translation) {
-      float v0[3], v1[3];
-      cgltf_accessor_read_float(output, low, v0, 3);
-      if (low + 1 < output->count)
-        cgltf_accessor_read_float(output, low + 1, v1, 3);
-      else
-        memcpy(v1, v0, sizeof(v0));
-      node->has_translation = 1;
-      for (int j = 0; j < 3; ++j)
-        node->translation[j] = v0[j] + alpha * (v1[j] - v0[j]);
-    } else if (channel->target_path == cgltf_animation_path_type_rotation) {
-      float v0[4], v1[4];
-      cgltf_accessor_read_float(output, low, v0, 4);
-      if (low + 1 < output->count)
-        cgltf_accessor_read_float(output, low + 1, v1, 4);
-      else
-        memcpy(v1, v0, sizeof(v0));
-      node->has_rotation = 1;
-      float dot = v0[0] * v1[0] + v0[1] * v1[1] + v0[2] * v1[2] + v0[3] * v1[3];
-      float sign = (dot < 0.0f) ? -1.0f : 1.0f;
-      for (int j = 0; j < 4; ++j)
-        node->rotation[j] = v0[j] + alpha * (v1[j] * sign - v0[j]);
-      float len = sqrtf(node->rotation[0] * node->rotation[0] +
-                        node->rotation[1] * node->rotation[1] +
-                        node->rotation[2] * node->rotation[2] +
-                        node->rotation[3] * node->rotation[3]);
-      if (len > 0)
-        for (int j = 0; j < 4; j++)
-          node->rotation[j] /= len;
-    } else if (channel->target_path == cgltf_animation_path_type_scale) {
-      float v0[3], v1[3];
-      cgltf_accessor_read_float(output, low, v0, 3);
-      if (low + 1 < output->count)
-        cgltf_accessor_read_float(output, low + 1, v1, 3);
-      else
-        memcpy(v1, v0, sizeof(v0));
-      node->has_scale = 1;
-      for (int j = 0; j < 3; ++j)
-        node->scale[j] = v0[j] + alpha * (v1[j] - v0[j]);
+static void pose_node_world(RAY_GLTF_Model *model, RAY_GLTF_Pose *pose,
+                            cgltf_node *node, const mat4 parent_world) {
+  cgltf_size i = (cgltf_size)(node - model->data->nodes);
+  mat4 local;
+  if (model->scratch_has_matrix[i]) {
+    memcpy(local, &model->rest_matrix[i * 16], sizeof(mat4));
+  } else {
+    const float *trs = &model->scratch_trs[i * 10];
+    mat4_from_trs(local, &trs[0], &trs[3], &trs[7]);
+  }
+
+  float *world = &pose->node_world[i * 16];
+  mat4_mul(world, parent_world, local);
+
+  for (cgltf_size c = 0; c < node->children_count; ++c)
+    pose_node_world(model, pose, node->children[c], world);
+}
+
+static void evaluate_pose(RAY_GLTF_Model *model, RAY_GLTF_Pose *pose,
+                          int anim_index, float time) {
+  cgltf_data *data = model->data;
+  cgltf_size n = data->nodes_count;
+
+  memcpy(model->scratch_trs, model->rest_trs, n * 10 * sizeof(float));
+  memcpy(model->scratch_has_matrix, model->rest_has_matrix, n);
+
+  if (anim_index >= 0) {
+    cgltf_animation *anim = &data->animations[anim_index];
+    for (cgltf_size c = 0; c < anim->channels_count; ++c) {
+      cgltf_animation_channel *channel = &anim->channels[c];
+      if (!channel->target_node)
+        continue;
+      cgltf_size i = (cgltf_size)(channel->target_node - data->nodes);
+      float *trs = &model->scratch_trs[i * 10];
+      if (sample_channel(channel, time, &trs[0], &trs[3], &trs[7]))
+        model->scratch_has_matrix[i] = 0;
     }
-    node->has_matrix = 0; // Clear cached world matrix
   }
+
+  mat4 ident;
+  mat4_identity(ident);
+  for (cgltf_size i = 0; i < n; ++i) {
+    if (!data->nodes[i].parent)
+      pose_node_world(model, pose, &data->nodes[i], ident);
+  }
+
+  for (cgltf_size s = 0; s < data->skins_count; ++s) {
+    cgltf_skin *skin = &data->skins[s];
+    int base = model->skin_joint_offset[s];
+    for (cgltf_size j = 0; j < skin->joints_count; ++j) {
+      cgltf_size ni = (cgltf_size)(skin->joints[j] - data->nodes);
+      mat4_mul(&pose->joints[(base + j) * 16], &pose->node_world[ni * 16],
+               &model->inv_bind[(base + j) * 16]);
+    }
+  }
+
+  pose->anim_index = anim_index;
+  pose->anim_time = time;
+  pose->serial = ++model->pose_serial;
+  if (pose->serial == 0) /* Wrapped: 0 means "unused" */
+    pose->serial = ++model->pose_serial;
+}
+
+const RAY_GLTF_Pose *ray_gltf_acquire_pose(RAY_GLTF_Model *model,
+                                           int anim_index, float time,
+                                           int *slot, unsigned int *serial) {
+  if (!model || !model->data || !model->rest_trs || !model->inv_bind)
+    return NULL;
+
+  if (anim_index < 0 ||
+      (cgltf_size)anim_index >= model->data->animations_count) {
+    anim_index = -1; /* Rest pose */
+    time = 0.0f;
+  }
+
+  unsigned int tick = ++model->pose_tick;
+
+  /* 1. Same pose this instance used last time */
+  if (slot && serial && *slot >= 0 && *slot < GLTF_POSE_CACHE) {
+    RAY_GLTF_Pose *p = &model->poses[*slot];
+    if (p->serial != 0 && p->serial == *serial && p->anim_index == anim_index &&
+        p->anim_time == time) {
+      p->last_used = tick;
+      return p;
+    }
+  }
+
+  /* 2. Another instance already evaluated it; else take a free/LRU slot */
+  int victim = 0;
+  for (int i = 0; i < GLTF_POSE_CACHE; i++) {
+    RAY_GLTF_Pose *p = &model->poses[i];
+    if (p->serial != 0 && p->anim_index == anim_index &&
+        p->anim_time == time) {
+      p->last_used = tick;
+      if (slot && serial) {
+        *slot = i;
+        *serial = p->serial;
+      }
+      return p;
+    }
+    if (model->poses[victim].serial != 0 &&
+        (p->serial == 0 || p->last_used < model->poses[victim].last_used))
+      victim = i;
+  }
+
+  RAY_GLTF_Pose *p = &model->poses[victim];
+  if (!p->node_world) {
+    cgltf_size n = model->data->nodes_count;
+    p->node_world = (float *)malloc((n ? n : 1) * 16 * sizeof(float));
+    p->joints = (float *)malloc(
+        (model->joints_total ? model->joints_total : 1) * 16 * sizeof(float));
+    if (!p->node_world || !p->joints) {
+      free(p->node_world);
+      free(p->joints);
+      p->node_world = p->joints = NULL;
+      return NULL;
+    }
+  }
+
+  evaluate_pose(model, p, anim_index, time);
+  p->last_used = tick;
+  if (slot && serial) {
+    *slot = victim;
+    *serial = p->serial;
+  }
+  return p;
 }
 
 void ray_gltf_free(RAY_GLTF_Model *model) {
@@ -251,12 +591,38 @@ void ray_gltf_free(RAY_GLTF_Model *model) {
     }
     free(model->textures);
   }
+  if (model->pending_surfaces) {
+    for (int i = 0; i < model->textures_count; ++i) {
+      if (model->pending_surfaces[i])
+        SDL_FreeSurface(model->pending_surfaces[i]);
+    }
+    free(model->pending_surfaces);
+  }
   if (model->skin_matrices) {
     for (int i = 0; i < model->skins_count; i++)
       if (model->skin_matrices[i])
         free(model->skin_matrices[i]);
     free(model->skin_matrices);
   }
+  if (model->prims) {
+    for (int i = 0; i < model->prims_count; i++) {
+      free(model->prims[i].vertices);
+      free(model->prims[i].skin);
+    }
+    free(model->prims);
+  }
+  free(model->mesh_first_prim);
+  free(model->rest_trs);
+  free(model->rest_matrix);
+  free(model->rest_has_matrix);
+  free(model->inv_bind);
+  free(model->skin_joint_offset);
+  free(model->scratch_trs);
+  free(model->scratch_has_matrix);
+  for (int i = 0; i < GLTF_POSE_CACHE; i++) {
+    free(model->poses[i].node_world);
+    free(model->poses[i].joints);
+  }
   if (model->data)
     cgltf_free(model->data);
   free(model);
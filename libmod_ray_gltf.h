@@ -9,23 +9,82 @@
 
 #define GLTF_MAGIC 0x46544C47 /* "GLTF" */
 
+#define GLTF_VERTEX_FLOATS 5 /* x, y, z, u, v (GPU_BATCH_XYZ_ST layout) */
+#define GLTF_SKIN_FLOATS 8   /* joint0..3, weight0..3 */
+
+/* Primitive decoded once at load: flat triangle list (indices expanded) */
+typedef struct {
+  int vertex_count;
+  float *vertices; /* vertex_count * GLTF_VERTEX_FLOATS, bind pose */
+  float *skin;     /* vertex_count * GLTF_SKIN_FLOATS, NULL if not skinned */
+  int image_index; /* Base color image (-1 = none) */
+  int alpha_blend; /* Material alphaMode BLEND: drawn sorted, no depth write */
+} RAY_GLTF_Primitive;
+
+#define GLTF_POSE_CACHE 16 /* Distinct (animation, time) poses kept per model */
+
+/* Evaluated pose shared by every sprite at the same (anim_index, time) */
+typedef struct {
+  int anim_index; /* -1 = rest pose */
+  float anim_time;
+  unsigned int serial;    /* Bumped on each evaluation (0 = slot unused) */
+  unsigned int last_used; /* LRU tick */
+  float *node_world;      /* nodes_count * 16, world matrix per node */
+  float *joints;          /* Joint matrices, skin s at skin_joint_offset[s] */
+} RAY_GLTF_Pose;
+
 typedef struct {
   uint32_t magic;
   cgltf_data *data;
   GPU_Image **textures;
   int textures_count;
+  SDL_Surface **pending_surfaces; /* Decoded, not uploaded yet (async load) */
+  int pending_textures;
   int textureID; // Default texture ID if none in GLTF
   char name[64];
 
   /* Skeleton / Skinning data */
   float **skin_matrices; // skin_matrices[skin_idx][joint_idx * 16]
   int skins_count;
+
+  /* Decoded geometry: primitives of mesh m are
+     prims[mesh_first_prim[m] .. mesh_first_prim[m + 1] - 1] */
+  RAY_GLTF_Primitive *prims;
+  int prims_count;
+  int *mesh_first_prim;
+
+  /* Rest pose (captured at load, never modified) and pose cache */
+  float *rest_trs;           /* nodes_count * 10: t[3], r[4], s[3] */
+  float *rest_matrix;        /* nodes_count * 16, local matrix if has_matrix */
+  unsigned char *rest_has_matrix;
+  float *inv_bind;           /* joints_total * 16 inverse bind matrices */
+  int *skin_joint_offset;    /* First joint of skin s in inv_bind / joints */
+  int joints_total;
+  float *scratch_trs;        /* Evaluation workspace (nodes_count * 10) */
+  unsigned char *scratch_has_matrix;
+  RAY_GLTF_Pose poses[GLTF_POSE_CACHE];
+  unsigned int pose_tick;
+  unsigned int pose_serial;
 } RAY_GLTF_Model;
 
 RAY_GLTF_Model *ray_gltf_load(const char *filename);
+
+/* Split loader for background loading: ray_gltf_load_cpu does the file I/O,
+   parsing and image decoding and never touches the GL context, so it can run
+   on a worker thread. ray_gltf_upload_textures then turns at most `budget`
+   decoded images into GPU textures (main thread) and returns how many it
+   uploaded; the model is complete once pending_textures reaches 0. */
+RAY_GLTF_Model *ray_gltf_load_cpu(const char *filename);
+int ray_gltf_upload_textures(RAY_GLTF_Model *model, int budget);
 void ray_gltf_apply_animation(RAY_GLTF_Model *model, int anim_index,
                               float time);
 void ray_gltf_free(RAY_GLTF_Model *model);
 void ray_gltf_update_matrices(RAY_GLTF_Model *model);
 
+/* Pose for (anim_index, time), evaluated at most once while cached.
+   slot/serial are the caller's per-instance cache (may be NULL). */
+const RAY_GLTF_Pose *ray_gltf_acquire_pose(RAY_GLTF_Model *model,
+                                           int anim_index, float time,
+                                           int *slot, unsigned int *serial);
+
 #endif /* __LIBMOD_RAY_GLTF_H */
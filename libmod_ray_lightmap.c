@@ -0,0 +1,758 @@
+/* ============================================================================
+   libmod_ray_lightmap.c - Baked static lightmaps
+   ============================================================================
+   Bakes the lights of g_engine.lights into one RGBA atlas with a rect per
+   floor, ceiling and wall of every sector, using the same falloff as the
+   GPU normal shader plus a shadow trace through the sector graph. The
+   atlas is cached next to the map as <map>.raylm, keyed by a hash of the
+   geometry and the baked lights, so only the first load pays for it.
+   Both renderers sample it and evaluate just the lights added afterwards.
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_compat.h"
+#ifdef __ANDROID__
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern RAY_Engine g_engine;
+
+#define RAY_LIGHTMAP_MAGIC "RAYLMAP"
+#define RAY_LIGHTMAP_VERSION 1
+#define RAY_LIGHTMAP_MAX_THREADS 16
+#define LM_BIAS 1.0f        /* Samples sit this far off their surface */
+#define LM_TRACE_STEP 8.0f  /* Shadow trace step (world units) */
+#define LM_DILATE_PASSES 2  /* Luxels outside the polygon copy neighbours */
+
+static char *s_lm_cache_path = NULL; /* <map>.raylm of the last bake */
+
+/* ============================================================================
+   CACHE KEY
+   ============================================================================
+ */
+
+static uint32_t lm_hash(uint32_t h, const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < size; i++) {
+    h ^= bytes[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* Everything the bake reads: geometry, hierarchy, portals and lights */
+static uint32_t lm_key(int num_lights) {
+  uint32_t h = 2166136261u;
+  uint32_t layout[3] = {RAY_LIGHTMAP_VERSION, sizeof(RAY_LightmapRect),
+                        sizeof(RAY_Light)};
+  h = lm_hash(h, layout, sizeof(layout));
+  h = lm_hash(h, &g_engine.num_sectors, sizeof(int));
+  for (int i = 0; i < g_engine.num_sectors; i++) {
+    const RAY_Sector *s = &g_engine.sectors[i];
+    h = lm_hash(h, &s->floor_z, sizeof(float));
+    h = lm_hash(h, &s->ceiling_z, sizeof(float));
+    h = lm_hash(h, &s->parent_sector_id, sizeof(int));
+    h = lm_hash(h, &s->num_portals, sizeof(int));
+    h = lm_hash(h, &s->num_walls, sizeof(int));
+    for (int w = 0; w < s->num_walls; w++) {
+      h = lm_hash(h, &s->walls[w].x1, 4 * sizeof(float));
+      h = lm_hash(h, &s->walls[w].portal_id, sizeof(int));
+    }
+  }
+  h = lm_hash(h, &num_lights, sizeof(int));
+  return lm_hash(h, g_engine.lights, num_lights * sizeof(RAY_Light));
+}
+
+/* ============================================================================
+   ATLAS LAYOUT
+   Rect sizes follow the surface extent at the luxel size; rects are packed
+   tallest first into shelves of RAY_LIGHTMAP_ATLAS_W luxels.
+   ============================================================================
+ */
+
+static int lm_side(float extent, float luxel) {
+  int n = (int)ceilf(extent / luxel);
+  return n < 1 ? 1 : (n > RAY_LIGHTMAP_MAX_SIDE ? RAY_LIGHTMAP_MAX_SIDE : n);
+}
+
+static void lm_size_rects(RAY_Lightmap *lm, float luxel) {
+  for (int i = 0; i < g_engine.num_sectors; i++) {
+    const RAY_Sector *s = &g_engine.sectors[i];
+    RAY_LightmapRect *r = &lm->rects[lm->sector_first[i]];
+    float bx = s->max_x - s->min_x, by = s->max_y - s->min_y;
+    bx = bx > 0.01f ? bx : 0.01f;
+    by = by > 0.01f ? by : 0.01f;
+    for (int k = 0; k < 2; k++) {
+      r[k].w = lm_side(bx, luxel);
+      r[k].h = lm_side(by, luxel);
+      r[k].origin_u = s->min_x;
+      r[k].origin_v = s->min_y;
+      r[k].scale_u = r[k].w / bx;
+      r[k].scale_v = r[k].h / by;
+    }
+
+    float height = s->ceiling_z - s->floor_z;
+    height = height > 0.01f ? height : 0.01f;
+    for (int w = 0; w < s->num_walls; w++) {
+      const RAY_Wall *wall = &s->walls[w];
+      RAY_LightmapRect *wr = &r[2 + w];
+      float len = sqrtf((wall->x2 - wall->x1) * (wall->x2 - wall->x1) +
+                        (wall->y2 - wall->y1) * (wall->y2 - wall->y1));
+      len = len > 0.01f ? len : 0.01f;
+      wr->w = lm_side(len, luxel);
+      wr->h = lm_side(height, luxel);
+      wr->origin_u = 0.0f;
+      wr->origin_v = s->ceiling_z; /* Rows run downwards */
+      wr->scale_u = wr->w / len;
+      wr->scale_v = -wr->h / height;
+    }
+  }
+}
+
+static const RAY_LightmapRect *s_sort_rects;
+
+static int lm_rect_height_cmp(const void *a, const void *b) {
+  int ia = *(const int *)a, ib = *(const int *)b;
+  int ha = s_sort_rects[ia].h, hb = s_sort_rects[ib].h;
+  return ha != hb ? hb - ha : ia - ib;
+}
+
+/* Returns the atlas height, or 0 if it does not fit */
+static int lm_pack(RAY_Lightmap *lm, int *order) {
+  for (int i = 0; i < lm->num_rects; i++)
+    order[i] = i;
+  s_sort_rects = lm->rects;
+  qsort(order, lm->num_rects, sizeof(int), lm_rect_height_cmp);
+
+  int x = 0, y = 0, shelf = 0;
+  for (int k = 0; k < lm->num_rects; k++) {
+    RAY_LightmapRect *r = &lm->rects[order[k]];
+    int w = r->w + 2, h = r->h + 2;
+    if (x + w > RAY_LIGHTMAP_ATLAS_W) {
+      y += shelf;
+      x = 0;
+      shelf = 0;
+    }
+    r->x = x + 1;
+    r->y = y + 1;
+    x += w;
+    shelf = h > shelf ? h : shelf;
+    if (y + shelf > RAY_LIGHTMAP_ATLAS_MAX_H)
+      return 0;
+  }
+  return y + shelf;
+}
+
+/* ============================================================================
+   SHADOW TRACE
+   A sample sees a light when every step of the segment between them stays
+   in open space (between floor and ceiling of the innermost sector, or
+   outside a solid nested box) and consecutive steps only move between
+   sectors joined by a portal or by the hierarchy.
+   ============================================================================
+ */
+
+typedef struct {
+  int *parent;   /* Sector index -> parent index (-1 = root) */
+  int *nb_first; /* Portal neighbours: nb[nb_first[i] .. nb_first[i + 1]) */
+  int *nb;
+} RAY_LmGraph;
+
+static int lm_graph_build(RAY_LmGraph *g) {
+  int n = g_engine.num_sectors, np = g_engine.num_portals;
+  g->parent = (int *)malloc(n * sizeof(int));
+  g->nb_first = (int *)calloc(n + 1, sizeof(int));
+  g->nb = (int *)malloc((np > 0 ? np : 1) * 2 * sizeof(int));
+  int *ends = (int *)malloc((np > 0 ? np : 1) * 2 * sizeof(int));
+  if (!g->parent || !g->nb_first || !g->nb || !ends) {
+    free(ends);
+    return 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    int pid = g_engine.sectors[i].parent_sector_id;
+    g->parent[i] = pid >= 0 ? ray_sector_index_by_id(&g_engine, pid) : -1;
+    if (g->parent[i] == i)
+      g->parent[i] = -1;
+  }
+  for (int p = 0; p < np; p++) {
+    const RAY_Portal *portal = &g_engine.portals[p];
+    ends[p * 2] = ray_sector_index_by_id(&g_engine, portal->sector_a);
+    ends[p * 2 + 1] = ray_sector_index_by_id(&g_engine, portal->sector_b);
+    if (ends[p * 2] >= 0 && ends[p * 2 + 1] >= 0) {
+      g->nb_first[ends[p * 2] + 1]++;
+      g->nb_first[ends[p * 2 + 1] + 1]++;
+    }
+  }
+  for (int i = 0; i < n; i++)
+    g->nb_first[i + 1] += g->nb_first[i];
+  int *fill = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+  if (!fill) {
+    free(ends);
+    return 0;
+  }
+  memcpy(fill, g->nb_first, n * sizeof(int));
+  for (int p = 0; p < np; p++) {
+    int a = ends[p * 2], b = ends[p * 2 + 1];
+    if (a >= 0 && b >= 0) {
+      g->nb[fill[a]++] = b;
+      g->nb[fill[b]++] = a;
+    }
+  }
+  free(fill);
+  free(ends);
+  return 1;
+}
+
+static void lm_graph_free(RAY_LmGraph *g) {
+  free(g->parent);
+  free(g->nb_first);
+  free(g->nb);
+}
+
+static int lm_is_ancestor(const RAY_LmGraph *g, int ancestor, int s) {
+  for (int guard = 0; s >= 0 && guard < 32; guard++) {
+    s = g->parent[s];
+    if (s == ancestor)
+      return 1;
+  }
+  return 0;
+}
+
+static int lm_connected(const RAY_LmGraph *g, int a, int b) {
+  if (a == b || lm_is_ancestor(g, a, b) || lm_is_ancestor(g, b, a))
+    return 1;
+  for (int k = g->nb_first[a]; k < g->nb_first[a + 1]; k++)
+    if (g->nb[k] == b)
+      return 1;
+  return 0;
+}
+
+static int lm_open(const RAY_LmGraph *g, int s, float z) {
+  const RAY_Sector *sector = &g_engine.sectors[s];
+  if (g->parent[s] >= 0 && ray_sector_is_solid((RAY_Sector *)sector)) {
+    if (z >= sector->floor_z && z <= sector->ceiling_z)
+      return 0; /* Inside the box */
+    const RAY_Sector *parent = &g_engine.sectors[g->parent[s]];
+    return z >= parent->floor_z && z <= parent->ceiling_z;
+  }
+  return z >= sector->floor_z - 0.01f && z <= sector->ceiling_z + 0.01f;
+}
+
+static int lm_visible(const RAY_LmGraph *g, int start, float px, float py,
+                      float pz, const RAY_Light *light) {
+  float dx = light->x - px, dy = light->y - py, dz = light->z - pz;
+  float dist = sqrtf(dx * dx + dy * dy + dz * dz);
+  int steps = (int)(dist / LM_TRACE_STEP) + 1;
+  int cur = start;
+  for (int i = 1; i <= steps; i++) {
+    float t = (float)i / (float)steps;
+    int next = ray_locate_sector_index(&g_engine, cur, px + dx * t,
+                                       py + dy * t);
+    if (next < 0 || !lm_connected(g, cur, next))
+      return 0;
+    /* The light itself may float above a floor it is drawn on */
+    if (i < steps && !lm_open(g, next, pz + dz * t))
+      return 0;
+    cur = next;
+  }
+  return 1;
+}
+
+/* ============================================================================
+   BAKE
+   Workers take one sector at a time; each sector writes only its own rects.
+   ============================================================================
+ */
+
+typedef struct {
+  RAY_Lightmap *lm;
+  const RAY_LmGraph *graph;
+  int num_lights;
+  SDL_atomic_t next_sector;
+} RAY_LmBake;
+
+typedef struct {
+  RAY_LmBake *bake;
+  float *acc;    /* RAY_LIGHTMAP_MAX_SIDE^2 * 3 */
+  uint8_t *mask; /* 1 = luxel sample lies in open space */
+  SDL_Thread *thread;
+} RAY_LmWorker;
+
+/* Light at p with normal n, same falloff as the normal shader */
+static void lm_light_point(RAY_LmBake *bake, int sector_index, float px,
+                           float py, float pz, float nx, float ny, float nz,
+                           float *out) {
+  out[0] = out[1] = out[2] = 0.0f;
+  int start = ray_locate_sector_index(&g_engine, sector_index, px, py);
+  int count = 0;
+  const int *list = ray_sector_lights(sector_index, &count);
+  if (start < 0 || !list)
+    return;
+
+  for (int k = 0; k < count; k++) {
+    if (list[k] >= bake->num_lights)
+      continue;
+    const RAY_Light *light = &g_engine.lights[list[k]];
+    float lx = light->x - px, ly = light->y - py, lz = light->z - pz;
+    float dist_sq = lx * lx + ly * ly + lz * lz;
+    float rad_sq = light->intensity * light->intensity;
+    float fade = 1.0f - dist_sq / (16.0f * rad_sq + 1.0f);
+    if (fade <= 0.0f)
+      continue;
+    float att = rad_sq / (rad_sq + dist_sq + 1.0f) * fade * fade;
+    if (att < 1.0f / 512.0f)
+      continue;
+    float inv = dist_sq > 1e-6f ? 1.0f / sqrtf(dist_sq) : 0.0f;
+    float diff = (lx * nx + ly * ny + lz * nz) * inv;
+    diff = diff > 0.0f ? diff : 0.0f;
+    if (!lm_visible(bake->graph, start, px, py, pz, light))
+      continue;
+    float w = (0.5f + 0.5f * diff) * att * 2.0f;
+    out[0] += light->r * w;
+    out[1] += light->g * w;
+    out[2] += light->b * w;
+  }
+}
+
+/* Fill masked-out luxels from lit neighbours, then encode with the border */
+static void lm_store_rect(RAY_Lightmap *lm, const RAY_LightmapRect *r,
+                          float *acc, uint8_t *mask) {
+  static const int off[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  for (int pass = 0; pass < LM_DILATE_PASSES; pass++) {
+    for (int y = 0; y < r->h; y++)
+      for (int x = 0; x < r->w; x++) {
+        if (mask[y * r->w + x])
+          continue;
+        float sum[3] = {0, 0, 0};
+        int n = 0;
+        for (int k = 0; k < 4; k++) {
+          int nx = x + off[k][0], ny = y + off[k][1];
+          if (nx < 0 || ny < 0 || nx >= r->w || ny >= r->h ||
+              mask[ny * r->w + nx] != 1)
+            continue;
+          for (int c = 0; c < 3; c++)
+            sum[c] += acc[(ny * r->w + nx) * 3 + c];
+          n++;
+        }
+        if (n > 0) {
+          for (int c = 0; c < 3; c++)
+            acc[(y * r->w + x) * 3 + c] = sum[c] / n;
+          mask[y * r->w + x] = 2; /* Filled this pass */
+        }
+      }
+    for (int i = 0; i < r->w * r->h; i++)
+      mask[i] = mask[i] ? 1 : 0;
+  }
+
+  /* The border repeats the nearest interior luxel for bilinear sampling */
+  for (int y = -1; y <= r->h; y++)
+    for (int x = -1; x <= r->w; x++) {
+      int sx = x < 0 ? 0 : (x >= r->w ? r->w - 1 : x);
+      int sy = y < 0 ? 0 : (y >= r->h ? r->h - 1 : y);
+      const float *c = &acc[(sy * r->w + sx) * 3];
+      uint8_t *out =
+          &lm->rgba[((size_t)(r->y + y) * lm->width + (r->x + x)) * 4];
+      for (int k = 0; k < 3; k++) {
+        float v = c[k] * 0.5f * 255.0f + 0.5f; /* Half scale */
+        out[k] = (uint8_t)(v > 255.0f ? 255.0f : v);
+      }
+      out[3] = 255;
+    }
+}
+
+static void lm_bake_sector(RAY_LmWorker *w, int si) {
+  RAY_LmBake *bake = w->bake;
+  RAY_Lightmap *lm = bake->lm;
+  RAY_Sector *s = &g_engine.sectors[si];
+  const RAY_LmGraph *g = bake->graph;
+  /* Solid nested boxes are seen from outside */
+  int outside = g->parent[si] >= 0 && ray_sector_is_solid(s);
+
+  for (int slot = 0; slot < 2 + s->num_walls; slot++) {
+    const RAY_LightmapRect *r = &lm->rects[lm->sector_first[si] + slot];
+    float nx = 0.0f, ny = 0.0f, nz = 0.0f;
+    float tx = 0.0f, ty = 0.0f, base_x = 0.0f, base_y = 0.0f;
+    float plane_z = 0.0f;
+    if (slot == RAY_LIGHTMAP_FLOOR) {
+      nz = outside ? -1.0f : 1.0f;
+      plane_z = s->floor_z;
+    } else if (slot == RAY_LIGHTMAP_CEILING) {
+      nz = outside ? 1.0f : -1.0f;
+      plane_z = s->ceiling_z;
+    } else {
+      const RAY_Wall *wall = &s->walls[slot - 2];
+      float dx = wall->x2 - wall->x1, dy = wall->y2 - wall->y1;
+      float len = sqrtf(dx * dx + dy * dy);
+      len = len > 0.001f ? len : 1.0f;
+      tx = dx / len;
+      ty = dy / len;
+      base_x = wall->x1;
+      base_y = wall->y1;
+      nx = -ty;
+      ny = tx;
+      /* Face the inside of the sector (outside for solid boxes) */
+      int inside = ray_point_in_sector_local(s, base_x + dx * 0.5f + nx,
+                                             base_y + dy * 0.5f + ny);
+      if (inside == outside) {
+        nx = -nx;
+        ny = -ny;
+      }
+    }
+
+    for (int y = 0; y < r->h; y++)
+      for (int x = 0; x < r->w; x++) {
+        float u = r->origin_u + (x + 0.5f) / r->scale_u;
+        float v = r->origin_v + (y + 0.5f) / r->scale_v;
+        float px, py, pz;
+        if (slot < 2) {
+          px = u;
+          py = v;
+          pz = plane_z;
+        } else {
+          px = base_x + tx * u;
+          py = base_y + ty * u;
+          pz = v;
+        }
+        px += nx * LM_BIAS;
+        py += ny * LM_BIAS;
+        pz += nz * LM_BIAS;
+
+        float *out = &w->acc[(y * r->w + x) * 3];
+        int start = ray_locate_sector_index(&g_engine, si, px, py);
+        w->mask[y * r->w + x] = start >= 0 && lm_open(g, start, pz);
+        if (w->mask[y * r->w + x])
+          lm_light_point(bake, si, px, py, pz, nx, ny, nz, out);
+        else
+          out[0] = out[1] = out[2] = 0.0f;
+      }
+    lm_store_rect(lm, r, w->acc, w->mask);
+  }
+}
+
+static int lm_bake_worker(void *data) {
+  RAY_LmWorker *w = (RAY_LmWorker *)data;
+  for (;;) {
+    int si = SDL_AtomicAdd(&w->bake->next_sector, 1);
+    if (si >= g_engine.num_sectors)
+      break;
+    lm_bake_sector(w, si);
+  }
+  return 0;
+}
+
+static int lm_bake_all(RAY_Lightmap *lm, int num_lights) {
+  RAY_LmGraph graph;
+  memset(&graph, 0, sizeof(graph));
+  if (!lm_graph_build(&graph)) {
+    lm_graph_free(&graph);
+    return 0;
+  }
+  /* Rebuild the sector light lists here: workers only read them */
+  int count;
+  ray_sector_lights(0, &count);
+
+  RAY_LmBake bake;
+  bake.lm = lm;
+  bake.graph = &graph;
+  bake.num_lights = num_lights;
+  SDL_AtomicSet(&bake.next_sector, 0);
+
+  int num_workers = SDL_GetCPUCount();
+  if (num_workers > RAY_LIGHTMAP_MAX_THREADS)
+    num_workers = RAY_LIGHTMAP_MAX_THREADS;
+  if (num_workers > g_engine.num_sectors)
+    num_workers = g_engine.num_sectors;
+  if (num_workers < 1)
+    num_workers = 1;
+
+  RAY_LmWorker workers[RAY_LIGHTMAP_MAX_THREADS];
+  memset(workers, 0, sizeof(workers));
+  size_t side_sq = (size_t)RAY_LIGHTMAP_MAX_SIDE * RAY_LIGHTMAP_MAX_SIDE;
+  int ready = 0;
+  for (int t = 0; t < num_workers; t++) {
+    workers[t].bake = &bake;
+    workers[t].acc = (float *)malloc(side_sq * 3 * sizeof(float));
+    workers[t].mask = (uint8_t *)malloc(side_sq);
+    if (!workers[t].acc || !workers[t].mask) {
+      free(workers[t].acc);
+      free(workers[t].mask);
+      break;
+    }
+    ready++;
+  }
+
+  for (int t = 1; t < ready; t++)
+    workers[t].thread =
+        SDL_CreateThread(lm_bake_worker, "ray_lightmap", &workers[t]);
+  if (ready > 0)
+    lm_bake_worker(&workers[0]);
+  for (int t = 1; t < ready; t++)
+    if (workers[t].thread)
+      SDL_WaitThread(workers[t].thread, NULL);
+  for (int t = 0; t < ready; t++) {
+    free(workers[t].acc);
+    free(workers[t].mask);
+  }
+  lm_graph_free(&graph);
+  return ready > 0 ? ready : 0;
+}
+
+/* ============================================================================
+   DISK CACHE
+   ============================================================================
+ */
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t key; /* lm_key() of the map and lights it was baked from */
+  uint32_t width, height;
+  uint32_t num_rects, num_sectors, baked_lights;
+  float luxel;
+} RAY_LightmapFileHeader;
+
+static char *lm_path(const char *map_filename) {
+  size_t len = strlen(map_filename);
+  char *path = (char *)malloc(len + 7);
+  if (!path)
+    return NULL;
+  memcpy(path, map_filename, len);
+  memcpy(path + len, ".raylm", 7);
+  return path;
+}
+
+static size_t lm_rgba_size(const RAY_Lightmap *lm) {
+  return (size_t)lm->width * lm->height * 4;
+}
+
+static int lm_cache_load(const char *path, uint32_t key, RAY_Lightmap *lm) {
+  FILE *file = path ? fopen(path, "rb") : NULL;
+  if (!file)
+    return 0;
+
+  RAY_LightmapFileHeader h;
+  int ok = fread(&h, sizeof(h), 1, file) == 1 &&
+           memcmp(h.magic, RAY_LIGHTMAP_MAGIC, 8) == 0 &&
+           h.version == RAY_LIGHTMAP_VERSION && h.key == key &&
+           (int)h.num_sectors == g_engine.num_sectors &&
+           (int)h.baked_lights == g_engine.num_lights &&
+           h.width == RAY_LIGHTMAP_ATLAS_W &&
+           h.height <= RAY_LIGHTMAP_ATLAS_MAX_H;
+  if (ok) {
+    lm->width = (int)h.width;
+    lm->height = (int)h.height;
+    lm->luxel = h.luxel;
+    lm->num_rects = (int)h.num_rects;
+    lm->num_sectors = (int)h.num_sectors;
+    lm->baked_lights = (int)h.baked_lights;
+    lm->rects = (RAY_LightmapRect *)malloc(
+        (lm->num_rects > 0 ? lm->num_rects : 1) * sizeof(RAY_LightmapRect));
+    lm->sector_first = (int *)malloc((lm->num_sectors + 1) * sizeof(int));
+    lm->rgba = (uint8_t *)malloc(lm_rgba_size(lm) ? lm_rgba_size(lm) : 1);
+    ok = lm->rects && lm->sector_first && lm->rgba &&
+         fread(lm->rects, sizeof(RAY_LightmapRect), lm->num_rects, file) ==
+             (size_t)lm->num_rects &&
+         fread(lm->sector_first, sizeof(int), lm->num_sectors + 1, file) ==
+             (size_t)lm->num_sectors + 1 &&
+         fread(lm->rgba, 1, lm_rgba_size(lm), file) == lm_rgba_size(lm);
+  }
+  fclose(file);
+  return ok;
+}
+
+static void lm_cache_save(const char *path, uint32_t key,
+                          const RAY_Lightmap *lm) {
+  if (!path)
+    return;
+  RAY_LightmapFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, RAY_LIGHTMAP_MAGIC, 8);
+  h.version = RAY_LIGHTMAP_VERSION;
+  h.key = key;
+  h.width = lm->width;
+  h.height = lm->height;
+  h.num_rects = lm->num_rects;
+  h.num_sectors = lm->num_sectors;
+  h.baked_lights = lm->baked_lights;
+  h.luxel = lm->luxel;
+
+  FILE *file = fopen(path, "wb");
+  int ok = file != NULL;
+  if (file) {
+    ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+         fwrite(lm->rects, sizeof(RAY_LightmapRect), lm->num_rects, file) ==
+             (size_t)lm->num_rects &&
+         fwrite(lm->sector_first, sizeof(int), lm->num_sectors + 1, file) ==
+             (size_t)lm->num_sectors + 1 &&
+         fwrite(lm->rgba, 1, lm_rgba_size(lm), file) == lm_rgba_size(lm);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+      remove(path);
+  }
+  if (ok)
+    printf("RAY: Lightmap cache written: %s\n", path);
+  else
+    printf("RAY: Could not write lightmap cache %s\n", path);
+}
+
+/* ============================================================================
+   PUBLIC API
+   ============================================================================
+ */
+
+static void lm_release(RAY_Lightmap *lm) {
+  free(lm->rgba);
+  free(lm->rects);
+  free(lm->sector_first);
+  lm->rgba = NULL;
+  lm->rects = NULL;
+  lm->sector_first = NULL;
+  lm->num_rects = 0;
+  lm->num_sectors = 0;
+  lm->baked_lights = 0;
+}
+
+void ray_lightmap_free(void) {
+  lm_release(&g_engine.lightmap);
+  g_engine.lightmap.serial++;
+}
+
+int ray_lightmap_bake(const char *map_filename) {
+  if (map_filename) {
+    free(s_lm_cache_path);
+    s_lm_cache_path = lm_path(map_filename);
+  }
+  ray_lightmap_free();
+  int n = g_engine.num_sectors;
+  if (!g_engine.lightmaps_enabled || n <= 0 || !g_engine.sectors ||
+      g_engine.num_lights <= 0)
+    return 0;
+
+  Uint32 start = SDL_GetTicks();
+  RAY_Lightmap lm;
+  memset(&lm, 0, sizeof(lm));
+  uint32_t key = lm_key(g_engine.num_lights);
+  int from_cache = lm_cache_load(s_lm_cache_path, key, &lm);
+
+  if (!from_cache) {
+    lm_release(&lm);
+    lm.num_sectors = n;
+    lm.baked_lights = g_engine.num_lights;
+    lm.sector_first = (int *)malloc((n + 1) * sizeof(int));
+    if (!lm.sector_first)
+      return 0;
+    lm.sector_first[0] = 0;
+    for (int i = 0; i < n; i++)
+      lm.sector_first[i + 1] =
+          lm.sector_first[i] + 2 + g_engine.sectors[i].num_walls;
+    lm.num_rects = lm.sector_first[n];
+    lm.rects = (RAY_LightmapRect *)calloc(lm.num_rects, sizeof(*lm.rects));
+    int *order = (int *)malloc(lm.num_rects * sizeof(int));
+    if (!lm.rects || !order) {
+      free(order);
+      lm_release(&lm);
+      return 0;
+    }
+
+    /* Maps too big for the atlas get coarser luxels */
+    lm.luxel = RAY_LIGHTMAP_LUXEL;
+    for (int tries = 0; tries < 6; tries++) {
+      lm_size_rects(&lm, lm.luxel);
+      lm.height = lm_pack(&lm, order);
+      if (lm.height > 0)
+        break;
+      lm.luxel *= 2.0f;
+    }
+    free(order);
+    lm.width = RAY_LIGHTMAP_ATLAS_W;
+    lm.rgba = lm.height > 0 ? (uint8_t *)calloc(lm_rgba_size(&lm), 1) : NULL;
+    if (!lm.rgba) {
+      fprintf(stderr, "RAY: Error allocating lightmap atlas\n");
+      lm_release(&lm);
+      return 0;
+    }
+
+    int threads = lm_bake_all(&lm, lm.baked_lights);
+    if (!threads) {
+      fprintf(stderr, "RAY: Error allocating lightmap bake buffers\n");
+      lm_release(&lm);
+      return 0;
+    }
+    printf("RAY: Lightmap Bake Complete (%u ms, %d threads): %dx%d luxels "
+           "of %.0f units, %d surfaces, %d lights\n",
+           SDL_GetTicks() - start, threads, lm.width, lm.height, lm.luxel,
+           lm.num_rects, lm.baked_lights);
+    lm_cache_save(s_lm_cache_path, key, &lm);
+  } else if (g_engine.verbose) {
+    printf("RAY: Lightmap loaded from %s (%dx%d, %d lights)\n",
+           s_lm_cache_path, lm.width, lm.height, lm.baked_lights);
+  }
+
+  lm.serial = g_engine.lightmap.serial + 1;
+  g_engine.lightmap = lm;
+  return 1;
+}
+
+int ray_lightmap_active(void) {
+  const RAY_Lightmap *lm = &g_engine.lightmap;
+  return g_engine.lightmaps_enabled && lm->rgba &&
+         lm->num_sectors == g_engine.num_sectors;
+}
+
+int ray_lightmap_surface(int sector_index, int slot, RAY_LightmapSurface *out) {
+  const RAY_Lightmap *lm = &g_engine.lightmap;
+  if (!ray_lightmap_active() || sector_index < 0 ||
+      sector_index >= lm->num_sectors)
+    return 0;
+  int first = lm->sector_first[sector_index];
+  if (slot < 0 || first + slot >= lm->sector_first[sector_index + 1])
+    return 0;
+  const RAY_LightmapRect *r = &lm->rects[first + slot];
+  out->stride = lm->width * 4;
+  out->rgba = lm->rgba + (size_t)r->y * out->stride + r->x * 4;
+  out->x = r->x;
+  out->y = r->y;
+  out->w = r->w;
+  out->h = r->h;
+  out->origin_u = r->origin_u;
+  out->origin_v = r->origin_v;
+  out->scale_u = r->scale_u;
+  out->scale_v = r->scale_v;
+  return 1;
+}
+
+/* ============================================================================
+   BINDINGS
+   ============================================================================
+ */
+
+/* RAY_SET_LIGHTMAPS(on): with a map loaded, switching on bakes (or loads
+   the cache) right away; otherwise RAY_LOAD_MAP does. Returns the previous
+   setting */
+int64_t libmod_ray_set_lightmaps(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return -1;
+  int prev = g_engine.lightmaps_enabled;
+  g_engine.lightmaps_enabled = params[0] ? 1 : 0;
+  if (g_engine.lightmaps_enabled && !g_engine.lightmap.rgba &&
+      g_engine.num_sectors > 0)
+    ray_lightmap_bake(NULL);
+  return prev;
+}
+
+/* RAY_BAKE_LIGHTMAP(): rebake with every current light, e.g. after adding
+   lights that should become static. Returns 1 if an atlas was built */
+int64_t libmod_ray_bake_lightmap(INSTANCE *my, int64_t *params) {
+  if (!g_engine.initialized)
+    return 0;
+  return ray_lightmap_bake(NULL);
+}
@@ -0,0 +1,455 @@
+/* ============================================================================
+   libmod_ray_lod.c - Model LOD chains and billboard impostors
+   ============================================================================
+   Any loaded MD2/MD3/glTF model can get lighter meshes of the same format
+   and an impostor: one pre-rendered view per billboard direction. Both
+   renderers ask ray_model_lod_pick() which one to draw from the height the
+   model would cover on screen, so far crowds cost about what flat sprites
+   do. MD2/MD3 impostors are baked here with the software rasterizer;
+   glTF textures only live on the GPU, so glTF impostors take their views
+   from graphs supplied by the game.
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_compat.h"
+#include "libmod_ray_gltf.h"
+#include "libmod_ray_md2.h"
+#include "libmod_ray_md3.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern RAY_Engine g_engine;
+
+#define LOD_BAKE_DISTANCE 64.0f /* Camara del bake a 64 radios: casi orto */
+
+static RAY_ModelLOD **s_lods = NULL;
+static int s_num_lods = 0, s_lods_capacity = 0;
+
+static uint32_t lod_magic(const void *model) {
+  return model ? *(const uint32_t *)model : 0;
+}
+
+static RAY_ModelLOD *lod_find(const void *model) {
+  for (int i = 0; i < s_num_lods; i++)
+    if (s_lods[i]->model == model)
+      return s_lods[i];
+  return NULL;
+}
+
+/* ============================================================================
+   MODEL BOUNDS
+   Caja en coordenadas locales del sprite (x adelante, y derecha, z arriba)
+   con escala 1: frame 0 en MD2/MD3 y pose de reposo en glTF.
+   ============================================================================
+ */
+
+static void lod_bounds_add(float *mn, float *mx, float x, float y, float z) {
+  float p[3] = {x, y, z};
+  for (int k = 0; k < 3; k++) {
+    if (p[k] < mn[k])
+      mn[k] = p[k];
+    if (p[k] > mx[k])
+      mx[k] = p[k];
+  }
+}
+
+static void lod_gltf_bounds(RAY_GLTF_Model *model, float *mn, float *mx) {
+  const RAY_GLTF_Pose *pose =
+      ray_gltf_acquire_pose(model, -1, 0.0f, NULL, NULL);
+  cgltf_data *data = model->data;
+  if (!pose || !model->prims)
+    return;
+  for (cgltf_size i = 0; i < data->nodes_count; i++) {
+    cgltf_node *node = &data->nodes[i];
+    if (!node->mesh)
+      continue;
+    const float *joints = NULL;
+    if (node->skin) {
+      cgltf_size s = (cgltf_size)(node->skin - data->skins);
+      if (s < data->skins_count)
+        joints = &pose->joints[model->skin_joint_offset[s] * 16];
+    }
+    int m = (int)(node->mesh - data->meshes);
+    for (int pi = model->mesh_first_prim[m]; pi < model->mesh_first_prim[m + 1];
+         pi++) {
+      const RAY_GLTF_Primitive *prim = &model->prims[pi];
+      for (int v = 0; v < prim->vertex_count; v++) {
+        const float *p = &prim->vertices[v * GLTF_VERTEX_FLOATS];
+        float n[3] = {0, 0, 0};
+        if (joints && prim->skin) {
+          const float *j = &prim->skin[v * GLTF_SKIN_FLOATS];
+          for (int b = 0; b < 4; b++) {
+            if (j[4 + b] <= 0)
+              continue;
+            const float *mt = &joints[(int)j[b] * 16];
+            for (int k = 0; k < 3; k++)
+              n[k] += (p[0] * mt[k] + p[1] * mt[4 + k] + p[2] * mt[8 + k] +
+                       mt[12 + k]) *
+                      j[4 + b];
+          }
+        } else {
+          const float *mt = &pose->node_world[i * 16];
+          for (int k = 0; k < 3; k++)
+            n[k] = p[0] * mt[k] + p[1] * mt[4 + k] + p[2] * mt[8 + k] +
+                   mt[12 + k];
+        }
+        /* Mismo cambio de ejes que el renderer glTF */
+        lod_bounds_add(mn, mx, -n[2], n[0], n[1]);
+      }
+    }
+  }
+}
+
+/* 0 si el modelo no tiene geometria */
+static int lod_model_bounds(void *model, float *mn, float *mx) {
+  mn[0] = mn[1] = mn[2] = RAY_INFINITY;
+  mx[0] = mx[1] = mx[2] = -RAY_INFINITY;
+  uint32_t magic = lod_magic(model);
+  if (magic == MD3_MAGIC) {
+    RAY_MD3_Model *md3 = (RAY_MD3_Model *)model;
+    for (int s = 0; s < md3->header.numSurfaces; s++) {
+      RAY_MD3_Surface *surf = &md3->surfaces[s];
+      for (int i = 0; i < surf->header.numVerts; i++)
+        lod_bounds_add(mn, mx, surf->vertices[i].x * MD3_XYZ_SCALE,
+                       surf->vertices[i].y * MD3_XYZ_SCALE,
+                       surf->vertices[i].z * MD3_XYZ_SCALE);
+    }
+  } else if (magic == MD2_MAGIC) {
+    RAY_MD2_Model *md2 = (RAY_MD2_Model *)model;
+    if (md2->header.numFrames > 0) {
+      const md2_frame_t *f = &md2->frames[0];
+      for (int i = 0; i < md2->header.numVertices; i++)
+        lod_bounds_add(mn, mx,
+                       f->vertices[i].v[0] * f->scale[0] + f->translate[0],
+                       f->vertices[i].v[1] * f->scale[1] + f->translate[1],
+                       f->vertices[i].v[2] * f->scale[2] + f->translate[2]);
+    }
+  } else if (magic == GLTF_MAGIC) {
+    lod_gltf_bounds((RAY_GLTF_Model *)model, mn, mx);
+  }
+  return mn[0] <= mx[0];
+}
+
+static RAY_ModelLOD *lod_get(void *model) {
+  RAY_ModelLOD *lod = lod_find(model);
+  if (lod)
+    return lod;
+  float mn[3], mx[3];
+  if (!lod_model_bounds(model, mn, mx))
+    return NULL;
+  if (s_num_lods == s_lods_capacity) {
+    int cap = s_lods_capacity ? s_lods_capacity * 2 : 16;
+    RAY_ModelLOD **grown =
+        (RAY_ModelLOD **)realloc(s_lods, cap * sizeof(RAY_ModelLOD *));
+    if (!grown)
+      return NULL;
+    s_lods = grown;
+    s_lods_capacity = cap;
+  }
+  lod = (RAY_ModelLOD *)calloc(1, sizeof(RAY_ModelLOD));
+  if (!lod)
+    return NULL;
+  lod->model = model;
+  float ex = mx[0] - mn[0], ey = mx[1] - mn[1], ez = mx[2] - mn[2];
+  lod->radius = 0.5f * sqrtf(ex * ex + ey * ey + ez * ez);
+  /* El impostor gira alrededor del origen del modelo: su ancho cubre el
+     punto de la caja mas alejado del eje */
+  float rx = fmaxf(fabsf(mn[0]), fabsf(mx[0]));
+  float ry = fmaxf(fabsf(mn[1]), fabsf(mx[1]));
+  lod->impostor.axis_radius = sqrtf(rx * rx + ry * ry);
+  lod->impostor.z_min = mn[2];
+  lod->impostor.z_max = mx[2];
+  s_lods[s_num_lods++] = lod;
+  return lod;
+}
+
+/* ============================================================================
+   LOD LEVELS
+   ============================================================================
+ */
+
+int ray_model_lod_add(void *model, void *lod_model, float screen_px) {
+  if (!model || !lod_model || model == lod_model ||
+      lod_magic(model) != lod_magic(lod_model) || screen_px <= 0)
+    return 0;
+  RAY_ModelLOD *lod = lod_get(model);
+  if (!lod)
+    return 0;
+
+  /* Niveles de mayor a menor umbral; el mismo umbral sustituye */
+  int i = 0;
+  while (i < lod->num_levels && lod->level_px[i] > screen_px)
+    i++;
+  if (i < lod->num_levels && lod->level_px[i] == screen_px) {
+    lod->levels[i] = lod_model;
+    return 1;
+  }
+  if (lod->num_levels >= RAY_LOD_MAX_LEVELS)
+    return 0;
+  memmove(&lod->levels[i + 1], &lod->levels[i],
+          (lod->num_levels - i) * sizeof(lod->levels[0]));
+  memmove(&lod->level_px[i + 1], &lod->level_px[i],
+          (lod->num_levels - i) * sizeof(lod->level_px[0]));
+  lod->levels[i] = lod_model;
+  lod->level_px[i] = screen_px;
+  lod->num_levels++;
+  return 1;
+}
+
+/* ============================================================================
+   IMPOSTOR BAKE
+   Vista k: camara en la direccion local k * 360 / n mirando al origen.
+   ============================================================================
+ */
+
+typedef struct {
+  float cs, sn;   /* Direccion de la camara en coordenadas del modelo */
+  float depth;    /* Distancia de la camara al origen */
+  float ppu;      /* Pixels por unidad */
+  float cx, cy;   /* Origen del modelo en la imagen */
+  float z_center;
+} LODBakeView;
+
+static void lod_bake_project(const LODBakeView *v, float lx, float ly,
+                             float lz, RAY_RasterVert *out) {
+  out->z = v->depth - (lx * v->cs + ly * v->sn);
+  out->x = v->cx + (lx * v->sn - ly * v->cs) * v->ppu;
+  out->y = v->cy - (lz - v->z_center) * v->ppu;
+}
+
+static void lod_bake_md3(RAY_MD3_Model *model, const LODBakeView *v) {
+  for (int s = 0; s < model->header.numSurfaces; s++) {
+    RAY_MD3_Surface *surf = &model->surfaces[s];
+    RAY_RasterVert *pv = ray_raster_vertices(surf->header.numVerts);
+    if (!pv)
+      return;
+    for (int i = 0; i < surf->header.numVerts; i++)
+      lod_bake_project(v, surf->vertices[i].x * MD3_XYZ_SCALE,
+                       surf->vertices[i].y * MD3_XYZ_SCALE,
+                       surf->vertices[i].z * MD3_XYZ_SCALE, &pv[i]);
+    ray_raster_surface(surf->textureID ? surf->textureID : model->textureID,
+                       RAY_CULL_NONE);
+    for (int i = 0; i < surf->header.numTriangles; i++) {
+      const int *ix = surf->triangles[i].indexes;
+      ray_raster_triangle(&pv[ix[0]], &pv[ix[1]], &pv[ix[2]],
+                          surf->texCoords[ix[0]].s, surf->texCoords[ix[0]].t,
+                          surf->texCoords[ix[1]].s, surf->texCoords[ix[1]].t,
+                          surf->texCoords[ix[2]].s, surf->texCoords[ix[2]].t);
+    }
+  }
+}
+
+static void lod_bake_md2(RAY_MD2_Model *model, const LODBakeView *v) {
+  if (model->header.numFrames <= 0)
+    return;
+  const md2_frame_t *f = &model->frames[0];
+  RAY_RasterVert *pv = ray_raster_vertices(model->header.numVertices);
+  if (!pv)
+    return;
+  for (int i = 0; i < model->header.numVertices; i++)
+    lod_bake_project(v, f->vertices[i].v[0] * f->scale[0] + f->translate[0],
+                     f->vertices[i].v[1] * f->scale[1] + f->translate[1],
+                     f->vertices[i].v[2] * f->scale[2] + f->translate[2],
+                     &pv[i]);
+  float sw = (float)(model->header.skinWidth ? model->header.skinWidth : 1);
+  float sh = (float)(model->header.skinHeight ? model->header.skinHeight : 1);
+  ray_raster_surface(model->textureID, RAY_CULL_NONE);
+  for (int i = 0; i < model->header.numTriangles; i++) {
+    const md2_triangle_t *t = &model->triangles[i];
+    const md2_texCoord_t *tc = model->texCoords;
+    ray_raster_triangle(
+        &pv[t->vertexIndices[0]], &pv[t->vertexIndices[1]],
+        &pv[t->vertexIndices[2]], tc[t->textureIndices[0]].s / sw,
+        tc[t->textureIndices[0]].t / sh, tc[t->textureIndices[1]].s / sw,
+        tc[t->textureIndices[1]].t / sh, tc[t->textureIndices[2]].s / sw,
+        tc[t->textureIndices[2]].t / sh);
+  }
+}
+
+static void lod_impostor_release(RAY_ModelImpostor *imp) {
+  if (imp->owned) {
+    for (int k = 0; k < imp->num_views; k++)
+      if (imp->views[k])
+        bitmap_destroy(imp->views[k]);
+  }
+  memset(imp->views, 0, sizeof(imp->views));
+  imp->num_views = 0;
+  imp->owned = 0;
+}
+
+static int lod_view_count(void) {
+  int n = g_engine.billboard_directions;
+  if (n < 1)
+    n = 1;
+  if (n > RAY_IMPOSTOR_MAX_VIEWS)
+    n = RAY_IMPOSTOR_MAX_VIEWS;
+  return n;
+}
+
+int ray_model_impostor_bake(void *model, float screen_px, int size) {
+  uint32_t magic = lod_magic(model);
+  if (magic != MD2_MAGIC && magic != MD3_MAGIC)
+    return 0;
+  RAY_ModelLOD *lod = lod_get(model);
+  if (!lod)
+    return 0;
+  RAY_ModelImpostor *imp = &lod->impostor;
+  if (size < 8)
+    size = 8;
+  if (size > 512)
+    size = 512;
+
+  float world_w = 2.0f * imp->axis_radius;
+  float world_h = imp->z_max - imp->z_min;
+  float extent = world_w > world_h ? world_w : world_h;
+  if (extent <= 0.0f)
+    return 0;
+  float ppu = (float)size / extent;
+  int w = (int)ceilf(world_w * ppu), h = (int)ceilf(world_h * ppu);
+  if (w < 1)
+    w = 1;
+  if (h < 1)
+    h = 1;
+
+  float *zbuf = (float *)malloc((size_t)w * h * sizeof(float));
+  float *cols = (float *)malloc((size_t)w * sizeof(float));
+  if (!zbuf || !cols) {
+    free(zbuf);
+    free(cols);
+    return 0;
+  }
+  for (int x = 0; x < w; x++)
+    cols[x] = RAY_INFINITY;
+
+  lod_impostor_release(imp);
+  imp->owned = 1;
+  int n = lod_view_count();
+  LODBakeView view;
+  view.depth = LOD_BAKE_DISTANCE * (imp->axis_radius + world_h) +
+               RAY_RASTER_NEAR;
+  view.ppu = ppu;
+  view.cx = (float)w * 0.5f;
+  view.cy = (float)h * 0.5f;
+  view.z_center = (imp->z_min + imp->z_max) * 0.5f;
+
+  for (int k = 0; k < n; k++) {
+    GRAPH *g = bitmap_new_syslib(w, h);
+    if (!g || !g->surface) {
+      if (g)
+        bitmap_destroy(g);
+      break;
+    }
+    uint32_t *px = (uint32_t *)g->surface->pixels;
+    int pitch = g->surface->pitch >> 2;
+    for (int y = 0; y < h; y++)
+      memset(px + (size_t)y * pitch, 0, (size_t)w * sizeof(uint32_t));
+    for (int i = 0; i < w * h; i++)
+      zbuf[i] = RAY_INFINITY;
+
+    float a = (float)k * 2.0f * (float)M_PI / (float)n;
+    view.cs = cosf(a);
+    view.sn = sinf(a);
+    if (ray_raster_begin_target(g, w, h, zbuf, w, cols)) {
+      if (magic == MD3_MAGIC)
+        lod_bake_md3((RAY_MD3_Model *)model, &view);
+      else
+        lod_bake_md2((RAY_MD2_Model *)model, &view);
+      ray_raster_flush();
+    }
+
+    /* Los billboards solo dibujan alfa > 0 */
+    for (int y = 0; y < h; y++)
+      for (int x = 0; x < w; x++)
+        if (px[(size_t)y * pitch + x])
+          px[(size_t)y * pitch + x] |= 0xFF000000;
+    bitmap_update_surface(g);
+    imp->views[imp->num_views++] = g;
+  }
+  free(zbuf);
+  free(cols);
+
+  if (imp->num_views < n) {
+    lod_impostor_release(imp);
+    lod->impostor_px = 0.0f;
+    return 0;
+  }
+  lod->impostor_px = screen_px;
+  if (g_engine.verbose)
+    printf("RAY: Impostor de %d vistas %dx%d\n", n, w, h);
+  return 1;
+}
+
+int ray_model_impostor_graphs(void *model, float screen_px, int64_t file,
+                              int first_graph) {
+  RAY_ModelLOD *lod = lod_get(model);
+  if (!lod)
+    return 0;
+  int n = lod_view_count();
+  GRAPH *views[RAY_IMPOSTOR_MAX_VIEWS];
+  for (int k = 0; k < n; k++) {
+    views[k] = bitmap_get(file, first_graph + k);
+    if (!views[k] || views[k]->height <= 0)
+      return 0;
+  }
+  lod_impostor_release(&lod->impostor);
+  memcpy(lod->impostor.views, views, n * sizeof(GRAPH *));
+  lod->impostor.num_views = n;
+  lod->impostor_px = screen_px;
+  return 1;
+}
+
+/* ============================================================================
+   SELECTION
+   ============================================================================
+ */
+
+void *ray_model_lod_pick(const RAY_Sprite *sprite, float distance,
+                         RAY_ImpostorDraw *imp) {
+  void *model = sprite->model;
+  if (!s_num_lods)
+    return model;
+  const RAY_ModelLOD *lod = lod_find(model);
+  if (!lod)
+    return model;
+
+  float scale = sprite->model_scale > 0 ? sprite->model_scale : 1.0f;
+  float focal = (float)g_engine.displayWidth * 0.5f;
+  float screen_px =
+      2.0f * lod->radius * scale * focal / (distance > 1.0f ? distance : 1.0f);
+
+  if (lod->impostor.num_views > 0 && screen_px < lod->impostor_px) {
+    const RAY_ModelImpostor *ip = &lod->impostor;
+    /* Angulo de la camara visto desde el modelo, en su espacio local */
+    float a = atan2f(g_engine.camera.y - sprite->y,
+                     g_engine.camera.x - sprite->x) -
+              sprite->rot;
+    float step = 2.0f * (float)M_PI / (float)ip->num_views;
+    int k = (int)floorf(a / step + 0.5f) % ip->num_views;
+    if (k < 0)
+      k += ip->num_views;
+    GRAPH *g = ip->views[k];
+    imp->graph = g;
+    imp->h = (ip->z_max - ip->z_min) * scale;
+    imp->w = imp->h * (float)g->width / (float)g->height;
+    imp->z = sprite->z + (ip->z_min + ip->z_max) * 0.5f * scale;
+    return NULL;
+  }
+  for (int i = 0; i < lod->num_levels; i++)
+    if (screen_px < lod->level_px[i])
+      model = lod->levels[i];
+  return model;
+}
+
+void ray_model_lod_clear(void) {
+  for (int i = 0; i < s_num_lods; i++) {
+    lod_impostor_release(&s_lods[i]->impostor);
+    free(s_lods[i]);
+  }
+  free(s_lods);
+  s_lods = NULL;
+  s_num_lods = s_lods_capacity = 0;
+}
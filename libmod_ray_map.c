@@ -5,10 +5,16 @@
 
 #include "libmod_ray.h"
 #include "libmod_ray_compat.h"
+#ifdef __ANDROID__
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 /* External engine instance */
 extern RAY_Engine g_engine;
@@ -67,6 +73,87 @@ typedef struct {
    ============================================================================
  */
 
+/* Explicitly write header fields to avoid platform-dependent struct padding */
+static void map_write_header_v9(FILE *file, const RAY_MapHeader_v9 *header) {
+  fwrite(header->magic, 8, 1, file);
+  fwrite(&header->version, 4, 1, file);
+  fwrite(&header->num_sectors, 4, 1, file);
+  fwrite(&header->num_portals, 4, 1, file);
+  fwrite(&header->num_sprites, 4, 1, file);
+  fwrite(&header->num_spawn_flags, 4, 1, file);
+  fwrite(&header->camera_x, 4, 1, file);
+  fwrite(&header->camera_y, 4, 1, file);
+  fwrite(&header->camera_z, 4, 1, file);
+  fwrite(&header->camera_rot, 4, 1, file);
+  fwrite(&header->camera_pitch, 4, 1, file);
+  fwrite(&header->skyTextureID, 4, 1, file);
+}
+
+static void map_write_sector_v9(FILE *file, const RAY_Sector *s) {
+  fwrite(&s->sector_id, sizeof(int), 1, file);
+  fwrite(&s->floor_z, sizeof(float), 1, file);
+  fwrite(&s->ceiling_z, sizeof(float), 1, file);
+  fwrite(&s->floor_texture_id, sizeof(int), 1, file);
+  fwrite(&s->ceiling_texture_id, sizeof(int), 1, file);
+  fwrite(&s->light_level, sizeof(int), 1, file);
+
+  /* v24+: Normal maps */
+  fwrite(&s->floor_normal_id, sizeof(int), 1, file);
+  fwrite(&s->ceiling_normal_id, sizeof(int), 1, file);
+
+  /* v22+: Sector flags */
+  fwrite(&s->flags, sizeof(int), 1, file);
+
+  /* v26+: Liquid settings */
+  fwrite(&s->liquid_intensity, sizeof(float), 1, file);
+  fwrite(&s->liquid_speed, sizeof(float), 1, file);
+
+  /* v28+: Fog settings */
+  fwrite(&s->fog_color_r, sizeof(float), 1, file);
+  fwrite(&s->fog_color_g, sizeof(float), 1, file);
+  fwrite(&s->fog_color_b, sizeof(float), 1, file);
+  fwrite(&s->fog_density, sizeof(float), 1, file);
+  fwrite(&s->fog_start, sizeof(float), 1, file);
+  fwrite(&s->fog_end, sizeof(float), 1, file);
+
+  /* Vertices */
+  fwrite(&s->num_vertices, sizeof(int), 1, file);
+  for (int v = 0; v < s->num_vertices; v++) {
+    fwrite(&s->vertices[v].x, sizeof(float), 1, file);
+    fwrite(&s->vertices[v].y, sizeof(float), 1, file);
+  }
+
+  /* Walls */
+  fwrite(&s->num_walls, sizeof(int), 1, file);
+  for (int w = 0; w < s->num_walls; w++) {
+    const RAY_Wall *wall = &s->walls[w];
+    fwrite(&wall->wall_id, sizeof(int), 1, file);
+    fwrite(&wall->x1, sizeof(float), 1, file);
+    fwrite(&wall->y1, sizeof(float), 1, file);
+    fwrite(&wall->x2, sizeof(float), 1, file);
+    fwrite(&wall->y2, sizeof(float), 1, file);
+    fwrite(&wall->texture_id_lower, sizeof(int), 1, file);
+    fwrite(&wall->texture_id_middle, sizeof(int), 1, file);
+    fwrite(&wall->texture_id_upper, sizeof(int), 1, file);
+    fwrite(&wall->texture_split_z_lower, sizeof(float), 1, file);
+    fwrite(&wall->texture_split_z_upper, sizeof(float), 1, file);
+    fwrite(&wall->portal_id, sizeof(int), 1, file);
+    fwrite(&wall->flags, sizeof(int), 1, file);
+
+    /* v24+: Normal maps */
+    fwrite(&wall->texture_id_lower_normal, sizeof(int), 1, file);
+    fwrite(&wall->texture_id_middle_normal, sizeof(int), 1, file);
+    fwrite(&wall->texture_id_upper_normal, sizeof(int), 1, file);
+  }
+
+  /* v9+: Hierarchy fields (parent and children) */
+  fwrite(&s->parent_sector_id, sizeof(int), 1, file);
+  fwrite(&s->num_children, sizeof(int), 1, file);
+  for (int c = 0; c < s->num_children; c++) {
+    fwrite(&s->child_sector_ids[c], sizeof(int), 1, file);
+  }
+}
+
 int ray_save_map_v9(const char *filename) {
   FILE *file = fopen(filename, "wb");
   if (!file) {
@@ -97,87 +184,11 @@ int ray_save_map_v9(const char *filename) {
   header.camera_pitch = g_engine.camera.pitch;
   header.skyTextureID = g_engine.skyTextureID;
 
-  /* Explicitly write header fields to avoid platform-dependent struct padding */
-  fwrite(header.magic, 8, 1, file);
-  fwrite(&header.version, 4, 1, file);
-  fwrite(&header.num_sectors, 4, 1, file);
-  fwrite(&header.num_portals, 4, 1, file);
-  fwrite(&header.num_sprites, 4, 1, file);
-  fwrite(&header.num_spawn_flags, 4, 1, file);
-  fwrite(&header.camera_x, 4, 1, file);
-  fwrite(&header.camera_y, 4, 1, file);
-  fwrite(&header.camera_z, 4, 1, file);
-  fwrite(&header.camera_rot, 4, 1, file);
-  fwrite(&header.camera_pitch, 4, 1, file);
-  fwrite(&header.skyTextureID, 4, 1, file);
+  map_write_header_v9(file, &header);
 
   /* 2. Sectors */
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    RAY_Sector *s = &g_engine.sectors[i];
-
-    fwrite(&s->sector_id, sizeof(int), 1, file);
-    fwrite(&s->floor_z, sizeof(float), 1, file);
-    fwrite(&s->ceiling_z, sizeof(float), 1, file);
-    fwrite(&s->floor_texture_id, sizeof(int), 1, file);
-    fwrite(&s->ceiling_texture_id, sizeof(int), 1, file);
-    fwrite(&s->light_level, sizeof(int), 1, file);
-
-    /* v24+: Normal maps */
-    fwrite(&s->floor_normal_id, sizeof(int), 1, file);
-    fwrite(&s->ceiling_normal_id, sizeof(int), 1, file);
-
-    /* v22+: Sector flags */
-    fwrite(&s->flags, sizeof(int), 1, file);
-
-    /* v26+: Liquid settings */
-    fwrite(&s->liquid_intensity, sizeof(float), 1, file);
-    fwrite(&s->liquid_speed, sizeof(float), 1, file);
-
-    /* v28+: Fog settings */
-    fwrite(&s->fog_color_r, sizeof(float), 1, file);
-    fwrite(&s->fog_color_g, sizeof(float), 1, file);
-    fwrite(&s->fog_color_b, sizeof(float), 1, file);
-    fwrite(&s->fog_density, sizeof(float), 1, file);
-    fwrite(&s->fog_start, sizeof(float), 1, file);
-    fwrite(&s->fog_end, sizeof(float), 1, file);
-
-    /* Vertices */
-    fwrite(&s->num_vertices, sizeof(int), 1, file);
-    for (int v = 0; v < s->num_vertices; v++) {
-      fwrite(&s->vertices[v].x, sizeof(float), 1, file);
-      fwrite(&s->vertices[v].y, sizeof(float), 1, file);
-    }
-
-    /* Walls */
-    fwrite(&s->num_walls, sizeof(int), 1, file);
-    for (int w = 0; w < s->num_walls; w++) {
-      RAY_Wall *wall = &s->walls[w];
-      fwrite(&wall->wall_id, sizeof(int), 1, file);
-      fwrite(&wall->x1, sizeof(float), 1, file);
-      fwrite(&wall->y1, sizeof(float), 1, file);
-      fwrite(&wall->x2, sizeof(float), 1, file);
-      fwrite(&wall->y2, sizeof(float), 1, file);
-      fwrite(&wall->texture_id_lower, sizeof(int), 1, file);
-      fwrite(&wall->texture_id_middle, sizeof(int), 1, file);
-      fwrite(&wall->texture_id_upper, sizeof(int), 1, file);
-      fwrite(&wall->texture_split_z_lower, sizeof(float), 1, file);
-      fwrite(&wall->texture_split_z_upper, sizeof(float), 1, file);
-      fwrite(&wall->portal_id, sizeof(int), 1, file);
-      fwrite(&wall->flags, sizeof(int), 1, file);
-
-      /* v24+: Normal maps */
-      fwrite(&wall->texture_id_lower_normal, sizeof(int), 1, file);
-      fwrite(&wall->texture_id_middle_normal, sizeof(int), 1, file);
-      fwrite(&wall->texture_id_upper_normal, sizeof(int), 1, file);
-    }
-
-    /* v9+: Hierarchy fields (parent and children) */
-    fwrite(&s->parent_sector_id, sizeof(int), 1, file);
-    fwrite(&s->num_children, sizeof(int), 1, file);
-    for (int c = 0; c < s->num_children; c++) {
-      fwrite(&s->child_sector_ids[c], sizeof(int), 1, file);
-    }
-  }
+  for (int i = 0; i < g_engine.num_sectors; i++)
+    map_write_sector_v9(file, &g_engine.sectors[i]);
 
   /* 3. Portals */
   for (int i = 0; i < g_engine.num_portals; i++) {
@@ -222,6 +233,150 @@ int ray_save_map_v9(const char *filename) {
   return 1;
 }
 
+/* ============================================================================
+   STRESS MAP GENERATOR
+   Grid of cols x rows rectangular rooms with stepped floors and ceilings,
+   optionally with a floating box (solid island) in every other room. The
+   file carries no portals or hierarchy: ray_load_map_v9 detects the shared
+   walls and nests the boxes exactly as it does for editor maps, so the
+   benchmark exercises the real load path too.
+   ============================================================================
+ */
+
+#define STRESS_CELL_SIZE 256.0f
+
+static uint32_t stress_rand(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+static void stress_fill_box(RAY_Sector *s, RAY_Point *verts, RAY_Wall *walls,
+                            float x0, float y0, float x1, float y1,
+                            int wall_tex) {
+  const float xs[4] = {x0, x1, x1, x0};
+  const float ys[4] = {y0, y0, y1, y1};
+  for (int v = 0; v < 4; v++) {
+    verts[v].x = xs[v];
+    verts[v].y = ys[v];
+  }
+  s->vertices = verts;
+  s->num_vertices = 4;
+  s->walls = walls;
+  s->num_walls = 4;
+  for (int w = 0; w < 4; w++) {
+    RAY_Wall *wall = &walls[w];
+    memset(wall, 0, sizeof(RAY_Wall));
+    wall->wall_id = w;
+    wall->x1 = verts[w].x;
+    wall->y1 = verts[w].y;
+    wall->x2 = verts[(w + 1) % 4].x;
+    wall->y2 = verts[(w + 1) % 4].y;
+    wall->texture_id_lower = wall_tex;
+    wall->texture_id_middle = wall_tex;
+    wall->texture_id_upper = wall_tex;
+    wall->texture_split_z_lower = 64.0f;
+    wall->texture_split_z_upper = 192.0f;
+    wall->portal_id = -1;
+  }
+}
+
+int ray_generate_stress_map(const char *filename, int cols, int rows,
+                            int boxes, uint32_t seed) {
+  if (!filename || cols < 1 || rows < 1)
+    return 0;
+
+  int num_rooms = cols * rows;
+  int num_boxes = boxes ? (num_rooms + 1) / 2 : 0;
+  if (num_rooms + num_boxes > RAY_MAX_SECTORS) {
+    fprintf(stderr, "RAY: Stress map too big (%d sectors, max %d)\n",
+            num_rooms + num_boxes, RAY_MAX_SECTORS);
+    return 0;
+  }
+
+  FILE *file = fopen(filename, "wb");
+  if (!file) {
+    fprintf(stderr, "RAY: Error creating file %s\n", filename);
+    return 0;
+  }
+
+  /* Cámara en el centro de la primera sala mirando a lo largo de la fila */
+  RAY_MapHeader_v9 header;
+  memcpy(header.magic, "RAYMAP\x1a", 8);
+  header.version = 34;
+  header.num_sectors = num_rooms + num_boxes;
+  header.num_portals = 0;
+  header.num_sprites = 0;
+  header.num_spawn_flags = 0;
+  header.camera_x = STRESS_CELL_SIZE * 0.5f;
+  header.camera_y = STRESS_CELL_SIZE * 0.5f;
+  header.camera_z = 32.0f;
+  header.camera_rot = 0.0f;
+  header.camera_pitch = 0.0f;
+  header.skyTextureID = 0;
+  map_write_header_v9(file, &header);
+
+  RAY_Point verts[4];
+  RAY_Wall walls[4];
+  int next_id = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    /* Misma semilla en ambas pasadas: las cajas repiten las alturas */
+    uint32_t state = seed ? seed : 1u;
+    for (int cy = 0; cy < rows; cy++) {
+      for (int cx = 0; cx < cols; cx++) {
+        int room = cy * cols + cx;
+        float floor_z = (float)(stress_rand(&state) % 4) * 8.0f;
+        float ceil_z =
+            floor_z + 192.0f + (float)(stress_rand(&state) % 3) * 64.0f;
+        int light = 128 + (int)(stress_rand(&state) % 128);
+        if (room == 0)
+          floor_z = 0.0f; /* La cámara arranca a la altura de la cabecera */
+
+        RAY_Sector s;
+        memset(&s, 0, sizeof(s));
+        s.parent_sector_id = -1;
+        s.liquid_intensity = 1.0f;
+        s.liquid_speed = 1.0f;
+        s.fog_color_r = s.fog_color_g = s.fog_color_b = 0.5f;
+        s.fog_start = 100.0f;
+        s.fog_end = 1000.0f;
+        s.light_level = light;
+
+        float x0 = cx * STRESS_CELL_SIZE, y0 = cy * STRESS_CELL_SIZE;
+        if (pass == 0) {
+          s.sector_id = next_id++;
+          s.floor_z = floor_z;
+          s.ceiling_z = ceil_z;
+          s.floor_texture_id = 1 + room % 2;
+          s.ceiling_texture_id = 3;
+          stress_fill_box(&s, verts, walls, x0, y0, x0 + STRESS_CELL_SIZE,
+                          y0 + STRESS_CELL_SIZE, 4 + room % 3);
+          map_write_sector_v9(file, &s);
+        } else if (boxes && room % 2 == 0) {
+          float inset = STRESS_CELL_SIZE * 0.375f;
+          s.sector_id = next_id++;
+          s.floor_z = floor_z + 16.0f;
+          s.ceiling_z = floor_z + 96.0f;
+          s.floor_texture_id = 2;
+          s.ceiling_texture_id = 2;
+          stress_fill_box(&s, verts, walls, x0 + inset, y0 + inset,
+                          x0 + STRESS_CELL_SIZE - inset,
+                          y0 + STRESS_CELL_SIZE - inset, 7);
+          map_write_sector_v9(file, &s);
+        }
+      }
+    }
+  }
+
+  /* Lights are always the last section (v25+): none */
+  uint32_t num_lights = 0;
+  fwrite(&num_lights, sizeof(uint32_t), 1, file);
+
+  fclose(file);
+  printf("RAY: Generated stress map %s (%dx%d rooms, %d boxes)\n", filename,
+         cols, rows, num_boxes);
+  return 1;
+}
+
 /* ============================================================================
    MAP LOADING (V9)
    ============================================================================
@@ -267,9 +422,13 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
         (RAY_Portal *)calloc(header->num_portals, sizeof(RAY_Portal));
     g_engine.portals_capacity = header->num_portals;
   }
-  g_engine.num_sprites = 0;
-  g_engine.sprites = (RAY_Sprite *)calloc(RAY_MAX_SPRITES, sizeof(RAY_Sprite));
-  g_engine.sprites_capacity = RAY_MAX_SPRITES;
+  /* Map sprites take the first slots of a fresh pool with generation 0, so
+     their handles equal their index in the file */
+  ray_sprite_pool_free();
+  if (!ray_sprite_pool_reserve(header->num_sprites > RAY_MAX_SPRITES
+                                   ? (int)header->num_sprites
+                                   : RAY_MAX_SPRITES))
+    return 0;
   g_engine.num_spawn_flags = 0;
   if (header->num_spawn_flags > 0) {
     if (g_engine.spawn_flags)
@@ -346,8 +505,10 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
       s->fog_end = 1000.0f;
     }
 
-    printf("RAY: Loading sector %d: floor_z=%.1f, ceiling_z=%.1f, fog=%.1f\n",
-           s->sector_id, s->floor_z, s->ceiling_z, s->fog_density);
+    if (g_engine.verbose)
+      printf("RAY: Loading sector %d: floor_z=%.1f, ceiling_z=%.1f, "
+             "fog=%.1f\n",
+             s->sector_id, s->floor_z, s->ceiling_z, s->fog_density);
 
     /* Vertices */
     (void)fread(&s->num_vertices, sizeof(int), 1, file);
@@ -359,7 +520,8 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
       (void)fread(&s->vertices[v].x, sizeof(float), 1, file);
       (void)fread(&s->vertices[v].y, sizeof(float), 1, file);
     }
-    printf("RAY:   %d vertices loaded\n", s->num_vertices);
+    if (g_engine.verbose)
+      printf("RAY:   %d vertices loaded\n", s->num_vertices);
 
     /* Walls */
     (void)fread(&s->num_walls, sizeof(int), 1, file);
@@ -393,7 +555,8 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
         wall->texture_id_upper_normal = 0;
       }
     }
-    printf("RAY:   %d walls loaded\n", s->num_walls);
+    if (g_engine.verbose)
+      printf("RAY:   %d walls loaded\n", s->num_walls);
 
     /* v9+: Hierarchy fields (parent and children) */
     if (map_version >= 9) {
@@ -406,8 +569,9 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
           for (int c = 0; c < s->num_children; c++) {
             (void)fread(&s->child_sector_ids[c], sizeof(int), 1, file);
           }
-          printf("RAY:   Sector %d: parent=%d, children=%d\n", s->sector_id,
-                 s->parent_sector_id, s->num_children);
+          if (g_engine.verbose)
+            printf("RAY:   Sector %d: parent=%d, children=%d\n",
+                   s->sector_id, s->parent_sector_id, s->num_children);
         } else {
           s->parent_sector_id = -1;
           s->child_sector_ids = NULL;
@@ -452,6 +616,9 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
   printf("RAY: Loaded %d sectors (expected %d)\n", g_engine.num_sectors,
          header->num_sectors);
 
+  /* 3b. Sector id -> index table (used by portal traversal everywhere) */
+  ray_build_sector_id_lookup(&g_engine);
+
   /* 4. Portals */
   for (int i = 0; i < header->num_portals; i++) {
     RAY_Portal *p = &g_engine.portals[i];
@@ -479,13 +646,7 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
   }
   g_engine.num_portals = header->num_portals;
 
-  /* 5. Sprites */
-  // Clear all previous sprites to prevent ghosts
-  for (int i = 0; i < RAY_MAX_SPRITES; i++) {
-    g_engine.sprites[i].in_use = 0;
-    g_engine.sprites[i].model = NULL;
-    g_engine.sprites[i].cleanup = 0;
-  }
+  /* 5. Sprites (the pool is zeroed above, no ghosts from the last map) */
   for (int i = 0; i < header->num_sprites; i++) {
     RAY_Sprite *s = &g_engine.sprites[i];
 
@@ -521,6 +682,7 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
     s->physics = NULL;
   }
   g_engine.num_sprites = header->num_sprites;
+  ray_sprite_pool_rebuild();
 
   /* 6. Spawn Flags */
   for (int i = 0; i < header->num_spawn_flags; i++) {
@@ -653,10 +815,11 @@ int ray_load_map_v9(FILE *file, RAY_MapHeader_v9 *header) {
               g_engine.lights[i].b = (float)temp_l.b / 255.0f;
               g_engine.lights[i].intensity = temp_l.intensity;
               g_engine.lights[i].falloff = temp_l.falloff;
-              printf("RAY:   Light[%d] pos=(%.1f, %.1f, %.1f) "
-                     "rgb=(%d,%d,%d) intensity=%.1f falloff=%.1f\n",
-                     i, temp_l.x, temp_l.y, temp_l.z, temp_l.r, temp_l.g,
-                     temp_l.b, temp_l.intensity, temp_l.falloff);
+              if (g_engine.verbose)
+                printf("RAY:   Light[%d] pos=(%.1f, %.1f, %.1f) "
+                       "rgb=(%d,%d,%d) intensity=%.1f falloff=%.1f\n",
+                       i, temp_l.x, temp_l.y, temp_l.z, temp_l.r, temp_l.g,
+                       temp_l.b, temp_l.intensity, temp_l.falloff);
             }
           }
           printf("RAY: %d light points loaded from file.\n",
@@ -732,6 +895,464 @@ int ray_load_map(const char *filename) {
   return result;
 }
 
+/* ============================================================================
+   COMPILED MAP CACHE (.raymapc)
+   Sidecar next to the .raymap holding the engine state as it is once
+   loading has finished: sectors with walls split into portals, the
+   rebuilt hierarchy, AABBs, portals, sprites, spawn flags, lights and the
+   baked PVS. Blocks are raw engine structs, so the file is only valid for
+   the build that wrote it; the header records the struct sizes and the
+   source file's size/mtime and any mismatch makes the loader fall back to
+   the .raymap (which then rewrites the cache).
+   ============================================================================
+ */
+
+#define RAY_MAPC_MAGIC "RAYMAPC"
+#define RAY_MAPC_VERSION 2 /* 2: PVS as RLE bitset rows */
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t sizeof_sector, sizeof_wall, sizeof_portal;
+  uint32_t sizeof_sprite, sizeof_spawn_flag, sizeof_light;
+  int64_t source_size;
+  int64_t source_mtime;
+
+  uint32_t num_sectors, num_portals, num_sprites, num_spawn_flags;
+  uint32_t num_lights;
+  uint32_t total_vertices, total_walls, total_portal_ids, total_children;
+  uint32_t pvs_ready; /* Offsets (num_sectors + 1) and RLE rows follow */
+  uint32_t pvs_size;  /* Bytes of RLE rows */
+
+  float camera_x, camera_y, camera_z, camera_rot, camera_pitch;
+  int32_t camera_sector_id;
+  int32_t skyTextureID;
+
+  uint64_t payload_size;
+  uint32_t payload_hash; /* FNV-1a of the payload */
+} RAY_MapCompiledHeader;
+
+static uint32_t mapc_hash(const uint8_t *data, size_t size) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static char *mapc_path(const char *filename) {
+  size_t len = strlen(filename);
+  char *path = (char *)malloc(len + 2);
+  if (!path)
+    return NULL;
+  memcpy(path, filename, len);
+  path[len] = 'c';
+  path[len + 1] = '\0';
+  return path;
+}
+
+static int mapc_source_stamp(const char *filename, int64_t *size,
+                             int64_t *mtime) {
+  struct stat st;
+  if (stat(filename, &st) != 0)
+    return 0;
+  *size = (int64_t)st.st_size;
+  *mtime = (int64_t)st.st_mtime;
+  return 1;
+}
+
+static void mapc_fill_layout(RAY_MapCompiledHeader *h) {
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, RAY_MAPC_MAGIC, 8);
+  h->version = RAY_MAPC_VERSION;
+  h->sizeof_sector = sizeof(RAY_Sector);
+  h->sizeof_wall = sizeof(RAY_Wall);
+  h->sizeof_portal = sizeof(RAY_Portal);
+  h->sizeof_sprite = sizeof(RAY_Sprite);
+  h->sizeof_spawn_flag = sizeof(RAY_SpawnFlag);
+  h->sizeof_light = sizeof(RAY_Light);
+}
+
+/* Carve the next block out of the payload */
+static const uint8_t *mapc_take(const uint8_t **cursor, const uint8_t *end,
+                                size_t bytes) {
+  if ((size_t)(end - *cursor) < bytes)
+    return NULL;
+  const uint8_t *block = *cursor;
+  *cursor += bytes;
+  return block;
+}
+
+int ray_save_map_compiled(const char *filename) {
+  if (!filename || g_engine.num_sectors <= 0)
+    return 0;
+
+  RAY_MapCompiledHeader h;
+  mapc_fill_layout(&h);
+  if (!mapc_source_stamp(filename, &h.source_size, &h.source_mtime))
+    return 0;
+
+  h.num_sectors = g_engine.num_sectors;
+  h.num_portals = g_engine.num_portals;
+  h.num_sprites = g_engine.num_sprites;
+  h.num_spawn_flags = g_engine.num_spawn_flags;
+  h.num_lights = g_engine.num_lights;
+  for (int i = 0; i < g_engine.num_sectors; i++) {
+    RAY_Sector *s = &g_engine.sectors[i];
+    h.total_vertices += s->num_vertices;
+    h.total_walls += s->num_walls;
+    h.total_portal_ids += s->num_portals;
+    h.total_children += s->child_sector_ids ? s->num_children : 0;
+  }
+  h.pvs_ready = (g_engine.pvs_ready && g_engine.pvs_data &&
+                 g_engine.pvs_offsets &&
+                 g_engine.pvs_num_sectors == g_engine.num_sectors);
+  h.pvs_size = h.pvs_ready ? g_engine.pvs_size : 0;
+  size_t pvs_offsets_size =
+      h.pvs_ready ? (size_t)(h.num_sectors + 1) * sizeof(uint32_t) : 0;
+  h.camera_x = g_engine.camera.x;
+  h.camera_y = g_engine.camera.y;
+  h.camera_z = g_engine.camera.z;
+  h.camera_rot = g_engine.camera.rot;
+  h.camera_pitch = g_engine.camera.pitch;
+  h.camera_sector_id = g_engine.camera.current_sector_id;
+  h.skyTextureID = g_engine.skyTextureID;
+
+  size_t payload_size =
+      (size_t)h.num_sectors * sizeof(RAY_Sector) +
+      (size_t)h.total_vertices * sizeof(RAY_Point) +
+      (size_t)h.total_walls * sizeof(RAY_Wall) +
+      (size_t)(h.total_portal_ids + h.total_children) * sizeof(int) +
+      (size_t)h.num_portals * sizeof(RAY_Portal) +
+      (size_t)h.num_sprites * sizeof(RAY_Sprite) +
+      (size_t)h.num_spawn_flags * sizeof(RAY_SpawnFlag) +
+      (size_t)h.num_lights * sizeof(RAY_Light) + pvs_offsets_size +
+      h.pvs_size;
+
+  uint8_t *payload = (uint8_t *)malloc(payload_size ? payload_size : 1);
+  if (!payload)
+    return 0;
+
+  uint8_t *out = payload;
+#define MAPC_PUT(src, bytes)                                                   \
+  do {                                                                         \
+    size_t _n = (bytes);                                                       \
+    if (_n) {                                                                  \
+      memcpy(out, (src), _n);                                                  \
+      out += _n;                                                               \
+    }                                                                          \
+  } while (0)
+
+  MAPC_PUT(g_engine.sectors, h.num_sectors * sizeof(RAY_Sector));
+  for (int i = 0; i < g_engine.num_sectors; i++) {
+    RAY_Sector *s = &g_engine.sectors[i];
+    MAPC_PUT(s->vertices, s->num_vertices * sizeof(RAY_Point));
+    MAPC_PUT(s->walls, s->num_walls * sizeof(RAY_Wall));
+    MAPC_PUT(s->portal_ids, s->num_portals * sizeof(int));
+    if (s->child_sector_ids)
+      MAPC_PUT(s->child_sector_ids, s->num_children * sizeof(int));
+  }
+  MAPC_PUT(g_engine.portals, h.num_portals * sizeof(RAY_Portal));
+  MAPC_PUT(g_engine.sprites, h.num_sprites * sizeof(RAY_Sprite));
+  MAPC_PUT(g_engine.spawn_flags, h.num_spawn_flags * sizeof(RAY_SpawnFlag));
+  MAPC_PUT(g_engine.lights, h.num_lights * sizeof(RAY_Light));
+  MAPC_PUT(g_engine.pvs_offsets, pvs_offsets_size);
+  MAPC_PUT(g_engine.pvs_data, h.pvs_size);
+#undef MAPC_PUT
+
+  h.payload_size = payload_size;
+  h.payload_hash = mapc_hash(payload, payload_size);
+
+  char *path = mapc_path(filename);
+  char *tmp_path = path ? mapc_path(path) : NULL; /* "<map>.raymapcc" */
+  int ok = 0;
+  FILE *file = tmp_path ? fopen(tmp_path, "wb") : NULL;
+  if (file) {
+    ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+         (payload_size == 0 || fwrite(payload, payload_size, 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+    /* Replace atomically so a crash never leaves a half-written cache */
+    if (ok) {
+      remove(path);
+      ok = rename(tmp_path, path) == 0;
+    }
+    if (!ok)
+      remove(tmp_path);
+  }
+
+  if (ok)
+    printf("RAY: Compiled map cache written: %s\n", path);
+  else
+    printf("RAY: Could not write compiled map cache for %s\n", filename);
+
+  free(payload);
+  free(tmp_path);
+  free(path);
+  return ok;
+}
+
+int ray_load_map_compiled(const char *filename) {
+  if (!filename)
+    return 0;
+
+  RAY_MapCompiledHeader expect;
+  mapc_fill_layout(&expect);
+  if (!mapc_source_stamp(filename, &expect.source_size, &expect.source_mtime))
+    return 0;
+
+  char *path = mapc_path(filename);
+  FILE *file = path ? fopen(path, "rb") : NULL;
+  if (!file) {
+    free(path);
+    return 0;
+  }
+
+  RAY_MapCompiledHeader h;
+  if (fread(&h, sizeof(h), 1, file) != 1 ||
+      memcmp(h.magic, expect.magic, 8) != 0 ||
+      h.version != expect.version ||
+      h.sizeof_sector != expect.sizeof_sector ||
+      h.sizeof_wall != expect.sizeof_wall ||
+      h.sizeof_portal != expect.sizeof_portal ||
+      h.sizeof_sprite != expect.sizeof_sprite ||
+      h.sizeof_spawn_flag != expect.sizeof_spawn_flag ||
+      h.sizeof_light != expect.sizeof_light) {
+    printf("RAY: Compiled map cache %s is from another build, rebuilding\n",
+           path);
+    fclose(file);
+    free(path);
+    return 0;
+  }
+  if (h.source_size != expect.source_size ||
+      h.source_mtime != expect.source_mtime) {
+    printf("RAY: %s changed since %s was compiled, rebuilding\n", filename,
+           path);
+    fclose(file);
+    free(path);
+    return 0;
+  }
+  if (h.num_sectors == 0 || h.num_sectors > RAY_MAX_SECTORS ||
+      h.num_sprites > RAY_SPRITE_SLOT_MASK + 1 ||
+      h.num_lights > RAY_MAX_LIGHTS) {
+    fclose(file);
+    free(path);
+    return 0;
+  }
+
+  /* One read for everything; the blocks are then handed to the engine */
+  uint8_t *payload = (uint8_t *)malloc(h.payload_size ? h.payload_size : 1);
+  int ok = payload && (h.payload_size == 0 ||
+                       fread(payload, h.payload_size, 1, file) == 1);
+  fclose(file);
+  if (!ok || mapc_hash(payload, h.payload_size) != h.payload_hash) {
+    printf("RAY: Compiled map cache %s is damaged, rebuilding\n", path);
+    free(payload);
+    free(path);
+    return 0;
+  }
+
+  const uint8_t *cursor = payload;
+  const uint8_t *end = payload + h.payload_size;
+  const RAY_Sector *src_sectors = (const RAY_Sector *)mapc_take(
+      &cursor, end, h.num_sectors * sizeof(RAY_Sector));
+  RAY_Sector *sectors = (RAY_Sector *)calloc(h.num_sectors, sizeof(RAY_Sector));
+  ok = src_sectors && sectors;
+
+  /* Pointer fixup: every per-sector array gets its own allocation (at the
+     recorded capacity) because the editor API grows and frees them
+     individually */
+  int built = 0;
+  for (uint32_t i = 0; ok && i < h.num_sectors; i++, built++) {
+    RAY_Sector *s = &sectors[i];
+    *s = src_sectors[i];
+    s->vertices = NULL;
+    s->walls = NULL;
+    s->portal_ids = NULL;
+    int has_children = (src_sectors[i].child_sector_ids != NULL);
+    s->child_sector_ids = NULL;
+
+    if (s->num_vertices < 0 || s->num_walls < 0 || s->num_portals < 0 ||
+        s->num_children < 0) {
+      ok = 0;
+      break;
+    }
+    if (s->vertices_capacity < s->num_vertices)
+      s->vertices_capacity = s->num_vertices;
+    if (s->walls_capacity < s->num_walls)
+      s->walls_capacity = s->num_walls;
+    if (s->portals_capacity < s->num_portals)
+      s->portals_capacity = s->num_portals;
+
+    const uint8_t *v =
+        mapc_take(&cursor, end, s->num_vertices * sizeof(RAY_Point));
+    const uint8_t *w = mapc_take(&cursor, end, s->num_walls * sizeof(RAY_Wall));
+    const uint8_t *p = mapc_take(&cursor, end, s->num_portals * sizeof(int));
+    s->vertices = (RAY_Point *)calloc(
+        s->vertices_capacity > 0 ? s->vertices_capacity : 1, sizeof(RAY_Point));
+    s->walls = (RAY_Wall *)calloc(s->walls_capacity > 0 ? s->walls_capacity : 1,
+                                  sizeof(RAY_Wall));
+    s->portal_ids = (int *)calloc(
+        s->portals_capacity > 0 ? s->portals_capacity : 1, sizeof(int));
+    if (!v || !w || !p || !s->vertices || !s->walls || !s->portal_ids) {
+      ok = 0;
+      break;
+    }
+    memcpy(s->vertices, v, s->num_vertices * sizeof(RAY_Point));
+    memcpy(s->walls, w, s->num_walls * sizeof(RAY_Wall));
+    memcpy(s->portal_ids, p, s->num_portals * sizeof(int));
+
+    if (has_children) {
+      const uint8_t *c = mapc_take(&cursor, end, s->num_children * sizeof(int));
+      int cap = s->children_capacity > s->num_children ? s->children_capacity
+                                                        : s->num_children;
+      s->child_sector_ids = (int *)malloc((cap > 0 ? cap : 1) * sizeof(int));
+      if (!c || !s->child_sector_ids) {
+        ok = 0;
+        break;
+      }
+      memcpy(s->child_sector_ids, c, s->num_children * sizeof(int));
+      s->children_capacity = cap;
+    } else {
+      s->num_children = 0;
+      s->children_capacity = 0;
+    }
+  }
+
+  const uint8_t *portals =
+      ok ? mapc_take(&cursor, end, h.num_portals * sizeof(RAY_Portal)) : NULL;
+  const uint8_t *sprites =
+      ok ? mapc_take(&cursor, end, h.num_sprites * sizeof(RAY_Sprite)) : NULL;
+  const uint8_t *flags =
+      ok ? mapc_take(&cursor, end, h.num_spawn_flags * sizeof(RAY_SpawnFlag))
+         : NULL;
+  const uint8_t *lights =
+      ok ? mapc_take(&cursor, end, h.num_lights * sizeof(RAY_Light)) : NULL;
+  size_t pvs_offsets_size =
+      h.pvs_ready ? (size_t)(h.num_sectors + 1) * sizeof(uint32_t) : 0;
+  const uint8_t *pvs_offsets =
+      ok ? mapc_take(&cursor, end, pvs_offsets_size) : NULL;
+  const uint8_t *pvs = ok ? mapc_take(&cursor, end, h.pvs_size) : NULL;
+  if (ok && h.pvs_ready && pvs_offsets &&
+      ((const uint32_t *)pvs_offsets)[h.num_sectors] != h.pvs_size)
+    ok = 0;
+
+  int portals_capacity =
+      h.num_portals > RAY_MAX_PORTALS ? (int)h.num_portals : RAY_MAX_PORTALS;
+  RAY_Portal *new_portals =
+      ok ? (RAY_Portal *)calloc(portals_capacity, sizeof(RAY_Portal)) : NULL;
+  int sprites_capacity =
+      h.num_sprites > RAY_MAX_SPRITES ? (int)h.num_sprites : RAY_MAX_SPRITES;
+  RAY_Sprite *new_sprites =
+      ok ? (RAY_Sprite *)calloc(sprites_capacity, sizeof(RAY_Sprite)) : NULL;
+  int *new_active =
+      ok ? (int *)malloc(sprites_capacity * sizeof(int)) : NULL;
+  RAY_SpawnFlag *new_flags =
+      ok ? (RAY_SpawnFlag *)calloc(h.num_spawn_flags ? h.num_spawn_flags : 1,
+                                   sizeof(RAY_SpawnFlag))
+         : NULL;
+  uint8_t *new_pvs =
+      (ok && h.pvs_ready) ? (uint8_t *)malloc(h.pvs_size ? h.pvs_size : 1)
+                          : NULL;
+  uint32_t *new_pvs_offsets =
+      (ok && h.pvs_ready) ? (uint32_t *)malloc(pvs_offsets_size) : NULL;
+
+  if (!ok || !portals || !sprites || !flags || !lights || !pvs_offsets ||
+      !pvs || !new_portals || !new_sprites || !new_active || !new_flags ||
+      (h.pvs_ready && (!new_pvs || !new_pvs_offsets))) {
+    for (int i = 0; sectors && i <= built && i < (int)h.num_sectors; i++) {
+      free(sectors[i].vertices);
+      free(sectors[i].walls);
+      free(sectors[i].portal_ids);
+      free(sectors[i].child_sector_ids);
+    }
+    free(sectors);
+    free(new_portals);
+    free(new_sprites);
+    free(new_active);
+    free(new_flags);
+    free(new_pvs);
+    free(new_pvs_offsets);
+    free(payload);
+    printf("RAY: Compiled map cache %s is inconsistent, rebuilding\n", path);
+    free(path);
+    return 0;
+  }
+
+  /* Commit: from here on the cache replaces the .raymap parse */
+  if (g_engine.sectors)
+    free(g_engine.sectors);
+  g_engine.sectors = sectors;
+  g_engine.num_sectors = h.num_sectors;
+  g_engine.sectors_capacity = h.num_sectors;
+
+  if (g_engine.portals)
+    free(g_engine.portals);
+  g_engine.portals = new_portals;
+  memcpy(g_engine.portals, portals, h.num_portals * sizeof(RAY_Portal));
+  g_engine.num_portals = h.num_portals;
+  g_engine.portals_capacity = portals_capacity;
+
+  ray_sprite_pool_free();
+  g_engine.sprites = new_sprites;
+  g_engine.active_sprites = new_active;
+  g_engine.sprites_capacity = sprites_capacity;
+  memcpy(g_engine.sprites, sprites, h.num_sprites * sizeof(RAY_Sprite));
+  g_engine.num_sprites = h.num_sprites;
+  for (int i = 0; i < g_engine.num_sprites; i++) {
+    /* Runtime links never survive a reload */
+    g_engine.sprites[i].process_ptr = NULL;
+    g_engine.sprites[i].model = NULL;
+    g_engine.sprites[i].model_data = NULL;
+    g_engine.sprites[i].physics = NULL;
+    g_engine.sprites[i].binned = 0;
+    g_engine.sprites[i].generation = 0;
+  }
+  ray_sprite_pool_rebuild();
+
+  if (g_engine.spawn_flags)
+    free(g_engine.spawn_flags);
+  g_engine.spawn_flags = new_flags;
+  memcpy(g_engine.spawn_flags, flags,
+         h.num_spawn_flags * sizeof(RAY_SpawnFlag));
+  g_engine.num_spawn_flags = h.num_spawn_flags;
+  g_engine.spawn_flags_capacity = h.num_spawn_flags;
+  for (int i = 0; i < g_engine.num_spawn_flags; i++) {
+    g_engine.spawn_flags[i].process_ptr = NULL;
+    g_engine.spawn_flags[i].occupied = 0;
+  }
+
+  memcpy(g_engine.lights, lights, h.num_lights * sizeof(RAY_Light));
+  g_engine.num_lights = h.num_lights;
+
+  ray_free_pvs();
+  if (h.pvs_ready) {
+    memcpy(new_pvs, pvs, h.pvs_size);
+    memcpy(new_pvs_offsets, pvs_offsets, pvs_offsets_size);
+    g_engine.pvs_data = new_pvs;
+    g_engine.pvs_offsets = new_pvs_offsets;
+    g_engine.pvs_size = h.pvs_size;
+    g_engine.pvs_num_sectors = h.num_sectors;
+    g_engine.pvs_ready = 1;
+  }
+
+  g_engine.camera.x = h.camera_x;
+  g_engine.camera.y = h.camera_y;
+  g_engine.camera.z = h.camera_z;
+  g_engine.camera.rot = h.camera_rot;
+  g_engine.camera.pitch = h.camera_pitch;
+  g_engine.camera.current_sector_id = h.camera_sector_id;
+  g_engine.skyTextureID = h.skyTextureID;
+
+  ray_build_sector_id_lookup(&g_engine);
+
+  printf("RAY: Loaded compiled map cache %s (%d sectors, %d portals)\n", path,
+         g_engine.num_sectors, g_engine.num_portals);
+  free(payload);
+  free(path);
+  return 1;
+}
+
 /* ============================================================================
    AUTOMATIC HIERARCHY RECONSTRUCTION
    ============================================================================
@@ -957,130 +1578,463 @@ static int split_wall_for_portal(RAY_Sector *sector, int wall_idx,
   }
 }
 
-/* Detect walls shared between ANY two sectors and create portals (Build
- * Engine style) */
-static void ray_detect_all_shared_walls(void) {
-  int portals_created = 0;
+/* ----------------------------------------------------------------------------
+   Shared-wall candidate hash
+   Only axis-aligned walls can match in calculate_wall_overlap, and a split
+   stays on the line of the wall it came from, so two sectors can only end
+   up sharing a portal if some pair of their original axis-aligned walls
+   have (padded) boxes that touch. Those boxes are hashed
+   into a uniform grid and every sector gets the ascending list of later
+   sectors that pass the test. The serial pass then visits only those pairs,
+   in the same i < j order as the full scan, so the portal set is identical.
+   ----------------------------------------------------------------------------
+ */
 
-  printf("RAY: Detecting shared walls between all sectors (Build Engine "
-         "style)...\n");
+#define RAY_SHARED_WALL_EPSILON 2.0f /* Same as calculate_wall_overlap */
+#define RAY_SHARED_WALL_CELL 128.0f
+#define RAY_SHARED_WALL_MAX_CELLS 1024 /* Per axis, cell grows beyond this */
+#define RAY_SHARED_WALL_MAX_THREADS 8
+#define RAY_SHARED_WALL_THREAD_MIN 512 /* Sectors before threading pays */
+
+typedef struct {
+  int sector;
+  float min_x, min_y, max_x, max_y; /* Padded, see wall_hash_build */
+} RAY_WallBox;
 
-  /* Compare all sector pairs */
+typedef struct {
+  int box;
+  int next;
+} RAY_WallCellNode;
+
+typedef struct {
+  RAY_WallBox *boxes;
+  int num_boxes;
+  int *sector_first_box; /* Boxes of sector i: [first[i], first[i + 1]) */
+  int *bucket_head;
+  uint32_t bucket_mask;
+  RAY_WallCellNode *nodes;
+  int num_nodes;
+  int nodes_capacity;
+  float origin_x, origin_y;
+  float inv_cell;
+} RAY_WallHash;
+
+typedef struct {
+  const RAY_WallHash *hash;
+  int begin, end;   /* Sector range handled by this job */
+  int *stamp;       /* Last sector that listed each candidate (+1) */
+  int *count;       /* Candidates per sector, indexed i - begin */
+  int *list;        /* Candidates of the whole range, sector by sector */
+  int list_size, list_capacity;
+  int failed;
+  SDL_Thread *thread;
+} RAY_WallCandidateJob;
+
+static uint32_t wall_hash_cell(int cx, int cy, uint32_t mask) {
+  return (((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u)) & mask;
+}
+
+static void wall_hash_cell_range(const RAY_WallHash *h, const RAY_WallBox *b,
+                                 int *cx0, int *cy0, int *cx1, int *cy1) {
+  *cx0 = (int)floorf((b->min_x - h->origin_x) * h->inv_cell);
+  *cy0 = (int)floorf((b->min_y - h->origin_y) * h->inv_cell);
+  *cx1 = (int)floorf((b->max_x - h->origin_x) * h->inv_cell);
+  *cy1 = (int)floorf((b->max_y - h->origin_y) * h->inv_cell);
+}
+
+static void wall_hash_free(RAY_WallHash *h) {
+  free(h->boxes);
+  free(h->sector_first_box);
+  free(h->bucket_head);
+  free(h->nodes);
+  memset(h, 0, sizeof(*h));
+}
+
+static int wall_hash_build(RAY_WallHash *h) {
+  float eps = RAY_SHARED_WALL_EPSILON;
+  /* Half the epsilon would be exact for the walls as loaded, but when two
+     walls only touch the split can overshoot the original wall by up to
+     the epsilon, so pad enough to cover that on both sides */
+  float pad = eps * 2.0f;
+  int total = 0;
+
+  memset(h, 0, sizeof(*h));
+  for (int i = 0; i < g_engine.num_sectors; i++)
+    total += g_engine.sectors[i].num_walls;
+
+  h->boxes = (RAY_WallBox *)malloc((total > 0 ? total : 1) *
+                                   sizeof(RAY_WallBox));
+  h->sector_first_box =
+      (int *)malloc((g_engine.num_sectors + 1) * sizeof(int));
+  if (!h->boxes || !h->sector_first_box) {
+    wall_hash_free(h);
+    return 0;
+  }
+
+  float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
   for (int i = 0; i < g_engine.num_sectors; i++) {
-    RAY_Sector *sector_a = &g_engine.sectors[i];
+    RAY_Sector *s = &g_engine.sectors[i];
+    h->sector_first_box[i] = h->num_boxes;
+    for (int w = 0; w < s->num_walls; w++) {
+      RAY_Wall *wall = &s->walls[w];
+      if (wall->portal_id != -1)
+        continue;
+      /* Diagonal walls never match, and are never split */
+      if (fabsf(wall->x1 - wall->x2) >= eps &&
+          fabsf(wall->y1 - wall->y2) >= eps)
+        continue;
 
-    printf("RAY: Sector %d has %d walls\n", i, sector_a->num_walls);
-    for (int wa = 0; wa < sector_a->num_walls; wa++) {
-      RAY_Wall *wall_a = &sector_a->walls[wa];
-      printf("RAY:   Wall %d: (%.1f,%.1f) -> (%.1f,%.1f) portal_id=%d\n", wa,
-             wall_a->x1, wall_a->y1, wall_a->x2, wall_a->y2, wall_a->portal_id);
+      RAY_WallBox *b = &h->boxes[h->num_boxes++];
+      b->sector = i;
+      b->min_x = fminf(wall->x1, wall->x2) - pad;
+      b->min_y = fminf(wall->y1, wall->y2) - pad;
+      b->max_x = fmaxf(wall->x1, wall->x2) + pad;
+      b->max_y = fmaxf(wall->y1, wall->y2) + pad;
+      min_x = fminf(min_x, b->min_x);
+      min_y = fminf(min_y, b->min_y);
+      max_x = fmaxf(max_x, b->max_x);
+      max_y = fmaxf(max_y, b->max_y);
     }
+  }
+  h->sector_first_box[g_engine.num_sectors] = h->num_boxes;
+  if (h->num_boxes == 0)
+    return 1;
 
-    for (int j = i + 1; j < g_engine.num_sectors; j++) {
-      RAY_Sector *sector_b = &g_engine.sectors[j];
+  float cell = RAY_SHARED_WALL_CELL;
+  float extent = fmaxf(max_x - min_x, max_y - min_y);
+  if (extent / cell > RAY_SHARED_WALL_MAX_CELLS)
+    cell = extent / RAY_SHARED_WALL_MAX_CELLS;
+  h->origin_x = min_x;
+  h->origin_y = min_y;
+  h->inv_cell = 1.0f / cell;
+
+  uint32_t buckets = 64;
+  while (buckets < (uint32_t)h->num_boxes * 2u)
+    buckets <<= 1;
+  h->bucket_mask = buckets - 1;
+  h->bucket_head = (int *)malloc(buckets * sizeof(int));
+  if (!h->bucket_head) {
+    wall_hash_free(h);
+    return 0;
+  }
+  for (uint32_t k = 0; k < buckets; k++)
+    h->bucket_head[k] = -1;
+
+  for (int e = 0; e < h->num_boxes; e++) {
+    int cx0, cy0, cx1, cy1;
+    wall_hash_cell_range(h, &h->boxes[e], &cx0, &cy0, &cx1, &cy1);
+    for (int cy = cy0; cy <= cy1; cy++) {
+      for (int cx = cx0; cx <= cx1; cx++) {
+        if (h->num_nodes >= h->nodes_capacity) {
+          int cap = h->nodes_capacity ? h->nodes_capacity * 2 : 1024;
+          RAY_WallCellNode *n = (RAY_WallCellNode *)realloc(
+              h->nodes, cap * sizeof(RAY_WallCellNode));
+          if (!n) {
+            wall_hash_free(h);
+            return 0;
+          }
+          h->nodes = n;
+          h->nodes_capacity = cap;
+        }
+        uint32_t k = wall_hash_cell(cx, cy, h->bucket_mask);
+        h->nodes[h->num_nodes].box = e;
+        h->nodes[h->num_nodes].next = h->bucket_head[k];
+        h->bucket_head[k] = h->num_nodes++;
+      }
+    }
+  }
+  return 1;
+}
 
-      /* Compare all walls of sector_a with all walls of sector_b */
-      for (int wa = 0; wa < sector_a->num_walls; wa++) {
-        RAY_Wall *wall_a = &sector_a->walls[wa];
+static int wall_candidate_cmp(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
 
-        /* Skip if already a portal */
-        if (wall_a->portal_id != -1) {
-          continue;
+static void wall_candidates_collect(RAY_WallCandidateJob *job) {
+  const RAY_WallHash *h = job->hash;
+
+  for (int i = job->begin; i < job->end && !job->failed; i++) {
+    int first = job->list_size;
+
+    for (int e = h->sector_first_box[i]; e < h->sector_first_box[i + 1];
+         e++) {
+      const RAY_WallBox *a = &h->boxes[e];
+      int cx0, cy0, cx1, cy1;
+      wall_hash_cell_range(h, a, &cx0, &cy0, &cx1, &cy1);
+
+      for (int cy = cy0; cy <= cy1; cy++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+          uint32_t k = wall_hash_cell(cx, cy, h->bucket_mask);
+          for (int n = h->bucket_head[k]; n != -1; n = h->nodes[n].next) {
+            const RAY_WallBox *b = &h->boxes[h->nodes[n].box];
+            if (b->sector <= i || job->stamp[b->sector] == i + 1)
+              continue;
+            if (a->max_x < b->min_x || b->max_x < a->min_x ||
+                a->max_y < b->min_y || b->max_y < a->min_y)
+              continue;
+
+            if (job->list_size >= job->list_capacity) {
+              int cap = job->list_capacity ? job->list_capacity * 2 : 256;
+              int *l = (int *)realloc(job->list, cap * sizeof(int));
+              if (!l) {
+                job->failed = 1;
+                return;
+              }
+              job->list = l;
+              job->list_capacity = cap;
+            }
+            job->stamp[b->sector] = i + 1;
+            job->list[job->list_size++] = b->sector;
+          }
         }
+      }
+    }
 
-        for (int wb = 0; wb < sector_b->num_walls; wb++) {
-          RAY_Wall *wall_b = &sector_b->walls[wb];
+    job->count[i - job->begin] = job->list_size - first;
+    qsort(job->list + first, job->list_size - first, sizeof(int),
+          wall_candidate_cmp);
+  }
+}
 
-          /* Skip if already a portal */
-          if (wall_b->portal_id != -1) {
-            continue;
-          }
+static int wall_candidates_worker(void *data) {
+  wall_candidates_collect((RAY_WallCandidateJob *)data);
+  return 0;
+}
 
-          /* Calculate overlap region */
-          float overlap_x1, overlap_y1, overlap_x2, overlap_y2;
-          if (calculate_wall_overlap(wall_a, wall_b, &overlap_x1, &overlap_y1,
-                                     &overlap_x2, &overlap_y2)) {
-            /* Check portal capacity */
-            if (g_engine.num_portals >= g_engine.portals_capacity) {
-              printf("RAY: WARNING - Portal capacity reached\n");
-              return;
-            }
+/* Build the candidate CSR: later sectors of sector i are
+   (*out_list)[(*out_start)[i] .. (*out_start)[i + 1]) */
+static int wall_candidates_build(const RAY_WallHash *h, int **out_start,
+                                 int **out_list) {
+  int num_sectors = g_engine.num_sectors;
+  int num_jobs = 1;
+  if (num_sectors >= RAY_SHARED_WALL_THREAD_MIN) {
+    num_jobs = SDL_GetCPUCount();
+    if (num_jobs > RAY_SHARED_WALL_MAX_THREADS)
+      num_jobs = RAY_SHARED_WALL_MAX_THREADS;
+    if (num_jobs < 1)
+      num_jobs = 1;
+  }
 
-            /* Split walls if needed and get portal segment indices */
-            int portal_wall_a_idx = wa;
-            int portal_wall_b_idx = wb;
-
-            split_wall_for_portal(sector_a, wa, overlap_x1, overlap_y1,
-                                  overlap_x2, overlap_y2, &portal_wall_a_idx);
-            split_wall_for_portal(sector_b, wb, overlap_x1, overlap_y1,
-                                  overlap_x2, overlap_y2, &portal_wall_b_idx);
-
-            /* Get the portal segment walls */
-            RAY_Wall *portal_wall_a = &sector_a->walls[portal_wall_a_idx];
-            RAY_Wall *portal_wall_b = &sector_b->walls[portal_wall_b_idx];
-
-            /* Create bidirectional portal */
-            RAY_Portal *new_portal = &g_engine.portals[g_engine.num_portals];
-            memset(new_portal, 0, sizeof(RAY_Portal));
-
-            new_portal->portal_id = g_engine.num_portals;
-            new_portal->sector_a = sector_a->sector_id;
-            new_portal->sector_b = sector_b->sector_id;
-            new_portal->wall_id_a = portal_wall_a_idx;
-            new_portal->wall_id_b = portal_wall_b_idx;
-            new_portal->x1 = overlap_x1;
-            new_portal->y1 = overlap_y1;
-            new_portal->x2 = overlap_x2;
-            new_portal->y2 = overlap_y2;
-
-            /* Assign portal to both wall segments */
-            portal_wall_a->portal_id = new_portal->portal_id;
-            portal_wall_b->portal_id = new_portal->portal_id;
-
-            /* Auto-assign step textures from main wall texture (Build
-             * Engine style) */
-            if (portal_wall_a->texture_id_upper == 0) {
-              portal_wall_a->texture_id_upper =
-                  portal_wall_a->texture_id_middle;
-            }
-            if (portal_wall_a->texture_id_lower == 0) {
-              portal_wall_a->texture_id_lower =
-                  portal_wall_a->texture_id_middle;
-            }
-            if (portal_wall_b->texture_id_upper == 0) {
-              portal_wall_b->texture_id_upper =
-                  portal_wall_b->texture_id_middle;
-            }
-            if (portal_wall_b->texture_id_lower == 0) {
-              portal_wall_b->texture_id_lower =
-                  portal_wall_b->texture_id_middle;
-            }
+  RAY_WallCandidateJob jobs[RAY_SHARED_WALL_MAX_THREADS];
+  memset(jobs, 0, sizeof(jobs));
+  int ok = 1;
+  for (int t = 0; t < num_jobs; t++) {
+    RAY_WallCandidateJob *job = &jobs[t];
+    job->hash = h;
+    job->begin = (int)((int64_t)num_sectors * t / num_jobs);
+    job->end = (int)((int64_t)num_sectors * (t + 1) / num_jobs);
+    job->stamp = (int *)calloc(num_sectors, sizeof(int));
+    job->count = (int *)calloc((job->end - job->begin) + 1, sizeof(int));
+    if (!job->stamp || !job->count)
+      ok = 0;
+  }
 
-            /* Add to both sectors portal lists */
-            if (sector_a->num_portals < sector_a->portals_capacity) {
-              sector_a->portal_ids[sector_a->num_portals++] =
-                  new_portal->portal_id;
-            }
-            if (sector_b->num_portals < sector_b->portals_capacity) {
-              sector_b->portal_ids[sector_b->num_portals++] =
-                  new_portal->portal_id;
-            }
+  if (ok) {
+    /* Job 0 runs here; any thread that does not start runs inline too */
+    for (int t = 1; t < num_jobs; t++)
+      jobs[t].thread =
+          SDL_CreateThread(wall_candidates_worker, "ray_walls", &jobs[t]);
+    wall_candidates_collect(&jobs[0]);
+    for (int t = 1; t < num_jobs; t++) {
+      if (jobs[t].thread)
+        SDL_WaitThread(jobs[t].thread, NULL);
+      else
+        wall_candidates_collect(&jobs[t]);
+    }
+  }
 
-            g_engine.num_portals++;
-            portals_created++;
+  int total = 0;
+  for (int t = 0; t < num_jobs; t++) {
+    ok = ok && !jobs[t].failed;
+    total += jobs[t].list_size;
+  }
 
-            printf("RAY: Created portal %d: Sector %d (wall %d) <-> Sector %d "
-                   "(wall %d)\n",
-                   new_portal->portal_id, sector_a->sector_id, wa,
-                   sector_b->sector_id, wb);
+  int *start = ok ? (int *)malloc((num_sectors + 1) * sizeof(int)) : NULL;
+  int *list = ok ? (int *)malloc((total > 0 ? total : 1) * sizeof(int)) : NULL;
+  if (start && list) {
+    int pos = 0;
+    for (int t = 0; t < num_jobs; t++) {
+      RAY_WallCandidateJob *job = &jobs[t];
+      for (int i = job->begin; i < job->end; i++) {
+        start[i] = pos;
+        pos += job->count[i - job->begin];
+      }
+      if (job->list_size)
+        memcpy(list + start[job->begin], job->list,
+               job->list_size * sizeof(int));
+    }
+    start[num_sectors] = pos;
+  } else {
+    free(start);
+    free(list);
+    start = list = NULL;
+    ok = 0;
+  }
 
-            break; /* Found match for this wall_a */
-          }
+  for (int t = 0; t < num_jobs; t++) {
+    free(jobs[t].stamp);
+    free(jobs[t].count);
+    free(jobs[t].list);
+  }
+
+  *out_start = start;
+  *out_list = list;
+  return ok;
+}
+
+/* Compare every wall of sector_a with every wall of sector_b and create the
+   portals they share. Returns 0 once the portal array is full. */
+static int ray_detect_shared_walls_pair(RAY_Sector *sector_a,
+                                        RAY_Sector *sector_b,
+                                        int *portals_created) {
+  for (int wa = 0; wa < sector_a->num_walls; wa++) {
+    RAY_Wall *wall_a = &sector_a->walls[wa];
+
+    /* Skip if already a portal */
+    if (wall_a->portal_id != -1) {
+      continue;
+    }
+
+    for (int wb = 0; wb < sector_b->num_walls; wb++) {
+      RAY_Wall *wall_b = &sector_b->walls[wb];
+
+      /* Skip if already a portal */
+      if (wall_b->portal_id != -1) {
+        continue;
+      }
+
+      /* Calculate overlap region */
+      float overlap_x1, overlap_y1, overlap_x2, overlap_y2;
+      if (calculate_wall_overlap(wall_a, wall_b, &overlap_x1, &overlap_y1,
+                                 &overlap_x2, &overlap_y2)) {
+        /* Check portal capacity */
+        if (g_engine.num_portals >= g_engine.portals_capacity) {
+          printf("RAY: WARNING - Portal capacity reached\n");
+          return 0;
         }
+
+        /* Split walls if needed and get portal segment indices */
+        int portal_wall_a_idx = wa;
+        int portal_wall_b_idx = wb;
+
+        split_wall_for_portal(sector_a, wa, overlap_x1, overlap_y1,
+                              overlap_x2, overlap_y2, &portal_wall_a_idx);
+        split_wall_for_portal(sector_b, wb, overlap_x1, overlap_y1,
+                              overlap_x2, overlap_y2, &portal_wall_b_idx);
+
+        /* Get the portal segment walls */
+        RAY_Wall *portal_wall_a = &sector_a->walls[portal_wall_a_idx];
+        RAY_Wall *portal_wall_b = &sector_b->walls[portal_wall_b_idx];
+
+        /* Create bidirectional portal */
+        RAY_Portal *new_portal = &g_engine.portals[g_engine.num_portals];
+        memset(new_portal, 0, sizeof(RAY_Portal));
+
+        new_portal->portal_id = g_engine.num_portals;
+        new_portal->sector_a = sector_a->sector_id;
+        new_portal->sector_b = sector_b->sector_id;
+        new_portal->wall_id_a = portal_wall_a_idx;
+        new_portal->wall_id_b = portal_wall_b_idx;
+        new_portal->x1 = overlap_x1;
+        new_portal->y1 = overlap_y1;
+        new_portal->x2 = overlap_x2;
+        new_portal->y2 = overlap_y2;
+
+        /* Assign portal to both wall segments */
+        portal_wall_a->portal_id = new_portal->portal_id;
+        portal_wall_b->portal_id = new_portal->portal_id;
+
+        /* Auto-assign step textures from main wall texture (Build
+         * Engine style) */
+        if (portal_wall_a->texture_id_upper == 0) {
+          portal_wall_a->texture_id_upper = portal_wall_a->texture_id_middle;
+        }
+        if (portal_wall_a->texture_id_lower == 0) {
+          portal_wall_a->texture_id_lower = portal_wall_a->texture_id_middle;
+        }
+        if (portal_wall_b->texture_id_upper == 0) {
+          portal_wall_b->texture_id_upper = portal_wall_b->texture_id_middle;
+        }
+        if (portal_wall_b->texture_id_lower == 0) {
+          portal_wall_b->texture_id_lower = portal_wall_b->texture_id_middle;
+        }
+
+        /* Add to both sectors portal lists */
+        if (sector_a->num_portals < sector_a->portals_capacity) {
+          sector_a->portal_ids[sector_a->num_portals++] =
+              new_portal->portal_id;
+        }
+        if (sector_b->num_portals < sector_b->portals_capacity) {
+          sector_b->portal_ids[sector_b->num_portals++] =
+              new_portal->portal_id;
+        }
+
+        g_engine.num_portals++;
+        (*portals_created)++;
+
+        if (g_engine.verbose)
+          printf("RAY: Created portal %d: Sector %d (wall %d) <-> Sector %d "
+                 "(wall %d)\n",
+                 new_portal->portal_id, sector_a->sector_id, wa,
+                 sector_b->sector_id, wb);
+
+        break; /* Found match for this wall_a */
+      }
+    }
+  }
+  return 1;
+}
+
+/* Detect walls shared between ANY two sectors and create portals (Build
+ * Engine style) */
+static void ray_detect_all_shared_walls(void) {
+  int portals_created = 0;
+
+  printf("RAY: Detecting shared walls between all sectors (Build Engine "
+         "style)...\n");
+
+  if (g_engine.verbose) {
+    for (int i = 0; i < g_engine.num_sectors; i++) {
+      RAY_Sector *sector = &g_engine.sectors[i];
+      printf("RAY: Sector %d has %d walls\n", i, sector->num_walls);
+      for (int w = 0; w < sector->num_walls; w++) {
+        RAY_Wall *wall = &sector->walls[w];
+        printf("RAY:   Wall %d: (%.1f,%.1f) -> (%.1f,%.1f) portal_id=%d\n", w,
+               wall->x1, wall->y1, wall->x2, wall->y2, wall->portal_id);
+      }
+    }
+  }
+
+  /* Candidate pairs from the wall hash; without memory for it fall back
+     to comparing every sector pair */
+  RAY_WallHash hash;
+  int *cand_start = NULL, *cand_list = NULL;
+  int hashed = wall_hash_build(&hash) &&
+               wall_candidates_build(&hash, &cand_start, &cand_list);
+  wall_hash_free(&hash);
+
+  for (int i = 0; i < g_engine.num_sectors; i++) {
+    RAY_Sector *sector_a = &g_engine.sectors[i];
+
+    if (hashed) {
+      for (int c = cand_start[i]; c < cand_start[i + 1]; c++) {
+        if (!ray_detect_shared_walls_pair(sector_a,
+                                          &g_engine.sectors[cand_list[c]],
+                                          &portals_created))
+          goto done;
+      }
+    } else {
+      for (int j = i + 1; j < g_engine.num_sectors; j++) {
+        if (!ray_detect_shared_walls_pair(sector_a, &g_engine.sectors[j],
+                                          &portals_created))
+          goto done;
       }
     }
   }
 
+done:
+  free(cand_start);
+  free(cand_list);
   printf("RAY: Created %d automatic portals\n", portals_created);
 }
 
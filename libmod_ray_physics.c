@@ -10,6 +10,7 @@
 #include "bgddl.h"
 #include "libmod_ray.h"
 #include "libmod_ray_compat.h"
+#include <SDL2/SDL.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,16 +20,17 @@
 #define GRAVITY -980.0f /* cm/s² (9.8 m/s² = 980 cm/s²) */
 #define PHYSICS_EPSILON 0.001f
 #define SLEEP_VELOCITY 0.5f /* Below this, body is considered at rest */
-#define MAX_CONTACTS 256
+#define SLEEP_STEPS 30      /* Resting steps before a body falls asleep */
+#define DEFAULT_MAX_SUBSTEPS 4
+#define MAX_CONTACTS 1024 /* Initial contact buffer (grows on demand) */
 #define COLLISION_SLOP 0.01f  /* Allowed penetration before correction */
 #define BAUMGARTE_FACTOR 0.2f /* Positional correction factor */
+#define PHYSICS_STEP_HEIGHT 10.0f /* Highest ledge a body walks onto */
+#define PHYSICS_SWEEP_SKIN 0.05f  /* Gap kept between a body and a wall */
+#define PHYSICS_SLIDE_ITERATIONS 3
 
 extern RAY_Engine g_engine;
 
-/* External collision function from libmod_ray_raycasting.c */
-extern int ray_check_collision(RAY_Engine *engine, float x, float y, float z,
-                               float new_x, float new_y, float step_h);
-
 /* ============================================================================
    PHYSICS BODY LIFECYCLE
    ============================================================================
@@ -62,6 +64,11 @@ RAY_PhysicsBody *ray_physics_create_body(float mass, float radius,
   return body;
 }
 
+static inline void body_wake(RAY_PhysicsBody *body) {
+  body->is_sleeping = 0;
+  body->sleep_counter = 0;
+}
+
 void ray_physics_destroy_body(RAY_PhysicsBody *body) {
   if (body)
     free(body);
@@ -76,6 +83,7 @@ void ray_physics_apply_force(RAY_PhysicsBody *body, float fx, float fy,
                              float fz) {
   if (!body || body->is_static || body->is_kinematic)
     return;
+  body_wake(body);
   body->ax += fx * body->inv_mass;
   body->ay += fy * body->inv_mass;
   body->az += fz * body->inv_mass;
@@ -85,6 +93,7 @@ void ray_physics_apply_impulse(RAY_PhysicsBody *body, float ix, float iy,
                                float iz) {
   if (!body || body->is_static || body->is_kinematic)
     return;
+  body_wake(body);
   body->vx += ix * body->inv_mass;
   body->vy += iy * body->inv_mass;
   body->vz += iz * body->inv_mass;
@@ -94,6 +103,7 @@ void ray_physics_set_velocity(RAY_PhysicsBody *body, float vx, float vy,
                               float vz) {
   if (!body)
     return;
+  body_wake(body);
   body->vx = vx;
   body->vy = vy;
   body->vz = vz;
@@ -104,12 +114,21 @@ void ray_physics_set_velocity(RAY_PhysicsBody *body, float vx, float vy,
    ============================================================================
  */
 
-/* Find which sector a point (x, y) belongs to.
-   For physics: skip solid sectors (buildings) so cars stay on the street. */
-static int find_sector_at(float px, float py) {
+/* Find which sector a point (x, y) belongs to (returns sector index).
+   For physics: skip solid sectors (buildings) so cars stay on the street.
+   Candidates come from the sector grid; full scan if it isn't built. */
+static int find_sector_index_at(float px, float py) {
+  const int *list;
+  int n = ray_sector_grid_query(&g_engine, px, py, &list);
+  if (n < 0) {
+    list = NULL;
+    n = g_engine.num_sectors;
+  }
+
   int best = -1;
   float min_area = 1e18f;
-  for (int i = 0; i < g_engine.num_sectors; i++) {
+  for (int k = 0; k < n; k++) {
+    int i = list ? list[k] : k;
     RAY_Sector *s = &g_engine.sectors[i];
     if (px < s->min_x || px > s->max_x || py < s->min_y || py > s->max_y)
       continue;
@@ -121,7 +140,7 @@ static int find_sector_at(float px, float py) {
       float area = (s->max_x - s->min_x) * (s->max_y - s->min_y);
       if (area < min_area) {
         min_area = area;
-        best = s->sector_id;
+        best = i;
       }
     }
   }
@@ -130,8 +149,15 @@ static int find_sector_at(float px, float py) {
 
 /* Check if point is inside any solid (building) sector */
 static int is_inside_solid_sector(float px, float py) {
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    RAY_Sector *s = &g_engine.sectors[i];
+  const int *list;
+  int n = ray_sector_grid_query(&g_engine, px, py, &list);
+  if (n < 0) {
+    list = NULL;
+    n = g_engine.num_sectors;
+  }
+
+  for (int k = 0; k < n; k++) {
+    RAY_Sector *s = &g_engine.sectors[list ? list[k] : k];
     if (!ray_sector_is_solid(s))
       continue;
     if (px < s->min_x || px > s->max_x || py < s->min_y || py > s->max_y)
@@ -144,26 +170,18 @@ static int is_inside_solid_sector(float px, float py) {
 
 /* Get floor height at position (x, y) in a given sector */
 static float get_floor_at(float px, float py) {
-  int sid = find_sector_at(px, py);
-  if (sid < 0)
+  int idx = find_sector_index_at(px, py);
+  if (idx < 0)
     return 0.0f;
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    if (g_engine.sectors[i].sector_id == sid)
-      return g_engine.sectors[i].floor_z;
-  }
-  return 0.0f;
+  return g_engine.sectors[idx].floor_z;
 }
 
 /* Get ceiling height at position (x, y) in a given sector */
 static float get_ceiling_at(float px, float py) {
-  int sid = find_sector_at(px, py);
-  if (sid < 0)
+  int idx = find_sector_index_at(px, py);
+  if (idx < 0)
     return 9999.0f;
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    if (g_engine.sectors[i].sector_id == sid)
-      return g_engine.sectors[i].ceiling_z;
-  }
-  return 9999.0f;
+  return g_engine.sectors[idx].ceiling_z;
 }
 
 /* Check wall collision: does moving from (ox,oy) to (nx,ny) cross a wall?
@@ -237,24 +255,68 @@ typedef struct {
   float depth;      /* Penetration depth */
 } PhysicsContact;
 
-static PhysicsContact s_contacts[MAX_CONTACTS];
+static PhysicsContact *s_contacts = NULL;
+static int s_contacts_capacity = 0;
 static int s_num_contacts = 0;
 
+/* Per-step statistics (RAY_PHYSICS_STATS) */
+static int s_stat_bodies = 0;
+static int s_stat_pairs_tested = 0;
+static int s_stat_contacts = 0;
+static int s_stat_sleeping = 0;
+static float s_stat_step_ms = 0.0f;
+static int s_stat_substeps = 0;
+
+/* Fixed timestep mode (0 = legacy variable step) */
+static float s_fixed_dt = 0.0f;
+static int s_max_substeps = DEFAULT_MAX_SUBSTEPS;
+static float s_accumulator = 0.0f;
+static float s_alpha = 1.0f; /* Render interpolation factor [0..1] */
+
+/* Cheap pair rejection, done before any geometry */
+static inline int bodies_may_collide(RAY_PhysicsBody *pa, RAY_PhysicsBody *pb) {
+  /* Pairs without an awake dynamic body never need resolving. A kinematic
+     body still reaches a sleeping one so that a platform or door that
+     moved wakes it (detect_body_collision); static/kinematic pairs are
+     skipped. */
+  int awake_a = !pa->is_static && !pa->is_kinematic && !pa->is_sleeping;
+  int awake_b = !pb->is_static && !pb->is_kinematic && !pb->is_sleeping;
+  if (!awake_a && !awake_b &&
+      !(pa->is_kinematic && pb->is_sleeping) &&
+      !(pb->is_kinematic && pa->is_sleeping))
+    return 0;
+
+  /* Layer check */
+  if (!(pa->collision_layer & pb->collision_mask) &&
+      !(pb->collision_layer & pa->collision_mask))
+    return 0;
+
+  return 1;
+}
+
+static PhysicsContact *alloc_contact(void) {
+  if (s_num_contacts >= s_contacts_capacity) {
+    int new_cap = s_contacts_capacity ? s_contacts_capacity * 2 : MAX_CONTACTS;
+    PhysicsContact *grown = (PhysicsContact *)realloc(
+        s_contacts, new_cap * sizeof(PhysicsContact));
+    if (!grown)
+      return NULL;
+    s_contacts = grown;
+    s_contacts_capacity = new_cap;
+  }
+  return &s_contacts[s_num_contacts++];
+}
+
 /* Detect cylinder-cylinder collision between two sprites */
 static void detect_body_collision(RAY_Sprite *a, RAY_Sprite *b) {
   if (!a->physics || !b->physics)
     return;
   RAY_PhysicsBody *pa = a->physics, *pb = b->physics;
 
-  /* Both static/kinematic → skip */
-  if ((pa->is_static || pa->is_kinematic) &&
-      (pb->is_static || pb->is_kinematic))
+  if (!bodies_may_collide(pa, pb))
     return;
 
-  /* Layer check */
-  if (!(pa->collision_layer & pb->collision_mask) &&
-      !(pb->collision_layer & pa->collision_mask))
-    return;
+  s_stat_pairs_tested++;
 
   /* 2D circle-circle test (XY plane) */
   float dx = b->x - a->x;
@@ -272,11 +334,24 @@ static void detect_body_collision(RAY_Sprite *a, RAY_Sprite *b) {
     return;
 
   /* Contact! */
-  if (s_num_contacts >= MAX_CONTACTS)
+  PhysicsContact *c = alloc_contact();
+  if (!c)
     return;
 
+  /* A moving awake body (or a kinematic one that code moved this step)
+     wakes the sleeper it touches; resting ones and idle platforms don't,
+     so settling piles don't keep waking each other */
+  if (pa->is_sleeping || pb->is_sleeping) {
+    RAY_PhysicsBody *sleeper = pa->is_sleeping ? pa : pb;
+    RAY_PhysicsBody *other = pa->is_sleeping ? pb : pa;
+    float ov2 = other->vx * other->vx + other->vy * other->vy +
+                other->vz * other->vz;
+    if (other->is_kinematic ? other->kin_moved
+                            : ov2 > SLEEP_VELOCITY * SLEEP_VELOCITY)
+      body_wake(sleeper);
+  }
+
   float dist = sqrtf(dist_sq);
-  PhysicsContact *c = &s_contacts[s_num_contacts++];
   c->a = a;
   c->b = b;
   c->depth = min_dist - dist;
@@ -311,7 +386,11 @@ static void resolve_contact(PhysicsContact *c) {
   if (pa->is_trigger || pb->is_trigger)
     return;
 
-  float inv_mass_sum = pa->inv_mass + pb->inv_mass;
+  /* Sleeping bodies act as immovable until something wakes them */
+  int move_a = !pa->is_static && !pa->is_kinematic && !pa->is_sleeping;
+  int move_b = !pb->is_static && !pb->is_kinematic && !pb->is_sleeping;
+  float inv_mass_sum = (pa->is_sleeping ? 0.0f : pa->inv_mass) +
+                       (pb->is_sleeping ? 0.0f : pb->inv_mass);
   if (inv_mass_sum < PHYSICS_EPSILON)
     return;
 
@@ -336,12 +415,12 @@ static void resolve_contact(PhysicsContact *c) {
   float jny = j * c->ny;
   float jnz = j * c->nz;
 
-  if (!pa->is_static && !pa->is_kinematic) {
+  if (move_a) {
     pa->vx -= jnx * pa->inv_mass;
     pa->vy -= jny * pa->inv_mass;
     pa->vz -= jnz * pa->inv_mass;
   }
-  if (!pb->is_static && !pb->is_kinematic) {
+  if (move_b) {
     pb->vx += jnx * pb->inv_mass;
     pb->vy += jny * pb->inv_mass;
     pb->vz += jnz * pb->inv_mass;
@@ -360,12 +439,12 @@ static void resolve_contact(PhysicsContact *c) {
     float jtz = -tan_vz / tan_speed;
     float jt = fminf(fabsf(j) * avg_friction, tan_speed / inv_mass_sum);
 
-    if (!pa->is_static && !pa->is_kinematic) {
+    if (move_a) {
       pa->vx -= jt * jtx * pa->inv_mass;
       pa->vy -= jt * jty * pa->inv_mass;
       pa->vz -= jt * jtz * pa->inv_mass;
     }
-    if (!pb->is_static && !pb->is_kinematic) {
+    if (move_b) {
       pb->vx += jt * jtx * pb->inv_mass;
       pb->vy += jt * jty * pb->inv_mass;
       pb->vz += jt * jtz * pb->inv_mass;
@@ -373,12 +452,12 @@ static void resolve_contact(PhysicsContact *c) {
   }
 
   /* Angular velocity from off-center collision */
-  if (!pa->is_static && !pa->is_kinematic && !pa->lock_rot_z) {
+  if (move_a && !pa->lock_rot_z) {
     float torque = (c->nx * (c->a->y - c->a->y) - c->ny * (c->a->x - c->a->x)) *
                    j * pa->inv_mass * 0.1f;
     pa->ang_vz += torque;
   }
-  if (!pb->is_static && !pb->is_kinematic && !pb->lock_rot_z) {
+  if (move_b && !pb->lock_rot_z) {
     float torque = (c->nx * (c->b->y - c->b->y) - c->ny * (c->b->x - c->b->x)) *
                    j * pb->inv_mass * 0.1f;
     pb->ang_vz -= torque;
@@ -388,12 +467,12 @@ static void resolve_contact(PhysicsContact *c) {
   if (c->depth > COLLISION_SLOP) {
     float correction =
         (c->depth - COLLISION_SLOP) * BAUMGARTE_FACTOR / inv_mass_sum;
-    if (!pa->is_static && !pa->is_kinematic) {
+    if (move_a) {
       c->a->x -= correction * pa->inv_mass * c->nx;
       c->a->y -= correction * pa->inv_mass * c->ny;
       c->a->z -= correction * pa->inv_mass * c->nz;
     }
-    if (!pb->is_static && !pb->is_kinematic) {
+    if (move_b) {
       c->b->x += correction * pb->inv_mass * c->nx;
       c->b->y += correction * pb->inv_mass * c->ny;
       c->b->z += correction * pb->inv_mass * c->nz;
@@ -401,22 +480,183 @@ static void resolve_contact(PhysicsContact *c) {
   }
 }
 
+/* ============================================================================
+   BROAD PHASE (Sweep and prune on X)
+   Bodies are sorted by the left edge of their col_radius interval; only
+   bodies whose X intervals overlap reach detect_body_collision. Contacts are
+   then put back in (a, b) index order so the sequential impulse solver sees
+   the same order as the old all-pairs loop.
+   ============================================================================
+ */
+
+typedef struct {
+  float min_x, max_x;
+  int index; /* Sprite index */
+} PhysicsSweepEntry;
+
+static PhysicsSweepEntry *s_sweep = NULL;
+static int s_sweep_capacity = 0;
+
+static int compare_sweep(const void *pa, const void *pb) {
+  const PhysicsSweepEntry *a = (const PhysicsSweepEntry *)pa;
+  const PhysicsSweepEntry *b = (const PhysicsSweepEntry *)pb;
+  if (a->min_x < b->min_x)
+    return -1;
+  if (a->min_x > b->min_x)
+    return 1;
+  return a->index - b->index;
+}
+
+static int compare_contacts(const void *pa, const void *pb) {
+  const PhysicsContact *a = (const PhysicsContact *)pa;
+  const PhysicsContact *b = (const PhysicsContact *)pb;
+  if (a->a != b->a)
+    return (a->a < b->a) ? -1 : 1;
+  if (a->b != b->b)
+    return (a->b < b->b) ? -1 : 1;
+  return 0;
+}
+
+static void broad_phase_collide(void) {
+  if (g_engine.num_active_sprites > s_sweep_capacity) {
+    PhysicsSweepEntry *grown = (PhysicsSweepEntry *)realloc(
+        s_sweep, g_engine.num_active_sprites * sizeof(PhysicsSweepEntry));
+    if (!grown)
+      return;
+    s_sweep = grown;
+    s_sweep_capacity = g_engine.num_active_sprites;
+  }
+
+  int n = 0;
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
+    RAY_Sprite *s = &g_engine.sprites[i];
+    if (!s->physics)
+      continue;
+    float r = s->physics->col_radius;
+    s_sweep[n].min_x = s->x - r;
+    s_sweep[n].max_x = s->x + r;
+    s_sweep[n].index = i;
+    n++;
+  }
+  s_stat_bodies = n;
+  if (n < 2)
+    return;
+
+  qsort(s_sweep, n, sizeof(PhysicsSweepEntry), compare_sweep);
+
+  for (int i = 0; i < n; i++) {
+    float max_x = s_sweep[i].max_x;
+    RAY_Sprite *si = &g_engine.sprites[s_sweep[i].index];
+    for (int j = i + 1; j < n && s_sweep[j].min_x < max_x; j++) {
+      RAY_Sprite *sj = &g_engine.sprites[s_sweep[j].index];
+      if (!bodies_may_collide(si->physics, sj->physics))
+        continue;
+      /* Lower index is always body A (normal points A → B) */
+      if (s_sweep[i].index < s_sweep[j].index)
+        detect_body_collision(si, sj);
+      else
+        detect_body_collision(sj, si);
+    }
+  }
+
+  if (s_num_contacts > 1)
+    qsort(s_contacts, s_num_contacts, sizeof(PhysicsContact),
+          compare_contacts);
+}
+
+/* ============================================================================
+   SLEEPING
+   ============================================================================
+ */
+
+static void body_fall_asleep(RAY_Sprite *s, RAY_PhysicsBody *p) {
+  p->is_sleeping = 1;
+  p->vx = p->vy = p->vz = 0;
+  p->ang_vx = p->ang_vy = p->ang_vz = 0;
+  p->sleep_x = s->x;
+  p->sleep_y = s->y;
+  p->sleep_z = s->z;
+  p->sleep_sector = find_sector_index_at(s->x, s->y);
+  if (p->sleep_sector >= 0) {
+    p->sleep_floor_z = g_engine.sectors[p->sleep_sector].floor_z;
+    p->sleep_ceiling_z = g_engine.sectors[p->sleep_sector].ceiling_z;
+  }
+}
+
+/* Something changed under a sleeping body: moved by code, velocity set
+   directly, or the floor/ceiling of its sector was changed (doors, lifts) */
+static int body_sleep_disturbed(RAY_Sprite *s, RAY_PhysicsBody *p) {
+  if (s->x != p->sleep_x || s->y != p->sleep_y || s->z != p->sleep_z)
+    return 1;
+  if (p->vx != 0 || p->vy != 0 || p->vz != 0)
+    return 1;
+  if (p->sleep_sector >= g_engine.num_sectors)
+    return 1;
+  if (p->sleep_sector >= 0) {
+    RAY_Sector *sec = &g_engine.sectors[p->sleep_sector];
+    if (sec->floor_z != p->sleep_floor_z ||
+        sec->ceiling_z != p->sleep_ceiling_z)
+      return 1;
+  }
+  return 0;
+}
+
+/* Count resting steps; falls asleep after SLEEP_STEPS in a row */
+static void body_update_sleep(RAY_Sprite *s, RAY_PhysicsBody *p) {
+  float lin2 = p->vx * p->vx + p->vy * p->vy + p->vz * p->vz;
+  float ang2 =
+      p->ang_vx * p->ang_vx + p->ang_vy * p->ang_vy + p->ang_vz * p->ang_vz;
+  if (p->on_ground && lin2 < SLEEP_VELOCITY * SLEEP_VELOCITY &&
+      ang2 < 0.01f * SLEEP_VELOCITY * SLEEP_VELOCITY) {
+    if (++p->sleep_counter >= SLEEP_STEPS)
+      body_fall_asleep(s, p);
+  } else {
+    p->sleep_counter = 0;
+  }
+}
+
 /* ============================================================================
    MAIN PHYSICS STEP
    ============================================================================
  */
 
-void ray_physics_step(float dt) {
-  if (dt <= 0 || dt > 0.1f)
-    dt = 0.016f; /* Clamp to ~60fps */
+/* One simulation step of exactly dt seconds */
+static void physics_substep(float dt) {
+  Uint64 step_start = SDL_GetPerformanceCounter();
+  s_stat_pairs_tested = 0;
+
+  /* --- 0. KINEMATIC MOVERS: did code move them since the last step? --- */
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    RAY_Sprite *s = &g_engine.sprites[g_engine.active_sprites[k]];
+    RAY_PhysicsBody *p = s->physics;
+    if (!p || !p->is_kinematic)
+      continue;
+    p->kin_moved = p->kin_valid &&
+                   (s->x != p->kin_x || s->y != p->kin_y ||
+                    s->z != p->kin_z || s->rot != p->kin_rot);
+    p->kin_x = s->x;
+    p->kin_y = s->y;
+    p->kin_z = s->z;
+    p->kin_rot = s->rot;
+    p->kin_valid = 1;
+  }
 
   /* --- 1. INTEGRATION: Apply gravity + velocity → position --- */
-  for (int i = 0; i < g_engine.num_sprites; i++) {
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
     RAY_Sprite *s = &g_engine.sprites[i];
     RAY_PhysicsBody *p = s->physics;
     if (!p || p->is_static || p->is_kinematic)
       continue;
 
+    /* Sleeping bodies cost one check until disturbed */
+    if (p->is_sleeping) {
+      if (!body_sleep_disturbed(s, p))
+        continue;
+      body_wake(p);
+    }
+
     /* Gravity */
     p->vz += GRAVITY * p->gravity_scale * dt;
 
@@ -464,23 +704,48 @@ void ray_physics_step(float dt) {
       p->vy = p->vy / speed * max_speed;
     }
 
-    /* --- 3. SECTOR WALL COLLISION (uses engine's proven collision system) ---
-     */
-    /* Per-axis collision for wall sliding */
-    float check_z =
-        s->z + 5.0f; /* Check slightly above ground to detect walls */
-
-    /* X-axis movement */
-    if (ray_check_collision(&g_engine, s->x, s->y, check_z, new_x, s->y,
-                            5.0f)) {
-      p->vx = -p->vx * p->restitution; /* Bounce */
-      new_x = s->x;                    /* Block X movement */
-    }
-    /* Y-axis movement */
-    if (ray_check_collision(&g_engine, s->x, s->y, check_z, new_x, new_y,
-                            5.0f)) {
-      p->vy = -p->vy * p->restitution; /* Bounce */
-      new_y = s->y;                    /* Block Y movement */
+    /* --- 3. SECTOR WALL COLLISION (swept circle, slides along walls) --- */
+    float move_x = new_x - s->x;
+    float move_y = new_y - s->y;
+    new_x = s->x;
+    new_y = s->y;
+    for (int it = 0; it < PHYSICS_SLIDE_ITERATIONS; it++) {
+      RAY_SweepHit hit;
+      if (!ray_sweep_circle(&g_engine, new_x, new_y, s->z, p->col_radius,
+                            p->col_height, PHYSICS_STEP_HEIGHT, move_x,
+                            move_y, &hit)) {
+        new_x += move_x;
+        new_y += move_y;
+        break;
+      }
+
+      /* Avanzar hasta el contacto, algo separado de la pared */
+      float move_len = sqrtf(move_x * move_x + move_y * move_y);
+      float t = hit.t - PHYSICS_SWEEP_SKIN / move_len;
+      if (t > 0.0f) {
+        new_x += move_x * t;
+        new_y += move_y * t;
+      } else {
+        t = 0.0f;
+      }
+
+      /* Rebote: solo la componente que va contra la pared */
+      float vn = p->vx * hit.nx + p->vy * hit.ny;
+      if (vn < 0.0f) {
+        p->vx -= (1.0f + p->restitution) * vn * hit.nx;
+        p->vy -= (1.0f + p->restitution) * vn * hit.ny;
+      }
+
+      /* Lo que falta del movimiento se desliza a lo largo de la pared */
+      move_x *= 1.0f - t;
+      move_y *= 1.0f - t;
+      float mn = move_x * hit.nx + move_y * hit.ny;
+      if (mn < 0.0f) {
+        move_x -= mn * hit.nx;
+        move_y -= mn * hit.ny;
+      }
+      if (move_x * move_x + move_y * move_y < PHYSICS_EPSILON)
+        break;
     }
 
     /* --- 3. FLOOR / CEILING COLLISION --- */
@@ -550,20 +815,152 @@ void ray_physics_step(float dt) {
 
   /* --- 4. BROAD PHASE + NARROW PHASE COLLISION DETECTION --- */
   s_num_contacts = 0;
-  for (int i = 0; i < g_engine.num_sprites; i++) {
-    if (!g_engine.sprites[i].physics)
-      continue;
-    for (int j = i + 1; j < g_engine.num_sprites; j++) {
-      if (!g_engine.sprites[j].physics)
-        continue;
-      detect_body_collision(&g_engine.sprites[i], &g_engine.sprites[j]);
-    }
-  }
+  broad_phase_collide();
+  s_stat_contacts = s_num_contacts;
 
   /* --- 5. COLLISION RESPONSE --- */
   for (int i = 0; i < s_num_contacts; i++) {
     resolve_contact(&s_contacts[i]);
   }
+
+  /* --- 6. SLEEP BOOKKEEPING + KEEP SECTOR BINS IN SYNC --- */
+  s_stat_sleeping = 0;
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
+    RAY_PhysicsBody *p = g_engine.sprites[i].physics;
+    if (!p || p->is_static)
+      continue;
+    if (p->is_sleeping) {
+      s_stat_sleeping++;
+      continue;
+    }
+    if (!p->is_kinematic)
+      body_update_sleep(&g_engine.sprites[i], p);
+    ray_sprite_bin_update(i);
+  }
+
+  s_stat_step_ms += (float)((double)(SDL_GetPerformanceCounter() - step_start) *
+                            1000.0 / (double)SDL_GetPerformanceFrequency());
+}
+
+/* ============================================================================
+   TIMESTEP DRIVERS
+   ============================================================================
+ */
+
+/* Remember where each simulated body starts and ends a step */
+static void physics_snapshot(int after_step) {
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
+    RAY_Sprite *s = &g_engine.sprites[i];
+    RAY_PhysicsBody *p = s->physics;
+    if (!p || p->is_static || p->is_kinematic)
+      continue;
+    if (after_step) {
+      p->curr_x = s->x;
+      p->curr_y = s->y;
+      p->curr_z = s->z;
+      p->curr_rot = s->rot;
+      p->interp_valid = 1;
+    } else {
+      p->prev_x = s->x;
+      p->prev_y = s->y;
+      p->prev_z = s->z;
+      p->prev_rot = s->rot;
+    }
+  }
+}
+
+/* Legacy variable step: dt is simulated as-is */
+void ray_physics_step(float dt) {
+  if (dt <= 0 || dt > 0.1f)
+    dt = 0.016f; /* Clamp to ~60fps */
+
+  s_stat_step_ms = 0.0f;
+  physics_substep(dt);
+  s_stat_substeps = 1;
+  s_alpha = 1.0f;
+  RAY_STAT_ADD(RAY_STAT_PHYSICS_MS, s_stat_step_ms);
+}
+
+/* Frame driver: variable step, or fixed steps from an accumulator when
+   RAY_PHYSICS_SET_FIXED_STEP is active. Leftover time becomes the
+   interpolation factor used by ray_physics_begin_render(). */
+void ray_physics_update(float frame_dt) {
+  if (s_fixed_dt <= 0.0f) {
+    ray_physics_step(frame_dt);
+    return;
+  }
+
+  if (frame_dt > 0.0f)
+    s_accumulator += frame_dt;
+
+  s_stat_step_ms = 0.0f;
+  s_stat_substeps = 0;
+  while (s_accumulator >= s_fixed_dt && s_stat_substeps < s_max_substeps) {
+    physics_snapshot(0);
+    physics_substep(s_fixed_dt);
+    physics_snapshot(1);
+    s_accumulator -= s_fixed_dt;
+    s_stat_substeps++;
+  }
+
+  /* Hit the substep cap: drop the backlog instead of spiralling */
+  if (s_accumulator >= s_fixed_dt)
+    s_accumulator = fmodf(s_accumulator, s_fixed_dt);
+
+  s_alpha = s_accumulator / s_fixed_dt;
+  RAY_STAT_ADD(RAY_STAT_PHYSICS_MS, s_stat_step_ms);
+}
+
+/* Show interpolated transforms while a frame is drawn. Bodies moved by
+   code since their last step are left where the code put them. */
+void ray_physics_begin_render(void) {
+  if (s_fixed_dt <= 0.0f)
+    return;
+  float a = s_alpha;
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
+    RAY_Sprite *s = &g_engine.sprites[i];
+    RAY_PhysicsBody *p = s->physics;
+    if (!p || !p->interp_valid || p->is_static || p->is_kinematic)
+      continue;
+    if (s->x != p->curr_x || s->y != p->curr_y || s->z != p->curr_z ||
+        s->rot != p->curr_rot)
+      continue;
+    s->x = p->prev_x + (p->curr_x - p->prev_x) * a;
+    s->y = p->prev_y + (p->curr_y - p->prev_y) * a;
+    s->z = p->prev_z + (p->curr_z - p->prev_z) * a;
+    s->rot = p->prev_rot + (p->curr_rot - p->prev_rot) * a;
+    p->interp_applied = 1;
+  }
+}
+
+void ray_physics_end_render(void) {
+  if (s_fixed_dt <= 0.0f)
+    return;
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
+    RAY_Sprite *s = &g_engine.sprites[i];
+    RAY_PhysicsBody *p = s->physics;
+    if (!p || !p->interp_applied)
+      continue;
+    s->x = p->curr_x;
+    s->y = p->curr_y;
+    s->z = p->curr_z;
+    s->rot = p->curr_rot;
+    p->interp_applied = 0;
+  }
+}
+
+void ray_physics_shutdown(void) {
+  free(s_contacts);
+  s_contacts = NULL;
+  s_contacts_capacity = 0;
+  s_num_contacts = 0;
+  free(s_sweep);
+  s_sweep = NULL;
+  s_sweep_capacity = 0;
 }
 
 /* ============================================================================
@@ -574,8 +971,8 @@ void ray_physics_step(float dt) {
 /* ray_physics_enable(sprite_index, mass, radius, height)
    Enables physics on a sprite. Creates a RAY_PhysicsBody. */
 int64_t libmod_ray_physics_enable(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
 
   RAY_Sprite *s = &g_engine.sprites[idx];
@@ -592,8 +989,8 @@ int64_t libmod_ray_physics_enable(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_mass(sprite_index, mass) */
 int64_t libmod_ray_physics_set_mass(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -605,8 +1002,8 @@ int64_t libmod_ray_physics_set_mass(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_friction(sprite_index, friction) */
 int64_t libmod_ray_physics_set_friction(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -617,8 +1014,8 @@ int64_t libmod_ray_physics_set_friction(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_restitution(sprite_index, restitution) */
 int64_t libmod_ray_physics_set_restitution(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -629,8 +1026,8 @@ int64_t libmod_ray_physics_set_restitution(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_gravity_scale(sprite_index, scale) */
 int64_t libmod_ray_physics_set_gravity_scale(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -641,8 +1038,8 @@ int64_t libmod_ray_physics_set_gravity_scale(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_damping(sprite_index, linear, angular) */
 int64_t libmod_ray_physics_set_damping(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -654,8 +1051,8 @@ int64_t libmod_ray_physics_set_damping(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_static(sprite_index, is_static) */
 int64_t libmod_ray_physics_set_static(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -663,25 +1060,29 @@ int64_t libmod_ray_physics_set_static(INSTANCE *my, int64_t *params) {
   p->is_static = (int)params[1];
   if (p->is_static)
     p->inv_mass = 0;
+  body_wake(p);
   return 0;
 }
 
 /* ray_physics_set_kinematic(sprite_index, is_kinematic) */
 int64_t libmod_ray_physics_set_kinematic(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
     return -1;
   p->is_kinematic = (int)params[1];
+  p->kin_valid = 0; /* Its first step as a mover doesn't count as a move */
+  p->kin_moved = 0;
+  body_wake(p);
   return 0;
 }
 
 /* ray_physics_set_trigger(sprite_index, is_trigger) */
 int64_t libmod_ray_physics_set_trigger(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -692,8 +1093,8 @@ int64_t libmod_ray_physics_set_trigger(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_lock_rotation(sprite_index, lock_x, lock_y, lock_z) */
 int64_t libmod_ray_physics_set_lock_rotation(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -706,8 +1107,8 @@ int64_t libmod_ray_physics_set_lock_rotation(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_set_collision_layer(sprite_index, layer, mask) */
 int64_t libmod_ray_physics_set_collision_layer(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -719,8 +1120,8 @@ int64_t libmod_ray_physics_set_collision_layer(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_apply_force(sprite_index, fx, fy, fz) */
 int64_t libmod_ray_physics_apply_force_bgd(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -734,8 +1135,8 @@ int64_t libmod_ray_physics_apply_force_bgd(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_apply_impulse(sprite_index, ix, iy, iz) */
 int64_t libmod_ray_physics_apply_impulse_bgd(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  int idx = ray_sprite_resolve(params[0]);
+  if (idx < 0)
     return -1;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -749,9 +1150,9 @@ int64_t libmod_ray_physics_apply_impulse_bgd(INSTANCE *my, int64_t *params) {
 
 /* ray_physics_get_velocity(sprite_index) → returns packed vx|vy|vz */
 int64_t libmod_ray_physics_get_velocity(INSTANCE *my, int64_t *params) {
-  int idx = (int)params[0];
+  int idx = ray_sprite_resolve(params[0]);
   int component = (int)params[1]; /* 0=vx, 1=vy, 2=vz */
-  if (idx < 0 || idx >= g_engine.num_sprites)
+  if (idx < 0)
     return 0;
   RAY_PhysicsBody *p = g_engine.sprites[idx].physics;
   if (!p)
@@ -765,6 +1166,61 @@ int64_t libmod_ray_physics_get_velocity(INSTANCE *my, int64_t *params) {
 /* ray_physics_step(dt_ms) — dt in milliseconds */
 int64_t libmod_ray_physics_step_bgd(INSTANCE *my, int64_t *params) {
   float dt = *(float *)&params[0];
-  ray_physics_step(dt / 1000.0f); /* Convert ms to seconds */
+  ray_physics_update(dt / 1000.0f); /* Convert ms to seconds */
   return 0;
 }
+
+/* ray_physics_set_fixed_step(hz, max_substeps) — hz <= 0 restores the
+   variable step. max_substeps <= 0 keeps the default. */
+int64_t libmod_ray_physics_set_fixed_step(INSTANCE *my, int64_t *params) {
+  float hz = *(float *)&params[0];
+  int max_substeps = (int)params[1];
+
+  s_fixed_dt = (hz > 0.0f) ? 1.0f / hz : 0.0f;
+  s_max_substeps = (max_substeps > 0) ? max_substeps : DEFAULT_MAX_SUBSTEPS;
+  s_accumulator = 0.0f;
+  s_alpha = 1.0f;
+
+  /* Restart interpolation from the current positions */
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
+    RAY_PhysicsBody *p = g_engine.sprites[i].physics;
+    if (p)
+      p->interp_valid = 0;
+  }
+  return 1;
+}
+
+/* ray_physics_stats(stat) — last step: 0=bodies, 1=pairs tested (narrow
+   phase), 2=contacts, 3=step time in ms (all substeps), 4=sleeping bodies,
+   5=substeps run, 6=interpolation alpha */
+int64_t libmod_ray_physics_stats(INSTANCE *my, int64_t *params) {
+  int which = (int)params[0];
+  float v = 0.0f;
+  switch (which) {
+  case 0:
+    v = (float)s_stat_bodies;
+    break;
+  case 1:
+    v = (float)s_stat_pairs_tested;
+    break;
+  case 2:
+    v = (float)s_stat_contacts;
+    break;
+  case 3:
+    v = s_stat_step_ms;
+    break;
+  case 4:
+    v = (float)s_stat_sleeping;
+    break;
+  case 5:
+    v = (float)s_stat_substeps;
+    break;
+  case 6:
+    v = s_alpha;
+    break;
+  }
+  int64_t result = 0;
+  *(float *)&result = v;
+  return result;
+}
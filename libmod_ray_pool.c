@@ -0,0 +1,101 @@
+/* ============================================================================
+   libmod_ray_pool.c - Persistent worker thread pools
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_pool.h"
+#include <stdio.h>
+
+extern RAY_Engine g_engine;
+
+static int pool_worker(void *data) {
+  RAY_PoolWorker *w = (RAY_PoolWorker *)data;
+  for (;;) {
+    SDL_SemWait(w->start);
+    if (w->quit)
+      break;
+    w->pool->task(w->pool, w->index);
+    SDL_SemPost(w->done);
+  }
+  return 0;
+}
+
+int ray_pool_thread_setting(int max_threads) {
+  int n = g_engine.render_threads;
+  if (n <= 0)
+    n = SDL_GetCPUCount();
+  if (n > max_threads)
+    n = max_threads;
+  return n < 1 ? 1 : n;
+}
+
+void ray_pool_stop(RAY_WorkerPool *pool) {
+  for (int i = 0; i < pool->num_workers; i++) {
+    RAY_PoolWorker *w = &pool->workers[i];
+    w->quit = 1;
+    SDL_SemPost(w->start);
+    SDL_WaitThread(w->thread, NULL);
+    SDL_DestroySemaphore(w->start);
+    SDL_DestroySemaphore(w->done);
+    w->thread = NULL;
+    w->start = w->done = NULL;
+    w->quit = 0;
+  }
+  pool->num_workers = 0;
+  pool->requested = 0;
+}
+
+int ray_pool_reserve(RAY_WorkerPool *pool, int wanted) {
+  if (wanted > RAY_POOL_MAX_WORKERS)
+    wanted = RAY_POOL_MAX_WORKERS;
+  if (wanted < 0)
+    wanted = 0;
+  /* Same request as last time: keep the pool, even a partial one */
+  if (wanted == pool->requested)
+    return pool->num_workers;
+
+  ray_pool_stop(pool);
+  pool->requested = wanted;
+  for (int i = 0; i < wanted; i++) {
+    RAY_PoolWorker *w = &pool->workers[i];
+    w->quit = 0;
+    w->index = i + 1;
+    w->pool = pool;
+    w->thread = NULL;
+    w->start = SDL_CreateSemaphore(0);
+    w->done = SDL_CreateSemaphore(0);
+    if (w->start && w->done)
+      w->thread =
+          pool->stack_size
+              ? SDL_CreateThreadWithStackSize(pool_worker, pool->name,
+                                              pool->stack_size, w)
+              : SDL_CreateThread(pool_worker, pool->name, w);
+    if (!w->thread) {
+      fprintf(stderr, "RAY: Could not start %s thread %d: %s\n", pool->name,
+              i + 1, SDL_GetError());
+      if (w->start)
+        SDL_DestroySemaphore(w->start);
+      if (w->done)
+        SDL_DestroySemaphore(w->done);
+      w->start = w->done = NULL;
+      break;
+    }
+    pool->num_workers = i + 1;
+  }
+  return pool->num_workers;
+}
+
+int ray_pool_dispatch(RAY_WorkerPool *pool, int count) {
+  if (count > pool->num_workers)
+    count = pool->num_workers;
+  for (int i = 0; i < count; i++)
+    SDL_SemPost(pool->workers[i].start);
+  return count > 0 ? count : 0;
+}
+
+void ray_pool_wait(RAY_WorkerPool *pool, int count) {
+  for (int i = 0; i < count && i < pool->num_workers; i++)
+    SDL_SemWait(pool->workers[i].done);
+}
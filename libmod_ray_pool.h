@@ -0,0 +1,71 @@
+#ifndef LIBMOD_RAY_POOL_H
+#define LIBMOD_RAY_POOL_H
+
+/* ============================================================================
+   libmod_ray_pool.h - Persistent worker thread pools
+   ============================================================================
+   Shared by the column bands of the software renderer, the model
+   rasterizer and the line traces. Workers sleep on a semaphore between
+   jobs; the calling thread always works as well, so a pool of N workers
+   gives N + 1 threads. A pool is only rebuilt when the number of workers
+   asked for changes, never because some of them failed to start: it keeps
+   whatever it reached and callers use that (or work alone).
+   ============================================================================
+ */
+
+#ifdef __ANDROID__
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RAY_POOL_MAX_WORKERS 16
+
+struct RAY_WorkerPool;
+
+/* Runs on worker `index` (1..num_workers); the caller is index 0 */
+typedef void (*RAY_PoolTask)(struct RAY_WorkerPool *pool, int index);
+
+typedef struct {
+  SDL_Thread *thread;
+  SDL_sem *start;
+  SDL_sem *done;
+  volatile int quit;
+  int index;
+  struct RAY_WorkerPool *pool;
+} RAY_PoolWorker;
+
+typedef struct RAY_WorkerPool {
+  const char *name;  /* Thread name */
+  size_t stack_size; /* 0 = SDL default */
+  RAY_PoolTask task;
+  int requested;   /* Workers asked for by the last ray_pool_reserve */
+  int num_workers; /* Workers actually running (<= requested) */
+  RAY_PoolWorker workers[RAY_POOL_MAX_WORKERS];
+} RAY_WorkerPool;
+
+#define RAY_POOL_INIT(name, stack, task) {name, stack, task, 0, 0, {{0}}}
+
+/* Threads to use from g_engine.render_threads (0 = CPU count), 1..max */
+int ray_pool_thread_setting(int max_threads);
+
+/* Makes `wanted` workers available; returns how many really are */
+int ray_pool_reserve(RAY_WorkerPool *pool, int wanted);
+
+/* Wakes the first `count` workers, clamped to the pool, and returns how
+   many were woken; ray_pool_wait must get the same number */
+int ray_pool_dispatch(RAY_WorkerPool *pool, int count);
+void ray_pool_wait(RAY_WorkerPool *pool, int count);
+
+void ray_pool_stop(RAY_WorkerPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBMOD_RAY_POOL_H
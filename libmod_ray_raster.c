@@ -0,0 +1,549 @@
+/* ============================================================================
+   libmod_ray_raster.c - Software model rasterizer (MD2 / MD3)
+   ============================================================================
+   The model renderers transform and project their vertices on the main
+   thread and queue triangles here. ray_raster_flush() bins the queue into
+   screen tiles and fills each tile with edge functions, four pixels per
+   step (SSE2 when the compiler provides it). Tiles never share pixels, so
+   they are spread over worker threads without locks and the image does
+   not depend on the thread count. Depth test as the old scanline code:
+   z-buffer plus the nearest solid wall of each column (g_wall_col_depth).
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_compat.h"
+#include "libmod_ray_pool.h"
+#ifdef __ANDROID__
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAY_RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+extern RAY_Engine g_engine;
+extern float g_wall_col_depth[];
+
+#define RASTER_TILE 32              /* Lado del tile en pixels */
+#define RASTER_MAX_THREADS 16
+#define RASTER_MIN_PARALLEL_TRIS 64 /* Lotes menores: solo hilo principal */
+
+typedef struct {
+  float ea[3], eb[3], ec[3]; /* Arista i: ea*x + eb*y + ec >= 0 dentro */
+  int tl[3];                 /* Arista top-left: los empates son dentro */
+  float iz[3], uz[3], vz[3]; /* Planos a*x + b*y + c de 1/z, u/z, v/z */
+  int x0, y0, x1, y1;        /* Pixels [x0,x1) x [y0,y1), ya recortados */
+  const RAY_MipLevel *lv;    /* NULL: textura sin mips o color plano */
+  GRAPH *graph;
+} RasterTri;
+
+/* Lote del frame (solo hilo principal hasta el flush) */
+static GRAPH *s_dest = NULL;
+static uint32_t *s_pixels = NULL; /* NULL: dest sin superficie, gr_put_pixel */
+static int s_pitch = 0;           /* En pixels */
+static int s_width = 0, s_height = 0;
+static float *s_zbuffer = NULL; /* s_zpitch floats por fila */
+static int s_zpitch = 0;
+static const float *s_col_depth = NULL; /* Pared mas cercana por columna */
+static RasterTri *s_tris = NULL;
+static int s_num_tris = 0, s_tris_capacity = 0;
+
+/* Superficie activa de ray_raster_surface */
+static GRAPH *s_tex = NULL;
+static const RAY_MipChain *s_mip = NULL;
+static int s_cull = RAY_CULL_NONE;
+
+/* Vertices proyectados del modelo en curso */
+static RAY_RasterVert *s_verts = NULL;
+static int s_verts_capacity = 0;
+
+/* Tiles: lista de triangulos por tile en formato CSR */
+static int s_tiles_x = 0;
+static int *s_tile_start = NULL, *s_tile_cursor = NULL;
+static int s_tile_start_capacity = 0, s_tile_cursor_capacity = 0;
+static int *s_tile_list = NULL; /* Tiles con algun triangulo */
+static int s_tile_list_capacity = 0;
+static int *s_tile_tris = NULL;
+static int s_tile_tris_capacity = 0;
+static int s_num_busy_tiles = 0;
+static SDL_atomic_t s_next_tile;
+
+static int raster_reserve(void **buf, int *capacity, int count, size_t size) {
+  if (count <= *capacity)
+    return 1;
+  int n = *capacity ? *capacity : 256;
+  while (n < count)
+    n *= 2;
+  void *p = realloc(*buf, (size_t)n * size);
+  if (!p)
+    return 0;
+  *buf = p;
+  *capacity = n;
+  return 1;
+}
+
+/* ============================================================================
+   QUEUE
+   ============================================================================
+ */
+
+int ray_raster_begin(GRAPH *dest) {
+  if (!dest)
+    return 0;
+  int w = dest->width < g_engine.displayWidth ? (int)dest->width
+                                              : g_engine.displayWidth;
+  int h = dest->height < g_engine.displayHeight ? (int)dest->height
+                                                : g_engine.displayHeight;
+  return ray_raster_begin_target(dest, w, h, g_zbuffer, g_engine.displayWidth,
+                                 g_wall_col_depth);
+}
+
+int ray_raster_begin_target(GRAPH *dest, int width, int height,
+                            float *zbuffer, int zpitch,
+                            const float *col_depth) {
+  if (s_dest || !dest || !zbuffer || !col_depth)
+    return 0;
+  s_dest = dest;
+  s_width = width;
+  s_height = height;
+  s_zbuffer = zbuffer;
+  s_zpitch = zpitch;
+  s_col_depth = col_depth;
+  s_pixels = dest->surface ? (uint32_t *)dest->surface->pixels : NULL;
+  s_pitch = dest->surface ? dest->surface->pitch >> 2 : 0;
+  s_num_tris = 0;
+  return 1;
+}
+
+RAY_RasterVert *ray_raster_vertices(int count) {
+  if (!raster_reserve((void **)&s_verts, &s_verts_capacity, count,
+                      sizeof(RAY_RasterVert)))
+    return NULL;
+  return s_verts;
+}
+
+void ray_raster_surface(int texture_id, int cull_mode) {
+  s_tex = NULL;
+  s_mip = NULL;
+  s_cull = cull_mode;
+  if (texture_id <= 0)
+    return;
+  int64_t file = 0;
+  s_tex = bitmap_get(0, texture_id);
+  if (!s_tex) {
+    file = g_engine.fpg_id;
+    s_tex = bitmap_get(file, texture_id);
+  }
+  if (s_tex)
+    s_mip = ray_mip_get(file, s_tex);
+}
+
+int ray_raster_sphere_visible(float dx, float dy, float dz, float radius) {
+  float cs = cosf(g_engine.camera.rot), sn = sinf(g_engine.camera.rot);
+  float tz = dx * cs + dy * sn;
+  float tx = -dx * sn + dy * cs;
+  if (tz + radius < RAY_RASTER_NEAR)
+    return 0;
+
+  /* Caja de la esfera en pantalla: cada borde dividido por la profundidad
+     que lo aleja mas del centro, asi la caja siempre la contiene */
+  int iw = g_engine.displayWidth, ih = g_engine.displayHeight;
+  float focal = (float)iw * 0.5f;
+  float hx = (float)iw * 0.5f;
+  float hy = (float)ih * 0.5f + g_engine.camera.pitch;
+  float z_near = tz - radius > RAY_RASTER_NEAR ? tz - radius : RAY_RASTER_NEAR;
+  float z_far = tz + radius;
+  float l = tx - radius, r = tx + radius;
+  float top = dz + radius, bot = dz - radius;
+  float sx0 = hx + l * focal / (l < 0 ? z_near : z_far);
+  float sx1 = hx + r * focal / (r > 0 ? z_near : z_far);
+  float sy0 = hy - top * focal / (top > 0 ? z_near : z_far);
+  float sy1 = hy - bot * focal / (bot < 0 ? z_near : z_far);
+  if (sx1 < 0 || sx0 >= (float)iw || sy1 < 0 || sy0 >= (float)ih)
+    return 0;
+
+  /* Oculto si cada columna tiene una pared solida delante de la esfera */
+  int c0 = sx0 < 0 ? 0 : (int)sx0;
+  int c1 = sx1 >= (float)iw ? iw - 1 : (int)sx1;
+  for (int c = c0; c <= c1; c++)
+    if (g_wall_col_depth[c] >= z_near)
+      return 1;
+  return 0;
+}
+
+/* Plano a*x + b*y + c que vale f0, f1, f2 en los tres vertices */
+static void raster_plane(float *p, const RAY_RasterVert *const *v,
+                         float inv_area, float f0, float f1, float f2) {
+  float x10 = v[1]->x - v[0]->x, y10 = v[1]->y - v[0]->y;
+  float x20 = v[2]->x - v[0]->x, y20 = v[2]->y - v[0]->y;
+  p[0] = ((f1 - f0) * y20 - (f2 - f0) * y10) * inv_area;
+  p[1] = ((f2 - f0) * x10 - (f1 - f0) * x20) * inv_area;
+  p[2] = f0 - p[0] * v[0]->x - p[1] * v[0]->y;
+}
+
+void ray_raster_triangle(const RAY_RasterVert *a, const RAY_RasterVert *b,
+                         const RAY_RasterVert *c, float ua, float va,
+                         float ub, float vb, float uc, float vc) {
+  if (!s_dest || a->z < RAY_RASTER_NEAR || b->z < RAY_RASTER_NEAR ||
+      c->z < RAY_RASTER_NEAR)
+    return;
+  float area = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+  if (s_cull == RAY_CULL_BACK && area <= 0)
+    return;
+  if (s_cull == RAY_CULL_FRONT && area >= 0)
+    return;
+  if (fabsf(area) < 1e-6f)
+    return;
+
+  /* Orden con area positiva: dentro = las tres aristas >= 0 */
+  const RAY_RasterVert *v[3] = {a, b, c};
+  float tu[3] = {ua, ub, uc}, tv[3] = {va, vb, vc};
+  if (area < 0) {
+    v[1] = c;
+    v[2] = b;
+    tu[1] = uc;
+    tu[2] = ub;
+    tv[1] = vc;
+    tv[2] = vb;
+    area = -area;
+  }
+
+  /* Pixels cuyo centro (x + 0.5, y + 0.5) cae en la caja del triangulo */
+  float min_x = fminf(v[0]->x, fminf(v[1]->x, v[2]->x));
+  float max_x = fmaxf(v[0]->x, fmaxf(v[1]->x, v[2]->x));
+  float min_y = fminf(v[0]->y, fminf(v[1]->y, v[2]->y));
+  float max_y = fmaxf(v[0]->y, fmaxf(v[1]->y, v[2]->y));
+  if (max_x < 0 || max_y < 0 || min_x >= (float)s_width ||
+      min_y >= (float)s_height)
+    return;
+  int x0 = (int)ceilf(min_x - 0.5f), x1 = (int)floorf(max_x - 0.5f) + 1;
+  int y0 = (int)ceilf(min_y - 0.5f), y1 = (int)floorf(max_y - 0.5f) + 1;
+  if (x0 < 0)
+    x0 = 0;
+  if (y0 < 0)
+    y0 = 0;
+  if (x1 > s_width)
+    x1 = s_width;
+  if (y1 > s_height)
+    y1 = s_height;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  if (!raster_reserve((void **)&s_tris, &s_tris_capacity, s_num_tris + 1,
+                      sizeof(RasterTri)))
+    return;
+  RasterTri *t = &s_tris[s_num_tris++];
+
+  /* Each edge is evaluated from its lower endpoint, so the neighbour that
+     shares it gets exactly the negated function and no pixel on the
+     edge is drawn twice or missed */
+  for (int i = 0; i < 3; i++) {
+    const RAY_RasterVert *p = v[i], *q = v[(i + 1) % 3];
+    int flip = q->y < p->y || (q->y == p->y && q->x < p->x);
+    if (flip) {
+      const RAY_RasterVert *tmp = p;
+      p = q;
+      q = tmp;
+    }
+    float dx = q->x - p->x, dy = q->y - p->y;
+    float sign = flip ? -1.0f : 1.0f;
+    t->ea[i] = -dy * sign;
+    t->eb[i] = dx * sign;
+    t->ec[i] = (dy * p->x - dx * p->y) * sign;
+    t->tl[i] = flip ? (dy > 0 || (dy == 0 && dx < 0))
+                    : (dy < 0 || (dy == 0 && dx > 0));
+  }
+  float inv_area = 1.0f / area;
+  float iz0 = 1.0f / v[0]->z, iz1 = 1.0f / v[1]->z, iz2 = 1.0f / v[2]->z;
+  raster_plane(t->iz, v, inv_area, iz0, iz1, iz2);
+  raster_plane(t->uz, v, inv_area, tu[0] * iz0, tu[1] * iz1, tu[2] * iz2);
+  raster_plane(t->vz, v, inv_area, tv[0] * iz0, tv[1] * iz1, tv[2] * iz2);
+  t->x0 = x0;
+  t->y0 = y0;
+  t->x1 = x1;
+  t->y1 = y1;
+
+  /* Mip por triangulo: texels por pixel segun la relacion de areas */
+  t->graph = s_tex;
+  t->lv = NULL;
+  if (s_mip) {
+    float uv_area = fabsf((tu[1] - tu[0]) * (tv[2] - tv[0]) -
+                          (tv[1] - tv[0]) * (tu[2] - tu[0])) *
+                    (float)s_tex->width * (float)s_tex->height;
+    t->lv = ray_mip_select(s_mip, sqrtf(uv_area * inv_area));
+  }
+  RAY_STAT_ADD(RAY_STAT_TRIANGLES, 1);
+}
+
+/* ============================================================================
+   TILE RASTERIZER
+   ============================================================================
+ */
+
+/* Profundidad y UV de los pixels x..x+3 de la fila; bit l = pixel x+l
+   dentro del triangulo y delante del z-buffer y de la pared de su columna */
+static int raster_quad(const RasterTri *t, int x, int x1, const float *row,
+                       const float *zrow, float *z, float *u, float *v) {
+  int lanes = x1 - x >= 4 ? 0xF : (1 << (x1 - x)) - 1;
+#ifdef RAY_RASTER_SSE2
+  __m128 px = _mm_add_ps(_mm_set1_ps((float)x + 0.5f),
+                         _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+  __m128 zero = _mm_setzero_ps();
+  __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  for (int i = 0; i < 3; i++) {
+    __m128 e =
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->ea[i]), px), _mm_set1_ps(row[i]));
+    __m128 ei = _mm_cmpgt_ps(e, zero);
+    if (t->tl[i])
+      ei = _mm_or_ps(ei, _mm_cmpeq_ps(e, zero));
+    in = _mm_and_ps(in, ei);
+  }
+  int mask = _mm_movemask_ps(in) & lanes;
+  if (!mask)
+    return 0;
+  __m128 iz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->iz[0]), px),
+                         _mm_set1_ps(row[3]));
+  __m128 zz = _mm_div_ps(_mm_set1_ps(1.0f),
+                         _mm_max_ps(iz, _mm_set1_ps(0.000001f)));
+  __m128 zb, wall;
+  if (lanes == 0xF) {
+    zb = _mm_loadu_ps(zrow + x);
+    wall = _mm_loadu_ps(s_col_depth + x);
+  } else {
+    float zt[4], wt[4];
+    for (int l = 0; l < 4; l++) {
+      zt[l] = (lanes >> l) & 1 ? zrow[x + l] : 0.0f;
+      wt[l] = (lanes >> l) & 1 ? s_col_depth[x + l] : 0.0f;
+    }
+    zb = _mm_loadu_ps(zt);
+    wall = _mm_loadu_ps(wt);
+  }
+  __m128 pass =
+      _mm_and_ps(_mm_cmplt_ps(zz, _mm_sub_ps(zb, _mm_set1_ps(0.1f))),
+                 _mm_cmplt_ps(zz, wall));
+  mask &= _mm_movemask_ps(pass);
+  if (!mask)
+    return 0;
+  __m128 uz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->uz[0]), px),
+                         _mm_set1_ps(row[4]));
+  __m128 vz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->vz[0]), px),
+                         _mm_set1_ps(row[5]));
+  _mm_storeu_ps(z, zz);
+  _mm_storeu_ps(u, _mm_mul_ps(uz, zz));
+  _mm_storeu_ps(v, _mm_mul_ps(vz, zz));
+  return mask;
+#else
+  int mask = 0;
+  for (int l = 0; l < 4; l++) {
+    if (!((lanes >> l) & 1))
+      continue;
+    float px = (float)(x + l) + 0.5f;
+    int in = 1;
+    for (int i = 0; i < 3 && in; i++) {
+      float e = t->ea[i] * px + row[i];
+      in = e > 0 || (e == 0 && t->tl[i]);
+    }
+    if (!in)
+      continue;
+    float iz = t->iz[0] * px + row[3];
+    float zz = 1.0f / (iz > 0.000001f ? iz : 0.000001f);
+    if (zz >= zrow[x + l] - 0.1f || zz >= s_col_depth[x + l])
+      continue;
+    z[l] = zz;
+    u[l] = (t->uz[0] * px + row[4]) * zz;
+    v[l] = (t->vz[0] * px + row[5]) * zz;
+    mask |= 1 << l;
+  }
+  return mask;
+#endif
+}
+
+static inline uint32_t raster_texel(const RasterTri *t, float u, float v) {
+  if (!t->graph)
+    return 0xAA00AA;
+  u -= floorf(u);
+  v -= floorf(v);
+  int tw = t->lv ? t->lv->width : (int)t->graph->width;
+  int th = t->lv ? t->lv->height : (int)t->graph->height;
+  int tx = (int)(u * (float)tw);
+  int ty = (int)(v * (float)th);
+  if (tx < 0)
+    tx = 0;
+  if (tx >= tw)
+    tx = tw - 1;
+  if (ty < 0)
+    ty = 0;
+  if (ty >= th)
+    ty = th - 1;
+  return t->lv ? t->lv->pixels[ty * t->lv->pitch + tx]
+               : gr_get_pixel(t->graph, tx, ty);
+}
+
+static void raster_tile(int tile) {
+  int rx0 = (tile % s_tiles_x) * RASTER_TILE;
+  int ry0 = (tile / s_tiles_x) * RASTER_TILE;
+  int rx1 = rx0 + RASTER_TILE < s_width ? rx0 + RASTER_TILE : s_width;
+  int ry1 = ry0 + RASTER_TILE < s_height ? ry0 + RASTER_TILE : s_height;
+
+  /* Orden de envio dentro del tile, como el rasterizador anterior */
+  for (int k = s_tile_start[tile]; k < s_tile_start[tile + 1]; k++) {
+    const RasterTri *t = &s_tris[s_tile_tris[k]];
+    int x0 = t->x0 > rx0 ? t->x0 : rx0, x1 = t->x1 < rx1 ? t->x1 : rx1;
+    int y0 = t->y0 > ry0 ? t->y0 : ry0, y1 = t->y1 < ry1 ? t->y1 : ry1;
+    for (int y = y0; y < y1; y++) {
+      float py = (float)y + 0.5f;
+      float row[6] = {t->eb[0] * py + t->ec[0], t->eb[1] * py + t->ec[1],
+                      t->eb[2] * py + t->ec[2], t->iz[1] * py + t->iz[2],
+                      t->uz[1] * py + t->uz[2], t->vz[1] * py + t->vz[2]};
+      float *zrow = s_zbuffer + y * s_zpitch;
+      for (int x = x0; x < x1; x += 4) {
+        float z[4], u[4], v[4];
+        int mask = raster_quad(t, x, x1, row, zrow, z, u, v);
+        for (int l = 0; mask; l++, mask >>= 1) {
+          if (!(mask & 1))
+            continue;
+          uint32_t color = raster_texel(t, u[l], v[l]);
+          if ((color & 0xFF000000) == 0 && (color & 0xFFFFFF) == 0)
+            continue;
+          if (s_pixels)
+            s_pixels[y * s_pitch + x + l] = color;
+          else
+            gr_put_pixel(s_dest, x + l, y, color);
+          zrow[x + l] = z[l];
+        }
+      }
+    }
+  }
+}
+
+static void raster_run_tiles(void) {
+  for (;;) {
+    int i = SDL_AtomicAdd(&s_next_tile, 1);
+    if (i >= s_num_busy_tiles)
+      break;
+    raster_tile(s_tile_list[i]);
+  }
+}
+
+/* Lista CSR de triangulos por tile y lista de tiles con trabajo */
+static int raster_bin(void) {
+  s_tiles_x = (s_width + RASTER_TILE - 1) / RASTER_TILE;
+  int tiles_y = (s_height + RASTER_TILE - 1) / RASTER_TILE;
+  int num_tiles = s_tiles_x * tiles_y;
+  if (!raster_reserve((void **)&s_tile_start, &s_tile_start_capacity,
+                      num_tiles + 1, sizeof(int)) ||
+      !raster_reserve((void **)&s_tile_cursor, &s_tile_cursor_capacity,
+                      num_tiles, sizeof(int)) ||
+      !raster_reserve((void **)&s_tile_list, &s_tile_list_capacity,
+                      num_tiles, sizeof(int)))
+    return 0;
+  memset(s_tile_start, 0, (size_t)(num_tiles + 1) * sizeof(int));
+
+  for (int i = 0; i < s_num_tris; i++) {
+    const RasterTri *t = &s_tris[i];
+    for (int ty = t->y0 / RASTER_TILE; ty <= (t->y1 - 1) / RASTER_TILE; ty++)
+      for (int tx = t->x0 / RASTER_TILE; tx <= (t->x1 - 1) / RASTER_TILE;
+           tx++)
+        s_tile_start[ty * s_tiles_x + tx + 1]++;
+  }
+  s_num_busy_tiles = 0;
+  for (int i = 0; i < num_tiles; i++) {
+    if (s_tile_start[i + 1])
+      s_tile_list[s_num_busy_tiles++] = i;
+    s_tile_start[i + 1] += s_tile_start[i];
+  }
+  if (!raster_reserve((void **)&s_tile_tris, &s_tile_tris_capacity,
+                      s_tile_start[num_tiles], sizeof(int)))
+    return 0;
+  memcpy(s_tile_cursor, s_tile_start, (size_t)num_tiles * sizeof(int));
+  for (int i = 0; i < s_num_tris; i++) {
+    const RasterTri *t = &s_tris[i];
+    for (int ty = t->y0 / RASTER_TILE; ty <= (t->y1 - 1) / RASTER_TILE; ty++)
+      for (int tx = t->x0 / RASTER_TILE; tx <= (t->x1 - 1) / RASTER_TILE;
+           tx++)
+        s_tile_tris[s_tile_cursor[ty * s_tiles_x + tx]++] = i;
+  }
+  return 1;
+}
+
+/* ============================================================================
+   WORKERS
+   ============================================================================
+ */
+
+static void raster_task(RAY_WorkerPool *pool, int index) {
+  (void)pool;
+  (void)index;
+  raster_run_tiles();
+}
+
+static RAY_WorkerPool s_pool = RAY_POOL_INIT("ray_raster", 0, raster_task);
+
+/* Same thread setting as the column bands; the main thread always works
+   as well */
+static int raster_thread_count(void) {
+  return ray_pool_thread_setting(RASTER_MAX_THREADS);
+}
+
+/* Threads worth waking for this flush; the pool itself keeps its size */
+static int raster_active_count(void) {
+  int n = raster_thread_count();
+  if (n > s_num_busy_tiles)
+    n = s_num_busy_tiles;
+  if (s_num_tris < RASTER_MIN_PARALLEL_TRIS)
+    n = 1;
+  return n < 1 ? 1 : n;
+}
+
+/* ============================================================================
+   FLUSH / SHUTDOWN
+   ============================================================================
+ */
+
+void ray_raster_flush(void) {
+  if (!s_dest)
+    return;
+  if (s_num_tris > 0 && raster_bin() && s_num_busy_tiles > 0) {
+    int workers = raster_active_count() - 1;
+    if (workers > 0)
+      ray_pool_reserve(&s_pool, raster_thread_count() - 1);
+    SDL_AtomicSet(&s_next_tile, 0);
+    workers = ray_pool_dispatch(&s_pool, workers);
+    raster_run_tiles();
+    ray_pool_wait(&s_pool, workers);
+  }
+  s_num_tris = 0;
+  s_dest = NULL;
+  s_pixels = NULL;
+  s_zbuffer = NULL;
+  s_col_depth = NULL;
+}
+
+void ray_raster_shutdown(void) {
+  ray_pool_stop(&s_pool);
+  free(s_tris);
+  free(s_verts);
+  free(s_tile_start);
+  free(s_tile_cursor);
+  free(s_tile_list);
+  free(s_tile_tris);
+  s_tris = NULL;
+  s_verts = NULL;
+  s_tile_start = s_tile_cursor = s_tile_list = s_tile_tris = NULL;
+  s_num_tris = s_tris_capacity = s_verts_capacity = 0;
+  s_tile_start_capacity = s_tile_cursor_capacity = 0;
+  s_tile_list_capacity = s_tile_tris_capacity = 0;
+  s_dest = NULL;
+  s_tex = NULL;
+  s_mip = NULL;
+}
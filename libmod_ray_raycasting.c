@@ -21,16 +21,7 @@ extern RAY_Engine g_engine;
  */
 
 static RAY_Sector *resolve_sector(RAY_Engine *engine, int sector_id) {
-  if (sector_id < 0)
-    return NULL;
-  if (sector_id < engine->num_sectors &&
-      engine->sectors[sector_id].sector_id == sector_id)
-    return &engine->sectors[sector_id];
-  for (int i = 0; i < engine->num_sectors; i++) {
-    if (engine->sectors[i].sector_id == sector_id)
-      return &engine->sectors[i];
-  }
-  return NULL;
+  return ray_sector_by_id(engine, sector_id);
 }
 
 /* ============================================================================
@@ -257,7 +248,8 @@ void ray_cast_sprites(RAY_Engine *engine, float ray_angle, int strip_idx,
   if (!engine || !hits || !num_hits)
     return;
 
-  for (int i = 0; i < engine->num_sprites; i++) {
+  for (int k = 0; k < engine->num_active_sprites; k++) {
+    int i = engine->active_sprites[k];
     RAY_Sprite *sprite = &engine->sprites[i];
     if (sprite->hidden || sprite->cleanup)
       continue;
@@ -113,6 +113,184 @@ uint32_t ray_sample_texture_bilinear(GRAPH *texture, float u, float v) {
   return SDL_MapRGB(gPixelFormat, rf, gf, bf);
 }
 
+/* ============================================================================
+   MIPMAP CACHE
+   Las cadenas se construyen bajo demanda desde cualquier banda del renderer:
+   la busqueda no bloquea y solo la construccion toma el spinlock. Un nodo se
+   publica en su cubo ya completo y no se libera hasta ray_mip_clear(), que
+   se llama con el renderer parado.
+   ============================================================================
+ */
+
+#define RAY_MIP_BUCKETS 256
+
+static void *s_mip_buckets[RAY_MIP_BUCKETS]; /* RAY_MipChain * */
+static SDL_SpinLock s_mip_lock = 0;
+static size_t s_mip_bytes = 0;
+static int s_mip_budget_warned = 0;
+
+static inline unsigned mip_bucket(int64_t file_id, int64_t graph_id) {
+  uint64_t h = (uint64_t)file_id * 0x9E3779B97F4A7C15ull ^ (uint64_t)graph_id;
+  h ^= h >> 29;
+  return (unsigned)(h * 0xBF58476D1CE4E5B9ull >> 56) & (RAY_MIP_BUCKETS - 1);
+}
+
+static void mip_fill_level(RAY_MipLevel *lv, const uint32_t *pixels, int pitch,
+                           int w, int h) {
+  lv->pixels = pixels;
+  lv->pitch = pitch;
+  lv->width = w;
+  lv->height = h;
+  lv->w_mask = w - 1;
+  lv->h_mask = h - 1;
+  lv->pot = ((w & (w - 1)) == 0) && ((h & (h - 1)) == 0);
+}
+
+/* Reduce 2x2 -> 1. El color se promedia solo entre texels opacos para que
+   los bordes de texturas con mascara no se oscurezcan; el resultado es
+   opaco si lo son al menos dos de los cuatro. */
+static void mip_downsample(const RAY_MipLevel *src, uint32_t *dst, int w,
+                           int h) {
+  for (int y = 0; y < h; y++) {
+    int sy0 = (y * 2) % src->height, sy1 = (y * 2 + 1) % src->height;
+    const uint32_t *r0 = src->pixels + sy0 * src->pitch;
+    const uint32_t *r1 = src->pixels + sy1 * src->pitch;
+    for (int x = 0; x < w; x++) {
+      int sx0 = (x * 2) % src->width, sx1 = (x * 2 + 1) % src->width;
+      uint32_t q[4] = {r0[sx0], r0[sx1], r1[sx0], r1[sx1]};
+      uint32_t r = 0, g = 0, b = 0, n = 0;
+      for (int i = 0; i < 4; i++) {
+        if (q[i] & 0xFF000000) {
+          r += (q[i] >> 16) & 0xFF;
+          g += (q[i] >> 8) & 0xFF;
+          b += q[i] & 0xFF;
+          n++;
+        }
+      }
+      if (n >= 2)
+        dst[y * w + x] = 0xFF000000 | ((r / n) << 16) | ((g / n) << 8) | (b / n);
+      else
+        dst[y * w + x] = 0;
+    }
+  }
+}
+
+static RAY_MipChain *mip_build(int64_t file_id, GRAPH *graph) {
+  RAY_MipChain *mip = (RAY_MipChain *)calloc(1, sizeof(RAY_MipChain));
+  if (!mip)
+    return NULL;
+  mip->file_id = file_id;
+  mip->graph_id = graph->code;
+  mip->source = graph;
+  mip->source_pixels = graph->surface->pixels;
+  mip_fill_level(&mip->levels[0], (const uint32_t *)graph->surface->pixels,
+                 graph->surface->pitch >> 2, graph->width, graph->height);
+  mip->num_levels = 1;
+  if (!g_engine.mipmaps)
+    return mip;
+
+  /* Niveles hasta 4 texels en el lado menor */
+  int levels = 1;
+  size_t texels = 0;
+  int w = graph->width, h = graph->height;
+  while (levels < RAY_MIP_MAX_LEVELS && w >= 8 && h >= 8) {
+    w >>= 1;
+    h >>= 1;
+    texels += (size_t)w * h;
+    levels++;
+  }
+  size_t bytes = texels * sizeof(uint32_t);
+  if (levels == 1)
+    return mip;
+  if (s_mip_bytes + bytes > g_engine.mip_budget) {
+    if (!s_mip_budget_warned) {
+      printf("RAY: Mipmaps: presupuesto agotado (%zu KB), texturas nuevas "
+             "sin mips\n",
+             g_engine.mip_budget / 1024);
+      s_mip_budget_warned = 1;
+    }
+    return mip;
+  }
+  mip->storage = (uint32_t *)malloc(bytes);
+  if (!mip->storage)
+    return mip;
+
+  uint32_t *dst = mip->storage;
+  w = graph->width;
+  h = graph->height;
+  for (int l = 1; l < levels; l++) {
+    w >>= 1;
+    h >>= 1;
+    mip_downsample(&mip->levels[l - 1], dst, w, h);
+    mip_fill_level(&mip->levels[l], dst, w, w, h);
+    dst += (size_t)w * h;
+  }
+  mip->num_levels = levels;
+  mip->bytes = bytes;
+  s_mip_bytes += bytes;
+  if (g_engine.verbose)
+    printf("RAY: Mipmaps %d:%d (%dx%d) %d niveles, %zu KB (total %zu KB)\n",
+           (int)file_id, (int)graph->code, (int)graph->width,
+           (int)graph->height, levels, bytes / 1024, s_mip_bytes / 1024);
+  return mip;
+}
+
+static const RAY_MipChain *mip_find(unsigned bucket, int64_t file_id,
+                                    GRAPH *graph) {
+  const RAY_MipChain *m =
+      (const RAY_MipChain *)SDL_AtomicGetPtr(&s_mip_buckets[bucket]);
+  for (; m; m = m->next) {
+    if (m->file_id == file_id && m->graph_id == graph->code &&
+        m->source == graph && m->source_pixels == graph->surface->pixels &&
+        m->levels[0].width == graph->width &&
+        m->levels[0].height == graph->height)
+      return m;
+  }
+  return NULL;
+}
+
+const RAY_MipChain *ray_mip_get(int64_t file_id, GRAPH *graph) {
+  if (!graph || !graph->surface || graph->width <= 0 || graph->height <= 0)
+    return NULL;
+
+  unsigned bucket = mip_bucket(file_id, graph->code);
+  const RAY_MipChain *found = mip_find(bucket, file_id, graph);
+  if (found)
+    return found;
+
+  SDL_AtomicLock(&s_mip_lock);
+  found = mip_find(bucket, file_id, graph);
+  if (!found) {
+    /* Un grafico recargado deja su nodo viejo detras del nuevo hasta el
+       siguiente ray_mip_clear() */
+    RAY_MipChain *mip = mip_build(file_id, graph);
+    if (mip) {
+      mip->next = (RAY_MipChain *)SDL_AtomicGetPtr(&s_mip_buckets[bucket]);
+      SDL_AtomicSetPtr(&s_mip_buckets[bucket], mip);
+    }
+    found = mip;
+  }
+  SDL_AtomicUnlock(&s_mip_lock);
+  return found;
+}
+
+void ray_mip_clear(void) {
+  for (int i = 0; i < RAY_MIP_BUCKETS; i++) {
+    RAY_MipChain *m = (RAY_MipChain *)s_mip_buckets[i];
+    while (m) {
+      RAY_MipChain *next = m->next;
+      free(m->storage);
+      free(m);
+      m = next;
+    }
+    s_mip_buckets[i] = NULL;
+  }
+  s_mip_bytes = 0;
+  s_mip_budget_warned = 0;
+}
+
+size_t ray_mip_memory_used(void) { return s_mip_bytes; }
+
 /* ============================================================================
    FOG SYSTEM
    ============================================================================
@@ -142,6 +320,89 @@ uint32_t ray_fog_pixel(uint32_t pixel, float distance) {
   return (r << 16) | (g << 8) | b;
 }
 
+/* Shade tables: se reconstruyen solo cuando cambia la niebla efectiva
+   (RAY_SET_FOG o la niebla del sector de la camara). */
+RAY_ShadeTable g_ray_shade;
+
+static struct {
+  int valid;
+  int on;
+  uint8_t r, g, b;
+  float start, end, amount;
+} s_shade_key;
+
+void ray_shade_invalidate(void) { s_shade_key.valid = 0; }
+
+void ray_shade_prepare(void) {
+  int on = 0;
+  uint8_t fr = 0, fg = 0, fb = 0;
+  float start = 0.0f, end = 0.0f, amount = 0.0f;
+
+  /* La niebla del sector (v28) tiene prioridad sobre la global */
+  RAY_Sector *cam_sector =
+      ray_sector_by_id(&g_engine, g_engine.camera.current_sector_id);
+  if (cam_sector && cam_sector->fog_density > 0.001f &&
+      cam_sector->fog_end > cam_sector->fog_start) {
+    on = 1;
+    fr = (uint8_t)(fminf(fmaxf(cam_sector->fog_color_r, 0.0f), 1.0f) * 255.0f);
+    fg = (uint8_t)(fminf(fmaxf(cam_sector->fog_color_g, 0.0f), 1.0f) * 255.0f);
+    fb = (uint8_t)(fminf(fmaxf(cam_sector->fog_color_b, 0.0f), 1.0f) * 255.0f);
+    start = cam_sector->fog_start;
+    end = cam_sector->fog_end;
+    amount = fminf(cam_sector->fog_density / 100.0f, 1.0f);
+  } else if (g_engine.fogOn &&
+             g_engine.fog_end_distance > g_engine.fog_start_distance) {
+    on = 1;
+    fr = g_engine.fog_r;
+    fg = g_engine.fog_g;
+    fb = g_engine.fog_b;
+    start = g_engine.fog_start_distance;
+    end = g_engine.fog_end_distance;
+    amount = 1.0f;
+  }
+
+  if (s_shade_key.valid && s_shade_key.on == on && s_shade_key.r == fr &&
+      s_shade_key.g == fg && s_shade_key.b == fb && s_shade_key.start == start &&
+      s_shade_key.end == end && s_shade_key.amount == amount)
+    return;
+
+  s_shade_key.valid = 1;
+  s_shade_key.on = on;
+  s_shade_key.r = fr;
+  s_shade_key.g = fg;
+  s_shade_key.b = fb;
+  s_shade_key.start = start;
+  s_shade_key.end = end;
+  s_shade_key.amount = amount;
+
+  g_ray_shade.identity = !on;
+  g_ray_shade.band_scale = on ? (float)(RAY_SHADE_BANDS - 1) / end : 0.0f;
+
+  uint32_t fog_rb = ((uint32_t)fr << 16) | fb;
+  uint32_t fog_g = (uint32_t)fg << 8;
+
+  for (int band = 0; band < RAY_SHADE_BANDS; band++) {
+    float f = 0.0f;
+    if (on) {
+      float d = (float)band / g_ray_shade.band_scale;
+      f = (d - start) / (end - start);
+      f = amount * fminf(fmaxf(f, 0.0f), 1.0f);
+    }
+    uint32_t fog_w = (uint32_t)(f * 256.0f + 0.5f);
+    if (fog_w > 256)
+      fog_w = 256;
+
+    for (int li = 0; li < RAY_SHADE_LIGHTS; li++) {
+      /* La ultima fila es luz completa para que 255 no oscurezca */
+      float light = (float)li / (float)(RAY_SHADE_LIGHTS - 1);
+      RAY_ShadeEntry *e = &g_ray_shade.entries[li][band];
+      e->mul = (uint32_t)(light * (float)(256 - fog_w) + 0.5f);
+      e->add_rb = fog_rb * fog_w;
+      e->add_g = fog_g * fog_w;
+    }
+  }
+}
+
 /* ============================================================================
    WALL RENDERING WITH MULTIPLE TEXTURES
    ============================================================================
@@ -447,13 +708,7 @@ void ray_draw_wall_strip(GRAPH *dest, RAY_RayHit *rayHit, int screen_x,
     int is_solid_child = 0;
 
     /* Find the sector this wall belongs to */
-    RAY_Sector *wall_sector = NULL;
-    for (int i = 0; i < g_engine.num_sectors; i++) {
-      if (g_engine.sectors[i].sector_id == rayHit->sector_id) {
-        wall_sector = &g_engine.sectors[i];
-        break;
-      }
-    }
+    RAY_Sector *wall_sector = ray_sector_by_id(&g_engine, rayHit->sector_id);
 
     /* For solid child sectors WITHOUT ceiling texture, do NOT update
      * ceiling_clip */
@@ -515,19 +770,7 @@ void ray_draw_floor_ceiling(GRAPH *dest, int screen_x, float ray_angle,
   float cos_factor = cosf(ray_angle - g_engine.camera.rot);
 
   /* Find the specified sector */
-  RAY_Sector *sector = NULL;
-  // Fast lookup if ID matches index
-  if (sector_id >= 0 && sector_id < g_engine.num_sectors &&
-      g_engine.sectors[sector_id].sector_id == sector_id) {
-    sector = &g_engine.sectors[sector_id];
-  } else {
-    for (int i = 0; i < g_engine.num_sectors; i++) {
-      if (g_engine.sectors[i].sector_id == sector_id) {
-        sector = &g_engine.sectors[i];
-        break;
-      }
-    }
-  }
+  RAY_Sector *sector = ray_sector_by_id(&g_engine, sector_id);
   if (!sector)
     return;
 
@@ -748,15 +991,25 @@ void ray_draw_sprites(GRAPH *dest, float *z_buffer) {
   if (!dest || !z_buffer || g_engine.num_sprites <= 0)
     return;
 
-  /* Use a stack-allocated or static index array to avoid reordering physically
-   */
-  static int sprite_sort_indices[RAY_MAX_SPRITES];
+  /* Sort an index array (grown with the sprite pool) to avoid reordering
+     the pool itself */
+  static int *sprite_sort_indices = NULL;
+  static int sprite_sort_capacity = 0;
+  if (g_engine.num_active_sprites > sprite_sort_capacity) {
+    int *grown = (int *)realloc(sprite_sort_indices,
+                                g_engine.num_active_sprites * sizeof(int));
+    if (!grown)
+      return;
+    sprite_sort_indices = grown;
+    sprite_sort_capacity = g_engine.num_active_sprites;
+  }
   int visible_count = 0;
 
   /* Calculate sprite distances and prepare index array */
-  for (int i = 0; i < g_engine.num_sprites; i++) {
+  for (int k = 0; k < g_engine.num_active_sprites; k++) {
+    int i = g_engine.active_sprites[k];
     RAY_Sprite *sprite = &g_engine.sprites[i];
-    if (!sprite->in_use || sprite->hidden || sprite->cleanup)
+    if (sprite->hidden || sprite->cleanup)
       continue;
 
     float dx = sprite->x - g_engine.camera.x;
@@ -1013,14 +1266,10 @@ void ray_render_frame(GRAPH *dest) {
       if (hit->wall && hit->distance < z_buffer[strip]) {
         /* Check if this wall belongs to a solid child sector */
         int is_solid_child = 0;
-        for (int i = 0; i < g_engine.num_sectors; i++) {
-          if (g_engine.sectors[i].sector_id == hit->sector_id &&
-              ray_sector_get_parent(&g_engine.sectors[i]) >= 0 &&
-              ray_sector_is_solid(&g_engine.sectors[i])) {
-            is_solid_child = 1;
-            break;
-          }
-        }
+        RAY_Sector *hit_sector = ray_sector_by_id(&g_engine, hit->sector_id);
+        if (hit_sector && ray_sector_get_parent(hit_sector) >= 0 &&
+            ray_sector_is_solid(hit_sector))
+          is_solid_child = 1;
 
         /* Only update z-buffer for non-solid-child walls */
         if (!is_solid_child) {
@@ -1090,29 +1339,8 @@ void ray_render_frame(GRAPH *dest) {
       hits[h].is_child_sector = 0;
 
       if (hits[h].wall) {
-        /* Validate sector index */
-        /* Warning: sector_id is not index! Need lookup? */
-        /* Usually sector_id == index if sequentially created, but safest is
-         * lookup or direct check if we have pointer. */
-        /* hits[h].wall->sector? No. */
-        /* But hits[h].sector_id is available. */
-
-        RAY_Sector *sec = NULL;
-        // Optimization: try direct index if it matches
-        if (hits[h].sector_id >= 0 &&
-            hits[h].sector_id < g_engine.num_sectors &&
-            g_engine.sectors[hits[h].sector_id].sector_id ==
-                hits[h].sector_id) {
-          sec = &g_engine.sectors[hits[h].sector_id];
-        } else {
-          // Fallback search
-          for (int i = 0; i < g_engine.num_sectors; i++) {
-            if (g_engine.sectors[i].sector_id == hits[h].sector_id) {
-              sec = &g_engine.sectors[i];
-              break;
-            }
-          }
-        }
+        /* sector_id is not an index: resolve through the lookup table */
+        RAY_Sector *sec = ray_sector_by_id(&g_engine, hits[h].sector_id);
 
         if (sec && ray_sector_get_parent(sec) >= 0) {
           hits[h].is_child_sector = 1;
@@ -1146,13 +1374,7 @@ void ray_render_frame(GRAPH *dest) {
        * them */
       if (hit->is_child_sector) {
         /* Check if this child is solid or hollow */
-        RAY_Sector *child_sector = NULL;
-        for (int i = 0; i < g_engine.num_sectors; i++) {
-          if (g_engine.sectors[i].sector_id == hit->sector_id) {
-            child_sector = &g_engine.sectors[i];
-            break;
-          }
-        }
+        RAY_Sector *child_sector = ray_sector_by_id(&g_engine, hit->sector_id);
 
         /* Only skip hollow children (they have their own floor/ceiling) */
         if (child_sector && !ray_sector_is_solid(child_sector)) {
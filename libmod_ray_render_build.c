@@ -7,6 +7,7 @@
 
 #include "libmod_ray.h"
 #include "libmod_ray_compat.h"
+#include "libmod_ray_pool.h"
 #ifdef __ANDROID__
 #include "SDL.h"
 #else
@@ -22,7 +23,16 @@
 extern RAY_Engine g_engine;
 extern uint32_t ray_sample_texture(GRAPH *texture, int tex_x, int tex_y);
 extern uint32_t ray_sample_texture_bilinear(GRAPH *texture, float u, float v);
-extern uint32_t ray_fog_pixel(uint32_t pixel, float distance);
+
+/* Nearest sample through the mip chain when there is one */
+static inline uint32_t sample_texture_mip(GRAPH *texture,
+                                          const RAY_MipChain *mip,
+                                          float texels_per_pixel, int tex_x,
+                                          int tex_y) {
+  if (mip)
+    return ray_mip_texel(mip, texels_per_pixel, tex_x, tex_y);
+  return ray_sample_texture(texture, tex_x, tex_y);
+}
 
 /* ============================================================================
    BUILD ENGINE CONSTANTS AND GLOBALS
@@ -54,8 +64,38 @@ float g_wall_col_depth[MAXSCREENWIDTH];
 uint8_t *g_wall_coverage = NULL;
 static int g_wall_coverage_size = 0;
 
+// Internal render target when resolutionScale < 1 (upscaled to dest)
+static GRAPH *s_internal_graph = NULL;
+
+/* Thread-local storage for per-band render state (column-band threading).
+   Clip arrays, z-buffer and coverage are shared but every band only touches
+   its own column range; scalar traversal state must be private per thread. */
+#if defined(_MSC_VER)
+#define RAY_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define RAY_THREAD_LOCAL _Thread_local
+#else
+#define RAY_THREAD_LOCAL __thread
+#endif
+
 // Island Rendering Mode Flag
-static int g_render_island_mode = 0;
+static RAY_THREAD_LOCAL int g_render_island_mode = 0;
+
+/* Frame statistics of the band running on this thread (NULL = stats off).
+   Merged into g_ray_stats_acc by the main thread once the bands finish. */
+static RAY_THREAD_LOCAL double *t_band_stats = NULL;
+
+#define BAND_STAT_ADD(id, v)                                                   \
+  do {                                                                         \
+    if (t_band_stats)                                                          \
+      t_band_stats[(id)] += (double)(v);                                       \
+  } while (0)
+#define BAND_STAT_TIMER(t) uint64_t t = t_band_stats ? ray_stats_clock() : 0
+#define BAND_STAT_ELAPSED(id, t)                                               \
+  do {                                                                         \
+    if (t)                                                                     \
+      t_band_stats[(id)] += ray_stats_elapsed_ms(t);                           \
+  } while (0)
 
 // Forward declaration
 void render_sector(GRAPH *dest, int sector_id, int min_x, int max_x, int depth,
@@ -407,13 +447,25 @@ static void draw_sky_column(GRAPH *dest, int x, int y_start, int y_end) {
   }
 }
 
+/* Baked light of one sector surface (RAY_LIGHTMAP_* slot), or NULL when
+   lightmaps are off. The surface is written to *out */
+static const RAY_LightmapSurface *
+lightmap_surface(const RAY_Sector *sector, int slot, RAY_LightmapSurface *out) {
+  if (!ray_lightmap_surface((int)(sector - g_engine.sectors), slot, out))
+    return NULL;
+  return out;
+}
+
 // Helper to draw a vertical column of floor/ceiling
 // flags: 0 = Normal, 1 = Clear Z (Hole Punch) - Resets Z to infinity for passed
 // pixels Helper to draw a vertical column of floor/ceiling
+// lm: baked light of the plane (NULL = light_level only)
 static void draw_plane_column(GRAPH *dest, int x, int y_start, int y_end,
                               float height_diff, GRAPH *texture, int flags,
                               float u_off, float v_off, int sector_flags,
-                              float liquid_intensity, float liquid_speed) {
+                              float liquid_intensity, float liquid_speed,
+                              int light_level,
+                              const RAY_LightmapSurface *lm) {
   if (y_start > y_end)
     return;
 
@@ -452,13 +504,9 @@ static void draw_plane_column(GRAPH *dest, int x, int y_start, int y_end,
 
   uint32_t *dest_pixels = (uint32_t *)dest->surface->pixels;
   int dest_pitch = dest->surface->pitch >> 2;
-  uint32_t *tex_pixels = (uint32_t *)texture->surface->pixels;
-  int tex_pitch = texture->surface->pitch >> 2;
-  int tex_w = texture->width;
-  int tex_h = texture->height;
-  int tex_w_mask = tex_w - 1;
-  int tex_h_mask = tex_h - 1;
-  bool is_pot = ((tex_w & (tex_w - 1)) == 0) && ((tex_h & (tex_h - 1)) == 0);
+  const RAY_MipChain *mip = ray_mip_get(g_engine.fpg_id, texture);
+  if (!mip)
+    return;
 
   /* Liquid/Fluid pre-calculation */
   float liq_x = 0, liq_y = 0;
@@ -469,7 +517,6 @@ static void draw_plane_column(GRAPH *dest, int x, int y_start, int y_end,
   }
 
   uint32_t *screen_ptr = dest_pixels + y_start * dest_pitch + x;
-  bool use_fog = g_engine.fogOn;
 
   for (int y = y_start; y <= y_end; y++) {
     int pixel_idx = ylookup[y] + x;
@@ -500,17 +547,31 @@ static void draw_plane_column(GRAPH *dest, int x, int y_start, int y_end,
     float map_x = g_engine.camera.x + ray_dir_x * scale + u_off + liq_x;
     float map_y = g_engine.camera.y + ray_dir_y * scale + v_off + liq_y;
 
+    /* Footprint: the larger of the across-screen and along-depth steps */
+    float along = z_depth / fabsf(dy);
+    const RAY_MipLevel *lv = ray_mip_select(mip, along > scale ? along : scale);
+    int lod = (int)(lv - mip->levels);
     int tx, ty;
-    if (is_pot) {
-      tx = (int)map_x & tex_w_mask;
-      ty = (int)map_y & tex_h_mask;
+    if (lv->pot) {
+      tx = ((int)map_x >> lod) & lv->w_mask;
+      ty = ((int)map_y >> lod) & lv->h_mask;
     } else {
-      tx = (int)map_x % tex_w; if (tx < 0) tx += tex_w;
-      ty = (int)map_y % tex_h; if (ty < 0) ty += tex_h;
+      tx = ((int)map_x >> lod) % lv->width; if (tx < 0) tx += lv->width;
+      ty = ((int)map_y >> lod) % lv->height; if (ty < 0) ty += lv->height;
     }
 
-    uint32_t pixel = tex_pixels[ty * tex_pitch + tx];
-    if (use_fog) pixel = ray_fog_pixel(pixel, z_depth);
+    uint32_t pixel = lv->pixels[ty * lv->pitch + tx];
+    const RAY_ShadeEntry *shade;
+    if (lm) {
+      /* Baked light on top of the sector's; the table only adds fog */
+      const uint8_t *lux = ray_lightmap_luxel(
+          lm, map_x - u_off - liq_x, map_y - v_off - liq_y);
+      pixel = ray_lightmap_apply(pixel, lux, light_level);
+      shade = ray_shade_lookup(255, z_depth);
+    } else {
+      shade = ray_shade_lookup(light_level, z_depth);
+    }
+    if (shade) pixel = ray_shade_pixel(pixel, shade);
 
     if (sector_flags & 7) {
       uint32_t bg = *screen_ptr;
@@ -525,6 +586,200 @@ static void draw_plane_column(GRAPH *dest, int x, int y_start, int y_end,
   }
 }
 
+/* ============================================================================
+   FLOOR/CEILING SPANS (visplanes)
+   draw_wall_segment_linear records the ceiling and floor extent of each
+   column into one RAY_PlaneSpans per plane and, once the segment is done,
+   turns the columns into horizontal spans (R_MakeSpans style). Depth is
+   constant along a row, so a span needs one division and walks the
+   texture linearly. Only pixels of that segment's own columns are touched
+   between recording and drawing, so the result matches the column path.
+   ============================================================================
+ */
+
+#define PLANE_SPAN_EMPTY_TOP INT16_MAX
+#define PLANE_SPAN_EMPTY_BOT (-1)
+
+typedef struct {
+  int x1, x2; /* Columns recorded so far (x1 > x2 = none) */
+  int16_t top[MAXSCREENWIDTH];
+  int16_t bot[MAXSCREENWIDTH];
+  float height_diff;
+  const RAY_MipChain *mip;
+  float u_off, v_off;
+  int sector_flags;
+  float liquid_intensity, liquid_speed;
+  int light_level;
+  int has_lm;
+  RAY_LightmapSurface lm;
+} RAY_PlaneSpans;
+
+static void plane_spans_reset(RAY_PlaneSpans *p) {
+  p->x1 = 0;
+  p->x2 = -1;
+}
+
+static void plane_spans_add(RAY_PlaneSpans *p, int x, int y_start, int y_end,
+                            float height_diff, GRAPH *texture, float u_off,
+                            float v_off, int sector_flags,
+                            float liquid_intensity, float liquid_speed,
+                            int light_level, const RAY_LightmapSurface *lm) {
+  if (p->x1 > p->x2) {
+    p->x1 = p->x2 = x;
+    p->height_diff = height_diff;
+    p->mip = ray_mip_get(g_engine.fpg_id, texture);
+    p->u_off = u_off;
+    p->v_off = v_off;
+    p->sector_flags = sector_flags;
+    p->liquid_intensity = liquid_intensity;
+    p->liquid_speed = liquid_speed;
+    p->light_level = light_level;
+    p->has_lm = (lm != NULL);
+    if (lm)
+      p->lm = *lm;
+  } else {
+    /* Columns are added left to right; skipped ones stay empty */
+    for (int c = p->x2 + 1; c < x; c++) {
+      p->top[c] = PLANE_SPAN_EMPTY_TOP;
+      p->bot[c] = PLANE_SPAN_EMPTY_BOT;
+    }
+    p->x2 = x;
+  }
+  p->top[x] = (int16_t)y_start;
+  p->bot[x] = (int16_t)y_end;
+}
+
+/* Same pixels as draw_plane_column for row y, columns [xa, xb] */
+static void draw_plane_span(GRAPH *dest, const RAY_PlaneSpans *p, int y,
+                            int xa, int xb) {
+  float half_w = (float)g_engine.displayWidth / 2.0f;
+  float half_h = (float)g_engine.displayHeight / 2.0f;
+  float dy = (float)y - half_h;
+  if (fabsf(dy) < 0.1f)
+    return;
+
+  float view_dist = (float)halfxdimen;
+  float z_depth = fabsf(p->height_diff * view_dist) / fabsf(dy);
+
+  /* map(x) = cam + ray_dir(x) * scale, and ray_dir is linear in x */
+  float cos_rot = cosf(g_engine.camera.rot);
+  float sin_rot = sinf(g_engine.camera.rot);
+  float scale = z_depth / view_dist;
+  float liq_x = 0, liq_y = 0;
+  if ((p->sector_flags & 7) && (p->sector_flags & 256)) {
+    float t = g_engine.time * p->liquid_speed;
+    liq_x = sinf(t * 3.0f) * 16.0f * p->liquid_intensity;
+    liq_y = cosf(t * 2.5f) * 16.0f * p->liquid_intensity;
+  }
+  float base_x = g_engine.camera.x + p->u_off + liq_x +
+                 (view_dist * cos_rot + half_w * sin_rot) * scale;
+  float base_y = g_engine.camera.y + p->v_off + liq_y +
+                 (view_dist * sin_rot - half_w * cos_rot) * scale;
+  float step_x = -sin_rot * scale;
+  float step_y = cos_rot * scale;
+
+  /* Light and fog depend on depth only: one shade entry per row. With a
+     lightmap the light comes from the luxels and the table only adds fog */
+  const RAY_LightmapSurface *lm = p->has_lm ? &p->lm : NULL;
+  const RAY_ShadeEntry *shade =
+      ray_shade_lookup(lm ? 255 : p->light_level, z_depth);
+  float lm_dx = p->u_off + liq_x, lm_dy = p->v_off + liq_y;
+
+  /* One mip level per row: depth is constant along it */
+  const RAY_MipChain *mip = p->mip;
+  if (!mip)
+    return;
+  float along = z_depth / fabsf(dy);
+  const RAY_MipLevel *lv = ray_mip_select(mip, along > scale ? along : scale);
+  int lod = (int)(lv - mip->levels);
+  const uint32_t *tex_pixels = lv->pixels;
+  int tex_pitch = lv->pitch;
+  int tex_w = lv->width;
+  int tex_h = lv->height;
+  int tex_w_mask = lv->w_mask;
+  int tex_h_mask = lv->h_mask;
+  bool is_pot = lv->pot;
+  int blend = p->sector_flags & 7;
+
+  uint32_t *screen_row = (uint32_t *)dest->surface->pixels +
+                         y * (dest->surface->pitch >> 2);
+  float *z_row = g_zbuffer + ylookup[y];
+  uint8_t *cov_row = g_wall_coverage + ylookup[y];
+
+  for (int x = xa; x <= xb; x++) {
+    if (z_depth >= z_row[x])
+      continue;
+
+    float map_x = base_x + step_x * (float)x;
+    float map_y = base_y + step_y * (float)x;
+    int tx, ty;
+    if (is_pot) {
+      tx = ((int)map_x >> lod) & tex_w_mask;
+      ty = ((int)map_y >> lod) & tex_h_mask;
+    } else {
+      tx = ((int)map_x >> lod) % tex_w;
+      if (tx < 0)
+        tx += tex_w;
+      ty = ((int)map_y >> lod) % tex_h;
+      if (ty < 0)
+        ty += tex_h;
+    }
+
+    uint32_t pixel = tex_pixels[ty * tex_pitch + tx];
+    if (lm)
+      pixel = ray_lightmap_apply(
+          pixel, ray_lightmap_luxel(lm, map_x - lm_dx, map_y - lm_dy),
+          p->light_level);
+    if (shade)
+      pixel = ray_shade_pixel(pixel, shade);
+    if (blend) {
+      uint32_t bg = screen_row[x];
+      pixel = ((pixel & 0x00FEFEFE) >> 1) + ((bg & 0x00FEFEFE) >> 1);
+    }
+
+    screen_row[x] = pixel;
+    z_row[x] = z_depth;
+    cov_row[x] = 1;
+  }
+}
+
+/* Turn the recorded columns into row spans and draw them */
+static void plane_spans_flush(GRAPH *dest, RAY_PlaneSpans *p) {
+  if (p->x1 > p->x2)
+    return;
+
+  int16_t span_start[MAXSCREENWIDTH];
+  int t1 = PLANE_SPAN_EMPTY_TOP, b1 = PLANE_SPAN_EMPTY_BOT;
+
+  /* One empty column past the end closes every open span */
+  for (int x = p->x1; x <= p->x2 + 1; x++) {
+    int t2 = (x <= p->x2) ? p->top[x] : PLANE_SPAN_EMPTY_TOP;
+    int b2 = (x <= p->x2) ? p->bot[x] : PLANE_SPAN_EMPTY_BOT;
+
+    while (t1 < t2 && t1 <= b1) {
+      draw_plane_span(dest, p, t1, span_start[t1], x - 1);
+      t1++;
+    }
+    while (b1 > b2 && b1 >= t1) {
+      draw_plane_span(dest, p, b1, span_start[b1], x - 1);
+      b1--;
+    }
+    while (t2 < t1 && t2 <= b2) {
+      span_start[t2] = (int16_t)x;
+      t2++;
+    }
+    while (b2 > b1 && b2 >= t2) {
+      span_start[b2] = (int16_t)x;
+      b2--;
+    }
+
+    t1 = (x <= p->x2) ? p->top[x] : PLANE_SPAN_EMPTY_TOP;
+    b1 = (x <= p->x2) ? p->bot[x] : PLANE_SPAN_EMPTY_BOT;
+  }
+
+  plane_spans_reset(p);
+}
+
 // Helper to draw a vertical column of wall
 // sector flags (Liquid types)
 
@@ -538,6 +793,9 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
   if (x1 > x2)
     return;
 
+  BAND_STAT_TIMER(t_walls);
+  BAND_STAT_ADD(RAY_STAT_DRAW_CALLS, 1);
+
   // Pre-calculate slopes for linear interpolation of screen coordinates
   float span_width = (float)(x2 - x1);
   if (span_width < 1.0f)
@@ -566,24 +824,12 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
   int end_x = x2;
 
   // Initial clipping (geometry vs screen 0)
-  if (start_x < 0) {
-    float clip_amount = (float)(-start_x);
-    curr_y_ceil += dy_ceil * clip_amount;
-    curr_y_floor += dy_floor * clip_amount;
-    curr_inv_z += d_inv_z * clip_amount;
-    curr_u_over_z += d_u_over_z * clip_amount;
+  if (start_x < 0)
     start_x = 0;
-  }
 
   // Further clipping (geometry vs portal window start)
-  if (start_x < clip_min_x) {
-    float clip_amount = (float)(clip_min_x - start_x);
-    curr_y_ceil += dy_ceil * clip_amount;
-    curr_y_floor += dy_floor * clip_amount;
-    curr_inv_z += d_inv_z * clip_amount;
-    curr_u_over_z += d_u_over_z * clip_amount;
+  if (start_x < clip_min_x)
     start_x = clip_min_x;
-  }
 
   if (end_x >= g_engine.displayWidth) {
     end_x = g_engine.displayWidth - 1;
@@ -614,7 +860,38 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
   float cx = g_engine.camera.x;
   float cy = g_engine.camera.y;
 
+  const RAY_MipChain *wall_mip =
+      (flags & 1) ? ray_mip_get(g_engine.fpg_id, texture) : NULL;
+  if (!wall_mip)
+    texture = NULL;
+
+  // Textured ceilings/floors are gathered per column and drawn as row spans
+  // after the loop
+  int use_spans = g_engine.floor_spans && (flags & 2);
+  RAY_PlaneSpans ceil_spans, floor_spans;
+  plane_spans_reset(&ceil_spans);
+  plane_spans_reset(&floor_spans);
+
+  // Baked light (RAY_SET_LIGHTMAPS): the wall's rect and the sector planes
+  RAY_LightmapSurface lm_wall_surf, lm_ceil_surf, lm_floor_surf;
+  const RAY_LightmapSurface *lm_wall = NULL, *lm_ceil = NULL, *lm_floor = NULL;
+  if (flags & 1)
+    lm_wall = lightmap_surface(sector, 2 + (int)(wall - sector->walls),
+                               &lm_wall_surf);
+  if (flags & 2) {
+    lm_ceil = lightmap_surface(sector, RAY_LIGHTMAP_CEILING, &lm_ceil_surf);
+    lm_floor = lightmap_surface(sector, RAY_LIGHTMAP_FLOOR, &lm_floor_surf);
+  }
+
   for (int x = start_x; x <= end_x; x++) {
+    // Evaluate interpolators from x1 for every column (not accumulated), so
+    // a column's output does not depend on where its render band starts.
+    float span_t = (float)(x - x1);
+    curr_y_ceil = (float)y1_ceil + dy_ceil * span_t;
+    curr_y_floor = (float)y1_floor + dy_floor * span_t;
+    curr_inv_z = inv_z1 + d_inv_z * span_t;
+    curr_u_over_z = u_over_z1 + d_u_over_z * span_t;
+
     int y_top = (int)curr_y_ceil;
     int y_bot = (int)curr_y_floor;
 
@@ -645,6 +922,7 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
 
     float det = rdx * wdy - rdy * wdx;
     float u = 0.0f;
+    float lm_u = 0.0f; // Distance along the wall, for the lightmap
 
     if (fabsf(det) > 0.001f) {
       float t = ((wx1 - cx) * wdy - (wy1 - cy) * wdx) / det;
@@ -664,7 +942,8 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
       // Actually u is simply length if we assume 0..len mapping.
       // u = sqrt(dux*dux + duy*duy);
       // Better: use dot product to allow extrapolation if needed and avoid sqrt
-      u = (dux * wdx + duy * wdy) / sqrtf(wall_len_sq) + u_off;
+      lm_u = (dux * wdx + duy * wdy) / sqrtf(wall_len_sq);
+      u = lm_u + u_off;
 
       // Wall fluid distortion
       if ((sector->flags & 128) && (sector->flags & 256)) {
@@ -684,6 +963,7 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
     } else {
       // Parallel ray? Use interpolated U as fallback
       u = curr_u_over_z * z;
+      lm_u = u - u_off;
     }
 
     // Draw Wall
@@ -716,19 +996,31 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
         // OPTIMIZATION: Use direct pointers if surface is available
         uint32_t *dest_pixels = (uint32_t *)dest->surface->pixels;
         int dest_pitch = dest->surface->pitch >> 2;
-        uint32_t *tex_pixels = (uint32_t *)texture->surface->pixels;
-        int tex_pitch = texture->surface->pitch >> 2;
-        int tex_h = texture->height;
-        int tex_h_mask = tex_h - 1;
+        /* Mip level from the larger of the vertical step and du/dx, the
+           derivative of the perspective-correct u */
+        float du_dx = fabsf((d_u_over_z - u * d_inv_z) * z);
+        const RAY_MipLevel *lv =
+            ray_mip_select(wall_mip, v_step > du_dx ? v_step : du_dx);
+        int lod = (int)(lv - wall_mip->levels);
+        const uint32_t *tex_pixels = lv->pixels;
+        int tex_pitch = lv->pitch;
+        int tex_h = lv->height;
+        int tex_h_mask = lv->h_mask;
         bool is_pot = (tex_h & tex_h_mask) == 0;
+        tex_x = (tex_x >> lod) % lv->width;
+        int v_shift = 16 + lod;
 
         uint32_t *screen_ptr = dest_pixels + draw_top * dest_pitch + x;
         uint8_t *cov_ptr = g_wall_coverage + (ylookup[draw_top] + x);
 
 
-        // OPTIMIZATION: Pre-calculate fog once per column (Z is constant for vertical wall)
-        uint32_t wall_color = 0; 
-        bool use_fog = g_engine.fogOn;
+        // OPTIMIZATION: Shade entry once per column (Z is constant for vertical wall)
+        // With a lightmap the luxels light it and the table only adds fog
+        const RAY_ShadeEntry *shade =
+            ray_shade_lookup(lm_wall ? 255 : sector->light_level, z);
+        // World z of row y: lm_z0 + y * lm_dz
+        float lm_dz = -z / (float)halfydimen;
+        float lm_z0 = g_engine.camera.z + z;
 
         for (int y = draw_top; y <= draw_bot; y++) {
           int pixel_idx = ylookup[y] + x;
@@ -741,13 +1033,18 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
             continue;
           }
 
-          int tex_y = is_pot ? (curr_v_fp >> 16) & tex_h_mask : (curr_v_fp >> 16) % tex_h;
+          int tex_y = is_pot ? (curr_v_fp >> v_shift) & tex_h_mask : (curr_v_fp >> v_shift) % tex_h;
           if (tex_y < 0) tex_y += tex_h;
 
           uint32_t pixel = tex_pixels[tex_y * tex_pitch + tex_x];
 
           if ((pixel & 0xff000000) != 0) { // Transparency check
-            if (use_fog) pixel = ray_fog_pixel(pixel, z);
+            if (lm_wall)
+              pixel = ray_lightmap_apply(
+                  pixel,
+                  ray_lightmap_luxel(lm_wall, lm_u, lm_z0 + (float)y * lm_dz),
+                  sector->light_level);
+            if (shade) pixel = ray_shade_pixel(pixel, shade);
 
             if (sector->flags & 7) {
               uint32_t bg = *screen_ptr;
@@ -822,9 +1119,16 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
         }
         if (!g_render_island_mode) {
           int sflags = (sector->flags & 64) ? (sector->flags & (7 | 256)) : 0;
-          draw_plane_column(dest, x, draw_c_start, draw_c_end, ceil_h, ceil_tex,
-                            0, cu_off, cv_off, sflags, sector->liquid_intensity,
-                            sector->liquid_speed);
+          if (use_spans && ceil_tex)
+            plane_spans_add(&ceil_spans, x, draw_c_start, draw_c_end, ceil_h,
+                            ceil_tex, cu_off, cv_off, sflags,
+                            sector->liquid_intensity, sector->liquid_speed,
+                              sector->light_level, lm_ceil);
+          else
+            draw_plane_column(dest, x, draw_c_start, draw_c_end, ceil_h,
+                              ceil_tex, 0, cu_off, cv_off, sflags,
+                              sector->liquid_intensity, sector->liquid_speed,
+                              sector->light_level, lm_ceil);
         }
       }
 
@@ -852,17 +1156,29 @@ draw_wall_segment_linear(GRAPH *dest, int x1, int x2, int y1_ceil, int y2_ceil,
         }
         if (!g_render_island_mode) {
           int sflags = (sector->flags & 32) ? (sector->flags & (7 | 256)) : 0;
-          draw_plane_column(dest, x, draw_f_start, draw_f_end, floor_h,
-                            floor_tex, 0, fu_off, fv_off, sflags,
-                            sector->liquid_intensity, sector->liquid_speed);
+          if (use_spans && floor_tex)
+            plane_spans_add(&floor_spans, x, draw_f_start, draw_f_end, floor_h,
+                            floor_tex, fu_off, fv_off, sflags,
+                            sector->liquid_intensity, sector->liquid_speed,
+                              sector->light_level, lm_floor);
+          else
+            draw_plane_column(dest, x, draw_f_start, draw_f_end, floor_h,
+                              floor_tex, 0, fu_off, fv_off, sflags,
+                              sector->liquid_intensity, sector->liquid_speed,
+                              sector->light_level, lm_floor);
         }
       }
     }
 
-    curr_y_ceil += dy_ceil;
-    curr_y_floor += dy_floor;
-    curr_inv_z += d_inv_z;
-    curr_u_over_z += d_u_over_z;
+  }
+
+  // Spans are the plane work of this segment; the column loop counts as walls
+  BAND_STAT_ELAPSED(RAY_STAT_WALLS_MS, t_walls);
+  if (use_spans) {
+    BAND_STAT_TIMER(t_planes);
+    plane_spans_flush(dest, &ceil_spans);
+    plane_spans_flush(dest, &floor_spans);
+    BAND_STAT_ELAPSED(RAY_STAT_PLANES_MS, t_planes);
   }
 }
 
@@ -1111,15 +1427,15 @@ static void render_solid_sector(GRAPH *dest, int sector_id, int min_x,
             wall_h_scr = 1.0f;
           float v_step = (float)wall_tex->height / wall_h_scr;
           float curr_v = (float)(step_draw_start - y_near_top) * v_step;
+          const RAY_MipChain *near_mip = ray_mip_get(g_engine.fpg_id, wall_tex);
 
           for (int y = step_draw_start; y <= step_draw_end; y++) {
             int pixel_idx = y * g_engine.displayWidth + x;
             if (t_near < g_zbuffer[pixel_idx]) {
-              uint32_t pix = ray_sample_texture(wall_tex, tex_x,
-                                                (int)curr_v); // Simple sample
+              uint32_t pix = sample_texture_mip(wall_tex, near_mip, v_step,
+                                                tex_x, (int)curr_v);
               if (pix != 0) {
-                if (g_engine.fogOn)
-                  pix = ray_fog_pixel(pix, t_near * view_dist);
+                pix = ray_shade(pix, sector->light_level, t_near * view_dist);
                 FAST_PUT_PIXEL(dest, x, y, pix);
                 g_zbuffer[pixel_idx] = t_near;
                 g_wall_coverage[pixel_idx] = 1;
@@ -1143,14 +1459,17 @@ static void render_solid_sector(GRAPH *dest, int sector_id, int min_x,
               wall_h_scr = 1.0f;
             float v_step = (float)wall_tex->height / wall_h_scr;
             float curr_v = (float)(step_draw_start - y_near_top) * v_step;
+            const RAY_MipChain *near_mip =
+                ray_mip_get(g_engine.fpg_id, wall_tex);
 
             for (int y = step_draw_start; y <= step_draw_end; y++) {
               int pixel_idx = y * g_engine.displayWidth + x;
               if (t_near < g_zbuffer[pixel_idx]) {
-                uint32_t pix = ray_sample_texture(wall_tex, tex_x, (int)curr_v);
+                uint32_t pix = sample_texture_mip(wall_tex, near_mip, v_step,
+                                                  tex_x, (int)curr_v);
                 if (pix != 0) {
-                  if (g_engine.fogOn)
-                    pix = ray_fog_pixel(pix, t_near * view_dist);
+                  pix = ray_shade(pix, sector->light_level,
+                                  t_near * view_dist);
                   FAST_PUT_PIXEL(dest, x, y, pix);
                   g_zbuffer[pixel_idx] = t_near;
                   g_wall_coverage[pixel_idx] = 1;
@@ -1187,15 +1506,17 @@ static void render_solid_sector(GRAPH *dest, int sector_id, int min_x,
                 wall_h_scr = 1.0f;
               float v_step = (float)wall_tex->height / wall_h_scr;
               float curr_v = (float)(far_draw_start - far_y1) * v_step;
+              const RAY_MipChain *far_mip =
+                  ray_mip_get(g_engine.fpg_id, wall_tex);
 
               for (int y = far_draw_start; y <= far_draw_end; y++) {
                 int pixel_idx = y * g_engine.displayWidth + x;
                 if (t_far < g_zbuffer[pixel_idx]) {
-                  uint32_t pix =
-                      ray_sample_texture(wall_tex, tex_x, (int)curr_v);
+                  uint32_t pix = sample_texture_mip(wall_tex, far_mip, v_step,
+                                                    tex_x, (int)curr_v);
                   if (pix != 0) {
-                    if (g_engine.fogOn)
-                      pix = ray_fog_pixel(pix, t_far * view_dist);
+                    pix = ray_shade(pix, sector->light_level,
+                                    t_far * view_dist);
                     FAST_PUT_PIXEL(dest, x, y, pix);
                     g_zbuffer[pixel_idx] = t_far;
                     g_wall_coverage[pixel_idx] = 1;
@@ -1248,9 +1569,13 @@ static void render_solid_sector(GRAPH *dest, int sector_id, int min_x,
               // We use a simplified constant height plane drawer for now
               // Ideally we need perspective correct u/v mapping for the lid
               // surface
+              RAY_LightmapSurface lm_surf;
               draw_plane_column(dest, x, draw_l_start, draw_l_end, sect_ceil,
                                 ceil_tex, 0, 0, 0, sector->flags,
-                                sector->liquid_intensity, sector->liquid_speed);
+                                sector->liquid_intensity, sector->liquid_speed,
+                              sector->light_level,
+                              lightmap_surface(sector, RAY_LIGHTMAP_CEILING,
+                                               &lm_surf));
             }
           }
 
@@ -1279,9 +1604,13 @@ static void render_solid_sector(GRAPH *dest, int sector_id, int min_x,
             int draw_l_end = (lid_end > max_y) ? max_y : lid_end;
 
             if (draw_l_end >= draw_l_start) {
+              RAY_LightmapSurface lm_surf;
               draw_plane_column(dest, x, draw_l_start, draw_l_end, sect_floor,
                                 floor_tex, 0, 0, 0, sector->flags,
-                                sector->liquid_intensity, sector->liquid_speed);
+                                sector->liquid_intensity, sector->liquid_speed,
+                              sector->light_level,
+                              lightmap_surface(sector, RAY_LIGHTMAP_FLOOR,
+                                               &lm_surf));
             }
           }
         }
@@ -1402,7 +1731,7 @@ static void render_hole_stencil(GRAPH * dest, int sector_id, int min_x,
           if (draw_l_end >= draw_l_start) {
             /* Flag 1 = Clear Z / Stencil */
             draw_plane_column(dest, x, draw_l_start, draw_l_end, 0.0f, NULL, 1,
-                              0, 0, 0, 0.0f, 1.0f);
+                              0, 0, 0, 0.0f, 1.0f, 255, NULL);
           }
         }
       }
@@ -1417,7 +1746,9 @@ static void render_hole_stencil(GRAPH * dest, int sector_id, int min_x,
           }
 
           if (ray_sector_is_solid(child)) {
+            BAND_STAT_TIMER(t_solid);
             render_solid_sector(dest, child_id, min_x, max_x);
+            BAND_STAT_ELAPSED(RAY_STAT_WALLS_MS, t_solid);
           } else {
             render_hole_stencil(dest, child_id, min_x, max_x);
             render_sector(dest, child_id, min_x, max_x, 0, 0);
@@ -1561,9 +1892,13 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
             if (draw_e >= draw_s) {
               int sflags =
                   (sector->flags & 64) ? (sector->flags & (7 | 256)) : 0;
+              RAY_LightmapSurface lm_surf;
               draw_plane_column(dest, x, draw_s, draw_e, sect_ceil, ceil_tex, 0,
                                 0, 0, sflags, sector->liquid_intensity,
-                                sector->liquid_speed);
+                                sector->liquid_speed,
+                              sector->light_level,
+                              lightmap_surface(sector, RAY_LIGHTMAP_CEILING,
+                                               &lm_surf));
             }
           }
 
@@ -1588,9 +1923,13 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
             if (draw_e >= draw_s) {
               int sflags =
                   (sector->flags & 32) ? (sector->flags & (7 | 256)) : 0;
+              RAY_LightmapSurface lm_surf;
               draw_plane_column(dest, x, draw_s, draw_e, sect_floor, floor_tex,
                                 0, 0, 0, sflags, sector->liquid_intensity,
-                                sector->liquid_speed);
+                                sector->liquid_speed,
+                              sector->light_level,
+                              lightmap_surface(sector, RAY_LIGHTMAP_FLOOR,
+                                               &lm_surf));
             }
           }
         }
@@ -1598,9 +1937,14 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
     }
 
     // Recursive rendering function
-    static int sectors_rendered_this_frame = 0; // Debug counter
-    static uint8_t *sector_visited = NULL;      // Visited tracking array
-    static int sector_visited_capacity = 0;
+    // Per-thread: each column band binds its own counter and visited array.
+    static RAY_THREAD_LOCAL int sectors_rendered_this_frame = 0; // Debug
+    static RAY_THREAD_LOCAL uint8_t *sector_visited = NULL; // Visited tracking
+    static RAY_THREAD_LOCAL int sector_visited_capacity = 0;
+
+    // PVS row of the camera sector, fetched once per frame before the bands
+    // start (shared read-only by every band)
+    static const uint8_t *s_pvs_row = NULL;
 
     void render_sector(GRAPH * dest, int sector_id, int min_x, int max_x,
                        int depth, int is_island) {
@@ -1626,16 +1970,9 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
       }
 
       // STATIC PVS CHECK (Pre-computed Visibility)
-      if (!is_island && g_engine.pvs_ready && g_engine.pvs_matrix &&
-          g_engine.camera.current_sector_id >= 0) {
-        int cam_sec = g_engine.camera.current_sector_id;
-        if (cam_sec < g_engine.num_sectors &&
-            sector_id < g_engine.num_sectors) {
-          if (g_engine.pvs_matrix[cam_sec * g_engine.num_sectors + sector_id] ==
-              0) {
-            return; // INVISIBLE according to PVS
-          }
-        }
+      if (!is_island && s_pvs_row && !RAY_PVS_TEST(s_pvs_row, sector_id)) {
+        BAND_STAT_ADD(RAY_STAT_PVS_CULLED, 1);
+        return; // INVISIBLE according to PVS
       }
 
       RAY_Sector *sector = &g_engine.sectors[sector_id];
@@ -1656,8 +1993,11 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
       // ISLAND MODE SETUP
       int saved_mode = g_render_island_mode;
       g_render_island_mode = is_island;
-      if (is_island)
+      if (is_island) {
+        BAND_STAT_TIMER(t_lids);
         render_solid_lids(dest, sector_id, min_x, max_x);
+        BAND_STAT_ELAPSED(RAY_STAT_PLANES_MS, t_lids);
+      }
       for (int w = 0; w < sector->num_walls; w++) {
         RAY_Wall *wall = &sector->walls[w];
 
@@ -1789,13 +2129,14 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
           float d_y1b = (float)(y2_bot - y1_bot) / span;
           float d_ny1b = (float)(ny2_bot - ny1_bot) / span;
 
-          // Starting values at draw_x1
-          float c_y1t = (float)y1_top + d_y1t * (float)(draw_x1 - sx1);
-          float c_ny1t = (float)ny1_top + d_ny1t * (float)(draw_x1 - sx1);
-          float c_y1b = (float)y1_bot + d_y1b * (float)(draw_x1 - sx1);
-          float c_ny1b = (float)ny1_bot + d_ny1b * (float)(draw_x1 - sx1);
-
           for (int x = draw_x1; x <= draw_x2; x++) {
+            // Values at this column, evaluated from sx1 (band-independent)
+            float c_t = (float)(x - sx1);
+            float c_y1t = (float)y1_top + d_y1t * c_t;
+            float c_ny1t = (float)ny1_top + d_ny1t * c_t;
+            float c_y1b = (float)y1_bot + d_y1b * c_t;
+            float c_ny1b = (float)ny1_bot + d_ny1b * c_t;
+
             // Save current state
             saved_umost[x] = umost[x];
             saved_dmost[x] = dmost[x];
@@ -1839,12 +2180,6 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
               dmost[x] = (int16_t)new_bot;
             }
 
-            // Advance interpolators
-            c_y1t += d_y1t;
-            c_ny1t += d_ny1t;
-            c_y1b += d_y1b;
-            c_ny1b += d_ny1b;
-
             // ---------------------------------------------------------
             // PORTAL STEP RENDERING (Upper/Lower Walls)
             // ---------------------------------------------------------
@@ -1924,6 +2259,8 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
 
                   float v_step = (float)tex_upper->height / wall_h_full;
                   float curr_v = (float)(draw_top - cy_top_curr) * v_step;
+                  const RAY_MipChain *mip_upper =
+                      ray_mip_get(g_engine.fpg_id, tex_upper);
 
                   // SAFETY: Check Surface
                   // if (!dest->surface) continue; // Removed
@@ -1957,13 +2294,14 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
                         pix = ray_sample_texture_bilinear(tex_upper, u_coord,
                                                           curr_v);
                       } else {
-                        pix = ray_sample_texture(tex_upper, tex_x, tex_y);
+                        pix = sample_texture_mip(tex_upper, mip_upper, v_step,
+                                                 tex_x, tex_y);
                       }
 
                       if (pix == 0)
                         pix = 0x00FF00;
-                      if (g_engine.fogOn)
-                        pix = ray_fog_pixel(pix, z_depth * halfxdimen);
+                      pix = ray_shade(pix, sector->light_level,
+                                      z_depth * halfxdimen);
 
                       // DIRECT WRITE -> Reverted
                       FAST_PUT_PIXEL(dest, x, y, pix);
@@ -2009,6 +2347,8 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
 
                     float v_step = (float)tex_lower->height / wall_h_full;
                     float curr_v = (float)(draw_top - cy_top_curr) * v_step;
+                    const RAY_MipChain *mip_lower =
+                        ray_mip_get(g_engine.fpg_id, tex_lower);
 
                     for (int y = draw_top; y <= draw_bot; y++) {
                       int pixel_idx = y * g_engine.displayWidth + x;
@@ -2024,12 +2364,13 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
                           pix = ray_sample_texture_bilinear(tex_lower, u_coord,
                                                             curr_v);
                         } else {
-                          pix = ray_sample_texture(tex_lower, tex_x, tex_y);
+                          pix = sample_texture_mip(tex_lower, mip_lower,
+                                                   v_step, tex_x, tex_y);
                         }
                         if (pix == 0)
                           pix = 0x00FF00;
-                        if (g_engine.fogOn)
-                          pix = ray_fog_pixel(pix, z_depth * halfxdimen);
+                        pix = ray_shade(pix, sector->light_level,
+                                        z_depth * halfxdimen);
 
                         FAST_PUT_PIXEL(dest, x, y, pix);
                         g_zbuffer[pixel_idx] = z_depth;
@@ -2055,6 +2396,7 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
 
               // Recursion
               if (portal_visible) {
+                BAND_STAT_ADD(RAY_STAT_PORTALS, 1);
                 render_sector(dest, next_sector_id, draw_x1, draw_x2, depth + 1,
                               is_island);
               }
@@ -2120,11 +2462,11 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
                 float inv_z1 = 1.0f / (z1 > 0.1f ? z1 : 0.1f);
                 float inv_z2 = 1.0f / (z2 > 0.1f ? z2 : 0.1f);
                 float d_inv_z = (inv_z2 - inv_z1) / span;
-                float curr_iz = inv_z1 + d_inv_z * (float)(draw_x1 - sx1);
                 for (int cx = draw_x1; cx <= draw_x2; cx++) {
                   float t = (float)(cx - sx1);
                   int yt = y1_top + (int)(dy_top * t);
                   int yb = y1_bot + (int)(dy_bot * t);
+                  float curr_iz = inv_z1 + d_inv_z * t;
                   if (yt > umost[cx])
                     umost[cx] = (int16_t)yt;
                   if (yb < dmost[cx])
@@ -2134,7 +2476,6 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
                       1.0f / (curr_iz > 0.000001f ? curr_iz : 0.000001f);
                   if (col_z < g_wall_col_depth[cx])
                     g_wall_col_depth[cx] = col_z;
-                  curr_iz += d_inv_z;
                 }
               }
             } else {
@@ -2188,13 +2529,7 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
               int child_id = sector->child_sector_ids[c];
 
               // Find child sector index
-              int child_index = -1;
-              for (int i = 0; i < g_engine.num_sectors; i++) {
-                if (g_engine.sectors[i].sector_id == child_id) {
-                  child_index = i;
-                  break;
-                }
-              }
+              int child_index = ray_sector_index_by_id(&g_engine, child_id);
 
               if (child_index < 0)
                 continue;
@@ -2253,18 +2588,15 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
         // ---------------------------------------------------------
         // BILLBOARD RENDERING (2D Sprites in 3D world)
         // ---------------------------------------------------------
-        static void ray_render_billboard(GRAPH * dest, RAY_Sprite * s) {
-          if (!s || s->textureID <= 0)
-            return;
-
-          // Retrieve texture
-          GRAPH *tex = bitmap_get(g_engine.fpg_id, s->textureID);
-          if (!tex)
-            return;
-
+        /* Billboard of tex centred at pos, world_w x world_h units. Shared
+           by sprites and model impostors. */
+        static void render_billboard_graph(GRAPH * dest, GRAPH * tex,
+                                           float pos_x, float pos_y,
+                                           float pos_z, float world_w,
+                                           float world_h) {
           // 1. Transform sprite to camera space
-          float dx = s->x - g_engine.camera.x;
-          float dy = s->y - g_engine.camera.y;
+          float dx = pos_x - g_engine.camera.x;
+          float dy = pos_y - g_engine.camera.y;
 
           // Camera rotation (optimization: precompute cos/sin if possible, but
           // fast enough here) Note: angles in Bennu are usually handled, here
@@ -2317,7 +2649,7 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
 
           // Z (Height) projection
           // Relative Z
-          float dz = s->z - g_engine.camera.z;
+          float dz = pos_z - g_engine.camera.z;
 
           // Calculate projected height and width
           // Assuming sprite world size matches texture size? Or s->w/h are
@@ -2330,8 +2662,8 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
 
           float scale = fov_scale / rot_x;
 
-          int sprite_screen_w = (int)(s->w * scale);
-          int sprite_screen_h = (int)(s->h * scale);
+          int sprite_screen_w = (int)(world_w * scale);
+          int sprite_screen_h = (int)(world_h * scale);
 
           // Screen Y position (Center - HeightOffset + LookUpDown)
           // Note: In Build/Ray engines, Z decreases upwards? or increases?
@@ -2421,57 +2753,287 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
           }
         }
 
+        static void ray_render_billboard(GRAPH * dest, RAY_Sprite * s) {
+          if (!s || s->textureID <= 0)
+            return;
+
+          // Retrieve texture
+          GRAPH *tex = bitmap_get(g_engine.fpg_id, s->textureID);
+          if (!tex)
+            return;
+          render_billboard_graph(dest, tex, s->x, s->y, s->z, s->w, s->h);
+        }
+
+        static void render_sprite_build(GRAPH * dest, RAY_Sprite * s) {
+          // Calculate distance
+          float dx = s->x - g_engine.camera.x;
+          float dy = s->y - g_engine.camera.y;
+          float dist = sqrtf(dx * dx + dy * dy);
+          s->distance = dist;
+
+          // Model Rendering (MD2 / MD3) or Billboard
+          RAY_STAT_TIMER(t_sprite);
+          RAY_ImpostorDraw imp;
+          void *model = s->model ? ray_model_lod_pick(s, dist, &imp) : NULL;
+          if (s->model && !model) {
+            render_billboard_graph(dest, imp.graph, s->x, s->y, imp.z, imp.w,
+                                   imp.h);
+            RAY_STAT_ELAPSED(RAY_STAT_SPRITES_MS, t_sprite);
+            RAY_STAT_ADD(RAY_STAT_IMPOSTORS, 1);
+          } else if (s->model) {
+            // Draw the chosen LOD through the sprite, then restore it
+            struct RAY_Model *base = s->model;
+            s->model = (struct RAY_Model *)model;
+            // Check magic number (First 4 bytes)
+            int magic = *(int *)s->model;
+
+            if (magic == 844121161) { // "IDP2"
+              ray_render_md2(dest, s);
+            } else if (magic == 860898377) { // "IDP3"
+              ray_render_md3(dest, s);
+            }
+            s->model = base;
+            RAY_STAT_ELAPSED(RAY_STAT_MODELS_MS, t_sprite);
+          } else if (s->textureID > 0) {
+            // Render Billboard (2D Sprite)
+            ray_render_billboard(dest, s);
+            RAY_STAT_ELAPSED(RAY_STAT_SPRITES_MS, t_sprite);
+          }
+          RAY_STAT_ADD(RAY_STAT_SPRITES_DRAWN, 1);
+        }
+
         void render_sprites_and_models(GRAPH * dest) {
           if (!g_engine.initialized || !g_engine.sprites)
             return;
 
-          for (int i = 0; i < g_engine.num_sprites; i++) {
-            RAY_Sprite *s = &g_engine.sprites[i];
+          // Sector visibility: walk only the sprite bins of sectors visited
+          // during BSP traversal. No PVS fallback - if the BSP didn't reach
+          // the sector, the model cannot be visible. Sprites outside every
+          // sector (bin -1) are always considered.
+          int num_bins = g_engine.num_sectors;
+          if (num_bins > g_engine.sector_sprite_head_capacity)
+            num_bins = g_engine.sector_sprite_head_capacity;
+
+          // MD2/MD3 triangles are queued while walking the bins and drawn
+          // in one tiled pass at the end; the z-buffer orders them against
+          // the billboards drawn in between.
+          int own_batch = ray_raster_begin(dest);
+
+          for (int si = -1; si < num_bins; si++) {
+            int head;
+            if (si < 0) {
+              head = g_engine.outside_sprite_head;
+            } else {
+              if (sector_visited && si < sector_visited_capacity &&
+                  !sector_visited[si]) {
+                // Sector not rendered = sprites hidden
+                if (g_engine.stats_enabled) {
+                  for (int i = g_engine.sector_sprite_head[si]; i >= 0;
+                       i = g_engine.sprites[i].bin_next)
+                    RAY_STAT_ADD(RAY_STAT_SPRITES_CULLED, 1);
+                }
+                continue;
+              }
+              head = g_engine.sector_sprite_head[si];
+            }
 
-            if (!s->in_use || s->hidden || s->cleanup)
-              continue;
+            for (int i = head; i >= 0; i = g_engine.sprites[i].bin_next) {
+              RAY_Sprite *s = &g_engine.sprites[i];
+              if (!s->in_use || s->hidden || s->cleanup)
+                continue;
+              render_sprite_build(dest, s);
+            }
+          }
 
-            // Sector visibility check: find which sector this sprite is in
-            // and only render if that sector was rendered this frame
-            int sprite_sector = -1;
-            for (int si = 0; si < g_engine.num_sectors; si++) {
-              if (ray_point_in_sector_local(&g_engine.sectors[si], s->x,
-                                            s->y)) {
-                sprite_sector = si;
-                break;
-              }
+          if (own_batch) {
+            RAY_STAT_TIMER(t_models);
+            ray_raster_flush();
+            RAY_STAT_ELAPSED(RAY_STAT_MODELS_MS, t_models);
+          }
+        }
+
+        /* ---------------------------------------------------------
+           COLUMN-BAND THREADING
+           ---------------------------------------------------------
+           The screen is split into vertical bands [min_x, max_x]. Each band
+           walks the portal graph from the root sector clipped to its own
+           columns, so umost/dmost, g_wall_col_depth, the z-buffer and the
+           coverage buffer are written by exactly one thread per column.
+           Per-column math is band-independent, so the result is identical
+           to the single-threaded path. Band 0 runs on the calling thread;
+           the rest run on persistent SDL worker threads. */
+
+#define RAY_MAX_RENDER_THREADS 16
+#define RAY_MIN_BAND_WIDTH 32
+#define RAY_RENDER_THREAD_STACK (4 * 1024 * 1024)
+
+        typedef struct {
+          GRAPH *dest;
+          int root_sector;
+          int min_x, max_x;
+          uint8_t *visited;
+          int visited_capacity;
+          int sectors_rendered;
+          double stats[RAY_STAT_COUNT];
+        } RAY_RenderBand;
+
+        static RAY_RenderBand s_bands[RAY_MAX_RENDER_THREADS];
+
+        static void render_band(RAY_RenderBand * band) {
+          /* Bind this thread's traversal state to the band */
+          sector_visited = band->visited;
+          sector_visited_capacity = band->visited_capacity;
+          sectors_rendered_this_frame = 0;
+          g_render_island_mode = 0;
+
+          if (sector_visited)
+            memset(sector_visited, 0, sector_visited_capacity);
+
+          t_band_stats = g_engine.stats_enabled ? band->stats : NULL;
+          if (t_band_stats)
+            memset(band->stats, 0, sizeof(band->stats));
+          BAND_STAT_TIMER(t_band);
+
+          render_sector(band->dest, band->root_sector, band->min_x,
+                        band->max_x, 0, 0);
+
+          BAND_STAT_ELAPSED(RAY_STAT_TRAVERSAL_MS, t_band);
+          t_band_stats = NULL;
+          band->sectors_rendered = sectors_rendered_this_frame;
+        }
+
+        /* Band times are CPU time summed over bands; traversal is what is
+           left of each band once its wall and plane drawing is taken out */
+        static void render_band_merge_stats(const RAY_RenderBand * band) {
+          if (!g_engine.stats_enabled)
+            return;
+          for (int i = 0; i < RAY_STAT_COUNT; i++)
+            g_ray_stats_acc[i] += band->stats[i];
+          g_ray_stats_acc[RAY_STAT_TRAVERSAL_MS] -=
+              band->stats[RAY_STAT_WALLS_MS] + band->stats[RAY_STAT_PLANES_MS];
+          g_ray_stats_acc[RAY_STAT_SECTORS] += band->sectors_rendered;
+        }
+
+        /* Worker i renders band i; band 0 is the calling thread's */
+        static void render_band_task(RAY_WorkerPool * pool, int index) {
+          (void)pool;
+          render_band(&s_bands[index]);
+        }
+
+        static RAY_WorkerPool s_band_pool = RAY_POOL_INIT(
+            "ray_band", RAY_RENDER_THREAD_STACK, render_band_task);
+
+        /* The pool follows the thread setting only, so a narrower frame
+           (dynamic resolution) uses fewer bands without respawning
+           threads. Returns the number of bands actually available. */
+        static int render_ensure_workers(int num_bands) {
+          int wanted = ray_pool_thread_setting(RAY_MAX_RENDER_THREADS) - 1;
+          int workers = ray_pool_reserve(&s_band_pool, wanted);
+          return num_bands < workers + 1 ? num_bands : workers + 1;
+        }
+
+        static int render_band_count(void) {
+          int n = ray_pool_thread_setting(RAY_MAX_RENDER_THREADS);
+          if (n > xdimen / RAY_MIN_BAND_WIDTH)
+            n = xdimen / RAY_MIN_BAND_WIDTH;
+          if (n < 1)
+            n = 1;
+          return n;
+        }
+
+        /* Render all sector geometry in column bands. Leaves band 0's
+           visited array (merged with all other bands) bound on the calling
+           thread for render_sprites_and_models. */
+        static void render_sectors_banded(GRAPH * dest, int root_sector) {
+          int num_bands = render_ensure_workers(render_band_count());
+
+          for (int b = 0; b < num_bands; b++) {
+            RAY_RenderBand *band = &s_bands[b];
+            if (!band->visited || band->visited_capacity < g_engine.num_sectors) {
+              free(band->visited);
+              band->visited_capacity = g_engine.num_sectors;
+              band->visited =
+                  (uint8_t *)calloc(band->visited_capacity, sizeof(uint8_t));
+              if (!band->visited)
+                band->visited_capacity = 0;
             }
+            band->dest = dest;
+            band->root_sector = root_sector;
+            band->min_x = (xdimen * b) / num_bands;
+            band->max_x = (xdimen * (b + 1)) / num_bands - 1;
+            band->sectors_rendered = 0;
+          }
 
-            // STRICT: If the sprite's sector wasn't visited during BSP
-            // traversal, skip it completely. No PVS fallback - if the BSP
-            // didn't reach the sector, the model cannot be visible.
-            if (sprite_sector >= 0 && sector_visited &&
-                sprite_sector < sector_visited_capacity) {
-              if (!sector_visited[sprite_sector]) {
-                continue; // Sector not rendered = sprite hidden
-              }
+          ray_pool_dispatch(&s_band_pool, num_bands - 1);
+
+          render_band(&s_bands[0]);
+
+          int total = s_bands[0].sectors_rendered;
+          render_band_merge_stats(&s_bands[0]);
+          ray_pool_wait(&s_band_pool, num_bands - 1);
+          for (int b = 1; b < num_bands; b++) {
+            RAY_RenderBand *band = &s_bands[b];
+            total += band->sectors_rendered;
+            render_band_merge_stats(band);
+            if (band->visited && s_bands[0].visited) {
+              for (int i = 0; i < s_bands[0].visited_capacity &&
+                              i < band->visited_capacity;
+                   i++)
+                s_bands[0].visited[i] |= band->visited[i];
             }
+          }
 
-            // Calculate distance
-            float dx = s->x - g_engine.camera.x;
-            float dy = s->y - g_engine.camera.y;
-            float dist = sqrtf(dx * dx + dy * dy);
-            s->distance = dist;
-
-            // Model Rendering (MD2 / MD3) or Billboard
-            if (s->model) {
-              // Check magic number (First 4 bytes)
-              int magic = *(int *)s->model;
-
-              if (magic == 844121161) { // "IDP2"
-                ray_render_md2(dest, s);
-              } else if (magic == 860898377) { // "IDP3"
-                ray_render_md3(dest, s);
-              }
-            } else if (s->textureID > 0) {
-              // Render Billboard (2D Sprite)
-              ray_render_billboard(dest, s);
+          /* Sprite culling reads this thread's bindings */
+          sector_visited = s_bands[0].visited;
+          sector_visited_capacity = s_bands[0].visited_capacity;
+          sectors_rendered_this_frame = total;
+        }
+
+        void ray_render_build_shutdown(void) {
+          ray_pool_stop(&s_band_pool);
+          for (int b = 0; b < RAY_MAX_RENDER_THREADS; b++) {
+            free(s_bands[b].visited);
+            s_bands[b].visited = NULL;
+            s_bands[b].visited_capacity = 0;
+          }
+          sector_visited = NULL;
+          sector_visited_capacity = 0;
+          if (s_internal_graph) {
+            bitmap_destroy(s_internal_graph);
+            s_internal_graph = NULL;
+          }
+        }
+
+        static void render_frame_build_scene(GRAPH * dest);
+
+        /* Nearest-neighbour upscale of the internal frame; consecutive
+           destination rows that map to the same source row are copied */
+        static void upscale_internal_frame(GRAPH * src, GRAPH * dest) {
+          if (!src->surface || !dest->surface)
+            return;
+          int sw = src->width, sh = src->height;
+          int dw = dest->width, dh = dest->height;
+          int src_pitch = src->surface->pitch >> 2;
+          int dest_pitch = dest->surface->pitch >> 2;
+          const uint32_t *src_pixels = (const uint32_t *)src->surface->pixels;
+          uint32_t *dest_pixels = (uint32_t *)dest->surface->pixels;
+          uint32_t x_step = (uint32_t)(((uint64_t)sw << 16) / dw);
+          uint32_t y_step = (uint32_t)(((uint64_t)sh << 16) / dh);
+
+          int prev_sy = -1;
+          uint32_t sy_fp = 0;
+          for (int y = 0; y < dh; y++, sy_fp += y_step) {
+            int sy = (int)(sy_fp >> 16);
+            uint32_t *row = dest_pixels + y * dest_pitch;
+            if (sy == prev_sy) {
+              memcpy(row, row - dest_pitch, (size_t)dw * sizeof(uint32_t));
+              continue;
             }
+            const uint32_t *src_row = src_pixels + sy * src_pitch;
+            uint32_t sx_fp = 0;
+            for (int x = 0; x < dw; x++, sx_fp += x_step)
+              row[x] = src_row[sx_fp >> 16];
+            prev_sy = sy;
           }
         }
 
@@ -2479,16 +3041,59 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
           if (!dest || !g_engine.initialized)
             return;
 
-          // PERFORMANCE DIAGNOSTICS
-          static int frame_count = 0;
-          static int sectors_rendered_total = 0;
-          static int sectors_culled_pvs_total = 0;
-          static double total_frame_time = 0.0;
-          struct timespec start_time, end_time;
-          clock_gettime(CLOCK_MONOTONIC, &start_time);
+          int iw = g_engine.internalWidth, ih = g_engine.internalHeight;
+          if (iw <= 0 || ih <= 0 ||
+              (iw >= g_engine.displayWidth && ih >= g_engine.displayHeight)) {
+            render_frame_build_scene(dest);
+            RAY_STAT_TIMER(t_commit);
+            frame_commit(dest);
+            RAY_STAT_ELAPSED(RAY_STAT_COMMIT_MS, t_commit);
+            return;
+          }
+
+          if (s_internal_graph && ((int)s_internal_graph->width != iw ||
+                                   (int)s_internal_graph->height != ih)) {
+            bitmap_destroy(s_internal_graph);
+            s_internal_graph = NULL;
+          }
+          if (!s_internal_graph)
+            s_internal_graph = bitmap_new_syslib(iw, ih);
+          if (!s_internal_graph) {
+            render_frame_build_scene(dest);
+            frame_commit(dest);
+            return;
+          }
+
+          /* The whole software pipeline sizes itself from displayWidth/
+             displayHeight, so render with the internal size in place and
+             scale the screen-space pitch to match */
+          int display_w = g_engine.displayWidth;
+          int display_h = g_engine.displayHeight;
+          float pitch = g_engine.camera.pitch;
+          g_engine.displayWidth = iw;
+          g_engine.displayHeight = ih;
+          g_engine.camera.pitch = pitch * (float)ih / (float)display_h;
+
+          render_frame_build_scene(s_internal_graph);
 
+          g_engine.displayWidth = display_w;
+          g_engine.displayHeight = display_h;
+          g_engine.camera.pitch = pitch;
+
+          RAY_STAT_TIMER(t_commit);
+          upscale_internal_frame(s_internal_graph, dest);
+          frame_commit(dest);
+          RAY_STAT_ELAPSED(RAY_STAT_COMMIT_MS, t_commit);
+        }
+
+        static void render_frame_build_scene(GRAPH * dest) {
+          /* Shade tables: only rebuilt when the effective fog changed */
+          ray_shade_prepare();
+
+          // Periodic diagnostics only with RAY_SET_VERBOSE(2); timings are
+          // in RAY_GET_STAT
           static int frame_debug = 0;
-          if (frame_debug++ % 120 == 0) {
+          if (g_engine.verbose >= 2 && frame_debug++ % 120 == 0) {
             printf("DEBUG: SkyID=%d FPG=%d Internal=%dx%d Display=%dx%d\n",
                    g_engine.skyTextureID, g_engine.fpg_id,
                    g_engine.internalWidth, g_engine.internalHeight,
@@ -2574,80 +3179,14 @@ static void render_solid_lids(GRAPH * dest, int sector_id, int min_x, int max_x)
                 g_engine.sectors[render_start_sector].parent_sector_id;
           }
 
-          // Initialize visited tracking array
-          if (!sector_visited ||
-              sector_visited_capacity < g_engine.num_sectors) {
-            if (sector_visited)
-              free(sector_visited);
-            sector_visited_capacity = g_engine.num_sectors;
-            sector_visited =
-                (uint8_t *)calloc(sector_visited_capacity, sizeof(uint8_t));
-          } else {
-            // Clear visited array for new frame
-            memset(sector_visited, 0,
-                   sector_visited_capacity * sizeof(uint8_t));
-          }
-
-          // Reset sector counter
-          sectors_rendered_this_frame = 0;
-
-          // Profiling timers
-          struct timespec prof_start, prof_end;
-          clock_gettime(CLOCK_MONOTONIC, &prof_start);
+          s_pvs_row = ray_pvs_row(ray_sector_index_by_id(
+              &g_engine, g_engine.camera.current_sector_id));
 
           // Build Engine standard: Render camera sector and recursively through
-          // portals All visible geometry MUST be connected by portals
-          render_sector(dest, render_start_sector, 0, xdimen - 1, 0, 0);
-
-          clock_gettime(CLOCK_MONOTONIC, &prof_end);
-          double sector_time =
-              (prof_end.tv_sec - prof_start.tv_sec) * 1000.0 +
-              (prof_end.tv_nsec - prof_start.tv_nsec) / 1000000.0;
+          // portals All visible geometry MUST be connected by portals.
+          // Visited tracking and the sector counter are reset per band.
+          render_sectors_banded(dest, render_start_sector);
 
           // Draw Sprites/Models
-          clock_gettime(CLOCK_MONOTONIC, &prof_start);
           render_sprites_and_models(dest);
-          clock_gettime(CLOCK_MONOTONIC, &prof_end);
-          double sprite_time =
-              (prof_end.tv_sec - prof_start.tv_sec) * 1000.0 +
-              (prof_end.tv_nsec - prof_start.tv_nsec) / 1000000.0;
-
-          // Commit software buffer to GPU texture
-          frame_commit(dest);
-
-          // PERFORMANCE MEASUREMENT
-          clock_gettime(CLOCK_MONOTONIC, &end_time);
-          double frame_time =
-              (end_time.tv_sec - start_time.tv_sec) * 1000.0 +
-              (end_time.tv_nsec - start_time.tv_nsec) / 1000000.0;
-
-          total_frame_time += frame_time;
-          frame_count++;
-
-          // Print stats every 60 frames
-          if (frame_count % 60 == 0) {
-            double avg_frame_time = total_frame_time / 60.0;
-            double fps = 1000.0 / avg_frame_time;
-
-            printf("=== PERFORMANCE STATS (60 frames) ===\n");
-            printf("Display Resolution: %dx%d\n", g_engine.displayWidth,
-                   g_engine.displayHeight);
-            printf("Internal Resolution: %dx%d (%.0f%%)\n",
-                   g_engine.internalWidth, g_engine.internalHeight,
-                   g_engine.resolutionScale * 100.0f);
-            printf("Avg Frame Time: %.2f ms (Sectors: %.2f ms, Sprites: %.2f "
-                   "ms)\n",
-                   avg_frame_time, sector_time, sprite_time);
-            printf("FPS: %.1f\n", fps);
-            printf("Sectors Rendered Last Frame: %d / %d\n",
-                   sectors_rendered_this_frame, g_engine.num_sectors);
-            printf("Total Sectors: %d\n", g_engine.num_sectors);
-            printf("PVS Ready: %s\n", g_engine.pvs_ready ? "YES" : "NO");
-            printf("Camera Sector: %d\n", camera_sector_id);
-            printf("=====================================\n");
-
-            total_frame_time = 0.0;
-            sectors_rendered_total = 0;
-            sectors_culled_pvs_total = 0;
-          }
         }
@@ -39,6 +39,31 @@ extern GPU_Target *gRenderer;
 void ray_render_scene_gpu(GPU_Target *target, int current_sector);
 static void render_sprite_gpu(GPU_Target *target, RAY_Sprite *sprite);
 
+/* ============================================================================
+   DRAW CALL ACCOUNTING
+   ============================================================================
+ */
+
+static GPU_Image *s_last_batch_image = NULL; /* Cambios de textura */
+
+/* Todas las llamadas de dibujo pasan por aquí para que RAY_GET_STAT cuente
+   draw calls y triángulos sin tocar cada sitio por separado. */
+static inline void gpu_triangle_batch(GPU_Image *image, GPU_Target *target,
+                                      unsigned short num_vertices,
+                                      float *values, unsigned int num_indices,
+                                      unsigned short *indices,
+                                      GPU_BatchFlagEnum flags) {
+  RAY_STAT_ADD(RAY_STAT_DRAW_CALLS, 1);
+  RAY_STAT_ADD(RAY_STAT_TRIANGLES,
+               (indices ? num_indices : num_vertices) / 3);
+  if (image != s_last_batch_image) {
+    RAY_STAT_ADD(RAY_STAT_TEXTURE_SWITCHES, 1);
+    s_last_batch_image = image;
+  }
+  GPU_TriangleBatch(image, target, num_vertices, values, num_indices,
+                    indices, flags);
+}
+
 /* ============================================================================
    CONSTANTS
    ============================================================================
@@ -107,15 +132,39 @@ static inline int clip_valid(ClipRect c) {
    ============================================================================
  */
 
+/* Resolved (fpg, code) -> GPU_Image, direct-mapped: a collision only costs
+   a bitmap_get. Misses are not cached (the graph may be loaded later).
+   Entries point into the FPG, which the script can unload or reload at any
+   time, so gpu_textures_begin_frame() checks every entry against
+   bitmap_get once per frame and drops the ones whose graph changed */
+#define GPU_TEX_CACHE_SIZE 1024 /* Power of two */
+
+typedef struct {
+  int fid, texture_id; /* texture_id 0 = empty */
+  GRAPH *graph;        /* Graph the image came from */
+  GPU_Image *img;
+} GPUTexCacheEntry;
+
+static GPUTexCacheEntry s_tex_cache[GPU_TEX_CACHE_SIZE];
+
 static GPU_Image *get_gpu_texture(int file_id, int texture_id) {
   if (texture_id <= 0)
     return NULL;
 
   int fid = (file_id > 0) ? file_id : g_engine.fpg_id;
+  unsigned h = ((unsigned)fid * 2654435761u) ^ (unsigned)texture_id;
+  GPUTexCacheEntry *e = &s_tex_cache[h & (GPU_TEX_CACHE_SIZE - 1)];
+  if (e->texture_id == texture_id && e->fid == fid)
+    return e->img;
+
   GRAPH *gr = bitmap_get((int64_t)fid, (int64_t)texture_id);
   if (!gr || !gr->tex)
     return NULL;
-  return (GPU_Image *)gr->tex;
+  e->fid = fid;
+  e->texture_id = texture_id;
+  e->graph = gr;
+  e->img = (GPU_Image *)gr->tex;
+  return e->img;
 }
 
 /* ============================================================================
@@ -124,11 +173,7 @@ static GPU_Image *get_gpu_texture(int file_id, int texture_id) {
  */
 
 static RAY_Sector *find_sector_by_id(int sector_id) {
-  for (int i = 0; i < g_engine.num_sectors; i++) {
-    if (g_engine.sectors[i].sector_id == sector_id)
-      return &g_engine.sectors[i];
-  }
-  return NULL;
+  return ray_sector_by_id(&g_engine, sector_id);
 }
 
 /* ============================================================================
@@ -160,9 +205,11 @@ static float s_cos_ang, s_sin_ang;
 static float s_focal;
 static int s_half_w, s_half_h, s_screen_w, s_screen_h;
 static int s_horizon;
+static const uint8_t *s_pvs_row; /* PVS row of the camera sector (or NULL) */
 
 /* ============================================================================
-   ISLAND SECTOR CACHE (pre-built each frame for sprite occlusion)
+   ISLAND SECTOR CACHE (built once per tick by ray_gpu_prepare_scene and
+   shared by every view rendered in it)
    ============================================================================
  */
 #define MAX_ISLAND_SECTORS 256
@@ -170,6 +217,185 @@ static RAY_Sector *s_island_sectors[MAX_ISLAND_SECTORS];
 static float s_island_floor[MAX_ISLAND_SECTORS];
 static float s_island_ceil[MAX_ISLAND_SECTORS];
 static int s_num_islands = 0;
+static RAY_Sector *s_island_owner = NULL; /* g_engine.sectors at build */
+
+/* ============================================================================
+   STATIC SECTOR CACHE (built at map load)
+   Wall XY geometry never changes after loading (doors only move heights),
+   so everything that depends on it alone is computed once here instead of
+   per wall per frame.
+   ============================================================================
+ */
+
+typedef struct {
+  float tan_x, tan_y; /* Unit direction (x1,y1) -> (x2,y2) */
+  int portal_index;   /* Index into g_engine.portals, -1 = solid */
+} GPUWallStatic;
+
+typedef struct {
+  int first_wall;
+  int num_walls;
+  int convex;
+  float min_x, min_y, max_x, max_y; /* Vertex bounds (island lid UVs) */
+} GPUSectorStatic;
+
+static GPUSectorStatic *s_gpu_sectors = NULL;
+static GPUWallStatic *s_gpu_walls = NULL;
+static int s_gpu_num_sectors = 0;
+static RAY_Sector *s_gpu_cache_owner = NULL; /* g_engine.sectors at build */
+
+/* ============================================================================
+   INTERNAL RESOLUTION TARGET
+   ============================================================================
+ */
+
+static GPU_Image *s_internal_image = NULL;
+
+static GPU_Target *gpu_internal_target(int w, int h) {
+  if (s_internal_image &&
+      (s_internal_image->w != (Uint16)w || s_internal_image->h != (Uint16)h)) {
+    GPU_FreeImage(s_internal_image);
+    s_internal_image = NULL;
+  }
+  if (!s_internal_image) {
+    s_internal_image = GPU_CreateImage(w, h, GPU_FORMAT_RGBA);
+    if (!s_internal_image)
+      return NULL;
+    GPU_SetImageFilter(s_internal_image, GPU_FILTER_LINEAR);
+    if (!GPU_LoadTarget(s_internal_image)) {
+      GPU_FreeImage(s_internal_image);
+      s_internal_image = NULL;
+      return NULL;
+    }
+    GPU_AddDepthBuffer(s_internal_image->target);
+  }
+  return s_internal_image->target;
+}
+
+static void gpu_free_lightmap(void);
+static void gpu_atlas_release(void);
+
+void ray_gpu_free_internal_target(void) {
+  if (s_internal_image) {
+    GPU_FreeImage(s_internal_image);
+    s_internal_image = NULL;
+  }
+  gpu_free_lightmap();
+  gpu_atlas_release();
+}
+
+void ray_gpu_free_sector_cache(void) {
+  free(s_gpu_sectors);
+  free(s_gpu_walls);
+  s_gpu_sectors = NULL;
+  s_gpu_walls = NULL;
+  s_gpu_num_sectors = 0;
+  s_gpu_cache_owner = NULL;
+  s_num_islands = 0;
+  s_island_owner = NULL;
+}
+
+static int sector_is_convex(const RAY_Sector *sector) {
+  if (sector->num_walls < 3)
+    return 1;
+  int sign = 0;
+  for (int w = 0; w < sector->num_walls; w++) {
+    int w1 = (w + 1) % sector->num_walls;
+    int w2 = (w + 2) % sector->num_walls;
+    float ax = sector->walls[w1].x1 - sector->walls[w].x1;
+    float ay = sector->walls[w1].y1 - sector->walls[w].y1;
+    float bx = sector->walls[w2].x1 - sector->walls[w1].x1;
+    float by = sector->walls[w2].y1 - sector->walls[w1].y1;
+    float cross = ax * by - ay * bx;
+    if (cross > 0.01f) {
+      if (sign < 0)
+        return 0;
+      sign = 1;
+    } else if (cross < -0.01f) {
+      if (sign > 0)
+        return 0;
+      sign = -1;
+    }
+  }
+  return 1;
+}
+
+void ray_gpu_build_sector_cache(RAY_Engine *engine) {
+  ray_gpu_free_sector_cache();
+  if (!engine || !engine->sectors || engine->num_sectors <= 0)
+    return;
+
+  int total_walls = 0;
+  for (int i = 0; i < engine->num_sectors; i++)
+    total_walls += engine->sectors[i].num_walls;
+
+  s_gpu_sectors = (GPUSectorStatic *)calloc(engine->num_sectors,
+                                            sizeof(GPUSectorStatic));
+  s_gpu_walls = (GPUWallStatic *)calloc(total_walls > 0 ? total_walls : 1,
+                                        sizeof(GPUWallStatic));
+  if (!s_gpu_sectors || !s_gpu_walls) {
+    ray_gpu_free_sector_cache();
+    return;
+  }
+
+  int next_wall = 0;
+  for (int i = 0; i < engine->num_sectors; i++) {
+    RAY_Sector *sector = &engine->sectors[i];
+    GPUSectorStatic *st = &s_gpu_sectors[i];
+    st->first_wall = next_wall;
+    st->num_walls = sector->num_walls;
+    st->convex = sector_is_convex(sector);
+
+    for (int w = 0; w < sector->num_walls; w++) {
+      RAY_Wall *wall = &sector->walls[w];
+      GPUWallStatic *ws = &s_gpu_walls[next_wall++];
+      float dx = wall->x2 - wall->x1;
+      float dy = wall->y2 - wall->y1;
+      float len = sqrtf(dx * dx + dy * dy);
+      if (len < 0.001f)
+        len = 1.0f;
+      ws->tan_x = dx / len;
+      ws->tan_y = dy / len;
+
+      ws->portal_index = -1;
+      if (wall->portal_id != -1) {
+        for (int p = 0; p < engine->num_portals; p++) {
+          if (engine->portals[p].portal_id == wall->portal_id) {
+            ws->portal_index = p;
+            break;
+          }
+        }
+      }
+
+      if (w == 0 || wall->x1 < st->min_x)
+        st->min_x = wall->x1;
+      if (w == 0 || wall->x1 > st->max_x)
+        st->max_x = wall->x1;
+      if (w == 0 || wall->y1 < st->min_y)
+        st->min_y = wall->y1;
+      if (w == 0 || wall->y1 > st->max_y)
+        st->max_y = wall->y1;
+    }
+  }
+
+  s_gpu_num_sectors = engine->num_sectors;
+  s_gpu_cache_owner = engine->sectors;
+}
+
+/* Static data for a sector, rebuilding if the map changed under us.
+   NULL only if the cache could not be allocated. */
+static const GPUSectorStatic *gpu_sector_static(RAY_Sector *sector) {
+  int index = (int)(sector - g_engine.sectors);
+  if (s_gpu_cache_owner != g_engine.sectors ||
+      s_gpu_num_sectors != g_engine.num_sectors || index < 0 ||
+      index >= s_gpu_num_sectors ||
+      s_gpu_sectors[index].num_walls != sector->num_walls) {
+    ray_gpu_build_sector_cache(&g_engine);
+    if (!s_gpu_sectors || index < 0 || index >= s_gpu_num_sectors)
+      return NULL;
+  }
+  return &s_gpu_sectors[index];
+}
 
 /* ============================================================================
    NORMAL MAPPING SHADER
@@ -199,6 +425,10 @@ static int s_u_fogColor = -1;
 static int s_u_fogDensity = -1;
 static int s_u_fogStart = -1;
 static int s_u_fogEnd = -1;
+static int s_u_lightMap = -1;
+static int s_u_useLightmap = -1;
+static int s_u_useAtlas = -1;
+static int s_u_atlas = -1;
 
 static const char *vertex_shader_source =
     "#version 120\n"
@@ -242,6 +472,10 @@ static const char *fragment_shader_source =
     "uniform float u_fogDensity;\n"
     "uniform float u_fogStart;\n"
     "uniform float u_fogEnd;\n"
+    "uniform sampler2D lightMap;\n"
+    "uniform int u_useLightmap; // colorVarying.rg = atlas coords\n"
+    "uniform int u_useAtlas; // colorVarying.b = texture layer + 1\n"
+    "uniform vec4 u_atlas; // cells per row, cell, padding, tile (UV)\n"
     "void main() {\n"
     "    vec2 finalUV = uv;\n"
     "    float fFlags = float(u_sectorFlags) + 0.1;\n"
@@ -275,7 +509,19 @@ static const char *fragment_shader_source =
     "    if (scrollX) finalUV.x += effectiveTime * 1.0;\n"
     "    if (scrollY) finalUV.y += effectiveTime * 1.0;\n"
     "\n"
-    "    vec4 texColor = texture2D(tex, finalUV) * colorVarying;\n"
+    "    if (u_useAtlas != 0 && colorVarying.b > 0.5) {\n"
+    "        float layer = floor(colorVarying.b - 0.5);\n"
+    "        float row = floor(layer / u_atlas.x);\n"
+    "        vec2 cell = vec2(layer - row * u_atlas.x, row);\n"
+    "        finalUV = cell * u_atlas.y + u_atlas.z + fract(finalUV) * "
+    "u_atlas.w;\n"
+    "    }\n"
+    "    vec4 texColor = texture2D(tex, finalUV);\n"
+    "    vec3 baked = vec3(0.0);\n"
+    "    if (u_useLightmap != 0)\n"
+    "        baked = texture2D(lightMap, colorVarying.rg).rgb * 2.0;\n"
+    "    else if (u_useAtlas == 0)\n"
+    "        texColor *= colorVarying;\n"
     "    if (isWater || isLava || isAcid) texColor.a *= 0.5;\n"
     "    if (u_time < 0.001) texColor.rgb *= 0.1; // Visual Debug: if time "
     "stalls, darken\n"
@@ -320,6 +566,7 @@ static const char *fragment_shader_source =
     "    }\n"
     "\n"
     "    if (u_numLights <= 0) {\n"
+    "        if (u_useLightmap != 0) finalRGB *= vec3(0.2) + baked;\n"
     "        gl_FragColor = vec4(finalRGB, texColor.a);\n"
     "        return;\n"
     "    }\n"
@@ -334,13 +581,16 @@ static const char *fragment_shader_source =
     "        worldNormal = normalize(nm.x * u_tangent + nm.y * u_bitangent + "
     "nm.z * u_normal);\n"
     "    }\n"
-    "    vec3 finalLight = vec3(0.2, 0.2, 0.2);\n"
+    "    vec3 finalLight = vec3(0.2, 0.2, 0.2) + baked;\n"
     "    for(int i = 0; i < 16; i++) {\n"
     "        if (i >= u_numLights) break;\n"
     "        vec3 lightVector = u_lightPos[i] - vPos;\n"
     "        float distSq = dot(lightVector, lightVector);\n"
     "        float radSq = u_lightIntensity[i] * u_lightIntensity[i];\n"
     "        float attenuation = radSq / (radSq + distSq + 1.0);\n"
+    "        float fade = clamp(1.0 - distSq / (16.0 * radSq + 1.0), 0.0, "
+    "1.0);\n"
+    "        attenuation *= fade * fade; // Zero at RAY_LIGHT_RANGE\n"
     "        vec3 L = normalize(lightVector);\n"
     "        float diff = max(dot(worldNormal, L), 0.0);\n"
     "        finalLight += u_lightColor[i] * (0.5 + 0.5 * diff) * attenuation "
@@ -390,72 +640,503 @@ static void init_normal_shader(void) {
   s_u_fogDensity = GPU_GetUniformLocation(s_normal_shader, "u_fogDensity");
   s_u_fogStart = GPU_GetUniformLocation(s_normal_shader, "u_fogStart");
   s_u_fogEnd = GPU_GetUniformLocation(s_normal_shader, "u_fogEnd");
+  s_u_lightMap = GPU_GetUniformLocation(s_normal_shader, "lightMap");
+  s_u_useLightmap = GPU_GetUniformLocation(s_normal_shader, "u_useLightmap");
+  s_u_useAtlas = GPU_GetUniformLocation(s_normal_shader, "u_useAtlas");
+  s_u_atlas = GPU_GetUniformLocation(s_normal_shader, "u_atlas");
 }
 
-static void activate_normal_shader(GPU_Image *normalMap, float tx, float ty,
-                                   float tz, float bx, float by, float bz,
-                                   float nx, float ny, float nz,
-                                   int sectorFlags, float liquidIntensity,
-                                   float liquidSpeed, float fogR, float fogG,
-                                   float fogB, float fogDensity, float fogStart,
-                                   float fogEnd) {
-  init_normal_shader();
-  if (s_normal_shader == 0)
+/* ============================================================================
+   TEXTURE ATLAS (RAY_SET_TEXTURE_ATLAS)
+   The map's RAY_TEXTURE_SIZE wall/floor/ceiling textures are copied into
+   one image, each in a cell padded with its own wrapped edges. Surfaces
+   using them bind the atlas and send their cell in the colour attribute;
+   the shader wraps the UVs inside the cell, so wall batches join across
+   textures. GLSL 1.20 has no array textures, hence cells instead of
+   layers. Other sizes, normal maps and sprites keep their own image.
+   ============================================================================
+ */
+
+#define GPU_ATLAS_SIZE 2048
+#define GPU_ATLAS_PAD 4 /* Wrapped texels around each cell (bilinear) */
+#define GPU_ATLAS_CELL (RAY_TEXTURE_SIZE + 2 * GPU_ATLAS_PAD)
+#define GPU_ATLAS_COLS (GPU_ATLAS_SIZE / GPU_ATLAS_CELL)
+#define GPU_ATLAS_SLOTS 512 /* Power of two, > GPU_ATLAS_COLS^2 */
+
+static GPU_Image *s_atlas_image = NULL;
+static int s_atlas_layers = 0;
+static int s_atlas_active = 0; /* This frame binds the atlas */
+static const RAY_Sector *s_atlas_owner = NULL;
+static int s_atlas_num_sectors = -1;
+static struct {
+  GPU_Image *img;
+  int layer;
+} s_atlas_slots[GPU_ATLAS_SLOTS];
+
+static unsigned atlas_slot(const GPU_Image *img) {
+  uintptr_t p = (uintptr_t)img;
+  return (unsigned)((p >> 4) ^ (p >> 13)) & (GPU_ATLAS_SLOTS - 1);
+}
+
+/* Cell of a texture in the atlas, or -1 */
+static int gpu_atlas_layer(const GPU_Image *img) {
+  if (!s_atlas_active || !img)
+    return -1;
+  for (unsigned i = atlas_slot(img);; i = (i + 1) & (GPU_ATLAS_SLOTS - 1)) {
+    if (s_atlas_slots[i].img == img)
+      return s_atlas_slots[i].layer;
+    if (!s_atlas_slots[i].img)
+      return -1;
+  }
+}
+
+static void gpu_atlas_release(void) {
+  if (s_atlas_image) {
+    GPU_FreeImage(s_atlas_image);
+    s_atlas_image = NULL;
+  }
+  memset(s_atlas_slots, 0, sizeof(s_atlas_slots));
+  s_atlas_layers = 0;
+  s_atlas_owner = NULL;
+  s_atlas_num_sectors = -1;
+}
+
+static void gpu_atlas_add(GPU_Target *atlas, int texture_id) {
+  GPU_Image *img = get_gpu_texture(0, texture_id);
+  if (!img || img->w != RAY_TEXTURE_SIZE || img->h != RAY_TEXTURE_SIZE)
+    return;
+  if (gpu_atlas_layer(img) >= 0 ||
+      s_atlas_layers >= GPU_ATLAS_COLS * GPU_ATLAS_COLS)
     return;
-  GPU_ActivateShaderProgram(s_normal_shader, &s_normal_block);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-  GPU_SetUniformi(s_u_tex, 0);       /* Texture unit 0 */
-  GPU_SetUniformi(s_u_normalMap, 1); /* Texture unit 1 */
+  int layer = s_atlas_layers++;
+  float cx = (float)((layer % GPU_ATLAS_COLS) * GPU_ATLAS_CELL);
+  float cy = (float)((layer / GPU_ATLAS_COLS) * GPU_ATLAS_CELL);
+  unsigned i = atlas_slot(img);
+  while (s_atlas_slots[i].img)
+    i = (i + 1) & (GPU_ATLAS_SLOTS - 1);
+  s_atlas_slots[i].img = img;
+  s_atlas_slots[i].layer = layer;
+
+  /* Exact copy: 3x3 tiles clipped to the padded cell */
+  GPU_FilterEnum filter = img->filter_mode;
+  GPU_bool blending = GPU_GetBlending(img);
+  GPU_SetImageFilter(img, GPU_FILTER_NEAREST);
+  GPU_SetBlending(img, 0);
+  GPU_SetClip(atlas, (Sint16)cx, (Sint16)cy, GPU_ATLAS_CELL, GPU_ATLAS_CELL);
+  for (int ty = -1; ty <= 1; ty++) {
+    for (int tx = -1; tx <= 1; tx++) {
+      GPU_Rect dst = {cx + GPU_ATLAS_PAD + tx * RAY_TEXTURE_SIZE,
+                      cy + GPU_ATLAS_PAD + ty * RAY_TEXTURE_SIZE,
+                      RAY_TEXTURE_SIZE, RAY_TEXTURE_SIZE};
+      GPU_BlitRect(img, NULL, atlas, &dst);
+    }
+  }
+  GPU_FlushBlitBuffer();
+  GPU_SetBlending(img, blending);
+  GPU_SetImageFilter(img, filter);
+}
 
-  if (normalMap) {
-    GPU_SetUniformi(s_u_useNormalMap, 1);
-    /* Bind normal map to unit 1 using SDL_gpu */
-    GPU_SetShaderImage(normalMap, s_u_normalMap, 1);
-    GPU_SetBlendMode(normalMap, GPU_BLEND_NORMAL);
-  } else {
-    GPU_SetUniformi(s_u_useNormalMap, 0);
+/* (Re)build for the current map; no-op while it stays valid */
+static void gpu_atlas_sync(void) {
+  if (s_atlas_owner == g_engine.sectors &&
+      s_atlas_num_sectors == g_engine.num_sectors)
+    return;
+  gpu_atlas_release();
+  s_atlas_owner = g_engine.sectors;
+  s_atlas_num_sectors = g_engine.num_sectors;
+
+  s_atlas_image = GPU_CreateImage(GPU_ATLAS_SIZE, GPU_ATLAS_SIZE,
+                                  GPU_FORMAT_RGBA);
+  GPU_Target *atlas = s_atlas_image ? GPU_LoadTarget(s_atlas_image) : NULL;
+  if (!atlas) {
+    if (s_atlas_image)
+      GPU_FreeImage(s_atlas_image);
+    s_atlas_image = NULL;
+    return;
+  }
+  GPU_SetImageFilter(s_atlas_image, GPU_FILTER_LINEAR);
+  GPU_Clear(atlas);
+
+  /* s_atlas_active gates gpu_atlas_layer, which gpu_atlas_add relies on */
+  s_atlas_active = 1;
+  for (int i = 0; i < g_engine.num_sectors; i++) {
+    const RAY_Sector *sector = &g_engine.sectors[i];
+    gpu_atlas_add(atlas, sector->floor_texture_id);
+    gpu_atlas_add(atlas, sector->ceiling_texture_id);
+    for (int w = 0; w < sector->num_walls; w++) {
+      gpu_atlas_add(atlas, sector->walls[w].texture_id_upper);
+      gpu_atlas_add(atlas, sector->walls[w].texture_id_middle);
+      gpu_atlas_add(atlas, sector->walls[w].texture_id_lower);
+    }
+  }
+  GPU_UnsetClip(atlas);
+  if (g_engine.verbose)
+    printf("RAY: Texture atlas %d/%d cells\n", s_atlas_layers,
+           GPU_ATLAS_COLS * GPU_ATLAS_COLS);
+}
+
+static void gpu_atlas_begin_frame(void) {
+  s_atlas_active = 0;
+  if (!g_engine.texture_atlas || g_engine.num_sectors <= 0) {
+    if (s_atlas_image)
+      gpu_atlas_release();
+    return;
+  }
+  gpu_atlas_sync();
+  s_atlas_active = (s_atlas_image && s_atlas_layers > 0);
+}
+
+void ray_gpu_invalidate_textures(void) {
+  memset(s_tex_cache, 0, sizeof(s_tex_cache));
+  gpu_atlas_release();
+  s_last_batch_image = NULL;
+}
+
+/* Before anything of the frame binds a cached image. One bitmap_get per
+   cached texture; a graph that was unloaded or replaced drops its entry,
+   and the atlas (keyed on the image pointers) is rebuilt */
+static void gpu_textures_begin_frame(void) {
+  int changed = 0;
+  for (int i = 0; i < GPU_TEX_CACHE_SIZE; i++) {
+    GPUTexCacheEntry *e = &s_tex_cache[i];
+    if (e->texture_id <= 0)
+      continue;
+    GRAPH *gr = bitmap_get((int64_t)e->fid, (int64_t)e->texture_id);
+    if (gr && gr == e->graph && (GPU_Image *)gr->tex == e->img)
+      continue;
+    memset(e, 0, sizeof(*e));
+    changed = 1;
+  }
+  if (changed) {
+    gpu_atlas_release();
+    s_last_batch_image = NULL;
+  }
+}
+
+/* ============================================================================
+   LIGHTMAP
+   With a baked atlas (ray_lightmap_active) every sector surface of the
+   frame carries its atlas coords in the colour attribute, so all draws use
+   GPU_BATCH_XYZ_ST_RGBA; the shader adds the baked light to the ambient and
+   the light sets below only hold the lights added after the bake. The
+   texture atlas shares that layout (cell in colour.b).
+   ============================================================================
+ */
+
+static GPU_Image *s_lightmap_image = NULL;
+static uint32_t s_lightmap_serial = 0;
+static int s_lm_active = 0; /* This frame samples the atlas */
+static int s_vert_floats = 5;
+static GPU_BatchFlagEnum s_vert_flags = GPU_BATCH_XYZ_ST;
+static float *s_layout_buf = NULL; /* gpu_layout_verts output */
+static int s_layout_cap = 0;
+
+/* Atlas coords as an affine function of a surface's (s, t) */
+typedef struct {
+  float u0, us, v0, vt;
+  float lo_u, hi_u, lo_v, hi_v; /* Walls clamp to their rect */
+  int clamp;
+} GPULightmapMap;
+
+static void gpu_free_lightmap(void) {
+  if (s_lightmap_image) {
+    GPU_FreeImage(s_lightmap_image);
+    s_lightmap_image = NULL;
+  }
+  free(s_layout_buf);
+  s_layout_buf = NULL;
+  s_layout_cap = 0;
+}
+
+/* Upload the atlas when it changed; returns whether this frame uses it */
+static int gpu_lightmap_sync(void) {
+  const RAY_Lightmap *lm = &g_engine.lightmap;
+  if (!ray_lightmap_active()) {
+    if (s_lightmap_image) {
+      GPU_FreeImage(s_lightmap_image);
+      s_lightmap_image = NULL;
+    }
+    return 0;
+  }
+  if (s_lightmap_image && s_lightmap_serial == lm->serial)
+    return 1;
+  if (s_lightmap_image && (s_lightmap_image->w != (Uint16)lm->width ||
+                           s_lightmap_image->h != (Uint16)lm->height)) {
+    GPU_FreeImage(s_lightmap_image);
+    s_lightmap_image = NULL;
+  }
+  if (!s_lightmap_image) {
+    s_lightmap_image = GPU_CreateImage(lm->width, lm->height, GPU_FORMAT_RGBA);
+    if (!s_lightmap_image)
+      return 0;
+    GPU_SetImageFilter(s_lightmap_image, GPU_FILTER_LINEAR);
+    GPU_SetWrapMode(s_lightmap_image, GPU_WRAP_NONE, GPU_WRAP_NONE);
+  }
+  GPU_UpdateImageBytes(s_lightmap_image, NULL, lm->rgba, lm->width * 4);
+  s_lightmap_serial = lm->serial;
+  return 1;
+}
+
+static void gpu_lightmap_begin_frame(void) {
+  s_lm_active = gpu_lightmap_sync();
+  int rgba = s_lm_active || s_atlas_active;
+  s_vert_floats = rgba ? 9 : 5;
+  s_vert_flags = rgba ? GPU_BATCH_XYZ_ST_RGBA : GPU_BATCH_XYZ_ST;
+}
+
+/* Wall strips: s is the fraction along the wall, t runs from z0 to z1 */
+static const GPULightmapMap *lm_map_wall(GPULightmapMap *m,
+                                         const RAY_LightmapSurface *surf,
+                                         const RAY_Wall *wall, float z0,
+                                         float z1) {
+  if (!s_lm_active)
+    return NULL;
+  memset(m, 0, sizeof(*m));
+  if (!surf)
+    return m;
+  float inv_w = 1.0f / (float)g_engine.lightmap.width;
+  float inv_h = 1.0f / (float)g_engine.lightmap.height;
+  float len = sqrtf((wall->x2 - wall->x1) * (wall->x2 - wall->x1) +
+                    (wall->y2 - wall->y1) * (wall->y2 - wall->y1));
+  m->u0 = (surf->x + (0.0f - surf->origin_u) * surf->scale_u) * inv_w;
+  m->us = len * surf->scale_u * inv_w;
+  m->v0 = (surf->y + (z0 - surf->origin_v) * surf->scale_v) * inv_h;
+  m->vt = (z1 - z0) * surf->scale_v * inv_h;
+  m->lo_u = (surf->x + 0.5f) * inv_w;
+  m->hi_u = (surf->x + surf->w - 0.5f) * inv_w;
+  m->lo_v = (surf->y + 0.5f) * inv_h;
+  m->hi_v = (surf->y + surf->h - 0.5f) * inv_h;
+  m->clamp = 1;
+  return m;
+}
+
+/* Planes: world (x, y) = (off_x + s * scale_s, off_y + t * scale_t) */
+static const GPULightmapMap *lm_map_plane(GPULightmapMap *m,
+                                          const RAY_Sector *sector,
+                                          float plane_z, float scale_s,
+                                          float off_x, float scale_t,
+                                          float off_y) {
+  if (!s_lm_active)
+    return NULL;
+  memset(m, 0, sizeof(*m));
+  RAY_LightmapSurface surf;
+  int slot = (plane_z == sector->ceiling_z) ? RAY_LIGHTMAP_CEILING
+                                            : RAY_LIGHTMAP_FLOOR;
+  if (!ray_lightmap_surface((int)(sector - g_engine.sectors), slot, &surf))
+    return m;
+  float inv_w = 1.0f / (float)g_engine.lightmap.width;
+  float inv_h = 1.0f / (float)g_engine.lightmap.height;
+  m->u0 = (surf.x + (off_x - surf.origin_u) * surf.scale_u) * inv_w;
+  m->us = scale_s * surf.scale_u * inv_w;
+  m->v0 = (surf.y + (off_y - surf.origin_v) * surf.scale_v) * inv_h;
+  m->vt = scale_t * surf.scale_v * inv_h;
+  return m;
+}
+
+/* x,y,z,s,t vertices in this frame's layout (the input itself without
+   lightmap and texture atlas), layer = texture atlas cell or -1. The
+   result is valid until the next call */
+static float *gpu_layout_verts(float *verts, int nv, const GPULightmapMap *lm,
+                               int layer) {
+  if (s_vert_floats == 5)
+    return verts;
+  if (nv * 9 > s_layout_cap) {
+    int cap = s_layout_cap ? s_layout_cap : 4096;
+    while (cap < nv * 9)
+      cap *= 2;
+    float *grown = (float *)realloc(s_layout_buf, cap * sizeof(float));
+    if (!grown)
+      return NULL;
+    s_layout_buf = grown;
+    s_layout_cap = cap;
+  }
+  for (int i = 0; i < nv; i++) {
+    const float *src = &verts[i * 5];
+    float *dst = &s_layout_buf[i * 9];
+    memcpy(dst, src, 5 * sizeof(float));
+    float lu = lm ? lm->u0 + lm->us * src[3] : 0.0f;
+    float lv = lm ? lm->v0 + lm->vt * src[4] : 0.0f;
+    if (lm && lm->clamp) {
+      lu = lu < lm->lo_u ? lm->lo_u : (lu > lm->hi_u ? lm->hi_u : lu);
+      lv = lv < lm->lo_v ? lm->lo_v : (lv > lm->hi_v ? lm->hi_v : lv);
+    }
+    dst[5] = lu;
+    dst[6] = lv;
+    dst[7] = (float)(layer + 1);
+    dst[8] = 1.0f;
+  }
+  return s_layout_buf;
+}
+
+/* ============================================================================
+   LIGHT SETS
+   Each sector draw uses the lights that reach it (ray_sector_lights), at
+   most RAY_MAX_DRAW_LIGHTS. render_sector_gpu selects them on entry and
+   restores its parent's on return; the shader arrays are re-sent only when
+   the selected set differs from the one already uploaded.
+   ============================================================================
+ */
+
+typedef struct {
+  int count;
+  int index[RAY_MAX_DRAW_LIGHTS];
+} GPULightSet;
+
+static GPULightSet s_draw_lights;   /* Lights of the sector being drawn */
+static GPULightSet s_shader_lights; /* Lights the normal shader holds */
+static int s_shader_lights_valid = 0;
+
+/* The first lights of the map, for RAY_LIGHT_CULL_NONE and fallbacks */
+static void select_all_lights(void) {
+  s_draw_lights.count = 0;
+  int first = s_lm_active ? g_engine.lightmap.baked_lights : 0;
+  for (int i = first;
+       i < g_engine.num_lights && s_draw_lights.count < RAY_MAX_DRAW_LIGHTS;
+       i++)
+    s_draw_lights.index[s_draw_lights.count++] = i;
+}
+
+/* Conservative screen rectangle of the light's reach against a clip rect */
+static int light_overlaps_clip(const RAY_Light *light, ClipRect clip) {
+  float range = RAY_LIGHT_RANGE * light->intensity;
+  float dx = light->x - s_cam_x, dy = light->y - s_cam_y;
+  float tz = dx * s_cos_ang + dy * s_sin_ang;
+  float tx = dy * s_cos_ang - dx * s_sin_ang;
+  float h = light->z - s_cam_z;
+  if (tz + range <= NEAR_PLANE)
+    return 0; /* Behind the camera */
+  if (tz - range <= NEAR_PLANE)
+    return 1; /* The camera is inside its reach */
+
+  float zn = tz - range, zf = tz + range;
+  float lo = tx - range, hi = tx + range;
+  float top = h + range, bot = h - range;
+  float x0 = s_half_w + lo * s_focal / (lo < 0.0f ? zn : zf);
+  float x1 = s_half_w + hi * s_focal / (hi > 0.0f ? zn : zf);
+  float y0 = (float)s_horizon - top * s_focal / (top > 0.0f ? zn : zf);
+  float y1 = (float)s_horizon - bot * s_focal / (bot < 0.0f ? zn : zf);
+  return x1 >= clip.x1 && x0 <= clip.x2 && y1 >= clip.y1 && y0 <= clip.y2;
+}
+
+static void select_sector_lights(const RAY_Sector *sector, ClipRect clip) {
+  int count = 0;
+  const int *list = NULL;
+  if (g_engine.light_culling != RAY_LIGHT_CULL_NONE)
+    list = ray_sector_lights((int)(sector - g_engine.sectors), &count);
+  if (!list) {
+    select_all_lights();
+    return;
   }
 
-  GPU_SetUniformi(s_u_numLights, g_engine.num_lights);
-  if (g_engine.num_lights > 0) {
-    float lp[16 * 3];
-    float lc[16 * 3];
-    float li[16];
-    for (int i = 0; i < g_engine.num_lights && i < 16; i++) {
+  int screen = (g_engine.light_culling == RAY_LIGHT_CULL_SCREEN);
+  int baked = s_lm_active ? g_engine.lightmap.baked_lights : 0;
+  s_draw_lights.count = 0;
+  for (int k = 0; k < count && s_draw_lights.count < RAY_MAX_DRAW_LIGHTS;
+       k++) {
+    if (list[k] < baked)
+      continue; /* Already in the lightmap */
+    if (screen && !light_overlaps_clip(&g_engine.lights[list[k]], clip))
+      continue;
+    s_draw_lights.index[s_draw_lights.count++] = list[k];
+  }
+}
+
+/* Send s_draw_lights to the active normal shader unless it already has it */
+static void normal_shader_sync_lights(void) {
+  const GPULightSet *set = &s_draw_lights;
+  if (s_shader_lights_valid && s_shader_lights.count == set->count &&
+      memcmp(s_shader_lights.index, set->index, set->count * sizeof(int)) == 0)
+    return;
+
+  GPU_SetUniformi(s_u_numLights, set->count);
+  if (set->count > 0) {
+    float lp[RAY_MAX_DRAW_LIGHTS * 3];
+    float lc[RAY_MAX_DRAW_LIGHTS * 3];
+    float li[RAY_MAX_DRAW_LIGHTS];
+    for (int i = 0; i < set->count; i++) {
+      const RAY_Light *light = &g_engine.lights[set->index[i]];
       /* Transform light pos to View Space for the shader */
-      float dx = g_engine.lights[i].x - s_cam_x;
-      float dy = g_engine.lights[i].y - s_cam_y;
+      float dx = light->x - s_cam_x;
+      float dy = light->y - s_cam_y;
 
       /* Camera space: X=Right, Z=Forward, Y=Up (relative to camera) */
       lp[i * 3 + 0] = dx * s_sin_ang - dy * s_cos_ang; /* Right */
-      lp[i * 3 + 1] = g_engine.lights[i].z - s_cam_z;  /* Up */
+      lp[i * 3 + 1] = light->z - s_cam_z;              /* Up */
       lp[i * 3 + 2] = dx * s_cos_ang + dy * s_sin_ang; /* Forward */
 
       /* Pass color directly: R,G,B are already correct in the engine */
-      lc[i * 3 + 0] = g_engine.lights[i].r;
-      lc[i * 3 + 1] = g_engine.lights[i].g;
-      lc[i * 3 + 2] = g_engine.lights[i].b;
-      li[i] = g_engine.lights[i].intensity;
+      lc[i * 3 + 0] = light->r;
+      lc[i * 3 + 1] = light->g;
+      lc[i * 3 + 2] = light->b;
+      li[i] = light->intensity;
     }
-    GPU_SetUniformfv(s_u_lightPosArr, 3, g_engine.num_lights, lp);
-    GPU_SetUniformfv(s_u_lightColorArr, 3, g_engine.num_lights, lc);
-    GPU_SetUniformfv(s_u_lightIntensityArr, 1, g_engine.num_lights, li);
+    GPU_SetUniformfv(s_u_lightPosArr, 3, set->count, lp);
+    GPU_SetUniformfv(s_u_lightColorArr, 3, set->count, lc);
+    GPU_SetUniformfv(s_u_lightIntensityArr, 1, set->count, li);
   }
+  s_shader_lights = *set;
+  s_shader_lights_valid = 1;
+}
+
+/* Uniforms that only change once per frame (camera, fog, time). GL keeps
+   program uniforms while the program is inactive, so surfaces only need to
+   set their own material/TBN state (and light set) afterwards. */
+static void normal_shader_begin_frame(void) {
+  init_normal_shader();
+  if (s_normal_shader == 0)
+    return;
+  GPU_ActivateShaderProgram(s_normal_shader, &s_normal_block);
+
+  GPU_SetUniformi(s_u_tex, 0);       /* Texture unit 0 */
+  GPU_SetUniformi(s_u_normalMap, 1); /* Texture unit 1 */
+  GPU_SetUniformi(s_u_useLightmap, s_lm_active);
+  GPU_SetUniformi(s_u_useAtlas, s_atlas_active);
+  float atlas[4] = {(float)GPU_ATLAS_COLS,
+                    (float)GPU_ATLAS_CELL / GPU_ATLAS_SIZE,
+                    (float)GPU_ATLAS_PAD / GPU_ATLAS_SIZE,
+                    (float)RAY_TEXTURE_SIZE / GPU_ATLAS_SIZE};
+  GPU_SetUniformfv(s_u_atlas, 4, 1, atlas);
+
+  /* The camera moved: light positions must be re-sent */
+  s_shader_lights_valid = 0;
+  select_all_lights();
+  normal_shader_sync_lights();
 
   GPU_SetUniformf(s_u_focal, s_focal);
   GPU_SetUniformf(s_u_halfW, (float)s_half_w);
   GPU_SetUniformf(s_u_horizon, (float)s_horizon);
   GPU_SetUniformf(s_u_time, g_engine.time);
+  float fogCol[3] = {s_fog_r, s_fog_g, s_fog_b};
+  GPU_SetUniformfv(s_u_fogColor, 3, 1, fogCol);
+  GPU_SetUniformf(s_u_fogDensity, s_fog_density);
+  GPU_SetUniformf(s_u_fogStart, s_fog_start);
+  GPU_SetUniformf(s_u_fogEnd, s_fog_end);
+
+  GPU_ActivateShaderProgram(0, NULL);
+}
+
+/* Per-surface uniforms. The program must already be active. */
+static void normal_shader_set_surface(GPU_Image *normalMap, float tx,
+                                      float ty, float tz, float bx, float by,
+                                      float bz, float nx, float ny, float nz,
+                                      int sectorFlags, float liquidIntensity,
+                                      float liquidSpeed) {
+  normal_shader_sync_lights();
+  if (s_lm_active) /* Unit 2; normal maps rebind unit 1 per surface */
+    GPU_SetShaderImage(s_lightmap_image, s_u_lightMap, 2);
+  if (normalMap) {
+    GPU_SetUniformi(s_u_useNormalMap, 1);
+    /* Bind normal map to unit 1 using SDL_gpu */
+    GPU_SetShaderImage(normalMap, s_u_normalMap, 1);
+    GPU_SetBlendMode(normalMap, GPU_BLEND_NORMAL);
+  } else {
+    GPU_SetUniformi(s_u_useNormalMap, 0);
+  }
+
   GPU_SetUniformi(s_u_sectorFlags, sectorFlags);
   GPU_SetUniformf(s_u_liquidIntensity, liquidIntensity);
   GPU_SetUniformf(s_u_liquidSpeed, liquidSpeed);
-  float fogCol[3] = {fogR, fogG, fogB};
-  GPU_SetUniformfv(s_u_fogColor, 3, 1, fogCol);
-  GPU_SetUniformf(s_u_fogDensity, fogDensity);
-  GPU_SetUniformf(s_u_fogStart, fogStart);
-  GPU_SetUniformf(s_u_fogEnd, fogEnd);
 
   /* Transform TBN Matrix to View Space */
   /* World vectors (nx, ny, tx, ty, bx, by) -> View space (X=Right, Z=Forward)
@@ -482,6 +1163,22 @@ static void activate_normal_shader(GPU_Image *normalMap, float tx, float ty,
   GPU_SetUniformfv(s_u_normal, 3, 1, n);
 }
 
+static int activate_normal_shader(GPU_Image *normalMap, float tx, float ty,
+                                  float tz, float bx, float by, float bz,
+                                  float nx, float ny, float nz,
+                                  int sectorFlags, float liquidIntensity,
+                                  float liquidSpeed) {
+  init_normal_shader();
+  if (s_normal_shader == 0)
+    return 0;
+  GPU_ActivateShaderProgram(s_normal_shader, &s_normal_block);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  normal_shader_set_surface(normalMap, tx, ty, tz, bx, by, bz, nx, ny, nz,
+                            sectorFlags, liquidIntensity, liquidSpeed);
+  return 1;
+}
+
 static void deactivate_normal_shader(void) {
   GPU_ActivateShaderProgram(0, NULL);
 }
@@ -535,6 +1232,7 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
   float h = plane_z - s_cam_z;
   if (fabsf(h) < 0.001f)
     return;
+  RAY_STAT_TIMER(t_plane);
 
   float nx_p = 0, ny_p = 0, nz_p = (h > 0) ? -1.0f : 1.0f;
   float bx_p = 0, by_p = (h > 0) ? -1.0f : 1.0f, bz_p = 0;
@@ -550,8 +1248,7 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
 
   activate_normal_shader(normal_tex, 1.0f, 0.0f, 0.0f, bx_p, by_p, bz_p, nx_p,
                          ny_p, nz_p, activeFlags, sector->liquid_intensity,
-                         sector->liquid_speed, s_fog_r, s_fog_g, s_fog_b,
-                         s_fog_density, s_fog_start, s_fog_end);
+                         sector->liquid_speed);
 
   if (depth > 0) {
     glEnable(GL_POLYGON_OFFSET_FILL);
@@ -563,6 +1260,12 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
   float v_local[SCAN_LIMIT * 20];
   unsigned short i_local[SCAN_LIMIT * 6];
   int v_idx = 0, i_idx = 0;
+  GPULightmapMap lm_m;
+  const GPULightmapMap *lm =
+      lm_map_plane(&lm_m, sector, plane_z, 64.0f, 0.0f, 64.0f, 0.0f);
+  int layer = gpu_atlas_layer(tex);
+  if (layer >= 0)
+    tex = s_atlas_image;
 
   float intercepts[MAX_SECTOR_VERTS * 4];
   float horizon_f = (float)s_horizon;
@@ -691,8 +1394,9 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
       if (v_idx >= SCAN_LIMIT * 20 - 20) {
         GPU_SetWrapMode(tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
         GPU_SetImageFilter(tex, GPU_FILTER_LINEAR);
-        GPU_TriangleBatch(tex, target, v_idx / 5, v_local, i_idx, i_local,
-                          GPU_BATCH_XYZ_ST);
+        float *vb = gpu_layout_verts(v_local, v_idx / 5, lm, layer);
+        gpu_triangle_batch(tex, target, v_idx / 5, vb, i_idx, i_local,
+                           s_vert_flags);
         v_idx = 0;
         i_idx = 0;
       }
@@ -702,8 +1406,9 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
   if (v_idx > 0) {
     GPU_SetWrapMode(tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
     GPU_SetImageFilter(tex, GPU_FILTER_LINEAR);
-    GPU_TriangleBatch(tex, target, v_idx / 5, v_local, i_idx, i_local,
-                      GPU_BATCH_XYZ_ST);
+    float *vb = gpu_layout_verts(v_local, v_idx / 5, lm, layer);
+    gpu_triangle_batch(tex, target, v_idx / 5, vb, i_idx, i_local,
+                       s_vert_flags);
     GPU_FlushBlitBuffer();
   }
 
@@ -711,6 +1416,7 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
 
   if (depth > 0)
     glDisable(GL_POLYGON_OFFSET_FILL);
+  RAY_STAT_ELAPSED(RAY_STAT_PLANES_MS, t_plane);
 }
 
 /* ============================================================================
@@ -721,15 +1427,16 @@ static void render_sector_plane(GPU_Target *target, RAY_Sector *sector,
 /* Render a solid sector lid (top or bottom face) as a projected 3D polygon.
    Uses depth buffer so the closer face automatically wins. */
 static void render_island_lid(GPU_Target *target, RAY_Sector *sector,
-                              float plane_z, GPU_Image *tex,
-                              GPU_Image *normal_tex, XFormWall *xf,
-                              int num_walls, ClipRect clip) {
+                              const GPUSectorStatic *st, float plane_z,
+                              GPU_Image *tex, GPU_Image *normal_tex,
+                              XFormWall *xf, int num_walls, ClipRect clip) {
   if (!tex || num_walls < 3 || num_walls > MAX_SECTOR_VERTS)
     return;
 
   float h = plane_z - s_cam_z;
   if (fabsf(h) < 0.001f)
     return;
+  RAY_STAT_TIMER(t_lid);
 
   /* Normal mapping for lids:
      Floor (mapping bottom face): Normal=(0,0,1), Tangent=(1,0,0),
@@ -750,13 +1457,18 @@ static void render_island_lid(GPU_Target *target, RAY_Sector *sector,
 
   activate_normal_shader(normal_tex, 1.0f, 0.0f, 0.0f, bx, by, bz, nx, ny, nz,
                          activeFlags, sector->liquid_intensity,
-                         sector->liquid_speed, s_fog_r, s_fog_g, s_fog_b,
-                         s_fog_density, s_fog_start, s_fog_end);
+                         sector->liquid_speed);
 
-  /* Calculate bounding box of the sector for fixed texture mapping (0..1) */
+  /* Bounding box of the sector for fixed texture mapping (0..1) */
   float min_x = sector->walls[0].x1, max_x = sector->walls[0].x1;
   float min_y = sector->walls[0].y1, max_y = sector->walls[0].y1;
-  for (int i = 1; i < num_walls; i++) {
+  if (st) {
+    min_x = st->min_x;
+    max_x = st->max_x;
+    min_y = st->min_y;
+    max_y = st->max_y;
+  }
+  for (int i = 1; !st && i < num_walls; i++) {
     if (sector->walls[i].x1 < min_x)
       min_x = sector->walls[i].x1;
     if (sector->walls[i].x1 > max_x)
@@ -889,6 +1601,7 @@ static void render_island_lid(GPU_Target *target, RAY_Sector *sector,
 
   if (t_nv < 3) {
     deactivate_normal_shader();
+    RAY_STAT_ELAPSED(RAY_STAT_PLANES_MS, t_lid);
     return;
   }
 
@@ -905,13 +1618,205 @@ static void render_island_lid(GPU_Target *target, RAY_Sector *sector,
   glScissor((int)clip.x1, s_screen_h - (int)clip.y2, (int)(clip.x2 - clip.x1),
             (int)(clip.y2 - clip.y1));
 
-  GPU_TriangleBatch(tex, target, t_nv, t_vb, 0, NULL, GPU_BATCH_XYZ_ST);
+  GPULightmapMap lm_m;
+  const GPULightmapMap *lm =
+      lm_map_plane(&lm_m, sector, plane_z, dx, min_x, dy, min_y);
+  int layer = gpu_atlas_layer(tex);
+  if (layer >= 0)
+    tex = s_atlas_image;
+  gpu_triangle_batch(tex, target, t_nv,
+                     gpu_layout_verts(t_vb, t_nv, lm, layer), 0, NULL,
+                     s_vert_flags);
   GPU_FlushBlitBuffer();
 
   deactivate_normal_shader();
 
   glDisable(GL_SCISSOR_TEST);
   /* Depth test disabled globally if needed, but we keep it on for the pass */
+  RAY_STAT_ELAPSED(RAY_STAT_PLANES_MS, t_lid);
+}
+
+/* ============================================================================
+   WALL BATCHES
+   Opaque wall strips are grouped by material (texture, normal map, sector
+   effects and, when lights need it, wall orientation) and drawn with one
+   GPU_TriangleBatch and one uniform upload per group. Each
+   render_sector_gpu call owns the slots from its base upwards and flushes
+   them under its own clip rect, so recursion never mixes geometry that is
+   clipped differently.
+   ============================================================================
+ */
+
+#define WALL_BATCH_SLOTS 128
+#define WALL_BATCH_MAX_VERTS 65000 /* Indices are unsigned short */
+
+typedef struct {
+  GPU_Image *tex;
+  GPU_Image *norm;
+  int flags;
+  float liquid_intensity, liquid_speed;
+  float tan_x, tan_y; /* Wall direction; normal and bitangent follow */
+  float *verts;       /* x,y,z,s,t (+ atlas coords, s_vert_floats) */
+  int num_verts, cap_verts;
+  unsigned short *indices;
+  int num_indices, cap_indices;
+} WallBatch;
+
+static WallBatch s_wall_batches[WALL_BATCH_SLOTS];
+static int s_wall_batch_top = 0;
+
+static WallBatch *wall_batch_find(int base, GPU_Image *tex, GPU_Image *norm,
+                                  int flags, float liquid_intensity,
+                                  float liquid_speed, float tan_x,
+                                  float tan_y) {
+  /* Without lights the shader never reads the TBN */
+  int match_tbn = (s_draw_lights.count > 0);
+  for (int i = base; i < s_wall_batch_top; i++) {
+    WallBatch *b = &s_wall_batches[i];
+    if (b->tex != tex || b->norm != norm || b->flags != flags ||
+        b->liquid_intensity != liquid_intensity ||
+        b->liquid_speed != liquid_speed)
+      continue;
+    if (match_tbn && (b->tan_x != tan_x || b->tan_y != tan_y))
+      continue;
+    return b;
+  }
+  if (s_wall_batch_top >= WALL_BATCH_SLOTS)
+    return NULL;
+
+  WallBatch *b = &s_wall_batches[s_wall_batch_top++];
+  b->tex = tex;
+  b->norm = norm;
+  b->flags = flags;
+  b->liquid_intensity = liquid_intensity;
+  b->liquid_speed = liquid_speed;
+  b->tan_x = tan_x;
+  b->tan_y = tan_y;
+  b->num_verts = 0;
+  b->num_indices = 0;
+  return b;
+}
+
+static void wall_batch_draw(GPU_Target *target, WallBatch *b) {
+  if (b->num_verts == 0)
+    return;
+  GPU_SetImageFilter(b->tex, GPU_FILTER_LINEAR);
+  GPU_SetWrapMode(b->tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
+  gpu_triangle_batch(b->tex, target, b->num_verts, b->verts, b->num_indices,
+                     b->indices, s_vert_flags);
+  GPU_FlushBlitBuffer();
+  b->num_verts = 0;
+  b->num_indices = 0;
+}
+
+/* Wall normal = tangent rotated 90 degrees; bitangent is always +Z */
+static int wall_batch_activate(WallBatch *b, int shader_active) {
+  float nrm_x = -b->tan_y, nrm_y = b->tan_x;
+  if (shader_active) {
+    normal_shader_set_surface(b->norm, b->tan_x, b->tan_y, 0.0f, 0.0f, 0.0f,
+                              1.0f, nrm_x, nrm_y, 0.0f, b->flags,
+                              b->liquid_intensity, b->liquid_speed);
+    return 1;
+  }
+  return activate_normal_shader(b->norm, b->tan_x, b->tan_y, 0.0f, 0.0f, 0.0f,
+                                1.0f, nrm_x, nrm_y, 0.0f, b->flags,
+                                b->liquid_intensity, b->liquid_speed);
+}
+
+static void wall_batch_flush(GPU_Target *target, int base) {
+  RAY_STAT_TIMER(t_walls);
+  int shader_active = 0;
+  for (int i = base; i < s_wall_batch_top; i++) {
+    WallBatch *b = &s_wall_batches[i];
+    if (b->num_verts == 0)
+      continue;
+    shader_active = wall_batch_activate(b, shader_active);
+    wall_batch_draw(target, b);
+  }
+  if (shader_active)
+    deactivate_normal_shader();
+  s_wall_batch_top = base;
+  RAY_STAT_ELAPSED(RAY_STAT_WALLS_MS, t_walls);
+}
+
+static int wall_batch_append(GPU_Target *target, WallBatch *b,
+                             const float *verts, int nv,
+                             const unsigned short *indices, int ni) {
+  if (nv > WALL_BATCH_MAX_VERTS)
+    return 0;
+  if (b->num_verts + nv > WALL_BATCH_MAX_VERTS) {
+    int on = wall_batch_activate(b, 0);
+    wall_batch_draw(target, b);
+    if (on)
+      deactivate_normal_shader();
+  }
+
+  if (b->num_verts + nv > b->cap_verts) {
+    int cap = b->cap_verts ? b->cap_verts * 2 : 1024;
+    while (cap < b->num_verts + nv)
+      cap *= 2;
+    /* Room for the lightmap layout, so toggling it never reallocates */
+    float *grown = (float *)realloc(b->verts, cap * 9 * sizeof(float));
+    if (!grown)
+      return 0;
+    b->verts = grown;
+    b->cap_verts = cap;
+  }
+  if (b->num_indices + ni > b->cap_indices) {
+    int cap = b->cap_indices ? b->cap_indices * 2 : 2048;
+    while (cap < b->num_indices + ni)
+      cap *= 2;
+    unsigned short *grown =
+        (unsigned short *)realloc(b->indices, cap * sizeof(unsigned short));
+    if (!grown)
+      return 0;
+    b->indices = grown;
+    b->cap_indices = cap;
+  }
+
+  memcpy(&b->verts[b->num_verts * s_vert_floats], verts,
+         nv * s_vert_floats * sizeof(float));
+  for (int i = 0; i < ni; i++)
+    b->indices[b->num_indices + i] =
+        (unsigned short)(indices[i] + b->num_verts);
+  b->num_verts += nv;
+  b->num_indices += ni;
+  return 1;
+}
+
+/* Queue a wall strip into its batch, or draw it right away when order
+   matters (transparent pass) or the batch pool is exhausted */
+static void submit_wall_strip(GPU_Target *target, int batch_base,
+                              int immediate, GPU_Image *tex, GPU_Image *norm,
+                              float tan_x, float tan_y, int flags,
+                              float liquid_intensity, float liquid_speed,
+                              const GPULightmapMap *lm, float *verts, int nv,
+                              unsigned short *indices, int ni) {
+  int layer = gpu_atlas_layer(tex);
+  if (layer >= 0)
+    tex = s_atlas_image; /* Joins the batches of other atlas textures */
+  verts = gpu_layout_verts(verts, nv, lm, layer);
+  if (!verts)
+    return;
+  if (!immediate) {
+    WallBatch *b = wall_batch_find(batch_base, tex, norm, flags,
+                                   liquid_intensity, liquid_speed, tan_x,
+                                   tan_y);
+    if (b && wall_batch_append(target, b, verts, nv, indices, ni))
+      return;
+  }
+
+  RAY_STAT_TIMER(t_walls);
+  GPU_SetImageFilter(tex, GPU_FILTER_LINEAR);
+  GPU_SetWrapMode(tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
+  int on = activate_normal_shader(norm, tan_x, tan_y, 0.0f, 0.0f, 0.0f, 1.0f,
+                                  -tan_y, tan_x, 0.0f, flags,
+                                  liquid_intensity, liquid_speed);
+  gpu_triangle_batch(tex, target, nv, verts, ni, indices, s_vert_flags);
+  GPU_FlushBlitBuffer();
+  if (on)
+    deactivate_normal_shader();
+  RAY_STAT_ELAPSED(RAY_STAT_WALLS_MS, t_walls);
 }
 
 static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
@@ -921,7 +1826,19 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
     return;
   if (visited_test(sector_id))
     return;
+  /* Static PVS, before marking it visited so its sprites stay hidden too.
+     Islands are reached through the hierarchy, not portals */
+  if (!is_island && depth > 0 && s_pvs_row) {
+    int pvs_index = ray_sector_index_by_id(&g_engine, sector_id);
+    if (pvs_index >= 0 && !RAY_PVS_TEST(s_pvs_row, pvs_index)) {
+      if (!transparent_pass)
+        RAY_STAT_ADD(RAY_STAT_PVS_CULLED, 1);
+      return;
+    }
+  }
   visited_set(sector_id);
+  if (!transparent_pass)
+    RAY_STAT_ADD(RAY_STAT_SECTORS, 1);
   if (!clip_valid(clip))
     return;
 
@@ -929,6 +1846,18 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
   if (!sector)
     return;
 
+  /* Lights reaching this sector; the parent's come back on return */
+  GPULightSet parent_lights = s_draw_lights;
+  select_sector_lights(sector, clip);
+
+  const GPUSectorStatic *st = gpu_sector_static(sector);
+  const GPUWallStatic *st_walls = st ? &s_gpu_walls[st->first_wall] : NULL;
+
+  /* Opaque walls are batched and flushed under this sector's clip; the
+     transparent pass draws in painter order, so it stays immediate */
+  int batch_base = s_wall_batch_top;
+  int immediate = transparent_pass;
+
   GPU_SetClip(target, (Sint16)clip.x1, (Sint16)clip.y1,
               (Uint16)(clip.x2 - clip.x1), (Uint16)(clip.y2 - clip.y1));
 
@@ -1094,8 +2023,9 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
     order[w].dist = mx * mx + my * my;
   }
 
-  /* Simple bubble sort or qsort for wall order */
-  for (int i = 0; i < sector->num_walls - 1; i++) {
+  /* Simple bubble sort or qsort for wall order. Batched walls are resolved
+     by the depth buffer and don't need it. */
+  for (int i = 0; immediate && i < sector->num_walls - 1; i++) {
     for (int j = 0; j < sector->num_walls - i - 1; j++) {
       if (order[j].dist < order[j + 1].dist) {
         WallOrder temp = order[j];
@@ -1109,19 +2039,37 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
     int w = order[wi].index;
     RAY_Wall *wall = &sector->walls[w];
 
-    float x0 = wall->x1 - s_cam_x;
-    float y0 = wall->y1 - s_cam_y;
-    float x1 = wall->x2 - s_cam_x;
-    float y1 = wall->y2 - s_cam_y;
+    float tz0 = xf_walls[w].tz0;
+    float tx0 = xf_walls[w].tx0;
+    float tz1 = xf_walls[w].tz1;
+    float tx1 = xf_walls[w].tx1;
 
-    float tz0 = x0 * s_cos_ang + y0 * s_sin_ang;
-    float tx0 = y0 * s_cos_ang - x0 * s_sin_ang;
-    float tz1 = x1 * s_cos_ang + y1 * s_sin_ang;
-    float tx1 = y1 * s_cos_ang - x1 * s_sin_ang;
+    /* Wall tangent (TBN) from the static cache */
+    float wall_tan_x, wall_tan_y;
+    if (st_walls) {
+      wall_tan_x = st_walls[w].tan_x;
+      wall_tan_y = st_walls[w].tan_y;
+    } else {
+      float wdx = wall->x2 - wall->x1, wdy = wall->y2 - wall->y1;
+      float wlen = sqrtf(wdx * wdx + wdy * wdy);
+      if (wlen < 0.001f)
+        wlen = 1.0f;
+      wall_tan_x = wdx / wlen;
+      wall_tan_y = wdy / wlen;
+    }
 
     if (tz0 <= NEAR_PLANE && tz1 <= NEAR_PLANE)
       continue;
 
+    /* Baked light of this wall; every strip maps its own z range */
+    RAY_LightmapSurface wall_lm_surf;
+    const RAY_LightmapSurface *wall_lm = NULL;
+    if (s_lm_active &&
+        ray_lightmap_surface((int)(sector - g_engine.sectors), 2 + w,
+                             &wall_lm_surf))
+      wall_lm = &wall_lm_surf;
+    GPULightmapMap strip_lm;
+
     int v0_clipped = 0, v1_clipped = 0;
     if (tz0 <= NEAR_PLANE || tz1 <= NEAR_PLANE) {
       float t = (NEAR_PLANE - tz0) / (tz1 - tz0);
@@ -1146,7 +2094,15 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
 
     /* ---- PORTAL WALL ---- */
     if (wall->portal_id != -1) {
-      int other_sector_id = portal_get_other_sector(wall->portal_id, sector_id);
+      int other_sector_id;
+      if (st_walls && st_walls[w].portal_index >= 0) {
+        RAY_Portal *p = &g_engine.portals[st_walls[w].portal_index];
+        other_sector_id = (p->sector_a == sector_id)   ? p->sector_b
+                          : (p->sector_b == sector_id) ? p->sector_a
+                                                       : -1;
+      } else {
+        other_sector_id = portal_get_other_sector(wall->portal_id, sector_id);
+      }
       if (other_sector_id >= 0 && !visited_test(other_sector_id)) {
         float portal_left = (sx0 < sx1) ? sx0 : sx1;
         float portal_right = (sx0 > sx1) ? sx0 : sx1;
@@ -1189,6 +2145,8 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
 
         if (clip_valid(new_clip)) {
           /* Render adjacent sector clipped to the portal opening rectangle */
+          if (!transparent_pass)
+            RAY_STAT_ADD(RAY_STAT_PORTALS, 1);
           render_sector_gpu(target, other_sector_id, new_clip, depth + 1, 0,
                             sector->floor_z, sector->ceiling_z,
                             transparent_pass);
@@ -1305,8 +2263,6 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
             if (other_ceil_h < ceil_h && wall->texture_id_upper > 0) {
               GPU_Image *upper_tex = get_gpu_texture(0, wall->texture_id_upper);
               if (upper_tex) {
-                GPU_SetWrapMode(upper_tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
-                GPU_SetImageFilter(upper_tex, GPU_FILTER_LINEAR);
                 float *vu = (float *)alloca(pnum_cols * 2 * 5 * sizeof(float));
                 unsigned short *iu = (unsigned short *)alloca(
                     (pnum_cols - 1) * 6 * sizeof(unsigned short));
@@ -1363,31 +2319,16 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
                 }
                 GPU_Image *upper_normal_tex =
                     get_gpu_texture(0, wall->texture_id_upper_normal);
-                /* TBN for Upper wall */
-                float wall_dx_u = wall->x2 - wall->x1;
-                float wall_dy_u = wall->y2 - wall->y1;
-                float wall_len_u =
-                    sqrtf(wall_dx_u * wall_dx_u + wall_dy_u * wall_dy_u);
-                if (wall_len_u < 0.001f)
-                  wall_len_u = 1.0f;
-                float wall_tx_u = wall_dx_u / wall_len_u;
-                float wall_ty_u = wall_dy_u / wall_len_u;
-                float wall_nx_u = (wall->y1 - wall->y2) / wall_len_u;
-                float wall_ny_u = (wall->x2 - wall->x1) / wall_len_u;
-
                 int wallActiveFlags = (sector->flags & (8 | 16 | 256));
                 if (sector->flags & 128)
                   wallActiveFlags |= (sector->flags & 7);
-                activate_normal_shader(
-                    upper_normal_tex, wall_tx_u, wall_ty_u, 0.0f, 0.0f, 0.0f,
-                    1.0f, wall_nx_u, wall_ny_u, 0.0f, wallActiveFlags,
-                    sector->liquid_intensity, sector->liquid_speed, s_fog_r,
-                    s_fog_g, s_fog_b, s_fog_density, s_fog_start, s_fog_end);
-
-                GPU_TriangleBatch(upper_tex, target, nvu, vu, niu, iu,
-                                  GPU_BATCH_XYZ_ST);
-                GPU_FlushBlitBuffer();
-                deactivate_normal_shader();
+                submit_wall_strip(
+                    target, batch_base, immediate, upper_tex,
+                    upper_normal_tex, wall_tan_x, wall_tan_y, wallActiveFlags,
+                    sector->liquid_intensity, sector->liquid_speed,
+                    lm_map_wall(&strip_lm, wall_lm, wall, cz,
+                                other_sector->ceiling_z),
+                    vu, nvu, iu, niu);
               }
             }
 
@@ -1395,8 +2336,6 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
             if (other_floor_h > floor_h && wall->texture_id_lower > 0) {
               GPU_Image *lower_tex = get_gpu_texture(0, wall->texture_id_lower);
               if (lower_tex) {
-                GPU_SetWrapMode(lower_tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
-                GPU_SetImageFilter(lower_tex, GPU_FILTER_LINEAR);
                 float *vl = (float *)alloca(pnum_cols * 2 * 5 * sizeof(float));
                 unsigned short *il = (unsigned short *)alloca(
                     (pnum_cols - 1) * 6 * sizeof(unsigned short));
@@ -1452,31 +2391,16 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
                 GPU_Image *lower_normal_tex =
                     get_gpu_texture(0, wall->texture_id_lower_normal);
 
-                /* TBN for Lower wall */
-                float wall_dx_l = wall->x2 - wall->x1;
-                float wall_dy_l = wall->y2 - wall->y1;
-                float wall_len_l =
-                    sqrtf(wall_dx_l * wall_dx_l + wall_dy_l * wall_dy_l);
-                if (wall_len_l < 0.001f)
-                  wall_len_l = 1.0f;
-                float wall_tx_l = wall_dx_l / wall_len_l;
-                float wall_ty_l = wall_dy_l / wall_len_l;
-                float wall_nx_l = (wall->y1 - wall->y2) / wall_len_l;
-                float wall_ny_l = (wall->x2 - wall->x1) / wall_len_l;
-
                 int wallActiveFlags = (sector->flags & (8 | 16 | 256));
                 if (sector->flags & 128)
                   wallActiveFlags |= (sector->flags & 7);
-                activate_normal_shader(
-                    lower_normal_tex, wall_tx_l, wall_ty_l, 0.0f, 0.0f, 0.0f,
-                    1.0f, wall_nx_l, wall_ny_l, 0.0f, wallActiveFlags,
-                    sector->liquid_intensity, sector->liquid_speed, s_fog_r,
-                    s_fog_g, s_fog_b, s_fog_density, s_fog_start, s_fog_end);
-
-                GPU_TriangleBatch(lower_tex, target, nvl, vl, nil, il,
-                                  GPU_BATCH_XYZ_ST);
-                GPU_FlushBlitBuffer();
-                deactivate_normal_shader();
+                submit_wall_strip(
+                    target, batch_base, immediate, lower_tex,
+                    lower_normal_tex, wall_tan_x, wall_tan_y, wallActiveFlags,
+                    sector->liquid_intensity, sector->liquid_speed,
+                    lm_map_wall(&strip_lm, wall_lm, wall,
+                                other_sector->floor_z, fz),
+                    vl, nvl, il, nil);
               }
             }
           }
@@ -1508,17 +2432,6 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
     float mid_z_bot = (wall->texture_id_lower > 0) ? split_low : z_floor;
     float mid_z_top = (wall->texture_id_upper > 0) ? split_up : z_ceil;
 
-    /* TBN calculation common for all segments */
-    float wall_dx_m = wall->x2 - wall->x1;
-    float wall_dy_m = wall->y2 - wall->y1;
-    float wall_len_m = sqrtf(wall_dx_m * wall_dx_m + wall_dy_m * wall_dy_m);
-    if (wall_len_m < 0.001f)
-      wall_len_m = 1.0f;
-    float wall_tx_m = wall_dx_m / wall_len_m;
-    float wall_ty_m = wall_dy_m / wall_len_m;
-    float wall_nx_m = (wall->y1 - wall->y2) / wall_len_m;
-    float wall_ny_m = (wall->x2 - wall->x1) / wall_len_m;
-
     /* Projection math (Screen-space subdivision) */
     float wall_dx = tx1 - tx0;
     float wall_dz = tz1 - tz0;
@@ -1600,8 +2513,6 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
     if ((tex_id) > 0 && (z_top_abs) > (z_bot_abs)) {                           \
       GPU_Image *_tex = get_gpu_texture(0, tex_id);                            \
       if (_tex) {                                                              \
-        GPU_SetImageFilter(_tex, GPU_FILTER_LINEAR);                           \
-        GPU_SetWrapMode(_tex, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);               \
         GPU_Image *_norm = get_gpu_texture(0, normal_id);                      \
         int is_fluid = (force_no_fluid) ? 0 : ((sector->flags & 128) != 0);    \
         if ((transparent_pass && is_fluid) ||                                  \
@@ -1616,11 +2527,6 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
             activeFlags |= (sector->flags & 7);                                \
           else if (force_no_fluid)                                             \
             activeFlags = 0; /* No effects on rim */                           \
-          activate_normal_shader(                                              \
-              _norm, wall_tx_m, wall_ty_m, 0.0f, 0.0f, 0.0f, 1.0f, wall_nx_m,  \
-              wall_ny_m, 0.0f, activeFlags, sector->liquid_intensity,          \
-              sector->liquid_speed, s_fog_r, s_fog_g, s_fog_b, s_fog_density,  \
-              s_fog_start, s_fog_end);                                         \
           int _nvCount = 0;                                                    \
           float _h_bot = (z_bot_abs) - s_cam_z;                                \
           float _h_top = (z_top_abs) - s_cam_z;                                \
@@ -1646,10 +2552,12 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
             v_w[_nvCount * 5 + 4] = _v_bot;                                    \
             _nvCount++;                                                        \
           }                                                                    \
-          GPU_TriangleBatch(_tex, target, _nvCount, v_w, ni, i_w,              \
-                            GPU_BATCH_XYZ_ST);                                 \
-          GPU_FlushBlitBuffer();                                               \
-          deactivate_normal_shader();                                          \
+          submit_wall_strip(target, batch_base, immediate, _tex, _norm,        \
+                            wall_tan_x, wall_tan_y, activeFlags,               \
+                            sector->liquid_intensity, sector->liquid_speed,    \
+                            lm_map_wall(&strip_lm, wall_lm, wall, (z_top_abs), \
+                                        (z_bot_abs)),                          \
+                            v_w, _nvCount, i_w, ni);                           \
           if (transparent_pass)                                                \
             glDepthMask(GL_TRUE);                                              \
         }                                                                      \
@@ -1740,6 +2648,8 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
 #undef RENDER_SOLID_SEGMENT
   } /* end wall loop */
 
+  wall_batch_flush(target, batch_base);
+
   /* ---- ISLAND LIDS (rendered after walls so walls occlude them) ---- */
   if (is_island) {
     /* Texture fallback */
@@ -1780,44 +2690,19 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
        Fan tessellation only works for convex polygons.
        For concave sectors (C-shape, rings), render_sector_plane
        already handles them correctly via scanline clipping. */
-    int is_convex = 1;
-    if (sector->num_walls >= 3) {
-      int sign = 0;
-      for (int w = 0; w < sector->num_walls; w++) {
-        int w1 = (w + 1) % sector->num_walls;
-        int w2 = (w + 2) % sector->num_walls;
-        float ax = sector->walls[w1].x1 - sector->walls[w].x1;
-        float ay = sector->walls[w1].y1 - sector->walls[w].y1;
-        float bx = sector->walls[w2].x1 - sector->walls[w1].x1;
-        float by = sector->walls[w2].y1 - sector->walls[w1].y1;
-        float cross = ax * by - ay * bx;
-        if (cross > 0.01f) {
-          if (sign < 0) {
-            is_convex = 0;
-            break;
-          }
-          sign = 1;
-        } else if (cross < -0.01f) {
-          if (sign > 0) {
-            is_convex = 0;
-            break;
-          }
-          sign = -1;
-        }
-      }
-    }
+    int is_convex = st ? st->convex : sector_is_convex(sector);
 
     if (is_convex) {
       if (render_floor && floor_tex) {
         GPU_Image *floor_normal_tex =
             get_gpu_texture(0, sector->floor_normal_id);
-        render_island_lid(target, sector, sector->floor_z, floor_tex,
+        render_island_lid(target, sector, st, sector->floor_z, floor_tex,
                           floor_normal_tex, xf_walls, sector->num_walls, clip);
       }
       if (render_ceil && ceil_tex) {
         GPU_Image *ceil_normal_tex =
             get_gpu_texture(0, sector->ceiling_normal_id);
-        render_island_lid(target, sector, sector->ceiling_z, ceil_tex,
+        render_island_lid(target, sector, st, sector->ceiling_z, ceil_tex,
                           ceil_normal_tex, xf_walls, sector->num_walls, clip);
       }
     }
@@ -1844,6 +2729,8 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
                   (Uint16)(clip.x2 - clip.x1), (Uint16)(clip.y2 - clip.y1));
     }
   }
+
+  s_draw_lights = parent_lights;
 }
 
 /* ============================================================================
@@ -1855,21 +2742,117 @@ static void render_sector_gpu(GPU_Target *target, int sector_id, ClipRect clip,
 #define MD3_XYZ_SCALE (1.0f / 64.0f)
 #endif
 
-/* MD3 Painter's sort comparator: ascending (far first, near last) */
-static int md3_tri_cmp_asc(const void *a, const void *b) {
-  float da = ((const struct {
-               float depth;
-               int base;
-             } *)a)
-                 ->depth;
-  float db = ((const struct {
-               float depth;
-               int base;
-             } *)b)
-                 ->depth;
+/* ============================================================================
+   MODEL PASS STATE (MD3 / glTF)
+   Opaque model triangles go straight to the hardware depth buffer in
+   submission order. Only alpha-blended surfaces are sorted back to front,
+   and they test against depth without writing it.
+   ============================================================================
+ */
+
+static float *s_model_vb = NULL; /* Projected triangle scratch (x,y,z,s,t) */
+static int s_model_vb_capacity = 0; /* In vertices */
+
+static float *model_scratch_vb(int vertices) {
+  if (vertices > s_model_vb_capacity) {
+    float *grown =
+        (float *)realloc(s_model_vb, vertices * 5 * sizeof(float));
+    if (!grown)
+      return NULL;
+    s_model_vb = grown;
+    s_model_vb_capacity = vertices;
+  }
+  return s_model_vb;
+}
+
+static void model_begin_opaque(GPU_Image *img) {
+  GPU_SetWrapMode(img, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
+  GPU_FlushBlitBuffer();
+  GPU_SetBlending(img, 0);
+  glDisable(GL_CULL_FACE);
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+#ifndef __ANDROID__
+#ifndef VITA
+  glEnable(GL_ALPHA_TEST);
+  glAlphaFunc(GL_GREATER, 0.1f);
+#endif
+#endif
+}
+
+static void model_end_opaque(GPU_Image *img) {
+  GPU_SetBlending(img, 1);
+  glDisable(GL_DEPTH_TEST);
+#ifndef __ANDROID__
+#ifndef VITA
+  glDisable(GL_ALPHA_TEST);
+#endif
+#endif
+}
+
+static void model_begin_blended(GPU_Image *img) {
+  GPU_SetWrapMode(img, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
+  GPU_FlushBlitBuffer();
+  GPU_SetBlending(img, 1);
+  glDisable(GL_CULL_FACE);
+  glEnable(GL_DEPTH_TEST);
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_LESS);
+}
+
+static void model_end_blended(GPU_Image *img) {
+  (void)img;
+  glDepthMask(GL_TRUE);
+  glDisable(GL_DEPTH_TEST);
+}
+
+/* Painter's sort for blended triangles: ascending depth (far first) */
+typedef struct {
+  float depth;
+  int base; /* First vertex of the triangle */
+} ModelTriDepth;
+
+static ModelTriDepth *s_model_td = NULL;
+static float *s_model_sorted_vb = NULL;
+static int s_model_sort_capacity = 0; /* In vertices */
+
+static int model_tri_cmp_asc(const void *a, const void *b) {
+  float da = ((const ModelTriDepth *)a)->depth;
+  float db = ((const ModelTriDepth *)b)->depth;
   return (da > db) - (da < db); /* ascending: smaller (farther) first */
 }
 
+/* Returns a far-to-near copy of vb (v_added vertices), or NULL */
+static float *model_sort_triangles(const float *vb, int v_added) {
+  int num_tris = v_added / 3;
+  if (v_added > s_model_sort_capacity) {
+    ModelTriDepth *td =
+        (ModelTriDepth *)realloc(s_model_td, num_tris * sizeof(ModelTriDepth));
+    if (!td)
+      return NULL;
+    s_model_td = td;
+    float *sorted =
+        (float *)realloc(s_model_sorted_vb, v_added * 5 * sizeof(float));
+    if (!sorted)
+      return NULL;
+    s_model_sorted_vb = sorted;
+    s_model_sort_capacity = v_added;
+  }
+
+  for (int t = 0; t < num_tris; t++) {
+    int b = t * 3;
+    s_model_td[t].depth =
+        (vb[b * 5 + 2] + vb[(b + 1) * 5 + 2] + vb[(b + 2) * 5 + 2]) / 3.0f;
+    s_model_td[t].base = b;
+  }
+  qsort(s_model_td, num_tris, sizeof(ModelTriDepth), model_tri_cmp_asc);
+  for (int t = 0; t < num_tris; t++)
+    memcpy(&s_model_sorted_vb[t * 3 * 5], &vb[s_model_td[t].base * 5],
+           3 * 5 * sizeof(float));
+  return s_model_sorted_vb;
+}
+
 static void ray_render_md3_gpu(GPU_Target *target, RAY_Sprite *sprite) {
   if (!sprite || !sprite->model)
     return;
@@ -1880,7 +2863,7 @@ static void ray_render_md3_gpu(GPU_Target *target, RAY_Sprite *sprite) {
 
   /* DEBUG: Track if sprite->rot or position changes during strafe */
   static int md3_dbg_counter = 0;
-  if (md3_dbg_counter++ % 60 == 0) {
+  if (g_engine.verbose >= 2 && md3_dbg_counter++ % 60 == 0) {
     printf("MD3 DEBUG: sprite rot=%.4f pos=(%.1f,%.1f,%.1f) cam=(%.1f,%.1f) "
            "cam_rot=%.4f\n",
            sprite->rot, sprite->x, sprite->y, sprite->z, s_cam_x, s_cam_y,
@@ -1915,8 +2898,9 @@ static void ray_render_md3_gpu(GPU_Target *target, RAY_Sprite *sprite) {
        3. Sprite global skin (if any)
        4. Model global default */
     GPU_Image *img = NULL;
-    if (s < 32 && sprite->md3_surface_textures[s] > 0)
-      img = get_gpu_texture(sprite->fileID, sprite->md3_surface_textures[s]);
+    const RAY_SpriteModelData *md = sprite->model_data;
+    if (md && s < 32 && md->md3_surface_textures[s] > 0)
+      img = get_gpu_texture(sprite->fileID, md->md3_surface_textures[s]);
     else if (surf->textureID > 0)
       img = get_gpu_texture(sprite->fileID, surf->textureID);
     else if (sprite->textureID > 0)
@@ -1933,7 +2917,7 @@ static void ray_render_md3_gpu(GPU_Target *target, RAY_Sprite *sprite) {
 
     /* Render MD3 using Triangle Soup for proper clipping */
     int nt = surf->header.numTriangles;
-    float *tri_vb = (float *)malloc(nt * 3 * 5 * sizeof(float));
+    float *tri_vb = model_scratch_vb(nt * 3);
     if (!tri_vb)
       continue;
 
@@ -1994,47 +2978,14 @@ static void ray_render_md3_gpu(GPU_Target *target, RAY_Sprite *sprite) {
       }
     }
 
-    /* Painter's Algorithm with qsort — O(n log n), no polygon limit.
-       Sort ascending: smaller depth = farther (depth_from_tz maps near→+100,
-       far→-100). Far triangles paint first, near ones overwrite on top. */
-    typedef struct {
-      float depth;
-      int base;
-    } Md3TriDepth;
-    int num_tris_md3 = v_added / 3;
-    if (num_tris_md3 > 0) {
-      Md3TriDepth *td =
-          (Md3TriDepth *)malloc(num_tris_md3 * sizeof(Md3TriDepth));
-      float *sorted_vb = (float *)malloc(v_added * 5 * sizeof(float));
-      if (td && sorted_vb) {
-        for (int t = 0; t < num_tris_md3; t++) {
-          int b = t * 3;
-          td[t].depth = (tri_vb[b * 5 + 2] + tri_vb[(b + 1) * 5 + 2] +
-                         tri_vb[(b + 2) * 5 + 2]) /
-                        3.0f;
-          td[t].base = b;
-        }
-        /* Sort ascending: far (small depth) first, near (large depth) last */
-        qsort(td, num_tris_md3, sizeof(Md3TriDepth), md3_tri_cmp_asc);
-        for (int t = 0; t < num_tris_md3; t++) {
-          int src = td[t].base, dst = t * 3;
-          memcpy(&sorted_vb[dst * 5], &tri_vb[src * 5], 3 * 5 * sizeof(float));
-        }
-        GPU_FlushBlitBuffer();
-        GPU_SetBlending(img, 0);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-        GPU_TriangleBatch(img, target, v_added, sorted_vb, 0, NULL,
-                          GPU_BATCH_XYZ_ST);
-        GPU_FlushBlitBuffer();
-        GPU_SetBlending(img, 1);
-      }
-      if (td)
-        free(td);
-      if (sorted_vb)
-        free(sorted_vb);
+    /* Opaque surface: the depth buffer resolves visibility, no sort */
+    if (v_added > 0) {
+      model_begin_opaque(img);
+      gpu_triangle_batch(img, target, v_added, tri_vb, 0, NULL,
+                         GPU_BATCH_XYZ_ST);
+      GPU_FlushBlitBuffer();
+      model_end_opaque(img);
     }
-    free(tri_vb);
   }
 }
 
@@ -2043,155 +2994,294 @@ static void ray_render_md3_gpu(GPU_Target *target, RAY_Sprite *sprite) {
    ============================================================================
  */
 
-/* Triangle depth entry for Painter's Algorithm sort */
-typedef struct {
-  float depth;
-  int base; /* index into vertex buffer: tri starts at base*5*3 */
-} GltfTriDepth;
+/* ============================================================================
+   GLTF SKINNING SHADER
+   Bind-pose vertices are sent as-is; the vertex shader applies the joint
+   (or node) matrix, the sprite placement and the camera projection. The
+   output is the same screen-space x/y/depth the CPU path produces, scaled
+   by tz so the GL clipper handles the near plane.
+   ============================================================================
+ */
 
-static int gltf_tri_depth_cmp(const void *a, const void *b) {
-  /* Sort descending (far first) so near triangles paint on top */
-  float da = ((const GltfTriDepth *)a)->depth;
-  float db = ((const GltfTriDepth *)b)->depth;
-  return (da < db) - (da > db); /* >0 if a<b (a is nearer, goes later) */
-}
+#define GLTF_GPU_MAX_JOINTS 64
+#define GLTF_BATCH_VERTS 30000
+
+static uint32_t s_gltf_shader = 0;
+static int s_gltf_shader_failed = 0;
+static GPU_ShaderBlock s_gltf_block;
+static int s_gu_joints = -1;
+static int s_gu_node = -1;
+static int s_gu_skinned = -1;
+static int s_gu_model = -1;
+static int s_gu_modelPos = -1;
+static int s_gu_camPos = -1;
+static int s_gu_camRot = -1;
+static int s_gu_proj = -1;
+static int s_gu_depth = -1;
+static int s_gu_tex = -1;
+static int s_ga_joints = -1;
+static int s_ga_weights = -1;
+
+static const char *gltf_vertex_shader_source =
+    "#version 120\n"
+    "attribute vec3 bgd_Vertex;\n"
+    "attribute vec2 bgd_TexCoord;\n"
+    "attribute vec4 bgd_Color;\n"
+    "attribute vec4 a_joints;\n"
+    "attribute vec4 a_weights;\n"
+    "varying vec2 uv;\n"
+    "varying vec4 colorVarying;\n"
+    "uniform mat4 bgd_ModelViewProjectionMatrix;\n"
+    "uniform mat4 u_joints[64];\n"
+    "uniform mat4 u_node;\n"
+    "uniform int u_skinned;\n"
+    "uniform vec3 u_model;    /* cos, sin, scale */\n"
+    "uniform vec3 u_modelPos;\n"
+    "uniform vec3 u_camPos;\n"
+    "uniform vec2 u_camRot;   /* cos, sin */\n"
+    "uniform vec3 u_proj;     /* focal, half_w, horizon */\n"
+    "uniform vec3 u_depth;    /* near, log(near), log(far) */\n"
+    "void main() {\n"
+    "    vec4 p = vec4(bgd_Vertex, 1.0);\n"
+    "    vec3 n;\n"
+    "    if (u_skinned != 0) {\n"
+    "        mat4 m = u_joints[int(a_joints.x)] * a_weights.x +\n"
+    "                 u_joints[int(a_joints.y)] * a_weights.y +\n"
+    "                 u_joints[int(a_joints.z)] * a_weights.z +\n"
+    "                 u_joints[int(a_joints.w)] * a_weights.w;\n"
+    "        n = (m * p).xyz;\n"
+    "    } else {\n"
+    "        n = (u_node * p).xyz;\n"
+    "    }\n"
+    "    float fwd = -n.z * u_model.z;\n"
+    "    float right = n.x * u_model.z;\n"
+    "    float height = n.y * u_model.z;\n"
+    "    float dx = fwd * u_model.x - right * u_model.y + u_modelPos.x - "
+    "u_camPos.x;\n"
+    "    float dy = fwd * u_model.y + right * u_model.x + u_modelPos.y - "
+    "u_camPos.y;\n"
+    "    float dz = height + u_modelPos.z - u_camPos.z;\n"
+    "    float tz = dx * u_camRot.x + dy * u_camRot.y;\n"
+    "    float tx = -dx * u_camRot.y + dy * u_camRot.x;\n"
+    "    float t = clamp((log(max(tz, u_depth.x)) - u_depth.y) /\n"
+    "                    (u_depth.z - u_depth.y), 0.0, 1.0);\n"
+    "    float depth = 100.0 - t * 200.0;\n"
+    "    vec4 screen = vec4(u_proj.y * tz + tx * u_proj.x,\n"
+    "                       u_proj.z * tz - dz * u_proj.x, depth * tz, tz);\n"
+    "    uv = bgd_TexCoord;\n"
+    "    colorVarying = bgd_Color;\n"
+    "    gl_Position = bgd_ModelViewProjectionMatrix * screen;\n"
+    "}\n";
 
-static void ray_render_gltf_gpu(GPU_Target *target, RAY_Sprite *sprite) {
-  if (!sprite || !sprite->model)
-    return;
-  RAY_GLTF_Model *model = (RAY_GLTF_Model *)sprite->model;
-  cgltf_data *data = model->data;
+static const char *gltf_fragment_shader_source =
+    "#version 120\n"
+    "varying vec2 uv;\n"
+    "varying vec4 colorVarying;\n"
+    "uniform sampler2D tex;\n"
+    "void main() {\n"
+    "    vec4 c = texture2D(tex, uv) * colorVarying;\n"
+    "    if (c.a <= 0.1) discard;\n"
+    "    gl_FragColor = c;\n"
+    "}\n";
 
-  /* Aplicar animación glTF si el modelo tiene animaciones */
-  if (data->animations_count > 0 && sprite->glb_anim_index >= 0) {
-    ray_gltf_apply_animation(model, sprite->glb_anim_index,
-                             sprite->glb_anim_time);
+static int init_gltf_shader(void) {
+  if (s_gltf_shader != 0)
+    return 1;
+  if (s_gltf_shader_failed)
+    return 0;
+
+  uint32_t v = GPU_CompileShader(GPU_VERTEX_SHADER, gltf_vertex_shader_source);
+  uint32_t f =
+      GPU_CompileShader(GPU_FRAGMENT_SHADER, gltf_fragment_shader_source);
+  s_gltf_shader = (v && f) ? GPU_LinkShaders(v, f) : 0;
+
+  if (s_gltf_shader == 0) {
+    printf("RAY: glTF skinning shader unavailable, using CPU skinning: %s\n",
+           GPU_GetShaderMessage());
+    s_gltf_shader_failed = 1;
+    return 0;
   }
 
-  /* Actualizar jerarquía de nodos y matrices de huesos */
-  ray_gltf_update_matrices(model);
+  s_gltf_block =
+      GPU_LoadShaderBlock(s_gltf_shader, "bgd_Vertex", "bgd_TexCoord",
+                          "bgd_Color", "bgd_ModelViewProjectionMatrix");
+
+  s_gu_joints = GPU_GetUniformLocation(s_gltf_shader, "u_joints");
+  s_gu_node = GPU_GetUniformLocation(s_gltf_shader, "u_node");
+  s_gu_skinned = GPU_GetUniformLocation(s_gltf_shader, "u_skinned");
+  s_gu_model = GPU_GetUniformLocation(s_gltf_shader, "u_model");
+  s_gu_modelPos = GPU_GetUniformLocation(s_gltf_shader, "u_modelPos");
+  s_gu_camPos = GPU_GetUniformLocation(s_gltf_shader, "u_camPos");
+  s_gu_camRot = GPU_GetUniformLocation(s_gltf_shader, "u_camRot");
+  s_gu_proj = GPU_GetUniformLocation(s_gltf_shader, "u_proj");
+  s_gu_depth = GPU_GetUniformLocation(s_gltf_shader, "u_depth");
+  s_gu_tex = GPU_GetUniformLocation(s_gltf_shader, "tex");
+  s_ga_joints = GPU_GetAttributeLocation(s_gltf_shader, "a_joints");
+  s_ga_weights = GPU_GetAttributeLocation(s_gltf_shader, "a_weights");
+  return 1;
+}
 
+/* GPU path: no per-vertex CPU work, the cached arrays go straight out */
+static void gltf_draw_primitive_shader(GPU_Target *target, GPU_Image *img,
+                                       RAY_Sprite *sprite,
+                                       RAY_GLTF_Primitive *prim,
+                                       const float *node_matrix,
+                                       const float *joint_matrices,
+                                       int joints_count) {
   float cos_model = cosf(sprite->rot);
   float sin_model = sinf(sprite->rot);
   float scale_factor =
       (sprite->model_scale > 0.0f) ? sprite->model_scale : 1.0f;
-
-  for (cgltf_size i = 0; i < data->nodes_count; ++i) {
-    cgltf_node *node = &data->nodes[i];
-    if (!node->mesh)
-      continue;
-
-    /* Find skin for this mesh/node */
-    cgltf_skin *skin = node->skin;
-    float *joint_matrices = NULL;
-    if (skin) {
-      for (cgltf_size s = 0; s < data->skins_count; s++) {
-        if (&data->skins[s] == skin) {
-          joint_matrices = model->skin_matrices[s];
-          break;
-        }
-      }
+  int skinned = (joint_matrices && prim->skin) ? 1 : 0;
+
+  model_begin_opaque(img);
+  GPU_ActivateShaderProgram(s_gltf_shader, &s_gltf_block);
+
+  float model[3] = {cos_model, sin_model, scale_factor};
+  float model_pos[3] = {sprite->x, sprite->y, sprite->z};
+  float cam_pos[3] = {s_cam_x, s_cam_y, s_cam_z};
+  float cam_rot[2] = {s_cos_ang, s_sin_ang};
+  float proj[3] = {s_focal, (float)s_half_w, (float)s_horizon};
+  float depth[3] = {NEAR_PLANE, logf(NEAR_PLANE), logf(10000.0f)};
+  GPU_SetUniformi(s_gu_tex, 0);
+  GPU_SetUniformfv(s_gu_model, 3, 1, model);
+  GPU_SetUniformfv(s_gu_modelPos, 3, 1, model_pos);
+  GPU_SetUniformfv(s_gu_camPos, 3, 1, cam_pos);
+  GPU_SetUniformfv(s_gu_camRot, 2, 1, cam_rot);
+  GPU_SetUniformfv(s_gu_proj, 3, 1, proj);
+  GPU_SetUniformfv(s_gu_depth, 3, 1, depth);
+  GPU_SetUniformi(s_gu_skinned, skinned);
+  if (skinned)
+    GPU_SetUniformMatrixfv(s_gu_joints, joints_count, 4, 4, 0,
+                           (float *)joint_matrices);
+  else
+    GPU_SetUniformMatrixfv(s_gu_node, 1, 4, 4, 0, (float *)node_matrix);
+
+  GPU_AttributeFormat joints_fmt = GPU_MakeAttributeFormat(
+      4, GPU_TYPE_FLOAT, 0, GLTF_SKIN_FLOATS * sizeof(float), 0);
+  GPU_AttributeFormat weights_fmt =
+      GPU_MakeAttributeFormat(4, GPU_TYPE_FLOAT, 0,
+                              GLTF_SKIN_FLOATS * sizeof(float),
+                              4 * sizeof(float));
+
+  for (int start = 0; start < prim->vertex_count; start += GLTF_BATCH_VERTS) {
+    int count = prim->vertex_count - start;
+    if (count > GLTF_BATCH_VERTS)
+      count = GLTF_BATCH_VERTS;
+
+    if (skinned) {
+      float *sk = &prim->skin[start * GLTF_SKIN_FLOATS];
+      GPU_SetAttributeSource(count,
+                             GPU_MakeAttribute(s_ga_joints, sk, joints_fmt));
+      GPU_SetAttributeSource(count,
+                             GPU_MakeAttribute(s_ga_weights, sk, weights_fmt));
     }
+    gpu_triangle_batch(img, target, (unsigned short)count,
+                       &prim->vertices[start * GLTF_VERTEX_FLOATS], 0, NULL,
+                       GPU_BATCH_XYZ_ST);
+    GPU_FlushBlitBuffer();
+  }
 
-    for (cgltf_size j = 0; j < node->mesh->primitives_count; ++j) {
-      cgltf_primitive *prim = &node->mesh->primitives[j];
-      cgltf_accessor *pos_acc = NULL;
-      cgltf_accessor *uv_acc = NULL;
-      cgltf_accessor *joints_acc = NULL;
-      cgltf_accessor *weights_acc = NULL;
-
-      for (cgltf_size k = 0; k < prim->attributes_count; ++k) {
-        if (prim->attributes[k].type == cgltf_attribute_type_position)
-          pos_acc = prim->attributes[k].data;
-        if (prim->attributes[k].type == cgltf_attribute_type_texcoord)
-          uv_acc = prim->attributes[k].data;
-        if (prim->attributes[k].type == cgltf_attribute_type_joints)
-          joints_acc = prim->attributes[k].data;
-        if (prim->attributes[k].type == cgltf_attribute_type_weights)
-          weights_acc = prim->attributes[k].data;
-      }
+  if (skinned) {
+    /* Detach the per-vertex sources before the arrays go out of scope */
+    GPU_SetAttributeSource(0, GPU_MakeAttribute(s_ga_joints, NULL, joints_fmt));
+    GPU_SetAttributeSource(0,
+                           GPU_MakeAttribute(s_ga_weights, NULL, weights_fmt));
+  }
 
-      if (!pos_acc || !prim->indices)
-        continue;
+  GPU_ActivateShaderProgram(0, NULL);
+  model_end_opaque(img);
+}
 
-      int ni_total = (int)prim->indices->count;
-      const int batch_indices = 30000;
-      for (int i_start = 0; i_start < ni_total; i_start += batch_indices) {
-        int i_count = ni_total - i_start;
-        if (i_count > batch_indices)
-          i_count = batch_indices;
-        i_count = (i_count / 3) * 3;
+/* CPU fallback (no shader support, or more joints than the shader takes).
+   Blended materials always come through here so they can be sorted. */
+static float *s_gltf_batch_vb = NULL;
+static int s_gltf_batch_capacity = 0; /* In vertices */
 
-        float *batch_vb = (float *)malloc(i_count * 2 * 5 * sizeof(float));
-        if (!batch_vb)
-          break;
+static void gltf_draw_primitive_cpu(GPU_Target *target, GPU_Image *img,
+                                    RAY_Sprite *sprite,
+                                    RAY_GLTF_Primitive *prim,
+                                    const float *node_matrix,
+                                    const float *joint_matrices) {
+  float cos_model = cosf(sprite->rot);
+  float sin_model = sinf(sprite->rot);
+  float scale_factor =
+      (sprite->model_scale > 0.0f) ? sprite->model_scale : 1.0f;
 
-        int v_added = 0;
-        for (int k = 0; k < i_count; k += 3) {
-          float cam_tx[3], cam_tz[3], cam_dz[3], cam_u[3], cam_v[3];
-          for (int tri_v = 0; tri_v < 3; tri_v++) {
-            int idx = (int)cgltf_accessor_read_index(prim->indices,
-                                                     i_start + k + tri_v);
-            float p[3];
-            cgltf_accessor_read_float(pos_acc, idx, p, 3);
-
-            float nnx, nny, nnz;
-            if (joint_matrices && joints_acc && weights_acc) {
-              /* CPU Skinning */
-              float j_idx[4], w[4];
-              cgltf_accessor_read_float(joints_acc, idx, j_idx, 4);
-              cgltf_accessor_read_float(weights_acc, idx, w, 4);
-
-              nnx = nny = nnz = 0;
-              for (int b = 0; b < 4; b++) {
-                if (w[b] <= 0)
-                  continue;
-                float *m = &joint_matrices[(int)j_idx[b] * 16];
-                nnx += (p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12]) * w[b];
-                nny += (p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13]) * w[b];
-                nnz +=
-                    (p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14]) * w[b];
-              }
-            } else {
-              /* Normal Node Transform */
-              float *m = node->matrix;
-              nnx = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
-              nny = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
-              nnz = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
-            }
+  /* Near-plane clipping can turn one triangle into two */
+  int needed = GLTF_BATCH_VERTS * 2;
+  if (s_gltf_batch_capacity < needed) {
+    float *grown = (float *)realloc(
+        s_gltf_batch_vb, needed * GLTF_VERTEX_FLOATS * sizeof(float));
+    if (!grown)
+      return;
+    s_gltf_batch_vb = grown;
+    s_gltf_batch_capacity = needed;
+  }
+  float *batch_vb = s_gltf_batch_vb;
 
-            float fwd = -nnz * scale_factor;
-            float right = nnx * scale_factor;
-            float height = nny * scale_factor;
-
-            float wx = fwd * cos_model - right * sin_model + sprite->x;
-            float wy = fwd * sin_model + right * cos_model + sprite->y;
-            float wz = height + sprite->z;
-
-            float dx = wx - s_cam_x, dy = wy - s_cam_y;
-            cam_dz[tri_v] = wz - s_cam_z;
-            cam_tz[tri_v] = dx * s_cos_ang + dy * s_sin_ang;
-            cam_tx[tri_v] = -dx * s_sin_ang + dy * s_cos_ang;
-
-            if (uv_acc) {
-              float uv[2];
-              cgltf_accessor_read_float(uv_acc, idx, uv, 2);
-              cam_u[tri_v] = uv[0];
-              /* Removed 1.0 - uv[1] flip for SDL_gpu compatibility with GLTF */
-              cam_v[tri_v] = uv[1];
-            } else {
-              cam_u[tri_v] = cam_v[tri_v] = 0.0f;
-            }
-          }
+  for (int i_start = 0; i_start < prim->vertex_count;
+       i_start += GLTF_BATCH_VERTS) {
+    int i_count = prim->vertex_count - i_start;
+    if (i_count > GLTF_BATCH_VERTS)
+      i_count = GLTF_BATCH_VERTS;
 
-          int behind[3], num_behind = 0;
-          for (int v = 0; v < 3; v++) {
-            behind[v] = (cam_tz[v] <= NEAR_PLANE) ? 1 : 0;
-            num_behind += behind[v];
+    int v_added = 0;
+    for (int k = 0; k < i_count; k += 3) {
+      float cam_tx[3], cam_tz[3], cam_dz[3], cam_u[3], cam_v[3];
+      for (int tri_v = 0; tri_v < 3; tri_v++) {
+        int idx = i_start + k + tri_v;
+        const float *p = &prim->vertices[idx * GLTF_VERTEX_FLOATS];
+
+        float nnx, nny, nnz;
+        if (joint_matrices && prim->skin) {
+          /* CPU Skinning */
+          const float *j_idx = &prim->skin[idx * GLTF_SKIN_FLOATS];
+          const float *w = j_idx + 4;
+
+          nnx = nny = nnz = 0;
+          for (int b = 0; b < 4; b++) {
+            if (w[b] <= 0)
+              continue;
+            const float *m = &joint_matrices[(int)j_idx[b] * 16];
+            nnx += (p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12]) * w[b];
+            nny += (p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13]) * w[b];
+            nnz += (p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14]) * w[b];
           }
+        } else {
+          /* Normal Node Transform */
+          const float *m = node_matrix;
+          nnx = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+          nny = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+          nnz = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
+        }
 
-          if (num_behind == 3)
-            continue;
+        float fwd = -nnz * scale_factor;
+        float right = nnx * scale_factor;
+        float height = nny * scale_factor;
+
+        float wx = fwd * cos_model - right * sin_model + sprite->x;
+        float wy = fwd * sin_model + right * cos_model + sprite->y;
+        float wz = height + sprite->z;
+
+        float dx = wx - s_cam_x, dy = wy - s_cam_y;
+        cam_dz[tri_v] = wz - s_cam_z;
+        cam_tz[tri_v] = dx * s_cos_ang + dy * s_sin_ang;
+        cam_tx[tri_v] = -dx * s_sin_ang + dy * s_cos_ang;
+
+        /* Removed 1.0 - uv[1] flip for SDL_gpu compatibility with GLTF */
+        cam_u[tri_v] = p[3];
+        cam_v[tri_v] = p[4];
+      }
+
+      int behind[3], num_behind = 0;
+      for (int v = 0; v < 3; v++) {
+        behind[v] = (cam_tz[v] <= NEAR_PLANE) ? 1 : 0;
+        num_behind += behind[v];
+      }
+
+      if (num_behind == 3)
+        continue;
 
 #define PROJECT_VERT(out, idx5, ttx, ttz, tdz, tu, tv)                         \
   do {                                                                         \
@@ -2203,125 +3293,163 @@ static void ray_render_gltf_gpu(GPU_Target *target, RAY_Sprite *sprite) {
     (out)[(idx5) + 4] = (tv);                                                  \
   } while (0)
 
-          if (num_behind == 0) {
-            for (int v = 0; v < 3; v++)
-              PROJECT_VERT(batch_vb, (v_added + v) * 5, cam_tx[v], cam_tz[v],
-                           cam_dz[v], cam_u[v], cam_v[v]);
-            v_added += 3;
-          } else if (num_behind == 1) {
-            int b = -1;
-            for (int v = 0; v < 3; v++)
-              if (behind[v]) {
-                b = v;
-                break;
-              }
-            int a = (b + 1) % 3, c = (b + 2) % 3;
-            float t_ba = (NEAR_PLANE - cam_tz[b]) / (cam_tz[a] - cam_tz[b]);
-            float c_tx_ba = cam_tx[b] + t_ba * (cam_tx[a] - cam_tx[b]);
-            float c_dz_ba = cam_dz[b] + t_ba * (cam_dz[a] - cam_dz[b]);
-            float c_u_ba = cam_u[b] + t_ba * (cam_u[a] - cam_u[b]);
-            float c_v_ba = cam_v[b] + t_ba * (cam_v[a] - cam_v[b]);
-            float t_bc = (NEAR_PLANE - cam_tz[b]) / (cam_tz[c] - cam_tz[b]);
-            float c_tx_bc = cam_tx[b] + t_bc * (cam_tx[c] - cam_tx[b]);
-            float c_dz_bc = cam_dz[b] + t_bc * (cam_dz[c] - cam_dz[b]);
-            float c_u_bc = cam_u[b] + t_bc * (cam_u[c] - cam_u[b]);
-            float c_v_bc = cam_v[b] + t_bc * (cam_v[c] - cam_v[b]);
-            PROJECT_VERT(batch_vb, (v_added + 0) * 5, cam_tx[a], cam_tz[a],
-                         cam_dz[a], cam_u[a], cam_v[a]);
-            PROJECT_VERT(batch_vb, (v_added + 1) * 5, c_tx_ba, NEAR_PLANE,
-                         c_dz_ba, c_u_ba, c_v_ba);
-            PROJECT_VERT(batch_vb, (v_added + 2) * 5, c_tx_bc, NEAR_PLANE,
-                         c_dz_bc, c_u_bc, c_v_bc);
-            v_added += 3;
-            PROJECT_VERT(batch_vb, (v_added + 0) * 5, cam_tx[a], cam_tz[a],
-                         cam_dz[a], cam_u[a], cam_v[a]);
-            PROJECT_VERT(batch_vb, (v_added + 1) * 5, c_tx_bc, NEAR_PLANE,
-                         c_dz_bc, c_u_bc, c_v_bc);
-            PROJECT_VERT(batch_vb, (v_added + 2) * 5, cam_tx[c], cam_tz[c],
-                         cam_dz[c], cam_u[c], cam_v[c]);
-            v_added += 3;
-          } else {
-            int f = -1;
-            for (int v = 0; v < 3; v++)
-              if (!behind[v]) {
-                f = v;
-                break;
-              }
-            int b1 = (f + 1) % 3, b2 = (f + 2) % 3;
-            float t1 = (NEAR_PLANE - cam_tz[f]) / (cam_tz[b1] - cam_tz[f]);
-            float t2 = (NEAR_PLANE - cam_tz[f]) / (cam_tz[b2] - cam_tz[f]);
-            float c1_tx = cam_tx[f] + t1 * (cam_tx[b1] - cam_tx[f]);
-            float c1_dz = cam_dz[f] + t1 * (cam_dz[b1] - cam_dz[f]);
-            float c1_u = cam_u[f] + t1 * (cam_u[b1] - cam_u[f]);
-            float c1_v = cam_v[f] + t1 * (cam_v[b1] - cam_v[f]);
-            float c2_tx = cam_tx[f] + t2 * (cam_tx[b2] - cam_tx[f]);
-            float c2_dz = cam_dz[f] + t2 * (cam_dz[b2] - cam_dz[f]);
-            float c2_u = cam_u[f] + t2 * (cam_u[b2] - cam_u[f]);
-            float c2_v = cam_v[f] + t2 * (cam_v[b2] - cam_v[f]);
-            PROJECT_VERT(batch_vb, (v_added + 0) * 5, cam_tx[f], cam_tz[f],
-                         cam_dz[f], cam_u[f], cam_v[f]);
-            PROJECT_VERT(batch_vb, (v_added + 1) * 5, c1_tx, NEAR_PLANE, c1_dz,
-                         c1_u, c1_v);
-            PROJECT_VERT(batch_vb, (v_added + 2) * 5, c2_tx, NEAR_PLANE, c2_dz,
-                         c2_u, c2_v);
-            v_added += 3;
+      if (num_behind == 0) {
+        for (int v = 0; v < 3; v++)
+          PROJECT_VERT(batch_vb, (v_added + v) * 5, cam_tx[v], cam_tz[v],
+                       cam_dz[v], cam_u[v], cam_v[v]);
+        v_added += 3;
+      } else if (num_behind == 1) {
+        int b = -1;
+        for (int v = 0; v < 3; v++)
+          if (behind[v]) {
+            b = v;
+            break;
+          }
+        int a = (b + 1) % 3, c = (b + 2) % 3;
+        float t_ba = (NEAR_PLANE - cam_tz[b]) / (cam_tz[a] - cam_tz[b]);
+        float c_tx_ba = cam_tx[b] + t_ba * (cam_tx[a] - cam_tx[b]);
+        float c_dz_ba = cam_dz[b] + t_ba * (cam_dz[a] - cam_dz[b]);
+        float c_u_ba = cam_u[b] + t_ba * (cam_u[a] - cam_u[b]);
+        float c_v_ba = cam_v[b] + t_ba * (cam_v[a] - cam_v[b]);
+        float t_bc = (NEAR_PLANE - cam_tz[b]) / (cam_tz[c] - cam_tz[b]);
+        float c_tx_bc = cam_tx[b] + t_bc * (cam_tx[c] - cam_tx[b]);
+        float c_dz_bc = cam_dz[b] + t_bc * (cam_dz[c] - cam_dz[b]);
+        float c_u_bc = cam_u[b] + t_bc * (cam_u[c] - cam_u[b]);
+        float c_v_bc = cam_v[b] + t_bc * (cam_v[c] - cam_v[b]);
+        PROJECT_VERT(batch_vb, (v_added + 0) * 5, cam_tx[a], cam_tz[a],
+                     cam_dz[a], cam_u[a], cam_v[a]);
+        PROJECT_VERT(batch_vb, (v_added + 1) * 5, c_tx_ba, NEAR_PLANE,
+                     c_dz_ba, c_u_ba, c_v_ba);
+        PROJECT_VERT(batch_vb, (v_added + 2) * 5, c_tx_bc, NEAR_PLANE,
+                     c_dz_bc, c_u_bc, c_v_bc);
+        v_added += 3;
+        PROJECT_VERT(batch_vb, (v_added + 0) * 5, cam_tx[a], cam_tz[a],
+                     cam_dz[a], cam_u[a], cam_v[a]);
+        PROJECT_VERT(batch_vb, (v_added + 1) * 5, c_tx_bc, NEAR_PLANE,
+                     c_dz_bc, c_u_bc, c_v_bc);
+        PROJECT_VERT(batch_vb, (v_added + 2) * 5, cam_tx[c], cam_tz[c],
+                     cam_dz[c], cam_u[c], cam_v[c]);
+        v_added += 3;
+      } else {
+        int f = -1;
+        for (int v = 0; v < 3; v++)
+          if (!behind[v]) {
+            f = v;
+            break;
           }
+        int b1 = (f + 1) % 3, b2 = (f + 2) % 3;
+        float t1 = (NEAR_PLANE - cam_tz[f]) / (cam_tz[b1] - cam_tz[f]);
+        float t2 = (NEAR_PLANE - cam_tz[f]) / (cam_tz[b2] - cam_tz[f]);
+        float c1_tx = cam_tx[f] + t1 * (cam_tx[b1] - cam_tx[f]);
+        float c1_dz = cam_dz[f] + t1 * (cam_dz[b1] - cam_dz[f]);
+        float c1_u = cam_u[f] + t1 * (cam_u[b1] - cam_u[f]);
+        float c1_v = cam_v[f] + t1 * (cam_v[b1] - cam_v[f]);
+        float c2_tx = cam_tx[f] + t2 * (cam_tx[b2] - cam_tx[f]);
+        float c2_dz = cam_dz[f] + t2 * (cam_dz[b2] - cam_dz[f]);
+        float c2_u = cam_u[f] + t2 * (cam_u[b2] - cam_u[f]);
+        float c2_v = cam_v[f] + t2 * (cam_v[b2] - cam_v[f]);
+        PROJECT_VERT(batch_vb, (v_added + 0) * 5, cam_tx[f], cam_tz[f],
+                     cam_dz[f], cam_u[f], cam_v[f]);
+        PROJECT_VERT(batch_vb, (v_added + 1) * 5, c1_tx, NEAR_PLANE, c1_dz,
+                     c1_u, c1_v);
+        PROJECT_VERT(batch_vb, (v_added + 2) * 5, c2_tx, NEAR_PLANE, c2_dz,
+                     c2_u, c2_v);
+        v_added += 3;
+      }
 #undef PROJECT_VERT
-        }
+    }
 
-        if (v_added == 0) {
-          free(batch_vb);
-          continue;
-        }
+    if (v_added == 0)
+      continue;
 
-        GPU_Image *img = NULL;
-        if (prim->material) {
-          cgltf_texture *tex_ptr =
-              prim->material->pbr_metallic_roughness.base_color_texture.texture;
-          if (tex_ptr && tex_ptr->image) {
-            for (cgltf_size m = 0; m < model->data->images_count; m++) {
-              if (&model->data->images[m] == tex_ptr->image) {
-                if ((int)m < model->textures_count)
-                  img = model->textures[m];
-                break;
-              }
-            }
-          }
-        }
-        if (!img && model->textures_count > 0)
-          img = model->textures[0];
-        if (!img)
-          img = get_gpu_texture(sprite->fileID, sprite->textureID);
-
-        if (img) {
-          GPU_SetWrapMode(img, GPU_WRAP_REPEAT, GPU_WRAP_REPEAT);
-          GPU_FlushBlitBuffer();
-          GPU_SetBlending(img, 0);
-          glEnable(GL_DEPTH_TEST);
-          glDepthMask(GL_TRUE);
-          glDepthFunc(GL_LESS);
-#ifndef __ANDROID__
-#ifndef VITA
-          glEnable(GL_ALPHA_TEST);
-          glAlphaFunc(GL_GREATER, 0.1f);
-#endif
-#endif
+    if (prim->alpha_blend) {
+      float *sorted_vb = model_sort_triangles(batch_vb, v_added);
+      if (!sorted_vb)
+        continue;
+      model_begin_blended(img);
+      gpu_triangle_batch(img, target, v_added, sorted_vb, 0, NULL,
+                         GPU_BATCH_XYZ_ST);
+      GPU_FlushBlitBuffer();
+      model_end_blended(img);
+    } else {
+      model_begin_opaque(img);
+      gpu_triangle_batch(img, target, v_added, batch_vb, 0, NULL,
+                         GPU_BATCH_XYZ_ST);
+      GPU_FlushBlitBuffer();
+      model_end_opaque(img);
+    }
+  }
+}
+
+static void ray_render_gltf_gpu(GPU_Target *target, RAY_Sprite *sprite) {
+  if (!sprite || !sprite->model)
+    return;
+  RAY_GLTF_Model *model = (RAY_GLTF_Model *)sprite->model;
+  cgltf_data *data = model->data;
+  if (!model->prims)
+    return;
 
-          GPU_TriangleBatch(img, target, v_added, batch_vb, 0, NULL,
-                            GPU_BATCH_XYZ_ST);
-          GPU_FlushBlitBuffer();
+  /* Pose de esta instancia: se evalúa una vez por (animación, tiempo) y se
+     comparte entre sprites del mismo modelo */
+  const RAY_GLTF_Pose *pose = ray_gltf_acquire_pose(
+      model, sprite->glb_anim_index, sprite->glb_anim_time,
+      &sprite->glb_pose_slot, &sprite->glb_pose_serial);
+  if (!pose) {
+    /* Sin caché (memoria): evaluar sobre los nodos compartidos */
+    if (data->animations_count > 0 && sprite->glb_anim_index >= 0) {
+      ray_gltf_apply_animation(model, sprite->glb_anim_index,
+                               sprite->glb_anim_time);
+    }
+    ray_gltf_update_matrices(model);
+  }
 
-          GPU_SetBlending(img, 1);
-          glDisable(GL_DEPTH_TEST);
-#ifndef __ANDROID__
-#ifndef VITA
-          glDisable(GL_ALPHA_TEST);
-#endif
-#endif
-        }
-        free(batch_vb);
+  int use_shader = init_gltf_shader();
+
+  for (cgltf_size i = 0; i < data->nodes_count; ++i) {
+    cgltf_node *node = &data->nodes[i];
+    if (!node->mesh)
+      continue;
+
+    const float *node_matrix =
+        pose ? &pose->node_world[i * 16] : node->matrix;
+
+    /* Skin for this mesh/node */
+    const float *joint_matrices = NULL;
+    int joints_count = 0;
+    if (node->skin) {
+      cgltf_size s = (cgltf_size)(node->skin - data->skins);
+      if (s < data->skins_count) {
+        joint_matrices = pose ? &pose->joints[model->skin_joint_offset[s] * 16]
+                              : model->skin_matrices[s];
+        joints_count = (int)node->skin->joints_count;
       }
     }
+
+    int m = (int)(node->mesh - data->meshes);
+    for (int pi = model->mesh_first_prim[m]; pi < model->mesh_first_prim[m + 1];
+         pi++) {
+      RAY_GLTF_Primitive *prim = &model->prims[pi];
+      if (prim->vertex_count <= 0)
+        continue;
+
+      GPU_Image *img = NULL;
+      if (prim->image_index >= 0 && prim->image_index < model->textures_count)
+        img = model->textures[prim->image_index];
+      if (!img && model->textures_count > 0)
+        img = model->textures[0];
+      if (!img)
+        img = get_gpu_texture(sprite->fileID, sprite->textureID);
+      if (!img)
+        continue;
+
+      if (use_shader && !prim->alpha_blend &&
+          (!joint_matrices || joints_count <= GLTF_GPU_MAX_JOINTS))
+        gltf_draw_primitive_shader(target, img, sprite, prim, node_matrix,
+                                   joint_matrices, joints_count);
+      else
+        gltf_draw_primitive_cpu(target, img, sprite, prim, node_matrix,
+                                joint_matrices);
+    }
   }
 }
 
@@ -2385,43 +3513,81 @@ static int sprite_occluded_by_islands(float sprite_x, float sprite_y,
   return 0;
 }
 
+/* Camera-facing quad of img centred at (x, y, z), w x h world units */
+static int gpu_draw_billboard(GPU_Target *target, GPU_Image *img, float x,
+                              float y, float z, float w, float h) {
+  float dx = x - s_cam_x, dy = y - s_cam_y;
+  float tz = dx * s_cos_ang + dy * s_sin_ang;
+  if (tz < NEAR_PLANE)
+    return 0;
+
+  float tx = -dx * s_sin_ang + dy * s_cos_ang;
+  float ty = z - s_cam_z;
+
+  float scale = s_focal / tz;
+  float sx = s_half_w + (tx * scale);
+  float sy = s_half_h - (ty * scale);
+  float sw = w * scale;
+  float sh = h * scale;
+  float sz = depth_from_tz(tz);
+
+  float vb[20] = {
+      sx - sw / 2, sy - sh / 2, sz, 0, 0, sx + sw / 2, sy - sh / 2, sz, 1, 0,
+      sx + sw / 2, sy + sh / 2, sz, 1, 1, sx - sw / 2, sy + sh / 2, sz, 0, 1};
+  unsigned short ib[6] = {0, 1, 2, 0, 2, 3};
+  GPU_SetImageFilter(img, GPU_FILTER_LINEAR);
+  gpu_triangle_batch(img, target, 4, vb, 6, ib, GPU_BATCH_XYZ_ST);
+  return 1;
+}
+
 static void render_sprite_gpu(GPU_Target *target, RAY_Sprite *sprite) {
   if (sprite->hidden || sprite->cleanup)
     return;
 
   /* Software occlusion: skip sprites hidden behind island walls */
-  if (sprite_occluded_by_islands(sprite->x, sprite->y, sprite->z))
+  if (sprite_occluded_by_islands(sprite->x, sprite->y, sprite->z)) {
+    RAY_STAT_ADD(RAY_STAT_SPRITES_CULLED, 1);
     return;
+  }
 
   if (sprite->model) {
-    uint32_t *magic = (uint32_t *)sprite->model;
-    if (*magic == MD3_MAGIC) {
-      ray_render_md3_gpu(target, sprite);
+    float dx = sprite->x - s_cam_x, dy = sprite->y - s_cam_y;
+    RAY_ImpostorDraw imp;
+    void *model = ray_model_lod_pick(sprite, sqrtf(dx * dx + dy * dy), &imp);
+    if (!model) {
+      RAY_STAT_TIMER(t_impostor);
+      GPU_Image *img = (GPU_Image *)imp.graph->tex;
+      if (!img || !gpu_draw_billboard(target, img, sprite->x, sprite->y,
+                                      imp.z, imp.w, imp.h))
+        return;
+      RAY_STAT_ELAPSED(RAY_STAT_SPRITES_MS, t_impostor);
+      RAY_STAT_ADD(RAY_STAT_IMPOSTORS, 1);
+      RAY_STAT_ADD(RAY_STAT_SPRITES_DRAWN, 1);
       return;
     }
-    if (*magic == GLTF_MAGIC) {
+
+    /* The chosen LOD is drawn through the sprite, then restored */
+    struct RAY_Model *base = sprite->model;
+    sprite->model = (struct RAY_Model *)model;
+    uint32_t *magic = (uint32_t *)sprite->model;
+    RAY_STAT_TIMER(t_model);
+    int drawn = 1;
+    if (*magic == MD3_MAGIC)
+      ray_render_md3_gpu(target, sprite);
+    else if (*magic == GLTF_MAGIC)
       ray_render_gltf_gpu(target, sprite);
+    else
+      drawn = 0;
+    sprite->model = base;
+    if (!drawn)
       return;
-    }
+    RAY_STAT_ELAPSED(RAY_STAT_MODELS_MS, t_model);
+    RAY_STAT_ADD(RAY_STAT_SPRITES_DRAWN, 1);
     return;
   }
 
   /* Regular billboard sprite */
-  float dx = sprite->x - s_cam_x, dy = sprite->y - s_cam_y;
-  float tz = dx * s_cos_ang + dy * s_sin_ang;
-  if (tz < NEAR_PLANE)
-    return;
-
-  float tx = -dx * s_sin_ang + dy * s_cos_ang;
-  float ty = (sprite->z + sprite->h / 2.0f) - s_cam_z;
-
-  float scale = s_focal / tz;
-  float sx = s_half_w + (tx * scale);
-  float sy = s_half_h - (ty * scale);
-  float sw = sprite->w * scale;
-  float sh = sprite->h * scale;
-  float sz = depth_from_tz(tz);
-
+  RAY_STAT_TIMER(t_sprite);
   GPU_Image *img = NULL;
   if (sprite->process_ptr) {
     GRAPH *g = instance_graph(sprite->process_ptr);
@@ -2432,12 +3598,11 @@ static void render_sprite_gpu(GPU_Target *target, RAY_Sprite *sprite) {
   if (!img)
     return;
 
-  float vb[20] = {
-      sx - sw / 2, sy - sh / 2, sz, 0, 0, sx + sw / 2, sy - sh / 2, sz, 1, 0,
-      sx + sw / 2, sy + sh / 2, sz, 1, 1, sx - sw / 2, sy + sh / 2, sz, 0, 1};
-  unsigned short ib[6] = {0, 1, 2, 0, 2, 3};
-  GPU_SetImageFilter(img, GPU_FILTER_LINEAR);
-  GPU_TriangleBatch(img, target, 4, vb, 6, ib, GPU_BATCH_XYZ_ST);
+  if (!gpu_draw_billboard(target, img, sprite->x, sprite->y,
+                          sprite->z + sprite->h / 2.0f, sprite->w, sprite->h))
+    return;
+  RAY_STAT_ELAPSED(RAY_STAT_SPRITES_MS, t_sprite);
+  RAY_STAT_ADD(RAY_STAT_SPRITES_DRAWN, 1);
 }
 
 static int sprite_sorter_gpu(const void *a, const void *b) {
@@ -2455,6 +3620,9 @@ void ray_render_frame_gpu(void *dest_graph_ptr) {
   if (!dest)
     return;
 
+  /* Cached images of unloaded or reloaded FPGs go before any draw */
+  gpu_textures_begin_frame();
+
   GPU_Target *target = NULL;
   if (dest->code == 0) {
     target = GPU_GetContextTarget();
@@ -2486,8 +3654,25 @@ void ray_render_frame_gpu(void *dest_graph_ptr) {
   if (!cam_sector)
     return;
 
+  /* Resolution scaling: draw into an internal target and stretch it over
+     the real one at the end of the frame */
+  GPU_Target *final_target = target;
+  int out_w = (dest->code == 0) ? g_engine.displayWidth : (int)dest->width;
+  int out_h = (dest->code == 0) ? g_engine.displayHeight : (int)dest->height;
+  int iw = g_engine.internalWidth, ih = g_engine.internalHeight;
   s_screen_w = g_engine.displayWidth;
   s_screen_h = g_engine.displayHeight;
+  if (iw > 0 && ih > 0 &&
+      (iw < g_engine.displayWidth || ih < g_engine.displayHeight)) {
+    GPU_Target *internal = gpu_internal_target(iw, ih);
+    if (internal) {
+      target = internal;
+      s_screen_w = iw;
+      s_screen_h = ih;
+    }
+  }
+  float pitch_scale = (float)s_screen_h / (float)g_engine.displayHeight;
+
   s_half_w = s_screen_w / 2;
   s_half_h = s_screen_h / 2;
   s_focal = (float)s_half_w;
@@ -2497,7 +3682,7 @@ void ray_render_frame_gpu(void *dest_graph_ptr) {
   float ang = g_engine.camera.rot;
   s_cos_ang = cosf(ang);
   s_sin_ang = sinf(ang);
-  s_horizon = s_half_h + (int)g_engine.camera.pitch;
+  s_horizon = s_half_h + (int)(g_engine.camera.pitch * pitch_scale);
 
   /* Set global fog from camera's current sector */
   s_fog_r = cam_sector->fog_color_r;
@@ -2556,7 +3741,8 @@ void ray_render_frame_gpu(void *dest_graph_ptr) {
 
       /* Vertical: Doom skies are centered at horizon and move 1:1 with pitch or
        * slower */
-      float v_offset = (float)g_engine.camera.pitch / (float)s_screen_h * 0.8f;
+      float v_offset =
+          (float)g_engine.camera.pitch / (float)g_engine.displayHeight * 0.8f;
       float v0 = 0.0f - v_offset;
       float v1 = 1.0f - v_offset;
 
@@ -2588,7 +3774,8 @@ void ray_render_frame_gpu(void *dest_graph_ptr) {
       glDisable(GL_DEPTH_TEST);
       glDepthMask(GL_FALSE); /* Don't write sky to depth buffer */
 
-      GPU_TriangleBatch(sky_tex, target, 4, sk_vb, 6, sk_ib, GPU_BATCH_XYZ_ST);
+      gpu_triangle_batch(sky_tex, target, 4, sk_vb, 6, sk_ib,
+                         GPU_BATCH_XYZ_ST);
 
       GPU_FlushBlitBuffer();
       glEnable(GL_DEPTH_TEST);
@@ -2601,6 +3788,33 @@ void ray_render_frame_gpu(void *dest_graph_ptr) {
 
   // Actually render the world scene
   ray_render_scene_gpu(target, current_sector);
+
+  if (target != final_target) {
+    GPU_FlushBlitBuffer();
+    GPU_SetDepthTest(final_target, 0);
+    glDisable(GL_DEPTH_TEST);
+    GPU_Rect out = {0, 0, (float)out_w, (float)out_h};
+    RAY_STAT_TIMER(t_commit);
+    GPU_BlitRect(s_internal_image, NULL, final_target, &out);
+    GPU_FlushBlitBuffer();
+    RAY_STAT_ELAPSED(RAY_STAT_COMMIT_MS, t_commit);
+  }
+}
+
+/* One full portal traversal from the root sector. The traversal time excludes
+   what render_sector_gpu already charged to walls and planes */
+static void render_root_pass(GPU_Target *target, int render_root,
+                             ClipRect full_clip, int transparent_pass) {
+  double nested = g_ray_stats_acc[RAY_STAT_WALLS_MS] +
+                  g_ray_stats_acc[RAY_STAT_PLANES_MS];
+  RAY_STAT_TIMER(t_pass);
+  render_sector_gpu(target, render_root, full_clip, 0, 0, -99999.0f, 99999.0f,
+                    transparent_pass);
+  RAY_STAT_ELAPSED(RAY_STAT_TRAVERSAL_MS, t_pass);
+  if (t_pass)
+    g_ray_stats_acc[RAY_STAT_TRAVERSAL_MS] -=
+        g_ray_stats_acc[RAY_STAT_WALLS_MS] +
+        g_ray_stats_acc[RAY_STAT_PLANES_MS] - nested;
 }
 
 static int sprite_ptr_sorter_gpu(const void *a, const void *b) {
@@ -2613,6 +3827,34 @@ static int sprite_ptr_sorter_gpu(const void *a, const void *b) {
   return 0;
 }
 
+/* Island cache for sprite occlusion, built once per tick for all views.
+   A sector is a solid island occluder only if it is a box completely
+   INSIDE its parent: floor above parent floor AND ceiling below parent
+   ceiling. Elevated-floor sectors (ramps, steps) where ceiling==parent
+   ceiling are NOT solid occluders. */
+void ray_gpu_prepare_scene(void) {
+  s_num_islands = 0;
+  s_island_owner = g_engine.sectors;
+  for (int si = 0;
+       si < g_engine.num_sectors && s_num_islands < MAX_ISLAND_SECTORS; si++) {
+    RAY_Sector *sec = &g_engine.sectors[si];
+    if (sec->parent_sector_id == -1)
+      continue;
+    RAY_Sector *par = find_sector_by_id(sec->parent_sector_id);
+    if (!par)
+      continue;
+    /* Must be strictly inside the parent vertically on BOTH ends */
+    if (sec->floor_z <= par->floor_z + 0.1f)
+      continue; /* floor not above parent floor → not a box */
+    if (sec->ceiling_z >= par->ceiling_z - 0.1f)
+      continue; /* ceiling not below parent ceiling → not a box */
+    s_island_sectors[s_num_islands] = sec;
+    s_island_floor[s_num_islands] = sec->floor_z;
+    s_island_ceil[s_num_islands] = sec->ceiling_z;
+    s_num_islands++;
+  }
+}
+
 void ray_render_scene_gpu(GPU_Target *target, int current_sector) {
   if (!g_engine.initialized || current_sector < 0) {
     if (target) {
@@ -2623,6 +3865,16 @@ void ray_render_scene_gpu(GPU_Target *target, int current_sector) {
   }
   glClear(GL_DEPTH_BUFFER_BIT);
 
+  /* Texture atlas and lightmap (built or uploaded if they changed) decide
+     the vertex layout of the frame */
+  s_last_batch_image = NULL;
+  gpu_atlas_begin_frame();
+  gpu_lightmap_begin_frame();
+  /* Camera, lights and fog uniforms: once per frame, not once per wall */
+  normal_shader_begin_frame();
+  s_wall_batch_top = 0;
+  s_pvs_row = ray_pvs_row(ray_sector_index_by_id(&g_engine, current_sector));
+
   ClipRect full_clip = {0, 0, (float)s_screen_w, (float)s_screen_h};
 
   /* Find root parent for correct nested context */
@@ -2633,35 +3885,14 @@ void ray_render_scene_gpu(GPU_Target *target, int current_sector) {
     rr_sec = find_sector_by_id(render_root);
   }
 
-  /* Pre-build island cache for sprite occlusion (once per frame).
-     A sector is a solid island occluder only if it is a box completely
-     INSIDE its parent: floor above parent floor AND ceiling below parent
-     ceiling. Elevated-floor sectors (ramps, steps) where ceiling==parent
-     ceiling are NOT solid occluders. */
-  s_num_islands = 0;
-  for (int si = 0;
-       si < g_engine.num_sectors && s_num_islands < MAX_ISLAND_SECTORS; si++) {
-    RAY_Sector *sec = &g_engine.sectors[si];
-    if (sec->parent_sector_id == -1)
-      continue;
-    RAY_Sector *par = find_sector_by_id(sec->parent_sector_id);
-    if (!par)
-      continue;
-    /* Must be strictly inside the parent vertically on BOTH ends */
-    if (sec->floor_z <= par->floor_z + 0.1f)
-      continue; /* floor not above parent floor → not a box */
-    if (sec->ceiling_z >= par->ceiling_z - 0.1f)
-      continue; /* ceiling not below parent ceiling → not a box */
-    s_island_sectors[s_num_islands] = sec;
-    s_island_floor[s_num_islands] = sec->floor_z;
-    s_island_ceil[s_num_islands] = sec->ceiling_z;
-    s_num_islands++;
-  }
+  /* Islands normally come from the scene preparation; rebuild them here if
+     the map changed since then */
+  if (s_island_owner != g_engine.sectors)
+    ray_gpu_prepare_scene();
 
   /* Pass 0: Opaque geometry */
   visited_clear();
-  render_sector_gpu(target, render_root, full_clip, 0, 0, -99999.0f, 99999.0f,
-                    0);
+  render_root_pass(target, render_root, full_clip, 0);
 
   /* Flush walls to depth buffer before sprites */
   GPU_FlushBlitBuffer();
@@ -2675,23 +3906,47 @@ void ray_render_scene_gpu(GPU_Target *target, int current_sector) {
   glDepthMask(GL_TRUE);
   glDepthFunc(GL_LEQUAL);
 
-  /* Pre-calculate distances for sorting */
+  /* Collect sprites from the bins of visited sectors (plus sprites outside
+     every sector) and pre-calculate distances for sorting */
   if (g_engine.num_sprites > 0) {
     RAY_Sprite **sorted_ptrs =
         (RAY_Sprite **)malloc(g_engine.num_sprites * sizeof(RAY_Sprite *));
     if (sorted_ptrs) {
-      for (int i = 0; i < g_engine.num_sprites; i++) {
-        float dx = g_engine.sprites[i].x - s_cam_x;
-        float dy = g_engine.sprites[i].y - s_cam_y;
-        g_engine.sprites[i].distance = sqrtf(dx * dx + dy * dy);
-        sorted_ptrs[i] = &g_engine.sprites[i];
+      int num_sorted = 0;
+      int num_bins = g_engine.num_sectors;
+      if (num_bins > g_engine.sector_sprite_head_capacity)
+        num_bins = g_engine.sector_sprite_head_capacity;
+
+      for (int si = -1; si < num_bins; si++) {
+        int head;
+        if (si < 0) {
+          head = g_engine.outside_sprite_head;
+        } else {
+          if (!visited_test(g_engine.sectors[si].sector_id)) {
+            if (g_engine.stats_enabled) {
+              for (int i = g_engine.sector_sprite_head[si]; i >= 0;
+                   i = g_engine.sprites[i].bin_next)
+                RAY_STAT_ADD(RAY_STAT_SPRITES_CULLED, 1);
+            }
+            continue;
+          }
+          head = g_engine.sector_sprite_head[si];
+        }
+        for (int i = head; i >= 0 && num_sorted < g_engine.num_sprites;
+             i = g_engine.sprites[i].bin_next) {
+          RAY_Sprite *spr = &g_engine.sprites[i];
+          float dx = spr->x - s_cam_x;
+          float dy = spr->y - s_cam_y;
+          spr->distance = sqrtf(dx * dx + dy * dy);
+          sorted_ptrs[num_sorted++] = spr;
+        }
       }
 
       /* Sort the pointer list, not the main array! */
-      qsort(sorted_ptrs, g_engine.num_sprites, sizeof(RAY_Sprite *),
+      qsort(sorted_ptrs, num_sorted, sizeof(RAY_Sprite *),
             sprite_ptr_sorter_gpu);
 
-      for (int i = 0; i < g_engine.num_sprites; i++) {
+      for (int i = 0; i < num_sorted; i++) {
         render_sprite_gpu(target, sorted_ptrs[i]);
       }
       free(sorted_ptrs);
@@ -2703,8 +3958,7 @@ void ray_render_scene_gpu(GPU_Target *target, int current_sector) {
   /* Pass 1: Transparent liquids (Drawn after sprites so they can be seen
    * through) */
   visited_clear();
-  render_sector_gpu(target, render_root, full_clip, 0, 0, -99999.0f, 99999.0f,
-                    1);
+  render_root_pass(target, render_root, full_clip, 1);
 
   GPU_FlushBlitBuffer();
   GPU_SetDepthTest(target, 0);
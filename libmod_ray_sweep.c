@@ -0,0 +1,470 @@
+/* ============================================================================
+   libmod_ray_sweep.c - Swept-circle collision against per-sector wall BVHs
+   ============================================================================
+   Each sector gets a small AABB tree over its walls when the map loads. A
+   body (circle of col_radius, col_height tall, feet at z) moving by
+   (dx, dy) gathers the sectors its swept box can touch (its own, the
+   nested ones and the portal neighbours that overlap the box), asks their
+   trees for candidate walls and returns the earliest time of impact with
+   the contact normal. Whether a wall blocks depends on the body: a portal
+   only stops it when the sector beyond is too high to step onto or too
+   low for its height, a solid block only inside its height span.
+   Nothing is allocated per query, and a continuous sweep cannot step over
+   a thin wall at high speed.
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_compat.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern RAY_Engine g_engine;
+
+#define BVH_LEAF_WALLS 4
+#define BVH_MAX_DEPTH 32
+#define SWEEP_MAX_SECTORS 64 /* Sectores revisados por consulta */
+#define SWEEP_NEIGHBOR_DEPTH 4
+#define SWEEP_MIN_RADIUS 1.0f
+
+typedef struct {
+  float min_x, min_y, max_x, max_y;
+  int first; /* Hoja: primera pared en order; interior: hijo izquierdo */
+  int count; /* Paredes de la hoja, 0 = nodo interior (hijos first, +1) */
+} WallBVHNode;
+
+typedef struct {
+  WallBVHNode *nodes;
+  int *order; /* Indices de pared ordenados por hoja */
+  int num_nodes;
+  const RAY_Wall *walls; /* Para detectar cambios en el sector */
+  int num_walls;
+} WallBVH;
+
+static WallBVH *s_bvh = NULL;
+static int s_num_bvh = 0;
+static const RAY_Engine *s_bvh_engine = NULL;
+
+/* ============================================================================
+   BUILD
+   ============================================================================
+ */
+
+static void wall_bounds(const RAY_Wall *w, float *b) {
+  b[0] = fminf(w->x1, w->x2);
+  b[1] = fminf(w->y1, w->y2);
+  b[2] = fmaxf(w->x1, w->x2);
+  b[3] = fmaxf(w->y1, w->y2);
+}
+
+static int bvh_build_node(WallBVH *t, const RAY_Wall *walls, int node,
+                          int first, int count, int depth) {
+  WallBVHNode *n = &t->nodes[node];
+  n->min_x = n->min_y = FLT_MAX;
+  n->max_x = n->max_y = -FLT_MAX;
+  float cmin[2] = {FLT_MAX, FLT_MAX}, cmax[2] = {-FLT_MAX, -FLT_MAX};
+  for (int i = first; i < first + count; i++) {
+    float b[4];
+    wall_bounds(&walls[t->order[i]], b);
+    n->min_x = fminf(n->min_x, b[0]);
+    n->min_y = fminf(n->min_y, b[1]);
+    n->max_x = fmaxf(n->max_x, b[2]);
+    n->max_y = fmaxf(n->max_y, b[3]);
+    for (int k = 0; k < 2; k++) {
+      float c = (b[k] + b[k + 2]) * 0.5f;
+      cmin[k] = fminf(cmin[k], c);
+      cmax[k] = fmaxf(cmax[k], c);
+    }
+  }
+
+  if (count <= BVH_LEAF_WALLS || depth >= BVH_MAX_DEPTH) {
+    n->first = first;
+    n->count = count;
+    return 1;
+  }
+
+  /* Particion por el punto medio de los centros en el eje mas largo */
+  int axis = (cmax[1] - cmin[1] > cmax[0] - cmin[0]) ? 1 : 0;
+  float split = (cmin[axis] + cmax[axis]) * 0.5f;
+  int mid = first;
+  for (int i = first; i < first + count; i++) {
+    float b[4];
+    wall_bounds(&walls[t->order[i]], b);
+    if ((b[axis] + b[axis + 2]) * 0.5f < split) {
+      int tmp = t->order[i];
+      t->order[i] = t->order[mid];
+      t->order[mid++] = tmp;
+    }
+  }
+  if (mid == first || mid == first + count)
+    mid = first + count / 2; /* Centros iguales: partir por la mitad */
+
+  int left = t->num_nodes;
+  t->num_nodes += 2;
+  n->first = left;
+  n->count = 0;
+  return bvh_build_node(t, walls, left, first, mid - first, depth + 1) &&
+         bvh_build_node(t, walls, left + 1, mid, first + count - mid,
+                        depth + 1);
+}
+
+void ray_wall_bvh_free(void) {
+  for (int i = 0; i < s_num_bvh; i++) {
+    free(s_bvh[i].nodes);
+    free(s_bvh[i].order);
+  }
+  free(s_bvh);
+  s_bvh = NULL;
+  s_num_bvh = 0;
+  s_bvh_engine = NULL;
+}
+
+void ray_wall_bvh_build(RAY_Engine *engine) {
+  ray_wall_bvh_free();
+  if (!engine || engine->num_sectors <= 0)
+    return;
+
+  s_bvh = (WallBVH *)calloc(engine->num_sectors, sizeof(WallBVH));
+  if (!s_bvh)
+    return;
+  s_num_bvh = engine->num_sectors;
+  s_bvh_engine = engine;
+
+  int total_nodes = 0;
+  for (int i = 0; i < engine->num_sectors; i++) {
+    RAY_Sector *sector = &engine->sectors[i];
+    WallBVH *t = &s_bvh[i];
+    int n = sector->num_walls;
+    if (n <= 0)
+      continue;
+    /* Un arbol binario con hojas de >= 1 pared tiene menos de 2n nodos */
+    t->nodes = (WallBVHNode *)malloc(2 * n * sizeof(WallBVHNode));
+    t->order = (int *)malloc(n * sizeof(int));
+    if (!t->nodes || !t->order) {
+      free(t->nodes);
+      free(t->order);
+      t->nodes = NULL;
+      t->order = NULL;
+      continue; /* Este sector se recorre pared a pared */
+    }
+    for (int w = 0; w < n; w++)
+      t->order[w] = w;
+    t->num_nodes = 1;
+    bvh_build_node(t, sector->walls, 0, 0, n, 0);
+    t->walls = sector->walls;
+    t->num_walls = n;
+    total_nodes += t->num_nodes;
+  }
+
+  if (engine->verbose)
+    printf("RAY: BVH de paredes: %d sectores, %d nodos\n", s_num_bvh,
+           total_nodes);
+}
+
+/* ============================================================================
+   BLOCKING RULES
+   ============================================================================
+ */
+
+typedef struct {
+  float x0, y0, dx, dy, r;
+  float z, height, step_h;
+  float min_x, min_y, max_x, max_y; /* Caja barrida */
+  int body_sector;                  /* Indice del sector del cuerpo */
+  RAY_SweepHit *hit;
+} SweepQuery;
+
+/* 1 si el cuerpo no cabe en el sector: escalon muy alto o techo bajo */
+static int sector_rejects(const SweepQuery *q, const RAY_Sector *s) {
+  if (s->floor_z - q->z > q->step_h)
+    return 1;
+  return s->ceiling_z - fmaxf(q->z, s->floor_z) < q->height;
+}
+
+static int wall_blocks(RAY_Engine *e, const SweepQuery *q, int owner,
+                       const RAY_Wall *w) {
+  RAY_Sector *S = &e->sectors[owner];
+
+  if (ray_sector_is_solid(S) && owner != q->body_sector) {
+    /* Bloque: para si no se puede subir encima ni pasar por debajo */
+    return S->ceiling_z - q->z > q->step_h && S->floor_z < q->z + q->height;
+  }
+
+  /* Pared entre dos espacios: bloquea si el lado donde no esta el cuerpo
+     no lo admite */
+  int other = -1;
+  if (w->portal_id >= 0) {
+    const RAY_Portal *p = NULL;
+    if (w->portal_id < e->num_portals &&
+        e->portals[w->portal_id].portal_id == w->portal_id) {
+      p = &e->portals[w->portal_id];
+    } else {
+      for (int i = 0; i < e->num_portals && !p; i++)
+        if (e->portals[i].portal_id == w->portal_id)
+          p = &e->portals[i];
+    }
+    if (p)
+      other = ray_sector_index_by_id(
+          e, p->sector_a == S->sector_id ? p->sector_b : p->sector_a);
+  } else {
+    other = ray_sector_index_by_id(e, ray_sector_get_parent(S));
+  }
+  if (other < 0)
+    return 1; /* Borde exterior del mapa */
+
+  if (owner != q->body_sector && sector_rejects(q, S))
+    return 1;
+  if (other != q->body_sector && sector_rejects(q, &e->sectors[other]))
+    return 1;
+  return 0;
+}
+
+/* ============================================================================
+   TIME OF IMPACT
+   ============================================================================
+ */
+
+static void sweep_consider(SweepQuery *q, float t, float nx, float ny,
+                           float cx, float cy, int owner, const RAY_Wall *w) {
+  RAY_SweepHit *hit = q->hit;
+  if (t >= hit->t)
+    return;
+  hit->t = t;
+  hit->nx = nx;
+  hit->ny = ny;
+  hit->x = cx;
+  hit->y = cy;
+  hit->sector_id = g_engine.sectors[owner].sector_id;
+  hit->wall_id = w->wall_id;
+}
+
+/* Circulo contra un extremo: rayo contra circulo de radio r */
+static void sweep_point(SweepQuery *q, float px, float py, int owner,
+                        const RAY_Wall *w) {
+  float fx = q->x0 - px, fy = q->y0 - py;
+  float c = fx * fx + fy * fy - q->r * q->r;
+  float b = fx * q->dx + fy * q->dy;
+  if (b >= 0.0f)
+    return; /* Se aleja del extremo */
+  if (c <= 0.0f) {
+    float len = sqrtf(fx * fx + fy * fy);
+    if (len > 1e-6f)
+      sweep_consider(q, 0.0f, fx / len, fy / len, px, py, owner, w);
+    return;
+  }
+  float a = q->dx * q->dx + q->dy * q->dy;
+  float disc = b * b - a * c;
+  if (disc < 0.0f || a < 1e-12f)
+    return;
+  float t = (-b - sqrtf(disc)) / a;
+  if (t < 0.0f || t > 1.0f)
+    return;
+  float nx = (fx + t * q->dx) / q->r, ny = (fy + t * q->dy) / q->r;
+  sweep_consider(q, t, nx, ny, px, py, owner, w);
+}
+
+static void sweep_wall(RAY_Engine *e, SweepQuery *q, int owner,
+                       const RAY_Wall *w) {
+  float ex = w->x2 - w->x1, ey = w->y2 - w->y1;
+  float len2 = ex * ex + ey * ey;
+  if (len2 < 1e-12f)
+    return;
+  if (!wall_blocks(e, q, owner, w))
+    return;
+
+  /* Cara: normal hacia el lado donde empieza el circulo */
+  float len = sqrtf(len2);
+  float nx = -ey / len, ny = ex / len;
+  float dist = (q->x0 - w->x1) * nx + (q->y0 - w->y1) * ny;
+  if (dist < 0.0f) {
+    nx = -nx;
+    ny = -ny;
+    dist = -dist;
+  }
+  float vn = q->dx * nx + q->dy * ny;
+  if (vn < 0.0f) {
+    float t = dist > q->r ? (dist - q->r) / -vn : 0.0f;
+    if (t <= 1.0f) {
+      float cx = q->x0 + t * q->dx - nx * dist;
+      float cy = q->y0 + t * q->dy - ny * dist;
+      if (dist > q->r) {
+        cx = q->x0 + t * q->dx - nx * q->r;
+        cy = q->y0 + t * q->dy - ny * q->r;
+      }
+      float u = ((cx - w->x1) * ex + (cy - w->y1) * ey) / len2;
+      if (u >= 0.0f && u <= 1.0f) {
+        sweep_consider(q, t, nx, ny, cx, cy, owner, w);
+        return; /* La cara llega antes que los extremos */
+      }
+    }
+  }
+
+  sweep_point(q, w->x1, w->y1, owner, w);
+  sweep_point(q, w->x2, w->y2, owner, w);
+}
+
+static int box_overlaps(const SweepQuery *q, float min_x, float min_y,
+                        float max_x, float max_y) {
+  return !(max_x < q->min_x || min_x > q->max_x || max_y < q->min_y ||
+           min_y > q->max_y);
+}
+
+static void sweep_sector(RAY_Engine *e, SweepQuery *q, int index) {
+  RAY_Sector *sector = &e->sectors[index];
+  WallBVH *t = (s_bvh_engine == e && index < s_num_bvh) ? &s_bvh[index] : NULL;
+
+  if (!t || !t->nodes || t->walls != sector->walls ||
+      t->num_walls != sector->num_walls) {
+    /* Sin arbol o el sector cambio despues de construirlo */
+    for (int i = 0; i < sector->num_walls; i++)
+      sweep_wall(e, q, index, &sector->walls[i]);
+    return;
+  }
+
+  int stack[2 * BVH_MAX_DEPTH + 2];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const WallBVHNode *n = &t->nodes[stack[--top]];
+    if (!box_overlaps(q, n->min_x, n->min_y, n->max_x, n->max_y))
+      continue;
+    if (n->count > 0) {
+      for (int i = n->first; i < n->first + n->count; i++)
+        sweep_wall(e, q, index, &sector->walls[t->order[i]]);
+    } else {
+      stack[top++] = n->first;
+      stack[top++] = n->first + 1;
+    }
+  }
+}
+
+/* ============================================================================
+   SECTOR GATHERING
+   ============================================================================
+ */
+
+typedef struct {
+  int items[SWEEP_MAX_SECTORS];
+  int count;
+} SectorSet;
+
+static int set_add(SectorSet *set, int index) {
+  for (int i = 0; i < set->count; i++)
+    if (set->items[i] == index)
+      return 0;
+  if (set->count == SWEEP_MAX_SECTORS)
+    return 0;
+  set->items[set->count++] = index;
+  return 1;
+}
+
+static int sector_overlaps(const SweepQuery *q, const RAY_Sector *s) {
+  return box_overlaps(q, s->min_x, s->min_y, s->max_x, s->max_y);
+}
+
+static void gather_nested(RAY_Engine *e, const SweepQuery *q, SectorSet *set,
+                          int index, int depth) {
+  RAY_Sector *sector = &e->sectors[index];
+  for (int c = 0; c < sector->num_children && depth < BVH_MAX_DEPTH; c++) {
+    int ci = ray_sector_index_by_id(e, sector->child_sector_ids[c]);
+    if (ci >= 0 && sector_overlaps(q, &e->sectors[ci]) && set_add(set, ci))
+      gather_nested(e, q, set, ci, depth + 1);
+  }
+  if (sector->sector_id != 0)
+    return;
+  /* Bloques colgados de 0 que no estan en su lista de hijos */
+  for (int i = 0; i < e->num_sectors; i++) {
+    RAY_Sector *s = &e->sectors[i];
+    if (s->parent_sector_id == 0 && s->sector_id != 0 &&
+        s->num_portals == 0 && sector_overlaps(q, s) && set_add(set, i))
+      gather_nested(e, q, set, i, depth + 1);
+  }
+}
+
+static void gather_sectors(RAY_Engine *e, const SweepQuery *q, SectorSet *set,
+                           int index, int depth) {
+  if (!set_add(set, index))
+    return;
+  gather_nested(e, q, set, index, 0);
+
+  RAY_Sector *sector = &e->sectors[index];
+  int parent = ray_sector_index_by_id(e, ray_sector_get_parent(sector));
+  if (parent >= 0 && depth < SWEEP_NEIGHBOR_DEPTH)
+    gather_sectors(e, q, set, parent, depth + 1);
+
+  if (depth >= SWEEP_NEIGHBOR_DEPTH)
+    return;
+  for (int p = 0; p < sector->num_portals; p++) {
+    int pid = sector->portal_ids[p];
+    if (pid < 0 || pid >= e->num_portals)
+      continue;
+    const RAY_Portal *portal = &e->portals[pid];
+    float pmin_x = fminf(portal->x1, portal->x2);
+    float pmax_x = fmaxf(portal->x1, portal->x2);
+    float pmin_y = fminf(portal->y1, portal->y2);
+    float pmax_y = fmaxf(portal->y1, portal->y2);
+    if (!box_overlaps(q, pmin_x, pmin_y, pmax_x, pmax_y))
+      continue;
+    int other = ray_sector_index_by_id(
+        e, portal->sector_a == sector->sector_id ? portal->sector_b
+                                                 : portal->sector_a);
+    if (other >= 0)
+      gather_sectors(e, q, set, other, depth + 1);
+  }
+}
+
+/* ============================================================================
+   QUERY
+   ============================================================================
+ */
+
+int ray_sweep_circle(RAY_Engine *engine, float x, float y, float z,
+                     float radius, float height, float step_h, float dx,
+                     float dy, RAY_SweepHit *hit) {
+  if (!engine || !hit || engine->num_sectors <= 0)
+    return 0;
+  hit->t = 1.0f + FLT_EPSILON; /* Ninguno */
+  hit->nx = hit->ny = 0.0f;
+  hit->x = x + dx;
+  hit->y = y + dy;
+  hit->sector_id = -1;
+  hit->wall_id = -1;
+  if (dx == 0.0f && dy == 0.0f)
+    return 0;
+
+  RAY_Sector *start = ray_find_sector_at_position(engine, x, y, z);
+  if (!start)
+    return 0; /* Fuera del mapa: nada contra lo que chocar */
+
+  SweepQuery q;
+  q.x0 = x;
+  q.y0 = y;
+  q.dx = dx;
+  q.dy = dy;
+  q.r = radius > SWEEP_MIN_RADIUS ? radius : SWEEP_MIN_RADIUS;
+  q.z = z;
+  q.height = height > 0.0f ? height : 0.0f;
+  q.step_h = step_h;
+  q.min_x = fminf(x, x + dx) - q.r;
+  q.max_x = fmaxf(x, x + dx) + q.r;
+  q.min_y = fminf(y, y + dy) - q.r;
+  q.max_y = fmaxf(y, y + dy) + q.r;
+  q.body_sector = (int)(start - engine->sectors);
+  q.hit = hit;
+
+  SectorSet set;
+  set.count = 0;
+  gather_sectors(engine, &q, &set, q.body_sector, 0);
+  for (int i = 0; i < set.count; i++)
+    sweep_sector(engine, &q, set.items[i]);
+
+  if (hit->t > 1.0f) {
+    hit->t = 1.0f;
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,489 @@
+/* ============================================================================
+   libmod_ray_trace.c - Batched line traces (line of sight / hitscan)
+   ============================================================================
+   Every segment starts in the sector that holds its origin and walks the
+   portal graph: in each sector it sorts the crossings with the sector's
+   walls and those of its nested sectors, passes portals whose opening
+   contains the segment height and stops at the first solid wall, step,
+   floor/ceiling or (optionally) sprite of the sectors it visits. Solid
+   nested sectors (blocks, buildings) are never entered: crossing one of
+   their walls inside its height blocks, and the parity of the crossings
+   tells when the segment came down on its roof or up into its base.
+   No segment writes shared state, so a batch is split over the render
+   threads in chunks and the result does not depend on the thread count.
+   ============================================================================
+ */
+
+#include "bgddl.h"
+#include "libmod_ray.h"
+#include "libmod_ray_compat.h"
+#include "libmod_ray_pool.h"
+#ifdef __ANDROID__
+#include "SDL.h"
+#else
+#include <SDL2/SDL.h>
+#endif
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern RAY_Engine g_engine;
+
+#define TRACE_MAX_THREADS 16
+#define TRACE_MIN_PARALLEL 64 /* Lotes mas pequenos: solo hilo principal */
+#define TRACE_CHUNK 16        /* Segmentos por reparto entre hilos */
+#define TRACE_MAX_STEPS 256   /* Sectores visitados como mucho */
+#define TRACE_MAX_CROSSINGS 64
+#define TRACE_MAX_BLOCKS 16 /* Bloques solidos seguidos a la vez */
+#define TRACE_MAX_DEPTH 32  /* Anidamiento de sectores */
+#define TRACE_EPSILON 0.01f /* Unidades de mundo tras cruzar una pared */
+
+typedef struct {
+  float t;
+  int owner; /* Indice del sector de la pared */
+  RAY_Wall *wall;
+} TraceCrossing;
+
+/* Bloque solido cruzado por encima o por debajo en el sector actual */
+typedef struct {
+  int index;
+  int inside; /* Paridad: 1 si el punto actual esta dentro del poligono */
+  int above;  /* Entro por encima del techo (si no, por debajo del suelo) */
+} TraceBlock;
+
+typedef struct {
+  float x0, y0, z0, dx, dy, dz;
+  float min_x, min_y, max_x, max_y; /* Caja 2D del segmento */
+  float t_eps;
+  TraceCrossing cross[TRACE_MAX_CROSSINGS];
+  int num_cross;
+} TraceSegment;
+
+/* Lote en curso */
+static RAY_Trace *s_batch = NULL;
+static int s_batch_count = 0;
+static SDL_atomic_t s_next_chunk;
+static SDL_atomic_t s_hits;
+
+/* ============================================================================
+   CROSSINGS
+   ============================================================================
+ */
+
+static void trace_add_crossing(TraceSegment *seg, float t, int owner,
+                               RAY_Wall *wall) {
+  int n = seg->num_cross;
+  if (n == TRACE_MAX_CROSSINGS) {
+    if (t >= seg->cross[n - 1].t)
+      return; /* Se queda con las mas cercanas */
+    n--;
+  }
+  int k = n;
+  while (k > 0 && seg->cross[k - 1].t > t) {
+    seg->cross[k] = seg->cross[k - 1];
+    k--;
+  }
+  seg->cross[k].t = t;
+  seg->cross[k].owner = owner;
+  seg->cross[k].wall = wall;
+  seg->num_cross = n + 1;
+}
+
+static int trace_box_overlaps(const TraceSegment *seg, const RAY_Sector *s) {
+  return !(s->max_x < seg->min_x || s->min_x > seg->max_x ||
+           s->max_y < seg->min_y || s->min_y > seg->max_y);
+}
+
+/* Paredes del sector y de sus anidados cortadas en (t_min, 1] */
+static void trace_collect(RAY_Engine *e, TraceSegment *seg, int index,
+                          float t_min, int depth) {
+  RAY_Sector *sector = &e->sectors[index];
+  for (int i = 0; i < sector->num_walls; i++) {
+    RAY_Wall *w = &sector->walls[i];
+    float wx = w->x2 - w->x1, wy = w->y2 - w->y1;
+    float denom = seg->dx * wy - seg->dy * wx;
+    if (fabsf(denom) < 1e-9f)
+      continue;
+    float ox = w->x1 - seg->x0, oy = w->y1 - seg->y0;
+    float t = (ox * wy - oy * wx) / denom;
+    if (t <= t_min || t > 1.0f)
+      continue;
+    float u = (ox * seg->dy - oy * seg->dx) / denom;
+    if (u < -0.001f || u > 1.001f)
+      continue;
+    trace_add_crossing(seg, t, index, w);
+  }
+
+  if (depth >= TRACE_MAX_DEPTH)
+    return;
+  for (int c = 0; c < sector->num_children; c++) {
+    int ci = ray_sector_index_by_id(e, sector->child_sector_ids[c]);
+    if (ci >= 0 && ci != index && trace_box_overlaps(seg, &e->sectors[ci]))
+      trace_collect(e, seg, ci, t_min, depth + 1);
+  }
+
+  /* Mismo rescate que collect_sector_geometry: bloques colgados de 0 que
+     no estan en su lista de hijos */
+  if (sector->sector_id != 0)
+    return;
+  for (int i = 0; i < e->num_sectors; i++) {
+    const RAY_Sector *s = &e->sectors[i];
+    if (s->sector_id == 0 || s->parent_sector_id != 0 || s->num_portals > 0 ||
+        i == index || !trace_box_overlaps(seg, s))
+      continue;
+    int listed = 0;
+    for (int c = 0; c < sector->num_children && !listed; c++)
+      listed = sector->child_sector_ids[c] == s->sector_id;
+    if (!listed)
+      trace_collect(e, seg, i, t_min, depth + 1);
+  }
+}
+
+static int trace_portal_other(RAY_Engine *e, int portal_id, int sector_id) {
+  const RAY_Portal *p = NULL;
+  if (portal_id >= 0 && portal_id < e->num_portals &&
+      e->portals[portal_id].portal_id == portal_id) {
+    p = &e->portals[portal_id];
+  } else {
+    for (int i = 0; i < e->num_portals && !p; i++)
+      if (e->portals[i].portal_id == portal_id)
+        p = &e->portals[i];
+  }
+  if (!p)
+    return -1;
+  int other = (p->sector_a == sector_id) ? p->sector_b : p->sector_a;
+  return ray_sector_index_by_id(e, other);
+}
+
+/* ============================================================================
+   SPRITES
+   ============================================================================
+ */
+
+/* Primer t en [0, t_max] donde el segmento entra en el cilindro del
+   sprite (radio y altura de colision), o -1 */
+static float trace_sprite_t(const TraceSegment *seg, const RAY_Sprite *s,
+                            float t_max) {
+  float r = (s->col_w > 0) ? s->col_w * 0.5f : s->w * 0.5f;
+  float h = (s->col_h > 0) ? s->col_h : (float)s->h;
+  if (r <= 0.0f || h <= 0.0f)
+    return -1.0f;
+
+  float fx = seg->x0 - s->x, fy = seg->y0 - s->y;
+  float a = seg->dx * seg->dx + seg->dy * seg->dy;
+  float c = fx * fx + fy * fy - r * r;
+  if (c <= 0.0f || a < 1e-9f)
+    return -1.0f; /* Empieza dentro: es quien dispara o lo toca ya */
+  float b = fx * seg->dx + fy * seg->dy;
+  float disc = b * b - a * c;
+  if (b >= 0.0f || disc < 0.0f)
+    return -1.0f;
+  float root = sqrtf(disc);
+  float t_in = (-b - root) / a;
+  float t_out = (-b + root) / a;
+  if (t_in > t_max)
+    return -1.0f;
+  if (t_out > t_max)
+    t_out = t_max;
+
+  /* Altura lineal dentro del cilindro: entra por el lateral o por una tapa */
+  float z_in = seg->z0 + t_in * seg->dz;
+  float z_out = seg->z0 + t_out * seg->dz;
+  float bottom = s->z, top = s->z + h;
+  if (z_in >= bottom && z_in <= top)
+    return t_in;
+  if (z_in > top && z_out <= top)
+    return (top - seg->z0) / seg->dz;
+  if (z_in < bottom && z_out >= bottom)
+    return (bottom - seg->z0) / seg->dz;
+  return -1.0f;
+}
+
+static void trace_sector_sprites(RAY_Engine *e, const TraceSegment *seg,
+                                 int index, int ignore, float t_max,
+                                 float *best_t, int *best) {
+  if (!e->sector_sprite_head || index >= e->sector_sprite_head_capacity)
+    return;
+  for (int i = e->sector_sprite_head[index]; i >= 0;
+       i = e->sprites[i].bin_next) {
+    const RAY_Sprite *s = &e->sprites[i];
+    if (i == ignore || s->hidden || s->cleanup)
+      continue;
+    float t = trace_sprite_t(seg, s, t_max);
+    if (t >= 0.0f && t < *best_t) {
+      *best_t = t;
+      *best = i;
+    }
+  }
+}
+
+/* ============================================================================
+   SEGMENT WALK
+   ============================================================================
+ */
+
+static void trace_result(const RAY_Engine *e, RAY_Trace *tr,
+                         const TraceSegment *seg, int hit, float t,
+                         int sector_index, int wall_id) {
+  tr->hit = hit;
+  tr->fraction = t;
+  tr->hit_x = seg->x0 + t * seg->dx;
+  tr->hit_y = seg->y0 + t * seg->dy;
+  tr->hit_z = seg->z0 + t * seg->dz;
+  tr->sector_id = sector_index >= 0 ? e->sectors[sector_index].sector_id : -1;
+  tr->wall_id = wall_id;
+}
+
+static int in_range(float z, float lo, float hi) {
+  return z >= lo && z <= hi;
+}
+
+static int trace_one(RAY_Engine *e, RAY_Trace *tr) {
+  TraceSegment seg;
+  seg.x0 = tr->x0;
+  seg.y0 = tr->y0;
+  seg.z0 = tr->z0;
+  seg.dx = tr->x1 - tr->x0;
+  seg.dy = tr->y1 - tr->y0;
+  seg.dz = tr->z1 - tr->z0;
+  seg.min_x = fminf(tr->x0, tr->x1);
+  seg.max_x = fmaxf(tr->x0, tr->x1);
+  seg.min_y = fminf(tr->y0, tr->y1);
+  seg.max_y = fmaxf(tr->y0, tr->y1);
+  float len = sqrtf(seg.dx * seg.dx + seg.dy * seg.dy);
+  seg.t_eps = len > TRACE_EPSILON ? TRACE_EPSILON / len : 1.0f;
+
+  tr->sprite = -1;
+  RAY_Sector *start = ray_find_sector_at_position(e, tr->x0, tr->y0, tr->z0);
+  if (!start) {
+    trace_result(e, tr, &seg, RAY_TRACE_HIT_WALL, 0.0f, -1, -1);
+    return 1;
+  }
+  int cur = (int)(start - e->sectors);
+
+  if ((tr->mask & RAY_TRACE_VISIBILITY) && e->pvs_ready) {
+    RAY_Sector *dest =
+        ray_find_sector_at_position(e, tr->x1, tr->y1, tr->z1);
+    if (dest && !ray_pvs_test(cur, (int)(dest - e->sectors))) {
+      trace_result(e, tr, &seg, RAY_TRACE_HIT_WALL, 0.0f, cur, -1);
+      return 1;
+    }
+  }
+
+  /* Sobre el tejado de un bloque: el espacio libre es el de su padre y el
+     bloque empieza como sobrevolado */
+  TraceBlock seed = {-1, 1, 1};
+  if (ray_sector_is_solid(start)) {
+    int parent = ray_sector_index_by_id(e, ray_sector_get_parent(start));
+    if (parent >= 0) {
+      seed.index = cur;
+      seed.above = tr->z0 >= (start->floor_z + start->ceiling_z) * 0.5f;
+      cur = parent;
+    }
+  }
+
+  int ignore =
+      (tr->mask & RAY_TRACE_SPRITES) ? ray_sprite_resolve(tr->ignore) : -1;
+  float t_cur = 0.0f;
+
+  for (int step = 0; step < TRACE_MAX_STEPS; step++) {
+    RAY_Sector *C = &e->sectors[cur];
+    float lo = C->floor_z, hi = C->ceiling_z;
+
+    /* Suelo o techo del sector actual */
+    float t_end = 1.0f;
+    int plane = 0;
+    float z_end = tr->z1;
+    if (seg.dz < 0.0f && z_end < lo) {
+      t_end = (lo - seg.z0) / seg.dz;
+      plane = 1;
+    } else if (seg.dz > 0.0f && z_end > hi) {
+      t_end = (hi - seg.z0) / seg.dz;
+      plane = 1;
+    }
+    if (t_end < t_cur)
+      t_end = t_cur;
+
+    seg.num_cross = 0;
+    if (len > TRACE_EPSILON)
+      trace_collect(e, &seg, cur, t_cur + seg.t_eps, 0);
+
+    TraceBlock blocks[TRACE_MAX_BLOCKS];
+    int num_blocks = 0;
+    if (step == 0 && seed.index >= 0)
+      blocks[num_blocks++] = seed;
+    int next = -1, blocked = 0, hit_owner = cur, hit_wall = -1;
+
+    for (int k = 0; k < seg.num_cross; k++) {
+      const TraceCrossing *x = &seg.cross[k];
+      if (x->t >= t_end)
+        break;
+      float z = seg.z0 + x->t * seg.dz;
+      RAY_Sector *O = &e->sectors[x->owner];
+      int to = -1;
+
+      if (x->owner == cur) {
+        if (ray_wall_is_portal(x->wall))
+          to = trace_portal_other(e, x->wall->portal_id, C->sector_id);
+        else if (!ray_sector_is_solid(C))
+          to = ray_sector_index_by_id(e, C->parent_sector_id);
+      } else if (ray_sector_is_solid(O)) {
+        if (z < O->floor_z || z >= O->ceiling_z) {
+          /* Por encima o por debajo del bloque: sigue en este sector */
+          int b = 0;
+          while (b < num_blocks && blocks[b].index != x->owner)
+            b++;
+          if (b == num_blocks && num_blocks < TRACE_MAX_BLOCKS) {
+            blocks[b].index = x->owner;
+            blocks[b].inside = 0;
+            num_blocks++;
+          }
+          if (b < num_blocks) {
+            blocks[b].inside ^= 1;
+            blocks[b].above = z > O->ceiling_z;
+          }
+          continue;
+        }
+      } else {
+        to = x->owner; /* Sector anidado abierto: se entra en el */
+      }
+
+      if (to >= 0 && to != cur) {
+        const RAY_Sector *N = &e->sectors[to];
+        if (in_range(z, fmaxf(lo, N->floor_z), fminf(hi, N->ceiling_z))) {
+          next = to;
+          t_end = x->t;
+          plane = 0;
+          break;
+        }
+      }
+      blocked = 1;
+      t_end = x->t;
+      plane = 0;
+      hit_owner = x->owner;
+      hit_wall = x->wall->wall_id;
+      break;
+    }
+
+    /* Llega al tejado (o a la base) de un bloque que esta sobrevolando */
+    int roof = -1;
+    for (int b = 0; b < num_blocks; b++) {
+      if (!blocks[b].inside)
+        continue;
+      const RAY_Sector *B = &e->sectors[blocks[b].index];
+      float t = -1.0f;
+      if (blocks[b].above && seg.dz < 0.0f)
+        t = (B->ceiling_z - seg.z0) / seg.dz;
+      else if (!blocks[b].above && seg.dz > 0.0f)
+        t = (B->floor_z - seg.z0) / seg.dz;
+      if (t >= t_cur && t <= t_end) {
+        t_end = t;
+        roof = blocks[b].index;
+      }
+    }
+    if (roof >= 0) {
+      blocked = 0;
+      next = -1;
+      plane = 1;
+      hit_owner = roof;
+    }
+
+    if (tr->mask & RAY_TRACE_SPRITES) {
+      float best_t = FLT_MAX;
+      int best = -1;
+      trace_sector_sprites(e, &seg, cur, ignore, t_end, &best_t, &best);
+      for (int b = 0; b < num_blocks; b++)
+        trace_sector_sprites(e, &seg, blocks[b].index, ignore, t_end, &best_t,
+                             &best);
+      if (best >= 0) {
+        trace_result(e, tr, &seg, RAY_TRACE_HIT_SPRITE, best_t,
+                     e->sprites[best].sector_index, -1);
+        tr->sprite = (int32_t)ray_sprite_handle(best);
+        return 1;
+      }
+    }
+
+    if (blocked) {
+      trace_result(e, tr, &seg, RAY_TRACE_HIT_WALL, t_end, hit_owner, hit_wall);
+      return 1;
+    }
+    if (plane) {
+      trace_result(e, tr, &seg, RAY_TRACE_HIT_PLANE, t_end, hit_owner, -1);
+      return 1;
+    }
+    if (next < 0)
+      break; /* Destino alcanzado */
+    cur = next;
+    t_cur = t_end;
+  }
+
+  trace_result(e, tr, &seg, RAY_TRACE_HIT_NONE, 1.0f, cur, -1);
+  return 0;
+}
+
+/* ============================================================================
+   BATCH / WORKERS
+   ============================================================================
+ */
+
+static void trace_run_chunks(void) {
+  int hits = 0;
+  for (;;) {
+    int first = SDL_AtomicAdd(&s_next_chunk, TRACE_CHUNK);
+    if (first >= s_batch_count)
+      break;
+    int last = first + TRACE_CHUNK;
+    if (last > s_batch_count)
+      last = s_batch_count;
+    for (int i = first; i < last; i++)
+      hits += trace_one(&g_engine, &s_batch[i]);
+  }
+  SDL_AtomicAdd(&s_hits, hits);
+}
+
+static void trace_task(RAY_WorkerPool *pool, int index) {
+  (void)pool;
+  (void)index;
+  trace_run_chunks();
+}
+
+static RAY_WorkerPool s_pool = RAY_POOL_INIT("ray_trace", 0, trace_task);
+
+static int trace_thread_count(void) {
+  return ray_pool_thread_setting(TRACE_MAX_THREADS);
+}
+
+/* Threads worth waking for this batch; the pool itself keeps its size */
+static int trace_active_count(int count) {
+  int n = trace_thread_count();
+  if (n > (count + TRACE_CHUNK - 1) / TRACE_CHUNK)
+    n = (count + TRACE_CHUNK - 1) / TRACE_CHUNK;
+  if (count < TRACE_MIN_PARALLEL)
+    n = 1;
+  return n < 1 ? 1 : n;
+}
+
+int ray_trace_batch(RAY_Trace *traces, int count) {
+  if (!traces || count <= 0 || g_engine.num_sectors <= 0)
+    return 0;
+
+  s_batch = traces;
+  s_batch_count = count;
+  SDL_AtomicSet(&s_next_chunk, 0);
+  SDL_AtomicSet(&s_hits, 0);
+
+  int workers = trace_active_count(count) - 1;
+  if (workers > 0)
+    ray_pool_reserve(&s_pool, trace_thread_count() - 1);
+  workers = ray_pool_dispatch(&s_pool, workers);
+  trace_run_chunks();
+  ray_pool_wait(&s_pool, workers);
+
+  s_batch = NULL;
+  s_batch_count = 0;
+  return SDL_AtomicGet(&s_hits);
+}
+
+void ray_trace_shutdown(void) { ray_pool_stop(&s_pool); }